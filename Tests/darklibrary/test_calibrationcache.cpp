@@ -0,0 +1,150 @@
+/*  KStars tests
+    Calibration cache eviction and budget.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "test_calibrationcache.h"
+
+#include "ekos/auxiliary/calibrationcache.h"
+
+#include <QtTest>
+
+#define NAME "m47_sim_stars.fits"
+
+TestCalibrationCache::TestCalibrationCache(QObject *parent) : QObject(parent)
+{
+}
+
+void TestCalibrationCache::initTestCase()
+{
+    QVERIFY(QFileInfo(NAME).exists());
+
+    m_Frame.reset(new FITSData());
+    QFuture<bool> worker = m_Frame->loadFromFile(NAME);
+    worker.waitForFinished();
+    QVERIFY(worker.result());
+
+    m_FrameBytes = static_cast<qint64>(m_Frame->samplesPerChannel()) * m_Frame->channels() * m_Frame->getBytesPerPixel();
+    QVERIFY(m_FrameBytes > 0);
+}
+
+void TestCalibrationCache::cleanupTestCase()
+{
+    m_Frame.clear();
+}
+
+void TestCalibrationCache::testLeastRecentlyUsedEviction()
+{
+    // Room for two frames only
+    CalibrationCache cache(2 * m_FrameBytes + m_FrameBytes / 2);
+
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "a", m_Frame);
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "b", m_Frame);
+    QCOMPARE(cache.count(), 2);
+    QCOMPARE(cache.usedBytes(), 2 * m_FrameBytes);
+
+    // Looking up "a" makes "b" the least recently used
+    QVERIFY(cache.frame(CalibrationCache::DARK_FRAME, "a"));
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "c", m_Frame);
+
+    QCOMPARE(cache.count(), 2);
+    QCOMPARE(cache.usedBytes(), 2 * m_FrameBytes);
+    QCOMPARE(cache.counters().evictions, 1u);
+    QVERIFY(cache.frame(CalibrationCache::DARK_FRAME, "b").isNull());
+    QVERIFY(cache.frame(CalibrationCache::DARK_FRAME, "a"));
+    QVERIFY(cache.frame(CalibrationCache::DARK_FRAME, "c"));
+
+    // Types do not share keys
+    QVERIFY(cache.frame(CalibrationCache::FLAT_FRAME, "a").isNull());
+
+    // Inserting an existing key replaces it without eviction
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "a", m_Frame);
+    QCOMPARE(cache.count(), 2);
+    QCOMPARE(cache.counters().evictions, 1u);
+
+    cache.remove(CalibrationCache::DARK_FRAME, "a");
+    QCOMPARE(cache.count(), 1);
+    QCOMPARE(cache.usedBytes(), m_FrameBytes);
+}
+
+void TestCalibrationCache::testBudget()
+{
+    // The most recent master is kept even if it exceeds the budget alone
+    CalibrationCache cache(m_FrameBytes / 2);
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "a", m_Frame);
+    QCOMPARE(cache.count(), 1);
+    QCOMPARE(cache.usedBytes(), m_FrameBytes);
+
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "b", m_Frame);
+    QCOMPARE(cache.count(), 1);
+    QVERIFY(cache.frame(CalibrationCache::DARK_FRAME, "b"));
+
+    // Raising the budget keeps everything, lowering it evicts down to the budget
+    cache.setBudget(3 * m_FrameBytes);
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "c", m_Frame);
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "d", m_Frame);
+    QCOMPARE(cache.count(), 3);
+    QCOMPARE(cache.usedBytes(), 3 * m_FrameBytes);
+
+    cache.setBudget(m_FrameBytes);
+    QCOMPARE(cache.count(), 1);
+    QVERIFY(cache.usedBytes() <= cache.budget());
+    QVERIFY(cache.frame(CalibrationCache::DARK_FRAME, "d"));
+
+    cache.clear();
+    QCOMPARE(cache.count(), 0);
+    QCOMPARE(cache.usedBytes(), 0);
+}
+
+void TestCalibrationCache::testDarkModel()
+{
+    // The same master at two durations fits a model without thermal current
+    CalibrationCache cache(4 * m_FrameBytes);
+    QList<QPair<QString, double>> masters;
+    masters << qMakePair(QString(NAME), 1.0) << qMakePair(QString(NAME), 10.0);
+    cache.prefetchDarkModel("model", masters);
+    QVERIFY(cache.isPending(CalibrationCache::DARK_MODEL, "model") || cache.count() == 1);
+
+    // Looking up a model that is still fitting waits for it
+    QSharedPointer<DarkModel> model = cache.darkModel("model");
+    QVERIFY(model);
+    QVERIFY(!cache.isPending(CalibrationCache::DARK_MODEL, "model"));
+    QCOMPARE(model->width(), static_cast<uint32_t>(m_Frame->width()));
+    QCOMPARE(model->height(), static_cast<uint32_t>(m_Frame->height()));
+
+    // Bias and thermal current of every pixel count against the budget
+    const qint64 modelBytes = static_cast<qint64>(m_Frame->samplesPerChannel()) * m_Frame->channels() * 2 * sizeof(float);
+    QCOMPARE(cache.usedBytes(), modelBytes);
+
+    // Models and frames share the budget
+    cache.setBudget(modelBytes + m_FrameBytes / 2);
+    cache.insertFrame(CalibrationCache::DARK_FRAME, "a", m_Frame);
+    QCOMPARE(cache.count(), 1);
+    QVERIFY(cache.darkModel("model").isNull());
+}
+
+void TestCalibrationCache::testFailedDarkModel()
+{
+    // A single duration cannot separate bias from thermal current
+    CalibrationCache cache(4 * m_FrameBytes);
+    QStringList failed;
+    connect(&cache, &CalibrationCache::loadFailed, this, [&failed](CalibrationCache::MasterType type, const QString & key)
+    {
+        QCOMPARE(type, CalibrationCache::DARK_MODEL);
+        failed << key;
+    });
+
+    QList<QPair<QString, double>> masters;
+    masters << qMakePair(QString(NAME), 5.0);
+    cache.prefetchDarkModel("model", masters);
+
+    QVERIFY(cache.darkModel("model").isNull());
+    QCOMPARE(failed, QStringList() << "model");
+    QCOMPARE(cache.count(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestCalibrationCache)
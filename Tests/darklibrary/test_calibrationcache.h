@@ -0,0 +1,38 @@
+/*  KStars tests
+    Calibration cache eviction and budget.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef TEST_CALIBRATIONCACHE_H
+#define TEST_CALIBRATIONCACHE_H
+
+#include <QObject>
+#include <QSharedPointer>
+
+#include "fitsviewer/fitsdata.h"
+
+class TestCalibrationCache : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestCalibrationCache(QObject *parent = nullptr);
+
+    private slots:
+        void initTestCase();
+        void cleanupTestCase();
+
+        void testLeastRecentlyUsedEviction();
+        void testBudget();
+        void testDarkModel();
+        void testFailedDarkModel();
+
+    private:
+        QSharedPointer<FITSData> m_Frame;
+        qint64 m_FrameBytes {0};
+};
+
+#endif // TEST_CALIBRATIONCACHE_H
@@ -0,0 +1,177 @@
+/*  KStars tests
+    Dark frame stacking algorithms.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "test_darkcombiner.h"
+
+#include "ekos/auxiliary/darkcombiner.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <fitsio.h>
+
+#include <cmath>
+#include <vector>
+
+Q_DECLARE_METATYPE(DarkCombiner::Algorithm)
+
+namespace
+{
+const int Width = 37;
+const int Height = 23;
+
+// Offsets of the frames from the level of each pixel. The last frame is an outlier on some pixels.
+const double Offsets[] = {0, 2, -2, 1, -1};
+const int Frames = 5;
+const double HotOutlier = 1000;
+const double ColdOutlier = -1000;
+
+double level(int pixel)
+{
+    return 1000 + (pixel * 13) % 500;
+}
+
+double frameValue(int frame, int pixel)
+{
+    if (frame == Frames - 1 && pixel % 7 == 0)
+        return level(pixel) + HotOutlier;
+    if (frame == Frames - 1 && pixel % 11 == 0)
+        return level(pixel) + ColdOutlier;
+    return level(pixel) + Offsets[frame];
+}
+
+QSharedPointer<FITSData> makeFrame(const QString &filename, int bitpix, int frame, int channels)
+{
+    const long samples = static_cast<long>(Width) * Height * channels;
+    std::vector<double> pixels(samples);
+    for (long i = 0; i < samples; i++)
+        pixels[i] = frameValue(frame, i);
+
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    long naxes[3] = {Width, Height, channels};
+    fits_create_diskfile(&fptr, QFile::encodeName(filename).data(), &status);
+    fits_create_img(fptr, bitpix, channels == 1 ? 2 : 3, naxes, &status);
+    fits_write_img(fptr, TDOUBLE, 1, samples, pixels.data(), &status);
+    fits_close_file(fptr, &status);
+    if (status)
+        return QSharedPointer<FITSData>();
+
+    QSharedPointer<FITSData> data(new FITSData());
+    QFuture<bool> worker = data->loadFromFile(filename);
+    worker.waitForFinished();
+    return worker.result() ? data : QSharedPointer<FITSData>();
+}
+}
+
+TestDarkCombiner::TestDarkCombiner(QObject *parent) : QObject(parent)
+{
+}
+
+void TestDarkCombiner::testCombine_data()
+{
+    QTest::addColumn<int>("BITPIX");
+    QTest::addColumn<int>("CHANNELS");
+    QTest::addColumn<DarkCombiner::Algorithm>("ALGORITHM");
+
+    for (int bitpix : {USHORT_IMG, FLOAT_IMG})
+    {
+        for (int channels : {1, 3})
+        {
+            const QString name = QString("%1-%2").arg(bitpix == USHORT_IMG ? "USHORT" : "FLOAT").arg(channels == 1 ? "MONO" : "RGB");
+            QTest::newRow(qPrintable(name + "-AVERAGE")) << bitpix << channels << DarkCombiner::COMBINE_AVERAGE;
+            QTest::newRow(qPrintable(name + "-MEDIAN")) << bitpix << channels << DarkCombiner::COMBINE_MEDIAN;
+            QTest::newRow(qPrintable(name + "-SIGMA-CLIP")) << bitpix << channels << DarkCombiner::COMBINE_SIGMA_CLIP;
+        }
+    }
+}
+
+void TestDarkCombiner::testCombine()
+{
+    QFETCH(int, BITPIX);
+    QFETCH(int, CHANNELS);
+    QFETCH(DarkCombiner::Algorithm, ALGORITHM);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    DarkCombiner combiner(dir.path(), ALGORITHM);
+    QSharedPointer<FITSData> first;
+    for (int frame = 0; frame < Frames; frame++)
+    {
+        QSharedPointer<FITSData> data = makeFrame(dir.filePath(QString("dark%1.fits").arg(frame)), BITPIX, frame, CHANNELS);
+        QVERIFY(data);
+        QVERIFY(combiner.addFrame(data));
+        if (frame == 0)
+            first = data;
+    }
+    QCOMPARE(combiner.count(), static_cast<uint32_t>(Frames));
+
+    // The scratch file is in the given directory
+    QCOMPARE(QDir(dir.path()).entryList(QStringList("dark_combine_*")).size(), 1);
+
+    const int samples = Width * Height * CHANNELS;
+    std::vector<uint8_t> master(static_cast<size_t>(samples) * first->getBytesPerPixel());
+    QVERIFY(combiner.combine(master.data()));
+
+    for (int i = 0; i < samples; i++)
+    {
+        // Known results of the offsets, with and without an outlier
+        double expected = level(i);
+        const bool hot = i % 7 == 0, cold = !hot && i % 11 == 0;
+        switch (ALGORITHM)
+        {
+            case DarkCombiner::COMBINE_AVERAGE:
+                expected += hot ? (HotOutlier + 1) / Frames : cold ? (ColdOutlier + 1) / Frames : 0;
+                break;
+            case DarkCombiner::COMBINE_MEDIAN:
+                // Sorted offsets with an outlier are -2, 0, 1, 2 and the outlier at either end
+                expected += hot ? 1 : 0;
+                break;
+            case DarkCombiner::COMBINE_SIGMA_CLIP:
+                // The outlier is rejected, the mean of the others is kept
+                expected += (hot || cold) ? 0.25 : 0;
+                break;
+        }
+
+        double value = 0;
+        if (BITPIX == USHORT_IMG)
+        {
+            value = reinterpret_cast<uint16_t const *>(master.data())[i];
+            expected = std::round(expected);
+        }
+        else
+            value = reinterpret_cast<float const *>(master.data())[i];
+
+        QVERIFY2(std::fabs(value - expected) < 1e-3,
+                 qPrintable(QString("pixel %1: %2 instead of %3").arg(i).arg(value).arg(expected)));
+    }
+}
+
+void TestDarkCombiner::testMismatchedFrames()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    DarkCombiner combiner(dir.path());
+    QVERIFY(!combiner.combine(nullptr));
+
+    QSharedPointer<FITSData> mono = makeFrame(dir.filePath("mono.fits"), USHORT_IMG, 0, 1);
+    QSharedPointer<FITSData> color = makeFrame(dir.filePath("color.fits"), USHORT_IMG, 0, 3);
+    QSharedPointer<FITSData> floating = makeFrame(dir.filePath("float.fits"), FLOAT_IMG, 0, 1);
+    QVERIFY(mono && color && floating);
+
+    QVERIFY(combiner.addFrame(mono));
+    QVERIFY(!combiner.addFrame(color));
+    QVERIFY(!combiner.addFrame(floating));
+    QVERIFY(!combiner.addFrame(QSharedPointer<FITSData>()));
+    QCOMPARE(combiner.count(), 1u);
+}
+
+QTEST_GUILESS_MAIN(TestDarkCombiner)
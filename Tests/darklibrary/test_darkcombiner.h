@@ -0,0 +1,27 @@
+/*  KStars tests
+    Dark frame stacking algorithms.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef TEST_DARKCOMBINER_H
+#define TEST_DARKCOMBINER_H
+
+#include <QObject>
+
+class TestDarkCombiner : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestDarkCombiner(QObject *parent = nullptr);
+
+    private slots:
+        void testCombine_data();
+        void testCombine();
+        void testMismatchedFrames();
+};
+
+#endif // TEST_DARKCOMBINER_H
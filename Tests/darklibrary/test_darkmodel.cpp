@@ -0,0 +1,219 @@
+/*  KStars tests
+    Dark frames synthesized from bias and thermal current.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "test_darkmodel.h"
+
+#include "ekos/auxiliary/darkmodel.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <fitsio.h>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+const int Width = 37;
+const int Height = 23;
+
+// Durations of the master darks. Thermal currents are multiples of 0.25, so that the darks hold whole values.
+const double DarkDurations[] = {4, 20, 60};
+
+// Subframe of the light frame in the full frame, and its duration which leaves fractions of a unit in the dark
+const int LightX = 5;
+const int LightY = 7;
+const int LightWidth = 20;
+const int LightHeight = 10;
+const double LightDuration = 45;
+
+double bias(long pixel)
+{
+    return 100 + (pixel * 7) % 50;
+}
+
+double thermal(long pixel)
+{
+    return 0.5 + (pixel % 13) * 0.25;
+}
+
+// Every ninth pixel of the light frame is below the dark, and is clamped at zero
+double lightValue(long pixel)
+{
+    return pixel % 9 == 0 ? 50 : 1000 + (pixel * 11) % 300;
+}
+
+QSharedPointer<FITSData> makeFrame(const QString &filename, int bitpix, const std::vector<double> &pixels, int width,
+                                   int height, int channels)
+{
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    long naxes[3] = {width, height, channels};
+    fits_create_diskfile(&fptr, QFile::encodeName(filename).data(), &status);
+    fits_create_img(fptr, bitpix, channels == 1 ? 2 : 3, naxes, &status);
+    fits_write_img(fptr, TDOUBLE, 1, pixels.size(), const_cast<double *>(pixels.data()), &status);
+    fits_close_file(fptr, &status);
+    if (status)
+        return QSharedPointer<FITSData>();
+
+    QSharedPointer<FITSData> data(new FITSData());
+    QFuture<bool> worker = data->loadFromFile(filename);
+    worker.waitForFinished();
+    return worker.result() ? data : QSharedPointer<FITSData>();
+}
+
+QSharedPointer<FITSData> makeDark(const QString &filename, int bitpix, double duration, int channels)
+{
+    std::vector<double> pixels(static_cast<size_t>(Width) * Height * channels);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = bias(i) + thermal(i) * duration;
+    return makeFrame(filename, bitpix, pixels, Width, Height, channels);
+}
+
+// Index in the full frame of a pixel of the light subframe
+long fullFramePixel(long pixel)
+{
+    const long plane = static_cast<long>(LightWidth) * LightHeight;
+    const long c = pixel / plane, y = (pixel % plane) / LightWidth, x = pixel % LightWidth;
+    return c * Width * Height + (y + LightY) * Width + x + LightX;
+}
+}
+
+TestDarkModel::TestDarkModel(QObject *parent) : QObject(parent)
+{
+}
+
+void TestDarkModel::testFitAndSubtract_data()
+{
+    QTest::addColumn<int>("BITPIX");
+    QTest::addColumn<int>("CHANNELS");
+
+    for (int bitpix : {USHORT_IMG, FLOAT_IMG})
+    {
+        for (int channels : {1, 3})
+        {
+            const QString name = QString("%1-%2").arg(bitpix == USHORT_IMG ? "USHORT" : "FLOAT").arg(channels == 1 ? "MONO" : "RGB");
+            QTest::newRow(qPrintable(name)) << bitpix << channels;
+        }
+    }
+}
+
+void TestDarkModel::testFitAndSubtract()
+{
+    QFETCH(int, BITPIX);
+    QFETCH(int, CHANNELS);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    DarkModel model;
+    for (double duration : DarkDurations)
+    {
+        QSharedPointer<FITSData> dark = makeDark(dir.filePath(QString("dark%1.fits").arg(duration)), BITPIX, duration,
+                                        CHANNELS);
+        QVERIFY(dark);
+        QVERIFY(model.addDark(dark, duration));
+    }
+    QVERIFY(!model.isValid());
+    QVERIFY(model.fit());
+    QVERIFY(model.isValid());
+    QCOMPARE(model.width(), static_cast<uint32_t>(Width));
+    QCOMPARE(model.height(), static_cast<uint32_t>(Height));
+
+    // Fitted bias and thermal current are those the darks were made from
+    const long samples = static_cast<long>(Width) * Height * CHANNELS;
+    QCOMPARE(model.bias().size(), static_cast<size_t>(samples));
+    QCOMPARE(model.thermal().size(), static_cast<size_t>(samples));
+    for (long i = 0; i < samples; i++)
+    {
+        QVERIFY2(std::fabs(model.bias()[i] - bias(i)) < 1e-2,
+                 qPrintable(QString("bias of pixel %1: %2 instead of %3").arg(i).arg(model.bias()[i]).arg(bias(i))));
+        QVERIFY2(std::fabs(model.thermal()[i] - thermal(i)) < 1e-4,
+                 qPrintable(QString("thermal current of pixel %1: %2 instead of %3").arg(i).arg(model.thermal()[i])
+                            .arg(thermal(i))));
+    }
+
+    // Subtract the dark of a duration that was never taken from a subframed light frame
+    const long lightSamples = static_cast<long>(LightWidth) * LightHeight * CHANNELS;
+    std::vector<double> pixels(lightSamples);
+    for (long i = 0; i < lightSamples; i++)
+        pixels[i] = lightValue(i);
+    QSharedPointer<FITSData> light = makeFrame(dir.filePath("light.fits"), BITPIX, pixels, LightWidth, LightHeight,
+                                     CHANNELS);
+    QVERIFY(light);
+    QVERIFY(model.subtract(light, LightDuration, LightX, LightY));
+
+    int clamped = 0, rounded = 0;
+    for (long i = 0; i < lightSamples; i++)
+    {
+        const long pixel = fullFramePixel(i);
+        double expected = lightValue(i) - bias(pixel) - thermal(pixel) * LightDuration;
+        if (expected <= 0)
+        {
+            expected = 0;
+            clamped++;
+        }
+
+        double value = 0;
+        if (BITPIX == USHORT_IMG)
+        {
+            // Integer pixels are rounded to nearest, halves up
+            if (expected != std::floor(expected))
+                rounded++;
+            expected = std::floor(expected + 0.5);
+            value = reinterpret_cast<uint16_t const *>(light->getImageBuffer())[i];
+        }
+        else
+            value = reinterpret_cast<float const *>(light->getImageBuffer())[i];
+
+        QVERIFY2(std::fabs(value - expected) < 1e-2,
+                 qPrintable(QString("light pixel %1: %2 instead of %3").arg(i).arg(value).arg(expected)));
+    }
+    QVERIFY(clamped > 0);
+    if (BITPIX == USHORT_IMG)
+        QVERIFY(rounded > 0);
+}
+
+void TestDarkModel::testInvalidModels()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // Nothing to fit
+    DarkModel model;
+    QVERIFY(!model.fit());
+    QVERIFY(!model.addDark(QSharedPointer<FITSData>(), 10));
+
+    // Darks of a single duration cannot separate bias from thermal current
+    QSharedPointer<FITSData> first = makeDark(dir.filePath("first.fits"), USHORT_IMG, 10, 1);
+    QSharedPointer<FITSData> second = makeDark(dir.filePath("second.fits"), USHORT_IMG, 10, 1);
+    QSharedPointer<FITSData> color = makeDark(dir.filePath("color.fits"), USHORT_IMG, 30, 3);
+    QVERIFY(first && second && color);
+    QVERIFY(model.addDark(first, 10));
+    QVERIFY(model.addDark(second, 10));
+    QVERIFY(!model.addDark(color, 30));
+    QVERIFY(!model.fit());
+    QVERIFY(!model.isValid());
+
+    // A light frame must fit in the model
+    QSharedPointer<FITSData> longer = makeDark(dir.filePath("longer.fits"), USHORT_IMG, 30, 1);
+    QVERIFY(longer);
+    QVERIFY(model.addDark(longer, 30));
+    QVERIFY(model.fit());
+
+    std::vector<double> pixels(static_cast<size_t>(LightWidth) * LightHeight, 1000);
+    QSharedPointer<FITSData> light = makeFrame(dir.filePath("light.fits"), USHORT_IMG, pixels, LightWidth, LightHeight, 1);
+    QVERIFY(light);
+    QVERIFY(!model.subtract(light, LightDuration, Width - LightWidth + 1, 0));
+    QVERIFY(!model.subtract(light, LightDuration, 0, Height - LightHeight + 1));
+    QVERIFY(model.subtract(light, LightDuration, Width - LightWidth, Height - LightHeight));
+}
+
+QTEST_GUILESS_MAIN(TestDarkModel)
@@ -0,0 +1,27 @@
+/*  KStars tests
+    Dark frames synthesized from bias and thermal current.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef TEST_DARKMODEL_H
+#define TEST_DARKMODEL_H
+
+#include <QObject>
+
+class TestDarkModel : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestDarkModel(QObject *parent = nullptr);
+
+    private slots:
+        void testFitAndSubtract_data();
+        void testFitAndSubtract();
+        void testInvalidModels();
+};
+
+#endif // TEST_DARKMODEL_H
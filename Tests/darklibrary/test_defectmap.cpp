@@ -0,0 +1,343 @@
+/*  KStars tests
+    Defect map tables and median correction.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "test_defectmap.h"
+
+#include "ekos/auxiliary/defectmap.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QRect>
+#include <QSet>
+#include <QtTest>
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+namespace
+{
+const int Width = 150;
+const int Height = 140;
+
+struct Defect
+{
+    int x, y;
+    bool hot;
+    // Whether the value is beyond the threshold of the map aggressiveness.
+    bool enabled;
+};
+
+// Defects on the frame edges, next to each other and around bucket boundaries, plus a scatter of
+// defects of which a third are below the aggressiveness thresholds.
+std::vector<Defect> makeDefects()
+{
+    std::vector<Defect> defects =
+    {
+        {0, 0, true, true}, {Width - 1, Height - 1, true, true}, {0, 70, true, true}, {75, 0, true, true},
+        {Width - 1, 30, true, true}, {40, Height - 1, true, true}, {Width - 1, 0, false, true},
+        {0, Height - 1, false, true}, {1, 1, false, true}, {Width - 2, Height - 2, false, true},
+        {30, 30, true, true}, {31, 30, true, true}, {30, 31, false, true},
+        {20, 63, true, true}, {20, 64, false, true}, {21, 65, true, true}, {22, 127, false, true}, {23, 128, true, true}
+    };
+
+    QSet<int> used;
+    for (const auto &oneDefect : defects)
+        used.insert(oneDefect.x + oneDefect.y * Width);
+
+    for (int i = 0; i < 200; i++)
+    {
+        const int x = (i * 37 + 11) % Width;
+        const int y = (i * 53 + 7) % Height;
+        if (used.contains(x + y * Width))
+            continue;
+        used.insert(x + y * Width);
+        defects.push_back({x, y, i % 2 == 1, i % 3 != 0});
+    }
+
+    return defects;
+}
+
+const std::vector<Defect> Defects = makeDefects();
+
+bool isCorrected(const Defect &defect, const QRect &subFrame, bool hotEnabled, bool coldEnabled)
+{
+    if (!defect.enabled || (defect.hot && !hotEnabled) || (!defect.hot && !coldEnabled))
+        return false;
+
+    const int x = defect.x - subFrame.x();
+    const int y = defect.y - subFrame.y();
+    return x >= 1 && y >= 1 && x < subFrame.width() - 1 && y < subFrame.height() - 1;
+}
+
+QVector<uint32_t> referenceOffsets(const QRect &subFrame, bool hotEnabled, bool coldEnabled)
+{
+    QVector<uint32_t> offsets;
+    for (const auto &oneDefect : Defects)
+    {
+        if (isCorrected(oneDefect, subFrame, hotEnabled, coldEnabled))
+            offsets.append((oneDefect.x - subFrame.x()) + (oneDefect.y - subFrame.y()) * subFrame.width());
+    }
+    std::sort(offsets.begin(), offsets.end());
+    return offsets;
+}
+
+// Median of the eight neighbours the way it was computed before the sorting network.
+template <typename T>
+T referenceMedian(uint32_t offset, uint32_t width, T const *buffer)
+{
+    T const *top = buffer + offset - width - 1;
+    T const *mid = buffer + offset - 1;
+    T const *bot = buffer + offset + width - 1;
+    std::array<T, 8> e = {{ top[0], top[1], top[2], mid[0], mid[2], bot[0], bot[1], bot[2] }};
+
+    std::nth_element(e.begin(), e.begin() + 4, e.end());
+    const T upper = e[4];
+    const T lower = *std::max_element(e.begin(), e.begin() + 4);
+    auto median = (lower + upper) / 2;
+    return median;
+}
+
+template <typename T, typename Distribution>
+void compareMedians(Distribution distribution)
+{
+    std::mt19937 generator(42);
+    std::array<T, 9> window;
+    for (int i = 0; i < 10000; i++)
+    {
+        for (auto &value : window)
+            value = static_cast<T>(distribution(generator));
+        QCOMPARE(DefectMap::median3x3Filter<T>(4, 3, window.data()), referenceMedian<T>(4, 3, window.data()));
+    }
+}
+
+void addSubFrameRows()
+{
+    QTest::addColumn<QRect>("SUBFRAME");
+    QTest::addColumn<bool>("HOT");
+    QTest::addColumn<bool>("COLD");
+
+    const QList<QPair<QString, QRect>> subFrames =
+    {
+        {"full", QRect(0, 0, Width, Height)},
+        {"inner", QRect(10, 20, 100, 90)},
+        {"top-left", QRect(0, 0, 64, 64)},
+        {"bottom-right", QRect(50, 40, Width - 50, Height - 40)},
+        {"single", QRect(29, 29, 3, 3)}
+    };
+
+    for (const auto &oneSubFrame : subFrames)
+    {
+        QTest::newRow(qPrintable(oneSubFrame.first + " hot cold")) << oneSubFrame.second << true << true;
+        QTest::newRow(qPrintable(oneSubFrame.first + " hot")) << oneSubFrame.second << true << false;
+        QTest::newRow(qPrintable(oneSubFrame.first + " cold")) << oneSubFrame.second << false << true;
+        QTest::newRow(qPrintable(oneSubFrame.first + " none")) << oneSubFrame.second << false << false;
+    }
+}
+}
+
+TestDefectMap::TestDefectMap(QObject *parent) : QObject(parent)
+{
+}
+
+void TestDefectMap::initTestCase()
+{
+    QVERIFY(m_TempDir.isValid());
+
+    // Median 100 and deviation 10 at aggressiveness 75 put the thresholds at about 120 and 80.
+    QJsonArray hot, cold;
+    int hotCount = 0, coldCount = 0;
+    for (size_t i = 0; i < Defects.size(); i++)
+    {
+        const Defect &oneDefect = Defects[i];
+        double value = 0;
+        if (oneDefect.hot)
+        {
+            value = oneDefect.enabled ? 1000 + i : 110;
+            hotCount += oneDefect.enabled ? 1 : 0;
+        }
+        else
+        {
+            value = oneDefect.enabled ? i % 50 : 90;
+            coldCount += oneDefect.enabled ? 1 : 0;
+        }
+        (oneDefect.hot ? hot : cold).append(BadPixel(oneDefect.x, oneDefect.y, value).json());
+    }
+
+    QJsonObject root;
+    root.insert("camera", "Test Camera");
+    root.insert("median", 100);
+    root.insert("standardDeviation", 10);
+    root.insert("hotAggressiveness", 75);
+    root.insert("coldAggressiveness", 75);
+    root.insert("hot", hot);
+    root.insert("cold", cold);
+
+    const QString filename = m_TempDir.filePath("defectmap.json");
+    QFile output(filename);
+    QVERIFY(output.open(QIODevice::WriteOnly));
+    output.write(QJsonDocument(root).toJson());
+    output.close();
+
+    m_DefectMap.reset(new DefectMap());
+    QVERIFY(m_DefectMap->load(filename));
+    m_DefectMap->filterPixels();
+    QCOMPARE(static_cast<int>(m_DefectMap->hotCount()), hotCount);
+    QCOMPARE(static_cast<int>(m_DefectMap->coldCount()), coldCount);
+}
+
+void TestDefectMap::testMedian3x3()
+{
+    compareMedians<uint8_t>(std::uniform_int_distribution<int>(0, 255));
+    if (QTest::currentTestFailed())
+        return;
+    // Few distinct values to exercise ties.
+    compareMedians<uint8_t>(std::uniform_int_distribution<int>(0, 3));
+    if (QTest::currentTestFailed())
+        return;
+    compareMedians<int16_t>(std::uniform_int_distribution<int>(-32768, 32767));
+    if (QTest::currentTestFailed())
+        return;
+    compareMedians<uint16_t>(std::uniform_int_distribution<int>(0, 65535));
+    if (QTest::currentTestFailed())
+        return;
+    compareMedians<int32_t>(std::uniform_int_distribution<int>(-1000000, 1000000));
+    if (QTest::currentTestFailed())
+        return;
+    compareMedians<float>(std::uniform_real_distribution<float>(-10000, 10000));
+    if (QTest::currentTestFailed())
+        return;
+    compareMedians<double>(std::uniform_real_distribution<double>(-10000, 10000));
+}
+
+void TestDefectMap::testDefectTable_data()
+{
+    addSubFrameRows();
+}
+
+void TestDefectMap::testDefectTable()
+{
+    QFETCH(QRect, SUBFRAME);
+    QFETCH(bool, HOT);
+    QFETCH(bool, COLD);
+
+    // Toggling must drop the tables cached by the previous rows.
+    m_DefectMap->setHotEnabled(HOT);
+    m_DefectMap->setColdEnabled(COLD);
+
+    QSharedPointer<DefectTable> table = m_DefectMap->defectTable(SUBFRAME);
+    QVERIFY(table);
+    QCOMPARE(table->offsets, referenceOffsets(SUBFRAME, HOT, COLD));
+    QVERIFY(m_DefectMap->defectTable(SUBFRAME) == table);
+
+    const int width = SUBFRAME.width();
+    const int bucketCount = (SUBFRAME.height() + DefectTable::RowsPerBucket - 1) / DefectTable::RowsPerBucket;
+    QCOMPARE(table->buckets.size(), bucketCount + 1);
+    QCOMPARE(table->buckets.first(), 0u);
+    QCOMPARE(static_cast<int>(table->buckets.last()), table->offsets.size());
+    for (int bucket = 0; bucket < bucketCount; bucket++)
+    {
+        QVERIFY(table->buckets[bucket] <= table->buckets[bucket + 1]);
+        for (uint32_t i = table->buckets[bucket]; i < table->buckets[bucket + 1]; i++)
+            QCOMPARE(static_cast<int>(table->offsets[i] / width / DefectTable::RowsPerBucket), bucket);
+    }
+}
+
+void TestDefectMap::testDefectTableCache()
+{
+    const QList<QRect> subFrames =
+    {
+        QRect(0, 0, Width, Height), QRect(10, 20, 100, 90), QRect(0, 0, 64, 64), QRect(50, 40, Width - 50, Height - 40),
+        QRect(29, 29, 3, 3)
+    };
+
+    m_DefectMap->setHotEnabled(true);
+    m_DefectMap->setColdEnabled(true);
+
+    QList<QSharedPointer<DefectTable>> tables;
+    for (int i = 0; i < 4; i++)
+        tables.append(m_DefectMap->defectTable(subFrames[i]));
+
+    // Using the first subframe again leaves the second one as the least recently used, dropped for the fifth
+    QVERIFY(m_DefectMap->defectTable(subFrames[0]) == tables[0]);
+    tables.append(m_DefectMap->defectTable(subFrames[4]));
+    QVERIFY(m_DefectMap->defectTable(subFrames[0]) == tables[0]);
+    QVERIFY(m_DefectMap->defectTable(subFrames[2]) == tables[2]);
+    QVERIFY(m_DefectMap->defectTable(subFrames[3]) == tables[3]);
+    QVERIFY(m_DefectMap->defectTable(subFrames[4]) == tables[4]);
+
+    QSharedPointer<DefectTable> rebuilt = m_DefectMap->defectTable(subFrames[1]);
+    QVERIFY(rebuilt != tables[1]);
+    QCOMPARE(rebuilt->offsets, tables[1]->offsets);
+    QCOMPARE(rebuilt->buckets, tables[1]->buckets);
+}
+
+void TestDefectMap::testCorrection_data()
+{
+    addSubFrameRows();
+}
+
+void TestDefectMap::testCorrection()
+{
+    QFETCH(QRect, SUBFRAME);
+    QFETCH(bool, HOT);
+    QFETCH(bool, COLD);
+
+    m_DefectMap->setHotEnabled(HOT);
+    m_DefectMap->setColdEnabled(COLD);
+
+    const int width = SUBFRAME.width();
+    const int height = SUBFRAME.height();
+    std::vector<uint16_t> original(static_cast<size_t>(width) * height);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            original[x + y * width] = 1000 + ((x + SUBFRAME.x()) * 31 + (y + SUBFRAME.y()) * 17) % 97;
+
+    for (const auto &oneDefect : Defects)
+    {
+        if (!SUBFRAME.contains(oneDefect.x, oneDefect.y))
+            continue;
+        const int offset = (oneDefect.x - SUBFRAME.x()) + (oneDefect.y - SUBFRAME.y()) * width;
+        original[offset] = oneDefect.hot ? 60000 : 10;
+    }
+
+    // Same two passes as the dark library: all medians first from the original values, then replacement.
+    QSharedPointer<DefectTable> table = m_DefectMap->defectTable(SUBFRAME);
+    std::vector<uint16_t> corrected = original;
+    std::vector<uint16_t> values(table->offsets.size());
+    for (int bucket = 0; bucket < table->buckets.size() - 1; bucket++)
+        for (uint32_t i = table->buckets[bucket]; i < table->buckets[bucket + 1]; i++)
+            values[i] = DefectMap::median3x3Filter(table->offsets[i], width, original.data());
+    for (int i = 0; i < table->offsets.size(); i++)
+        corrected[table->offsets[i]] = values[i];
+
+    std::vector<uint16_t> expected = original;
+    for (const auto &oneDefect : Defects)
+    {
+        if (!isCorrected(oneDefect, SUBFRAME, HOT, COLD))
+            continue;
+        const uint32_t offset = (oneDefect.x - SUBFRAME.x()) + (oneDefect.y - SUBFRAME.y()) * width;
+        expected[offset] = referenceMedian(offset, width, original.data());
+    }
+
+    for (size_t i = 0; i < expected.size(); i++)
+        QCOMPARE(corrected[i], expected[i]);
+
+    // Defects without a full neighbourhood in the subframe are left alone.
+    for (const auto &oneDefect : Defects)
+    {
+        const int x = oneDefect.x - SUBFRAME.x();
+        const int y = oneDefect.y - SUBFRAME.y();
+        if ((x == 0 || y == 0 || x == width - 1 || y == height - 1) && SUBFRAME.contains(oneDefect.x, oneDefect.y))
+            QCOMPARE(corrected[x + y * width], original[x + y * width]);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestDefectMap)
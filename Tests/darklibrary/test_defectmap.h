@@ -0,0 +1,43 @@
+/*  KStars tests
+    Defect map tables and median correction.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef TEST_DEFECTMAP_H
+#define TEST_DEFECTMAP_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QTemporaryDir>
+
+class DefectMap;
+
+class TestDefectMap : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestDefectMap(QObject *parent = nullptr);
+
+    private slots:
+        void initTestCase();
+
+        void testMedian3x3();
+
+        void testDefectTable_data();
+        void testDefectTable();
+
+        void testDefectTableCache();
+
+        void testCorrection_data();
+        void testCorrection();
+
+    private:
+        QTemporaryDir m_TempDir;
+        QSharedPointer<DefectMap> m_DefectMap;
+};
+
+#endif // TEST_DEFECTMAP_H
@@ -0,0 +1,162 @@
+/*  KStars tests
+    Image buffer pool size classes and recycling.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "testfitsbufferpool.h"
+
+#include "fitsviewer/fitsbufferpool.h"
+
+#include <QtTest>
+
+#include <algorithm>
+
+namespace
+{
+const size_t Budget = 64 * 1024 * 1024;
+}
+
+TestFitsBufferPool::TestFitsBufferPool(QObject *parent) : QObject(parent)
+{
+}
+
+void TestFitsBufferPool::init()
+{
+    FITSBufferPool::Instance()->setIdleBudget(Budget);
+    FITSBufferPool::Instance()->trim();
+}
+
+void TestFitsBufferPool::cleanup()
+{
+    FITSBufferPool::Instance()->trim();
+}
+
+void TestFitsBufferPool::testSizeClass_data()
+{
+    QTest::addColumn<qulonglong>("SIZE");
+    QTest::addColumn<qulonglong>("CAPACITY");
+
+    QTest::newRow("64KiB") << 65536ull << 65536ull;
+    QTest::newRow("64KiB+1") << 65537ull << 69632ull;
+    QTest::newRow("100000") << 100000ull << 102400ull;
+    QTest::newRow("1000000") << 1000000ull << 1015808ull;
+    QTest::newRow("16MiB") << 16777216ull << 16777216ull;
+    QTest::newRow("16MiB+1") << 16777217ull << 17825792ull;
+}
+
+void TestFitsBufferPool::testSizeClass()
+{
+    QFETCH(qulonglong, SIZE);
+    QFETCH(qulonglong, CAPACITY);
+
+    QCOMPARE(static_cast<qulonglong>(FITSBufferPool::sizeClass(SIZE)), CAPACITY);
+}
+
+void TestFitsBufferPool::testSizeClassWaste()
+{
+    // Capacities grow with sizes and waste at most a sixteenth of the size, or a page for small sizes
+    size_t previous = 0;
+    for (size_t size = 64 * 1024; size < 256 * 1024 * 1024; size += size / 7 + 1)
+    {
+        const size_t capacity = FITSBufferPool::sizeClass(size);
+        QVERIFY(capacity >= size);
+        QVERIFY(capacity >= previous);
+        QVERIFY2(capacity - size < std::max<size_t>(4096, size / 16), qPrintable(QString::number(size)));
+        previous = capacity;
+    }
+}
+
+void TestFitsBufferPool::testReuse()
+{
+    FITSBufferPool *pool = FITSBufferPool::Instance();
+    const FITSBufferPool::Statistics before = pool->statistics();
+
+    uint8_t *first = pool->acquire(100000);
+    QVERIFY(first != nullptr);
+    pool->release(first);
+    QCOMPARE(pool->statistics().idleBytes, FITSBufferPool::sizeClass(100000));
+
+    // Same class, the idle buffer is handed over
+    uint8_t *second = pool->acquire(99900);
+    QCOMPARE(second, first);
+    QCOMPARE(pool->statistics().idleBytes, static_cast<size_t>(0));
+
+    // Another class, a new buffer is allocated
+    uint8_t *third = pool->acquire(200000);
+    QVERIFY(third != nullptr);
+    QVERIFY(third != first);
+
+    FITSBufferPool::Statistics after = pool->statistics();
+    QCOMPARE(after.allocations - before.allocations, static_cast<uint64_t>(2));
+    QCOMPARE(after.reuses - before.reuses, static_cast<uint64_t>(1));
+    QCOMPARE(after.inUseBytes - before.inUseBytes, FITSBufferPool::sizeClass(100000) + FITSBufferPool::sizeClass(200000));
+
+    pool->release(second);
+    pool->release(third);
+    after = pool->statistics();
+    QCOMPARE(after.inUseBytes, before.inUseBytes);
+    QCOMPARE(after.idleBytes, FITSBufferPool::sizeClass(100000) + FITSBufferPool::sizeClass(200000));
+
+    pool->trim();
+    QCOMPARE(pool->statistics().idleBytes, static_cast<size_t>(0));
+}
+
+void TestFitsBufferPool::testSmallBuffersNotPooled()
+{
+    FITSBufferPool *pool = FITSBufferPool::Instance();
+    const FITSBufferPool::Statistics before = pool->statistics();
+
+    uint8_t *buffer = pool->acquire(1024);
+    QVERIFY(buffer != nullptr);
+    pool->release(buffer);
+
+    const FITSBufferPool::Statistics after = pool->statistics();
+    QCOMPARE(after.allocations, before.allocations);
+    QCOMPARE(after.reuses, before.reuses);
+    QCOMPARE(after.inUseBytes, before.inUseBytes);
+    QCOMPARE(after.idleBytes, before.idleBytes);
+}
+
+void TestFitsBufferPool::testReleaseUnknownBuffer()
+{
+    FITSBufferPool *pool = FITSBufferPool::Instance();
+    const FITSBufferPool::Statistics before = pool->statistics();
+
+    // Buffers the pool did not allocate are deleted, not kept idle
+    pool->release(new uint8_t[200000]);
+    pool->release(nullptr);
+
+    const FITSBufferPool::Statistics after = pool->statistics();
+    QCOMPARE(after.inUseBytes, before.inUseBytes);
+    QCOMPARE(after.idleBytes, before.idleBytes);
+
+    // And they are never handed over
+    uint8_t *buffer = pool->acquire(200000);
+    QCOMPARE(pool->statistics().allocations - before.allocations, static_cast<uint64_t>(1));
+    pool->release(buffer);
+}
+
+void TestFitsBufferPool::testIdleBudget()
+{
+    FITSBufferPool *pool = FITSBufferPool::Instance();
+    const size_t capacity = FITSBufferPool::sizeClass(100000);
+    pool->setIdleBudget(capacity);
+
+    uint8_t *first = pool->acquire(100000);
+    uint8_t *second = pool->acquire(100000);
+    QVERIFY(first != second);
+    pool->release(first);
+    pool->release(second);
+
+    // Only one buffer fits in the budget
+    QCOMPARE(pool->statistics().idleBytes, capacity);
+
+    pool->setIdleBudget(0);
+    QCOMPARE(pool->statistics().idleBytes, static_cast<size_t>(0));
+}
+
+QTEST_GUILESS_MAIN(TestFitsBufferPool)
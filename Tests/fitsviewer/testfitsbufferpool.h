@@ -0,0 +1,34 @@
+/*  KStars tests
+    Image buffer pool size classes and recycling.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef TESTFITSBUFFERPOOL_H
+#define TESTFITSBUFFERPOOL_H
+
+#include <QObject>
+
+class TestFitsBufferPool : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestFitsBufferPool(QObject *parent = nullptr);
+
+    private slots:
+        void init();
+        void cleanup();
+
+        void testSizeClass_data();
+        void testSizeClass();
+        void testSizeClassWaste();
+        void testReuse();
+        void testSmallBuffersNotPooled();
+        void testReleaseUnknownBuffer();
+        void testIdleBudget();
+};
+
+#endif // TESTFITSBUFFERPOOL_H
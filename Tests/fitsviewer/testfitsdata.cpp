@@ -9,11 +9,118 @@
  */
 
 #include <QtTest>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
 #include "testfitsdata.h"
+#include "fitsviewer/fitsconvolution.h"
+#include "fitsviewer/fitsthumbnailcache.h"
+#include "fitsviewer/fpack.h"
+#include "fitsviewer/stretch.h"
+#include "skypoint.h"
+#include "Options.h"
 
 Q_DECLARE_METATYPE(FITSMode);
 
+namespace
+{
+#ifdef Q_OS_WIN
+const char * const TemporaryPathVariable = "TMP";
+#else
+const char * const TemporaryPathVariable = "TMPDIR";
+#endif
+
+// Points the system temporary directory at a private empty directory while in scope, so that a test can
+// check what was written there without racing other processes writing to the shared one.
+class ScopedTemporaryPath
+{
+    public:
+        ScopedTemporaryPath() : m_Saved(qgetenv(TemporaryPathVariable)),
+            m_WasSet(qEnvironmentVariableIsSet(TemporaryPathVariable))
+        {
+            if (m_Dir.isValid())
+                qputenv(TemporaryPathVariable, QFile::encodeName(m_Dir.path()));
+        }
+
+        ~ScopedTemporaryPath()
+        {
+            if (m_WasSet)
+                qputenv(TemporaryPathVariable, m_Saved);
+            else
+                qunsetenv(TemporaryPathVariable);
+        }
+
+        bool isValid() const
+        {
+            return m_Dir.isValid() && QDir(QDir::tempPath()).canonicalPath() == QDir(m_Dir.path()).canonicalPath();
+        }
+
+        QStringList entries() const
+        {
+            return QDir(m_Dir.path()).entryList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+        }
+
+    private:
+        // Created in the original temporary directory, before the variable is changed
+        QTemporaryDir m_Dir;
+        QByteArray m_Saved;
+        bool m_WasSet;
+};
+
+// Replace a scatter of pixels and the first maximum, the way defect correction does, keeping their values.
+template <typename T>
+void replacePixels(uint8_t *image, uint32_t samples, std::vector<double> &oldValues, std::vector<double> &newValues)
+{
+    T * const buffer = reinterpret_cast<T *>(image);
+    const uint32_t maximum = std::max_element(buffer, buffer + samples) - buffer;
+    for (uint32_t i = 0; i < samples; i += 97)
+    {
+        const uint32_t offset = i == 0 ? maximum : i;
+        if (i != 0 && offset == maximum)
+            continue;
+        oldValues.push_back(buffer[offset]);
+        buffer[offset] = static_cast<T>((offset * 7919u) % std::numeric_limits<T>::max());
+        newValues.push_back(buffer[offset]);
+    }
+}
+
+// The single-threaded 2D filter FITSData::gaussianBlur used before FITSConvolution, as a benchmark reference.
+// It writes in place, and pixels out of the image are dropped from the kernel.
+template <typename T>
+void serialFilter2D(T *image, int width, int height, const QVector<float> &kernel, int kernelSize)
+{
+    const int fOff = (kernelSize - 1) / 2;
+    for (int offsetY = 0; offsetY < height; offsetY++)
+    {
+        for (int offsetX = 0; offsetX < width; offsetX++)
+        {
+            T gt = 0;
+            const int byteOffset = offsetY * width + offsetX;
+            for (int filterY = -fOff; filterY <= fOff; filterY++)
+            {
+                for (int filterX = -fOff; filterX <= fOff; filterX++)
+                {
+                    if ((offsetY + filterY) >= 0 && (offsetY + filterY) < height
+                            && (offsetX + filterX) >= 0 && (offsetX + filterX) < width)
+                    {
+                        const int calcOffset = byteOffset + filterX + filterY * width;
+                        const int index = (filterY + fOff) * kernelSize + (filterX + fOff);
+                        gt += image[calcOffset] * static_cast<double>(kernel.at(index));
+                    }
+                }
+            }
+            image[byteOffset] = gt;
+        }
+    }
+}
+}
+
 TestFitsData::TestFitsData(QObject *parent) : QObject(parent)
 {
 }
@@ -179,11 +286,11 @@ void TestFitsData::initGenericDataFixture()
             << 2.08     // HFR found with the StellarSolver detection
             << 41.08    // ADU
             << 41.08    // Mean
-            << 360.18   // StdDev
+            << 360.29   // StdDev
             << 0.114    // SNR
             << 57832L   // Max
             << 21L      // Min
-            << 0.0      // Median
+            << 31.0     // Median
             << QRect(591 - 16 / 2, 482 - 16 / 2, 16, 16);
 #endif
 }
@@ -240,7 +347,6 @@ void TestFitsData::testLoadFits()
     QCOMPARE((long)fd->getMax(), MAXIMUM);
     QCOMPARE((long)fd->getMin(), MINIMUM);
 
-    QWARN("No MEDIAN calculation in the current implementation");
     QVERIFY(abs(fd->getMedian() - MEDIAN) < 0.01);
 
     // Without searching for stars, there are no stars found
@@ -288,6 +394,140 @@ void TestFitsData::testLoadFits()
 #endif
 }
 
+void TestFitsData::testLoadCompressedFits_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+
+    QTest::newRow("M47") << "m47_sim_stars.fits";
+    QTest::newRow("NGC4535-1") << "ngc4535-autofocus1.fits";
+#endif
+}
+
+void TestFitsData::testLoadCompressedFits()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping compressed load test because of missing fixture");
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString compressed = dir.filePath(NAME + ".fz");
+
+    // Rice compression of integer data is lossless
+    fpstate fpvar;
+    fp_init(&fpvar);
+    int isLossLess = 0;
+    QVERIFY(fp_pack(QFile::encodeName(NAME).data(), QFile::encodeName(compressed).data(), fpvar, &isLossLess) >= 0);
+
+    ScopedTemporaryPath temporaryPath;
+    QVERIFY(temporaryPath.isValid());
+
+    std::unique_ptr<FITSData> plain(new FITSData());
+    QFuture<bool> worker = plain->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+
+    std::unique_ptr<FITSData> packed(new FITSData());
+    worker = packed->loadFromFile(compressed);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+
+    QVERIFY(packed->isCompressed());
+    QCOMPARE(packed->filename(), compressed);
+    QCOMPARE(packed->width(), plain->width());
+    QCOMPARE(packed->height(), plain->height());
+    QCOMPARE(packed->dataType(), plain->dataType());
+    QCOMPARE(memcmp(packed->getImageBuffer(), plain->getImageBuffer(),
+                    plain->samplesPerChannel() * plain->channels() * plain->getBytesPerPixel()), 0);
+    QCOMPARE(packed->getRecords().count() > 0, true);
+
+    // Nothing else should have been written next to the compressed file
+    QCOMPARE(QDir(dir.path()).entryList(QDir::Files).count(), 1);
+
+    // The image is decompressed in memory, no uncompressed copy goes through the temporary directory
+    QVERIFY2(temporaryPath.entries().isEmpty(), qPrintable(temporaryPath.entries().join(", ")));
+#endif
+}
+
+void TestFitsData::testLoadMappedFits_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+    QTest::addColumn<bool>("MAPPED");
+
+    // Only unscaled 8-bit data is in native layout on little endian hosts
+    QTest::newRow("BAHTINOV") << "bahtinov-focus.fits" << true;
+    QTest::newRow("M47") << "m47_sim_stars.fits" << (QSysInfo::ByteOrder == QSysInfo::BigEndian);
+#endif
+}
+
+void TestFitsData::testLoadMappedFits()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+    QFETCH(bool, MAPPED);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping mapped load test because of missing fixture");
+
+    const bool memoryMap = Options::memoryMapFITS();
+    ScopedTemporaryPath temporaryPath;
+    QVERIFY(temporaryPath.isValid());
+
+    Options::setMemoryMapFITS(false);
+    std::unique_ptr<FITSData> copied(new FITSData());
+    QFuture<bool> worker = copied->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    QVERIFY(!copied->isMapped());
+
+    Options::setMemoryMapFITS(true);
+    std::unique_ptr<FITSData> mapped(new FITSData());
+    worker = mapped->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    std::unique_ptr<FITSData> writable(new FITSData());
+    worker = writable->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    Options::setMemoryMapFITS(memoryMap);
+
+    QCOMPARE(mapped->isMapped(), MAPPED);
+    QCOMPARE(writable->isMapped(), MAPPED);
+
+    const uint32_t size = copied->samplesPerChannel() * copied->channels() * copied->getBytesPerPixel();
+    QCOMPARE(memcmp(mapped->getImageBuffer(), copied->getImageBuffer(), size), 0);
+    QCOMPARE(mapped->getMean(), copied->getMean());
+    QCOMPARE(mapped->getMax(), copied->getMax());
+
+    // Flipping produces a heap buffer, the file is left untouched
+    mapped->applyFilter(FITS_FLIP_H);
+    copied->applyFilter(FITS_FLIP_H);
+    QVERIFY(!mapped->isMapped());
+    QCOMPARE(memcmp(mapped->getImageBuffer(), copied->getImageBuffer(), size), 0);
+
+    // Asking for a writable buffer always detaches from the file, keeping the contents
+    QVERIFY(writable->getWritableImageBuffer() != nullptr);
+    QVERIFY(!writable->isMapped());
+    writable->applyFilter(FITS_FLIP_H);
+    QCOMPARE(memcmp(writable->getImageBuffer(), copied->getImageBuffer(), size), 0);
+
+    // Neither mapping nor detaching goes through a temporary copy of the file
+    QVERIFY2(temporaryPath.entries().isEmpty(), qPrintable(temporaryPath.entries().join(", ")));
+#endif
+}
+
 void TestFitsData::testCentroidAlgorithmBenchmark_data()
 {
 #if QT_VERSION < 0x050900
@@ -348,6 +588,71 @@ void TestFitsData::testGradientAlgorithmBenchmark()
 #endif
 }
 
+void TestFitsData::testTiledDetectionBenchmark_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+    QTest::addColumn<FITSMode>("MODE");
+    QTest::addColumn<int>("ALGORITHM");
+
+    QTest::newRow("M47-CENTROID") << "m47_sim_stars.fits" << FITS_NORMAL << static_cast<int>(ALGORITHM_CENTROID);
+    QTest::newRow("M47-GRADIENT") << "m47_sim_stars.fits" << FITS_NORMAL << static_cast<int>(ALGORITHM_GRADIENT);
+    QTest::newRow("NGC4535-1-CENTROID") << "ngc4535-autofocus1.fits" << FITS_FOCUS << static_cast<int>(ALGORITHM_CENTROID);
+    QTest::newRow("NGC4535-1-GRADIENT") << "ngc4535-autofocus1.fits" << FITS_FOCUS << static_cast<int>(ALGORITHM_GRADIENT);
+    QTest::newRow("NGC4535-2-CENTROID") << "ngc4535-autofocus2.fits" << FITS_FOCUS << static_cast<int>(ALGORITHM_CENTROID);
+    QTest::newRow("NGC4535-2-GRADIENT") << "ngc4535-autofocus2.fits" << FITS_FOCUS << static_cast<int>(ALGORITHM_GRADIENT);
+    QTest::newRow("NGC4535-3-CENTROID") << "ngc4535-autofocus3.fits" << FITS_FOCUS << static_cast<int>(ALGORITHM_CENTROID);
+    QTest::newRow("NGC4535-3-GRADIENT") << "ngc4535-autofocus3.fits" << FITS_FOCUS << static_cast<int>(ALGORITHM_GRADIENT);
+#endif
+}
+
+void TestFitsData::testTiledDetectionBenchmark()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+    QFETCH(FITSMode, MODE);
+    QFETCH(int, ALGORITHM);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping tiled detection benchmark because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData(MODE));
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+
+    StarAlgorithm const algorithm = static_cast<StarAlgorithm>(ALGORITHM);
+
+    // Reference from the serial detection
+    d->setSourceExtractorSettings({{"THREADS", 1}});
+    d->findStars(algorithm).waitForFinished();
+    QList<Edge> serial;
+    for (auto const * center : d->getStarCenters())
+        serial.append(*center);
+
+    // Enough tiles to split the frame whatever the number of cores
+    d->setSourceExtractorSettings({{"THREADS", 8}});
+    QBENCHMARK { d->findStars(algorithm).waitForFinished(); }
+
+    QList<Edge *> const &tiled = d->getStarCenters();
+    QCOMPARE(tiled.count(), serial.count());
+    for (int i = 0; i < serial.count(); i++)
+    {
+        // Masses of the gradient detection are summed per tile, which may round differently
+        QVERIFY(std::abs(tiled[i]->x - serial[i].x) < 0.01);
+        QVERIFY(std::abs(tiled[i]->y - serial[i].y) < 0.01);
+        QVERIFY(std::abs(tiled[i]->HFR - serial[i].HFR) < 0.01);
+        QCOMPARE(tiled[i]->width, serial[i].width);
+    }
+#endif
+}
+
 void TestFitsData::testThresholdAlgorithmBenchmark_data()
 {
 #if QT_VERSION < 0x050900
@@ -410,4 +715,1005 @@ void TestFitsData::testSEPAlgorithmBenchmark()
 #endif
 }
 
+void TestFitsData::testConvolution_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+    QTest::addColumn<int>("KERNEL_SIZE");
+    QTest::addColumn<double>("SIGMA");
+
+    QTest::newRow("M47-3x3") << "m47_sim_stars.fits" << 3 << 1.0;
+    QTest::newRow("M47-5x5") << "m47_sim_stars.fits" << 5 << 1.5;
+    QTest::newRow("NGC4535-1-9x9") << "ngc4535-autofocus1.fits" << 9 << 2.5;
+#endif
+}
+
+void TestFitsData::testConvolution()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+    QFETCH(int, KERNEL_SIZE);
+    QFETCH(double, SIGMA);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping convolution test because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    QCOMPARE(d->dataType(), static_cast<uint32_t>(TUSHORT));
+
+    const int w = d->width(), h = d->height();
+    const uint32_t samples = d->samplesPerChannel() * d->channels();
+    auto const * original = reinterpret_cast<uint16_t const *>(d->getImageBuffer());
+    std::vector<uint16_t> separable(original, original + samples);
+    std::vector<uint16_t> full(original, original + samples);
+
+    // A constant image must remain constant, including borders
+    std::vector<uint16_t> flat(w * h, 1234);
+    FITSConvolution::separableFilter<uint16_t>(flat.data(), w, h, 1, FITSConvolution::gaussianKernel(KERNEL_SIZE, SIGMA));
+    QVERIFY(std::all_of(flat.begin(), flat.end(), [](uint16_t v)
+    {
+        return v == 1234;
+    }));
+
+    // Separable and full 2D kernels must agree to rounding
+    FITSConvolution::separableFilter<uint16_t>(separable.data(), w, h, d->channels(),
+            FITSConvolution::gaussianKernel(KERNEL_SIZE, SIGMA));
+    FITSConvolution::filter2D<uint16_t>(full.data(), w, h, d->channels(),
+                                        FITSConvolution::gaussianKernel2D(KERNEL_SIZE, SIGMA), KERNEL_SIZE);
+
+    int maxDifference = 0;
+    for (uint32_t i = 0; i < samples; i++)
+        maxDifference = std::max(maxDifference, std::abs(static_cast<int>(separable[i]) - static_cast<int>(full[i])));
+    QVERIFY(maxDifference <= 1);
+
+    // Blurring must not change the mean beyond rounding
+    const double sumOriginal = std::accumulate(original, original + samples, 0.0);
+    const double sumBlurred = std::accumulate(separable.begin(), separable.end(), 0.0);
+    QVERIFY(std::abs(sumOriginal - sumBlurred) / samples < 1.0);
+#endif
+}
+
+void TestFitsData::testConvolutionBenchmark_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+    QTest::addColumn<QString>("PATH");
+
+    QTest::newRow("M47-SERIAL") << "m47_sim_stars.fits" << "serial";
+    QTest::newRow("M47-2D") << "m47_sim_stars.fits" << "2d";
+    QTest::newRow("M47-SEPARABLE") << "m47_sim_stars.fits" << "separable";
+#endif
+}
+
+void TestFitsData::testConvolutionBenchmark()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+    QFETCH(QString, PATH);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping convolution benchmark because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    QCOMPARE(d->dataType(), static_cast<uint32_t>(TUSHORT));
+
+    auto * buffer = reinterpret_cast<uint16_t *>(d->getWritableImageBuffer());
+    const int kernelSize = 5;
+    const double sigma = 1.5;
+
+    // The serial row is the filter gaussianBlur used to run, to compare both new paths against it
+    if (PATH == "separable")
+    {
+        const QVector<float> kernel = FITSConvolution::gaussianKernel(kernelSize, sigma);
+        QBENCHMARK { FITSConvolution::separableFilter<uint16_t>(buffer, d->width(), d->height(), d->channels(), kernel); }
+    }
+    else if (PATH == "2d")
+    {
+        const QVector<float> kernel = FITSConvolution::gaussianKernel2D(kernelSize, sigma);
+        QBENCHMARK { FITSConvolution::filter2D<uint16_t>(buffer, d->width(), d->height(), d->channels(), kernel, kernelSize); }
+    }
+    else
+    {
+        const QVector<float> kernel = FITSConvolution::gaussianKernel2D(kernelSize, sigma);
+        QBENCHMARK { serialFilter2D<uint16_t>(buffer, d->width(), d->height(), kernel, kernelSize); }
+    }
+#endif
+}
+
+void TestFitsData::testCalculateStatsBenchmark_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+
+    QTest::newRow("BAHTINOV") << "bahtinov-focus.fits";
+    QTest::newRow("M47") << "m47_sim_stars.fits";
+    QTest::newRow("NGC4535") << "ngc4535-autofocus1.fits";
+#endif
+}
+
+void TestFitsData::testCalculateStatsBenchmark()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping statistics benchmark because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    QCOMPARE(d->channels(), 1);
+
+    // Reference values computed the straightforward way, in several passes
+    const uint32_t samples = d->samplesPerChannel();
+    std::vector<double> values(samples);
+    switch (d->dataType())
+    {
+        case TBYTE:
+            std::copy_n(d->getImageBuffer(), samples, values.begin());
+            break;
+        case TUSHORT:
+            std::copy_n(reinterpret_cast<uint16_t const *>(d->getImageBuffer()), samples, values.begin());
+            break;
+        default:
+            QFAIL("Unexpected fixture data type");
+    }
+
+    const double mean = std::accumulate(values.begin(), values.end(), 0.0) / samples;
+    double squares = 0;
+    for (const double value : values)
+        squares += (value - mean) * (value - mean);
+    const auto minmax = std::minmax_element(values.begin(), values.end());
+
+    d->calculateStats(true);
+    QCOMPARE(d->getMin(), *minmax.first);
+    QCOMPARE(d->getMax(), *minmax.second);
+    QVERIFY(std::abs(d->getMean() - mean) < 1e-6);
+    QVERIFY(std::abs(d->getStdDev() - std::sqrt(squares / samples)) < 1e-6);
+
+    QBENCHMARK { d->calculateStats(true); }
+#endif
+}
+
+void TestFitsData::testPercentiles_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+
+    QTest::newRow("BAHTINOV") << "bahtinov-focus.fits";
+    QTest::newRow("M47") << "m47_sim_stars.fits";
+#endif
+}
+
+void TestFitsData::testPercentiles()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping percentile test because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+
+    const uint32_t samples = d->samplesPerChannel();
+    std::vector<double> sorted(samples);
+    switch (d->dataType())
+    {
+        case TBYTE:
+            std::copy_n(d->getImageBuffer(), samples, sorted.begin());
+            break;
+        case TUSHORT:
+            std::copy_n(reinterpret_cast<uint16_t const *>(d->getImageBuffer()), samples, sorted.begin());
+            break;
+        default:
+            QFAIL("Unexpected fixture data type");
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    // Integer images have exact percentiles, whatever their size
+    for (const double fraction : {0.0, 0.01, 0.25, 0.5, 0.75, 0.99, 0.999, 1.0})
+        QCOMPARE(d->getPercentile(fraction), sorted[std::lround(fraction * (samples - 1))]);
+    QCOMPARE(d->getMedian(), d->getPercentile(0.5));
+
+    // The distribution follows changes to the image
+    d->applyFilter(FITS_FLIP_H);
+    QCOMPARE(d->getPercentile(0.5), sorted[samples / 2]);
+    std::fill_n(d->getWritableImageBuffer(), samples * d->getBytesPerPixel(), 0);
+    QCOMPARE(d->getPercentile(1.0), 0.0);
+#endif
+}
+
+void TestFitsData::testUpdateStatistics_data()
+{
+    testPercentiles_data();
+}
+
+void TestFitsData::testUpdateStatistics()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping statistics update test because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    d->calculateStats(true);
+
+    const uint32_t samples = d->samplesPerChannel();
+    std::vector<double> oldValues, newValues;
+    switch (d->dataType())
+    {
+        case TBYTE:
+            replacePixels<uint8_t>(d->getWritableImageBuffer(), samples, oldValues, newValues);
+            break;
+        case TUSHORT:
+            replacePixels<uint16_t>(d->getWritableImageBuffer(), samples, oldValues, newValues);
+            break;
+        default:
+            QFAIL("Unexpected fixture data type");
+    }
+
+    // The update from the replaced values matches a full recomputation
+    d->updateStatistics(oldValues, newValues);
+    const FITSImage::Statistic updated = d->getStatistics();
+    const double percentile = d->getPercentile(0.9);
+    d->calculateStats(true);
+
+    QCOMPARE(updated.median[0], d->getMedian());
+    QCOMPARE(updated.min[0], d->getMin());
+    QCOMPARE(updated.max[0], d->getMax());
+    QCOMPARE(percentile, d->getPercentile(0.9));
+    QVERIFY(std::fabs(updated.mean[0] - d->getMean()) <= 1e-9 * d->getMax());
+    QVERIFY(std::fabs(updated.stddev[0] - d->getStdDev()) <= 1e-6 * d->getStdDev());
+#endif
+}
+
+void TestFitsData::testHistogram_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+
+    QTest::newRow("BAHTINOV") << "bahtinov-focus.fits";
+    QTest::newRow("M47") << "m47_sim_stars.fits";
+    QTest::newRow("NGC4535-1") << "ngc4535-autofocus1.fits";
+#endif
+}
+
+void TestFitsData::testHistogram()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping histogram test because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+
+    d->constructHistogram();
+    QVERIFY(d->isHistogramConstructed());
+
+    for (uint8_t n = 0; n < d->channels(); n++)
+    {
+        // Every pixel is counted once, whatever the number of threads
+        const QVector<double> &frequency = d->getHistogramFrequency(n);
+        const QVector<uint32_t> &cumulative = d->getCumulativeFrequency(n);
+        QVERIFY(!frequency.isEmpty());
+        QCOMPARE(cumulative.size(), frequency.size());
+        QCOMPARE(d->getHistogramIntensity(n).size(), frequency.size());
+        QCOMPARE(cumulative.last(), d->samplesPerChannel());
+        QVERIFY(std::is_sorted(cumulative.begin(), cumulative.end()));
+        QCOMPARE(std::accumulate(frequency.begin(), frequency.end(), 0.0), static_cast<double>(d->samplesPerChannel()));
+
+        // The cumulative distribution agrees with the exact percentiles to a bin
+        const double binWidth = d->getHistogramBinWidth(n);
+        for (const double fraction : {0.01, 0.25, 0.5, 0.75, 0.99})
+        {
+            const double value = d->getHistogramValue(fraction, n);
+            QVERIFY(std::abs(value - d->getPercentile(fraction, n)) <= 2 * binWidth);
+            QVERIFY(std::abs(d->getHistogramFraction(value, n) - fraction) < 0.01);
+        }
+        QCOMPARE(d->getHistogramFraction(d->getMin(n) - 1, n), 0.0);
+        QCOMPARE(d->getHistogramFraction(d->getMax(n) + binWidth, n), 1.0);
+    }
+#endif
+}
+
+void TestFitsData::testStretchBenchmark_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+    QTest::addColumn<bool>("LUT");
+    QTest::addColumn<int>("SAMPLING");
+
+    QTest::newRow("M47-FORMULA") << "m47_sim_stars.fits" << false << 1;
+    QTest::newRow("M47-LUT") << "m47_sim_stars.fits" << true << 1;
+    QTest::newRow("M47-FORMULA-SAMPLED") << "m47_sim_stars.fits" << false << 2;
+    QTest::newRow("M47-LUT-SAMPLED") << "m47_sim_stars.fits" << true << 2;
+    QTest::newRow("BAHTINOV-FORMULA") << "bahtinov-focus.fits" << false << 1;
+    QTest::newRow("BAHTINOV-LUT") << "bahtinov-focus.fits" << true << 1;
+#endif
+}
+
+void TestFitsData::testStretchBenchmark()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+    QFETCH(bool, LUT);
+    QFETCH(int, SAMPLING);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping stretch benchmark because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+
+    const int width = (d->width() + SAMPLING - 1) / SAMPLING;
+    const int height = (d->height() + SAMPLING - 1) / SAMPLING;
+    QImage reference(width, height, QImage::Format_Indexed8);
+    QImage image(width, height, QImage::Format_Indexed8);
+
+    Stretch stretch(d->width(), d->height(), d->channels(), d->dataType());
+    stretch.setParams(stretch.computeParams(d->getImageBuffer()));
+
+    // Both paths must produce the very same image
+    stretch.setUseLookupTable(false);
+    stretch.run(d->getImageBuffer(), &reference, SAMPLING);
+    stretch.setUseLookupTable(LUT);
+    stretch.run(d->getImageBuffer(), &image, SAMPLING);
+    for (int y = 0; y < height; y++)
+        QCOMPARE(memcmp(image.constScanLine(y), reference.constScanLine(y), width), 0);
+
+    // A tile, as stretched by the tile pyramid, must match the same area of the whole image
+    const int tileSize = 256;
+    const QRect region(tileSize * SAMPLING, tileSize * SAMPLING, tileSize * SAMPLING, tileSize * SAMPLING);
+    QImage tile(tileSize, tileSize, QImage::Format_Indexed8);
+    stretch.run(d->getImageBuffer(), &tile, region, SAMPLING);
+    for (int y = 0; y < tileSize; y++)
+        QCOMPARE(memcmp(tile.constScanLine(y), reference.constScanLine(tileSize + y) + tileSize, tileSize), 0);
+
+    QBENCHMARK { stretch.run(d->getImageBuffer(), &image, SAMPLING); }
+#endif
+}
+
+void TestFitsData::testRegionStatistics_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+    QTest::addColumn<QRect>("REGION");
+
+    QTest::newRow("M47-FULL") << "m47_sim_stars.fits" << QRect(0, 0, 1280, 1024);
+    QTest::newRow("M47-BOX") << "m47_sim_stars.fits" << QRect(600, 400, 32, 32);
+    QTest::newRow("M47-CORNER") << "m47_sim_stars.fits" << QRect(1270, 1000, 64, 64);
+    QTest::newRow("M47-PIXEL") << "m47_sim_stars.fits" << QRect(17, 3, 1, 1);
+    QTest::newRow("BAHTINOV-STRIP") << "bahtinov-focus.fits" << QRect(0, 500, 1280, 7);
+    QTest::newRow("BAHTINOV-BOX") << "bahtinov-focus.fits" << QRect(300, 200, 250, 120);
+#endif
+}
+
+void TestFitsData::testRegionStatistics()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+    QFETCH(QRect, REGION);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping region statistics test because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+
+    // Reference values from the pixels of the region
+    double mean = 0, stddev = 0;
+    QVERIFY(!d->hasIntegralImages());
+    QVERIFY(d->getRegionStatistics(REGION, mean, stddev));
+
+    if (REGION == QRect(0, 0, d->width(), d->height()))
+    {
+        QVERIFY(abs(mean - d->getMean()) < 1e-6);
+        QVERIFY(abs(stddev - d->getStdDev()) < 1e-6);
+    }
+
+    // Same values from the summed-area tables
+    double integralMean = 0, integralStdDev = 0;
+    d->buildIntegralImages();
+    QVERIFY(d->hasIntegralImages());
+    QVERIFY(d->getRegionStatistics(REGION, integralMean, integralStdDev));
+    QVERIFY(abs(integralMean - mean) < 1e-6 * std::max(1.0, abs(mean)));
+    QVERIFY(abs(integralStdDev - stddev) < 1e-6 * std::max(1.0, stddev));
+
+    // Regions out of the image have no statistics
+    QVERIFY(!d->getRegionStatistics(QRect(d->width(), 0, 10, 10), mean, stddev));
+
+    // The tables are dropped when the image changes
+    d->applyFilter(FITS_FLIP_H);
+    QVERIFY(!d->hasIntegralImages());
+
+    QBENCHMARK { d->getRegionStatistics(REGION, integralMean, integralStdDev); }
+#endif
+}
+
+void TestFitsData::testDebayer_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+    QTest::addColumn<int>("METHOD");
+    QTest::addColumn<int>("FILTER");
+
+    QTest::newRow("M47-NEAREST") << "m47_sim_stars.fits" << static_cast<int>(DC1394_BAYER_METHOD_NEAREST)
+                                 << static_cast<int>(DC1394_COLOR_FILTER_RGGB);
+    QTest::newRow("M47-BILINEAR") << "m47_sim_stars.fits" << static_cast<int>(DC1394_BAYER_METHOD_BILINEAR)
+                                  << static_cast<int>(DC1394_COLOR_FILTER_GRBG);
+    QTest::newRow("M47-HQLINEAR") << "m47_sim_stars.fits" << static_cast<int>(DC1394_BAYER_METHOD_HQLINEAR)
+                                  << static_cast<int>(DC1394_COLOR_FILTER_BGGR);
+    QTest::newRow("M47-VNG") << "m47_sim_stars.fits" << static_cast<int>(DC1394_BAYER_METHOD_VNG)
+                             << static_cast<int>(DC1394_COLOR_FILTER_GBRG);
+    QTest::newRow("M47-SIMPLE") << "m47_sim_stars.fits" << static_cast<int>(DC1394_BAYER_METHOD_SIMPLE)
+                                << static_cast<int>(DC1394_COLOR_FILTER_GRBG);
+    QTest::newRow("M47-EDGESENSE") << "m47_sim_stars.fits" << static_cast<int>(DC1394_BAYER_METHOD_EDGESENSE)
+                                   << static_cast<int>(DC1394_COLOR_FILTER_BGGR);
+    QTest::newRow("M47-AHD") << "m47_sim_stars.fits" << static_cast<int>(DC1394_BAYER_METHOD_AHD)
+                             << static_cast<int>(DC1394_COLOR_FILTER_RGGB);
+    QTest::newRow("M47-SUPERPIXEL") << "m47_sim_stars.fits" << static_cast<int>(DC1394_BAYER_METHOD_DOWNSAMPLE)
+                                    << static_cast<int>(DC1394_COLOR_FILTER_RGGB);
+    QTest::newRow("BAHTINOV-BILINEAR") << "bahtinov-focus.fits" << static_cast<int>(DC1394_BAYER_METHOD_BILINEAR)
+                                       << static_cast<int>(DC1394_COLOR_FILTER_RGGB);
+    QTest::newRow("BAHTINOV-VNG") << "bahtinov-focus.fits" << static_cast<int>(DC1394_BAYER_METHOD_VNG)
+                                  << static_cast<int>(DC1394_COLOR_FILTER_GRBG);
+    QTest::newRow("BAHTINOV-HQLINEAR") << "bahtinov-focus.fits" << static_cast<int>(DC1394_BAYER_METHOD_HQLINEAR)
+                                       << static_cast<int>(DC1394_COLOR_FILTER_GBRG);
+    QTest::newRow("BAHTINOV-SUPERPIXEL") << "bahtinov-focus.fits" << static_cast<int>(DC1394_BAYER_METHOD_DOWNSAMPLE)
+                                         << static_cast<int>(DC1394_COLOR_FILTER_BGGR);
+#endif
+}
+
+void TestFitsData::testDebayer()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+    QFETCH(int, METHOD);
+    QFETCH(int, FILTER);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping debayer test because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QVERIFY(d != nullptr);
+
+    QFuture<bool> worker = d->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    QCOMPARE(d->channels(), 1);
+
+    // Use the mono fixture as a mosaic
+    const int width = d->width(), height = d->height();
+    const int bpp = d->getBytesPerPixel();
+    const QByteArray mosaic(reinterpret_cast<const char *>(d->getImageBuffer()), width * height * bpp);
+
+    BayerParams params;
+    params.method = static_cast<dc1394bayer_method_t>(METHOD);
+    params.filter = static_cast<dc1394color_filter_t>(FILTER);
+    params.offsetX = params.offsetY = 0;
+    d->setBayerParams(&params);
+    QVERIFY(d->debayer());
+    QCOMPARE(d->channels(), 3);
+
+    if (params.method == DC1394_BAYER_METHOD_DOWNSAMPLE)
+    {
+        // One pixel per 2x2 cell, the green being the average of both green samples
+        QCOMPARE(static_cast<int>(d->width()), width / 2);
+        QCOMPARE(static_cast<int>(d->height()), height / 2);
+        if (bpp == 1)
+        {
+            auto const * in = reinterpret_cast<uint8_t const *>(mosaic.constData());
+            auto const * out = d->getImageBuffer();
+            const uint32_t samples = d->samplesPerChannel();
+            const int x = 100, y = 70;
+            QCOMPARE(out[2 * samples + y * d->width() + x], in[(2 * y) * width + 2 * x]);
+            QCOMPARE(out[y * d->width() + x], in[(2 * y + 1) * width + 2 * x + 1]);
+            QCOMPARE(static_cast<int>(out[samples + y * d->width() + x]),
+                     (in[(2 * y) * width + 2 * x + 1] + in[(2 * y + 1) * width + 2 * x] + 1) / 2);
+        }
+    }
+    else
+    {
+        // Decoding in parallel bands must produce the same planes as decoding the whole image at once
+        QCOMPARE(static_cast<int>(d->width()), width);
+        QCOMPARE(static_cast<int>(d->height()), height);
+        std::vector<uint8_t> rgb(mosaic.size() * 3);
+        if (bpp == 1)
+            QCOMPARE(dc1394_bayer_decoding_8bit(reinterpret_cast<const uint8_t *>(mosaic.constData()), rgb.data(),
+                                                width, height, params.filter, params.method), DC1394_SUCCESS);
+        else
+            QCOMPARE(dc1394_bayer_decoding_16bit(reinterpret_cast<const uint16_t *>(mosaic.constData()),
+                                                 reinterpret_cast<uint16_t *>(rgb.data()),
+                                                 width, height, params.filter, params.method, 16), DC1394_SUCCESS);
+
+        // Every pixel is compared, as a race between bands may only spoil a few of them
+        auto const * planes = d->getImageBuffer();
+        const size_t samples = static_cast<size_t>(width) * height;
+        size_t mismatches = 0;
+        for (int c = 0; c < 3; c++)
+            for (size_t i = 0; i < samples; i++)
+                if (memcmp(planes + (c * samples + i) * bpp, rgb.data() + (i * 3 + c) * bpp, bpp) != 0)
+                    mismatches++;
+        QCOMPARE(mismatches, static_cast<size_t>(0));
+    }
+
+    // The mosaic is read again from the file before every run
+    QBENCHMARK { d->debayer(true); }
+    QCOMPARE(d->channels(), 3);
+#endif
+}
+
+void TestFitsData::testRotation_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<int>("BITPIX");
+    QTest::addColumn<int>("WIDTH");
+    QTest::addColumn<int>("HEIGHT");
+    QTest::addColumn<int>("CHANNELS");
+
+    const QList<QPair<QString, int>> types =
+    {
+        {"BYTE", BYTE_IMG}, {"SHORT", SHORT_IMG}, {"USHORT", USHORT_IMG}, {"LONG", LONG_IMG},
+        {"ULONG", ULONG_IMG}, {"FLOAT", FLOAT_IMG}, {"LONGLONG", LONGLONG_IMG}, {"DOUBLE", DOUBLE_IMG}
+    };
+
+    // Sizes are not multiple of the transpose tiles, the square one is transposed in place
+    for (const auto &type : types)
+    {
+        QTest::newRow(qPrintable(type.first + "-MONO")) << type.second << 301 << 131 << 1;
+        QTest::newRow(qPrintable(type.first + "-RGB")) << type.second << 67 << 200 << 3;
+        QTest::newRow(qPrintable(type.first + "-SQUARE")) << type.second << 257 << 257 << 1;
+    }
+#endif
+}
+
+void TestFitsData::testRotation()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(int, BITPIX);
+    QFETCH(int, WIDTH);
+    QFETCH(int, HEIGHT);
+    QFETCH(int, CHANNELS);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("rotation.fits");
+
+    // Values fit in every type, and are different enough to spot misplaced pixels
+    const long samples = static_cast<long>(WIDTH) * HEIGHT * CHANNELS;
+    std::vector<double> pixels(samples);
+    for (long i = 0; i < samples; i++)
+        pixels[i] = (i * 7) % 251;
+
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    long naxes[3] = {WIDTH, HEIGHT, CHANNELS};
+    fits_create_file(&fptr, QFile::encodeName(filename).data(), &status);
+    fits_create_img(fptr, BITPIX, CHANNELS == 1 ? 2 : 3, naxes, &status);
+    fits_write_img(fptr, TDOUBLE, 1, samples, pixels.data(), &status);
+    fits_close_file(fptr, &status);
+    QCOMPARE(status, 0);
+
+    // Where the pixel at (x, y) ends up
+    const QList<QPair<FITSScale, std::function<QPoint(int, int)>>> filters =
+    {
+        {FITS_ROTATE_CW, [&](int x, int y) { return QPoint(HEIGHT - 1 - y, x); }},
+        {FITS_ROTATE_CCW, [&](int x, int y) { return QPoint(y, WIDTH - 1 - x); }},
+        {FITS_FLIP_H, [&](int x, int y) { return QPoint(WIDTH - 1 - x, y); }},
+        {FITS_FLIP_V, [&](int x, int y) { return QPoint(x, HEIGHT - 1 - y); }},
+    };
+
+    for (const auto &filter : filters)
+    {
+        std::unique_ptr<FITSData> d(new FITSData());
+        QFuture<bool> worker = d->loadFromFile(filename);
+        QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+        QVERIFY(worker.result());
+        QCOMPARE(d->channels(), CHANNELS);
+
+        const int bpp = d->getBytesPerPixel();
+        const QByteArray original(reinterpret_cast<const char *>(d->getImageBuffer()), samples * bpp);
+
+        d->applyFilter(filter.first);
+
+        const bool transposed = filter.first == FITS_ROTATE_CW || filter.first == FITS_ROTATE_CCW;
+        const int width = transposed ? HEIGHT : WIDTH;
+        QCOMPARE(static_cast<int>(d->width()), width);
+        QCOMPARE(static_cast<int>(d->height()), transposed ? WIDTH : HEIGHT);
+
+        auto const * rotated = d->getImageBuffer();
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            const long offset = static_cast<long>(c) * WIDTH * HEIGHT;
+            for (int y = 0; y < HEIGHT; y++)
+                for (int x = 0; x < WIDTH; x++)
+                {
+                    const QPoint p = filter.second(x, y);
+                    if (memcmp(rotated + (offset + p.y() * width + p.x()) * bpp,
+                               original.constData() + (offset + y * WIDTH + x) * bpp, bpp))
+                        QFAIL(qPrintable(QString("Pixel %1,%2 of channel %3 misplaced").arg(x).arg(y).arg(c)));
+                }
+        }
+    }
+#endif
+}
+
+void TestFitsData::testWCSBatch_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<int>("WIDTH");
+    QTest::addColumn<int>("HEIGHT");
+    QTest::addColumn<double>("RA");
+    QTest::addColumn<double>("DE");
+    QTest::addColumn<bool>("SIP");
+
+    // Small frames convert in a single call, large ones are split across threads
+    QTest::newRow("SMALL") << 320 << 240 << 120.0 << 30.0 << false;
+    QTest::newRow("LARGE") << 4000 << 3000 << 120.0 << 30.0 << false;
+    QTest::newRow("LARGE-SIP") << 4000 << 3000 << 120.0 << 30.0 << true;
+    QTest::newRow("RA-WRAP") << 4000 << 3000 << 0.05 << -10.0 << false;
+    QTest::newRow("POLE") << 4000 << 3000 << 45.0 << 89.9 << false;
+#endif
+}
+
+void TestFitsData::testWCSBatch()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#elif !defined(HAVE_WCSLIB)
+    QSKIP("Skipping WCS test without wcslib.");
+#else
+    QFETCH(int, WIDTH);
+    QFETCH(int, HEIGHT);
+    QFETCH(double, RA);
+    QFETCH(double, DE);
+    QFETCH(bool, SIP);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("wcs.fits");
+
+    // Two arcseconds per pixel, slightly rotated
+    std::vector<uint16_t> pixels(static_cast<size_t>(WIDTH) * HEIGHT, 1000);
+    const double scale = 2.0 / 3600, angle = 0.3;
+    double cd11 = -scale * std::cos(angle), cd12 = scale * std::sin(angle);
+    double cd21 = scale * std::sin(angle), cd22 = scale * std::cos(angle);
+    double crpix1 = WIDTH / 2.0, crpix2 = HEIGHT / 2.0;
+
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    long naxes[2] = {WIDTH, HEIGHT};
+    char ctype1[] = "RA---TAN", ctype2[] = "DEC--TAN", ctype1SIP[] = "RA---TAN-SIP", ctype2SIP[] = "DEC--TAN-SIP";
+    fits_create_file(&fptr, QFile::encodeName(filename).data(), &status);
+    fits_create_img(fptr, USHORT_IMG, 2, naxes, &status);
+    fits_update_key(fptr, TSTRING, "CTYPE1", SIP ? ctype1SIP : ctype1, nullptr, &status);
+    fits_update_key(fptr, TSTRING, "CTYPE2", SIP ? ctype2SIP : ctype2, nullptr, &status);
+    fits_update_key(fptr, TDOUBLE, "CRVAL1", &RA, nullptr, &status);
+    fits_update_key(fptr, TDOUBLE, "CRVAL2", &DE, nullptr, &status);
+    fits_update_key(fptr, TDOUBLE, "CRPIX1", &crpix1, nullptr, &status);
+    fits_update_key(fptr, TDOUBLE, "CRPIX2", &crpix2, nullptr, &status);
+    fits_update_key(fptr, TDOUBLE, "CD1_1", &cd11, nullptr, &status);
+    fits_update_key(fptr, TDOUBLE, "CD1_2", &cd12, nullptr, &status);
+    fits_update_key(fptr, TDOUBLE, "CD2_1", &cd21, nullptr, &status);
+    fits_update_key(fptr, TDOUBLE, "CD2_2", &cd22, nullptr, &status);
+    if (SIP)
+    {
+        int order = 2;
+        double a20 = 2e-6, b02 = -3e-6;
+        fits_update_key(fptr, TINT, "A_ORDER", &order, nullptr, &status);
+        fits_update_key(fptr, TINT, "B_ORDER", &order, nullptr, &status);
+        fits_update_key(fptr, TDOUBLE, "A_2_0", &a20, nullptr, &status);
+        fits_update_key(fptr, TDOUBLE, "B_0_2", &b02, nullptr, &status);
+    }
+    fits_write_img(fptr, TUSHORT, 1, pixels.size(), pixels.data(), &status);
+    fits_close_file(fptr, &status);
+    QCOMPARE(status, 0);
+
+    std::unique_ptr<FITSData> d(new FITSData());
+    QFuture<bool> worker = d->loadFromFile(filename);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    QVERIFY(d->loadWCS());
+
+    // Angular distance in arcseconds, insensitive to the RA wrap and the poles
+    auto separation = [](double ra1, double de1, double ra2, double de2)
+    {
+        const double toRad = M_PI / 180;
+        const double a = std::sin((de2 - de1) * toRad / 2), b = std::sin((ra2 - ra1) * toRad / 2);
+        return 2 * std::asin(std::sqrt(a * a + std::cos(de1 * toRad) * std::cos(de2 * toRad) * b * b)) / toRad * 3600;
+    };
+
+    // Pixels all over the frame, and a few out of it
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> xs(-50, WIDTH + 50), ys(-50, HEIGHT + 50);
+    QVector<QPointF> points;
+    for (int i = 0; i < 20000; i++)
+        points.append(QPointF(xs(generator), ys(generator)));
+
+    QVector<QPointF> world;
+    QVector<bool> valid;
+    QVERIFY(d->pixelsToWCS(points, world, &valid));
+    QCOMPARE(world.size(), points.size());
+    for (int i = 0; i < points.size(); i++)
+    {
+        SkyPoint expected;
+        QCOMPARE(valid[i], d->pixelToWCS(points[i], expected));
+        if (valid[i])
+            QVERIFY2(separation(world[i].x(), world[i].y(), expected.ra0().Degrees(), expected.dec0().Degrees()) < 1e-6,
+                     qPrintable(QString("Pixel %1,%2").arg(points[i].x()).arg(points[i].y())));
+    }
+
+    // Back to pixels, with points on the far side of the sky that cannot be projected
+    QVector<QPointF> sky = world;
+    sky.append(QPointF(std::fmod(RA + 180, 360), -DE));
+    sky.append(QPointF(std::fmod(RA + 90, 360), -DE / 2));
+    QVector<QPointF> back;
+    QVERIFY(d->wcsToPixels(sky, back, &valid));
+    QCOMPARE(back.size(), sky.size());
+    for (int i = 0; i < sky.size(); i++)
+    {
+        QPointF expected, image;
+        QCOMPARE(valid[i], d->wcsToPixel(SkyPoint(sky[i].x() / 15.0, sky[i].y()), expected, image));
+        if (!valid[i])
+            continue;
+
+        QVERIFY(std::hypot(back[i].x() - expected.x(), back[i].y() - expected.y()) < 1e-6);
+        if (i < points.size())
+            QVERIFY(std::hypot(back[i].x() - points[i].x(), back[i].y() - points[i].y()) < 1e-4);
+    }
+    QVERIFY(!valid[sky.size() - 2]);
+
+    // Bounds match the edges converted one by one
+    double minRA = 1000, maxRA = -1000, minDE = 1000, maxDE = -1000;
+    auto edge = [&](int x, int y)
+    {
+        SkyPoint p;
+        if (d->pixelToWCS(QPointF(x, y), p))
+        {
+            minRA = std::min(minRA, p.ra0().Degrees());
+            maxRA = std::max(maxRA, p.ra0().Degrees());
+            minDE = std::min(minDE, p.dec0().Degrees());
+            maxDE = std::max(maxDE, p.dec0().Degrees());
+        }
+    };
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        edge(0, y);
+        edge(WIDTH - 1, y);
+    }
+    for (int x = 1; x < WIDTH - 1; x++)
+    {
+        edge(x, 0);
+        edge(x, HEIGHT - 1);
+    }
+    SkyPoint NCP(0, 90), SCP(0, -90);
+    QPointF pole, image;
+    if (d->wcsToPixel(NCP, pole, image) && pole.x() > 0 && pole.x() < WIDTH && pole.y() > 0 && pole.y() < HEIGHT)
+        maxDE = 90;
+    if (d->wcsToPixel(SCP, pole, image) && pole.x() > 0 && pole.x() < WIDTH && pole.y() > 0 && pole.y() < HEIGHT)
+        minDE = -90;
+
+    double bounds[4];
+    for (int pass = 0; pass < 2; pass++)
+    {
+        // The second pass reads the cached bounds
+        QVERIFY(d->findWCSBounds(bounds[0], bounds[1], bounds[2], bounds[3]));
+        QCOMPARE(bounds[0], minRA);
+        QCOMPARE(bounds[1], maxRA);
+        QCOMPARE(bounds[2], minDE);
+        QCOMPARE(bounds[3], maxDE);
+    }
+
+    // The interpolation grid stays far below the pixel scale
+    double worst = 0;
+    for (const auto &point : points)
+    {
+        SkyPoint exact, interpolated;
+        if (!d->pixelToWCS(point, exact))
+            continue;
+        QVERIFY(d->interpolatePixelToWCS(point, interpolated));
+        worst = std::max(worst, separation(exact.ra0().Degrees(), exact.dec0().Degrees(),
+                                           interpolated.ra0().Degrees(), interpolated.dec0().Degrees()));
+    }
+    QVERIFY2(worst < 0.05, qPrintable(QString("Interpolation error %1\"").arg(worst)));
+
+    QBENCHMARK { d->pixelsToWCS(points, world); }
+#endif
+}
+
+void TestFitsData::testLoadHeader_data()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QTest::addColumn<QString>("NAME");
+    QTest::addColumn<bool>("COMPRESSED");
+
+    QTest::newRow("M47") << "m47_sim_stars.fits" << false;
+    QTest::newRow("M47-COMPRESSED") << "m47_sim_stars.fits" << true;
+    QTest::newRow("NGC4535-1") << "ngc4535-autofocus1.fits" << false;
+#endif
+}
+
+void TestFitsData::testLoadHeader()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    QFETCH(QString, NAME);
+    QFETCH(bool, COMPRESSED);
+
+    if(!QFile::exists(NAME))
+        QSKIP("Skipping header load test because of missing fixture");
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString filename = NAME;
+    if (COMPRESSED)
+    {
+        filename = dir.filePath(NAME + ".fz");
+        fpstate fpvar;
+        fp_init(&fpvar);
+        int isLossLess = 0;
+        QVERIFY(fp_pack(QFile::encodeName(NAME).data(), QFile::encodeName(filename).data(), fpvar, &isLossLess) >= 0);
+    }
+
+    std::unique_ptr<FITSData> full(new FITSData());
+    QFuture<bool> worker = full->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+
+    std::unique_ptr<FITSData> header(new FITSData());
+    QVERIFY(header->loadHeader(filename));
+    QVERIFY(header->isHeaderOnly());
+    QVERIFY(header->getImageBuffer() == nullptr);
+    QCOMPARE(header->width(), full->width());
+    QCOMPARE(header->height(), full->height());
+    QCOMPARE(header->dataType(), full->dataType());
+    QCOMPARE(header->hasWCS(), full->hasWCS());
+    QCOMPARE(header->getDateTime(), full->getDateTime());
+
+    // Every keyword of the image is available, compressed headers are translated
+    QVariant value;
+    QVERIFY(header->getRecordValue("NAXIS1", value));
+    QCOMPARE(value.toInt(), static_cast<int>(full->width()));
+    for (const auto &record : full->getRecords())
+    {
+        if (COMPRESSED || !record.value.isValid())
+            continue;
+        QVERIFY2(header->getRecordValue(record.key, value), qPrintable(record.key));
+        QCOMPARE(value, record.value);
+    }
+
+    // A full load afterwards reads the pixels again
+    worker = header->loadFromFile(NAME);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    QVERIFY(!header->isHeaderOnly());
+    QVERIFY(header->getImageBuffer() != nullptr);
+
+    QBENCHMARK { header->loadHeader(filename); }
+#endif
+}
+
+void TestFitsData::testThumbnailCache()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    const QString first = "m47_sim_stars.fits", second = "ngc4535-autofocus1.fits";
+    if(!QFile::exists(first) || !QFile::exists(second))
+        QSKIP("Skipping thumbnail test because of missing fixture");
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("image.fits");
+    QVERIFY(QFile::copy(first, filename));
+
+    FITSThumbnailCache cache(dir.filePath("thumbnails"));
+    const QString thumbnail = cache.thumbnailFile(filename, 128);
+    QVERIFY(!thumbnail.isEmpty());
+    QVERIFY(QFile::exists(thumbnail));
+
+    QImage image(thumbnail);
+    QVERIFY(!image.isNull());
+    QCOMPARE(std::max(image.width(), image.height()) <= 128, true);
+    QCOMPARE(std::max(image.width(), image.height()) > 64, true);
+
+    // Cached, and keyed by size and stretch
+    QCOMPARE(cache.thumbnailFile(filename, 128), thumbnail);
+    QVERIFY(cache.thumbnailFile(filename, 64) != thumbnail);
+    StretchParams params;
+    params.grey_red.shadows = 0.1f;
+    QVERIFY(cache.thumbnailFile(filename, 128, &params) != thumbnail);
+
+    // A modified file gets a new thumbnail
+    QVERIFY(QFile::remove(filename));
+    QVERIFY(QFile::copy(second, filename));
+    QVERIFY(cache.thumbnailFile(filename, 128) != thumbnail);
+
+    // Not an image
+    QCOMPARE(cache.thumbnailFile(dir.filePath("missing.fits")), QString());
+
+    FITSThumbnailCache small(dir.filePath("thumbnails"), 1);
+    QCOMPARE(QDir(small.directory()).entryList(QDir::Files).count(), 0);
+#endif
+}
+
 QTEST_GUILESS_MAIN(TestFitsData)
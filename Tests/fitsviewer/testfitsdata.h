@@ -33,12 +33,21 @@ class TestFitsData : public QObject
         void testLoadFits_data();
         void testLoadFits();
 
+        void testLoadCompressedFits_data();
+        void testLoadCompressedFits();
+
+        void testLoadMappedFits_data();
+        void testLoadMappedFits();
+
         void testCentroidAlgorithmBenchmark_data();
         void testCentroidAlgorithmBenchmark();
 
         void testGradientAlgorithmBenchmark_data();
         void testGradientAlgorithmBenchmark();
 
+        void testTiledDetectionBenchmark_data();
+        void testTiledDetectionBenchmark();
+
         void testThresholdAlgorithmBenchmark_data();
         void testThresholdAlgorithmBenchmark();
 
@@ -50,6 +59,44 @@ class TestFitsData : public QObject
 
         void testBahtinovFocusHFR_data();
         void testBahtinovFocusHFR();
+
+        void testConvolution_data();
+        void testConvolution();
+
+        void testConvolutionBenchmark_data();
+        void testConvolutionBenchmark();
+
+        void testCalculateStatsBenchmark_data();
+        void testCalculateStatsBenchmark();
+
+        void testPercentiles_data();
+        void testPercentiles();
+
+        void testUpdateStatistics_data();
+        void testUpdateStatistics();
+
+        void testHistogram_data();
+        void testHistogram();
+
+        void testStretchBenchmark_data();
+        void testStretchBenchmark();
+
+        void testRegionStatistics_data();
+        void testRegionStatistics();
+
+        void testDebayer_data();
+        void testDebayer();
+
+        void testRotation_data();
+        void testRotation();
+
+        void testWCSBatch_data();
+        void testWCSBatch();
+
+        void testLoadHeader_data();
+        void testLoadHeader();
+
+        void testThumbnailCache();
 };
 
 #endif // TESTFITSDATA_H
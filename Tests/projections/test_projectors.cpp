@@ -0,0 +1,247 @@
+/*  KStars tests
+    Batch projection of points against the projection of single points.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "test_projectors.h"
+
+#include "kstarsdata.h"
+#include "projections/azimuthalequidistantprojector.h"
+#include "projections/equirectangularprojector.h"
+#include "projections/gnomonicprojector.h"
+#include "projections/lambertprojector.h"
+#include "projections/orthographicprojector.h"
+#include "projections/stereographicprojector.h"
+#include "skyobjects/skypoint.h"
+
+#include <QMetaEnum>
+#include <QtTest>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace
+{
+const float Width = 800;
+const float Height = 600;
+// Declination of the focus, or its altitude in horizontal coordinates
+const double FocusLatitude = 30;
+
+std::unique_ptr<Projector> createProjector(Projector::Projection type, const ViewParams &vp)
+{
+    switch (type)
+    {
+        case Projector::Lambert:
+            return std::unique_ptr<Projector>(new LambertProjector(vp));
+        case Projector::AzimuthalEquidistant:
+            return std::unique_ptr<Projector>(new AzimuthalEquidistantProjector(vp));
+        case Projector::Orthographic:
+            return std::unique_ptr<Projector>(new OrthographicProjector(vp));
+        case Projector::Equirectangular:
+            return std::unique_ptr<Projector>(new EquirectangularProjector(vp));
+        case Projector::Stereographic:
+            return std::unique_ptr<Projector>(new StereographicProjector(vp));
+        case Projector::Gnomonic:
+            return std::unique_ptr<Projector>(new GnomonicProjector(vp));
+        default:
+            return std::unique_ptr<Projector>();
+    }
+}
+
+/**
+ * Compare the batch projection of a point with toScreen(), plus the checks of SkyPainter::drawPointSource().
+ * Points too close to the edge of the screen, of the projection or of the ground for their visibility
+ * to be decided are only compared in position. Returns an empty string on success.
+ */
+QString compareProjection(const Projector &projector, const ViewParams &vp, const SkyPoint &point, bool oRefract,
+                          float x, float y, bool visible, double tolerance)
+{
+    bool onVisibleHemisphere = false;
+    const QPointF expected = projector.toScreen(&point, oRefract, &onVisibleHemisphere);
+    const bool aboveGround = point.alt().Degrees() > SkyPoint::altCrit;
+    const bool expectedVisible = onVisibleHemisphere && projector.onScreen(expected) && (!vp.fillGround || aboveGround);
+
+    double Y, Y0, dX;
+    if (vp.useAltAz)
+    {
+        Y  = SkyPoint::refract(point.alt(), oRefract && vp.useRefraction).radians();
+        Y0 = SkyPoint::refract(vp.focus->alt(), vp.useRefraction).radians();
+        dX = point.az().radians() - vp.focus->az().radians();
+    }
+    else
+    {
+        Y  = point.dec().radians();
+        Y0 = vp.focus->dec().radians();
+        dX = point.ra().radians() - vp.focus->ra().radians();
+    }
+    const double c = std::sin(Y0) * std::sin(Y) + std::cos(Y0) * std::cos(Y) * std::cos(dX);
+    const double cosMaxFieldAngle = projector.type() == Projector::Gnomonic ? 0.02 : 0;
+
+    const double margin = tolerance + 1;
+    const bool nearEdge = onVisibleHemisphere &&
+                          (std::fabs(expected.x()) < margin || std::fabs(expected.x() - vp.width) < margin ||
+                           std::fabs(expected.y()) < margin || std::fabs(expected.y() - vp.height) < margin);
+    const bool nearHemisphere = projector.type() != Projector::Equirectangular &&
+                                std::fabs(c - cosMaxFieldAngle) < 1e-3;
+    const bool nearGround = vp.fillGround && std::fabs(point.alt().Degrees() - SkyPoint::altCrit) < 1e-3;
+
+    const QString where = QString("RA %1 Dec %2 Alt %3 Az %4").arg(point.ra().Hours(), 0, 'f', 6)
+                          .arg(point.dec().Degrees(), 0, 'f', 6).arg(point.alt().Degrees(), 0, 'f', 6)
+                          .arg(point.az().Degrees(), 0, 'f', 6);
+
+    if (visible != expectedVisible && !nearEdge && !nearHemisphere && !nearGround)
+        return QString("%1: visible %2, expected %3").arg(where).arg(visible).arg(expectedVisible);
+
+    if (visible && expectedVisible &&
+            (std::fabs(x - expected.x()) > tolerance || std::fabs(y - expected.y()) > tolerance))
+        return QString("%1: at %2,%3, expected %4,%5").arg(where).arg(x).arg(y).arg(expected.x()).arg(expected.y());
+
+    return QString();
+}
+}
+
+TestProjectors::TestProjectors(QObject *parent) : QObject(parent)
+{
+}
+
+void TestProjectors::testToScreenBatch_data()
+{
+    QTest::addColumn<int>("PROJECTION");
+    QTest::addColumn<bool>("ALTAZ");
+    QTest::addColumn<bool>("REFRACTION");
+    QTest::addColumn<double>("FOCUS_RA");
+    QTest::addColumn<double>("FOCUS_AZ");
+    QTest::addColumn<double>("ZOOM");
+
+    const QMetaEnum projections = QMetaEnum::fromType<Projector::Projection>();
+
+    // Focus just before and just after 0h and 360 degrees, so that the points are on both sides
+    const QList<QPair<QString, QPair<double, double>>> focuses =
+    {
+        {"before 0h", {23.9999, 359.9985}},
+        {"after 0h", {0.0001, 0.0015}}
+    };
+
+    for (int projection = Projector::Lambert; projection < Projector::UnknownProjection; projection++)
+        for (bool altAz : {false, true})
+            for (bool refraction : {false, true})
+                for (const auto &focus : focuses)
+                    for (double zoom : {1000.0, MAXZOOM})
+                    {
+                        const QString name = QString("%1 %2 %3 %4 zoom %5").arg(projections.valueToKey(projection))
+                                             .arg(altAz ? "altaz" : "equatorial")
+                                             .arg(refraction ? "refraction" : "no refraction").arg(focus.first).arg(zoom);
+                        QTest::newRow(qPrintable(name)) << projection << altAz << refraction << focus.second.first
+                                                        << focus.second.second << zoom;
+                    }
+}
+
+void TestProjectors::testToScreenBatch()
+{
+    QFETCH(int, PROJECTION);
+    QFETCH(bool, ALTAZ);
+    QFETCH(bool, REFRACTION);
+    QFETCH(double, FOCUS_RA);
+    QFETCH(double, FOCUS_AZ);
+    QFETCH(double, ZOOM);
+
+    SkyPoint focus;
+    focus.setRA(FOCUS_RA);
+    focus.setDec(FocusLatitude);
+    focus.setAz(FOCUS_AZ);
+    focus.setAlt(FocusLatitude);
+
+    ViewParams vp;
+    vp.width         = Width;
+    vp.height        = Height;
+    vp.zoomFactor    = ZOOM;
+    vp.useRefraction = REFRACTION;
+    vp.useAltAz      = ALTAZ;
+    vp.focus         = &focus;
+
+    std::unique_ptr<Projector> projector = createProjector(static_cast<Projector::Projection>(PROJECTION), vp);
+    QVERIFY(projector);
+
+    // A grid around the focus, reaching past the horizon at low zoom and twice the screen at high zoom.
+    // The points are kept in single precision as StarBlock does, and the SkyPoints hold the same values.
+    const double step = ZOOM < 100000 ? 7.0 : 0.1 * Width / ZOOM / dms::DegToRad;
+    std::vector<float> ra, dec, alt, az;
+    std::vector<SkyPoint> points;
+    for (int i = -20; i <= 20; i++)
+    {
+        for (int j = -20; j <= 20; j++)
+        {
+            const double latitude = FocusLatitude + j * step;
+            if (std::fabs(latitude) > 89)
+                continue;
+
+            float pointRA = std::fmod(FOCUS_RA + i * step / 15.0 + 24.0, 24.0);
+            float pointAz = std::fmod(FOCUS_AZ + i * step + 360.0, 360.0);
+            if (pointRA >= 24)
+                pointRA = 0;
+            if (pointAz >= 360)
+                pointAz = 0;
+
+            ra.push_back(pointRA);
+            dec.push_back(latitude);
+            az.push_back(pointAz);
+            alt.push_back(latitude);
+
+            SkyPoint point;
+            point.setRA(static_cast<double>(ra.back()));
+            point.setDec(static_cast<double>(dec.back()));
+            point.setAz(static_cast<double>(az.back()));
+            point.setAlt(static_cast<double>(alt.back()));
+            points.push_back(point);
+        }
+    }
+
+    const int count = points.size();
+    QVERIFY(count > Projector::BatchSize);
+    std::vector<const SkyPoint *> pointers;
+    for (const auto &onePoint : points)
+        pointers.push_back(&onePoint);
+
+    // Single precision coordinates of the points limit the float arrays more than the projection
+    const double arrayTolerance = ZOOM < 100000 ? 0.05 : 1.0;
+    const double pointTolerance = 0.05;
+
+    std::vector<float> x(count), y(count);
+    std::unique_ptr<bool[]> visible(new bool[count]);
+
+    for (bool fillGround : {false, true})
+    {
+        vp.fillGround = fillGround;
+        projector->setViewParams(vp);
+
+        // Unrefracted points in a refracted view also exercise the focus shift of the equirectangular projection
+        for (bool oRefract : {true, false})
+        {
+            projector->toScreenBatch(count, ra.data(), dec.data(), alt.data(), az.data(), x.data(), y.data(),
+                                     visible.get(), oRefract);
+            for (int i = 0; i < count; i++)
+            {
+                const QString error = compareProjection(*projector, vp, points[i], oRefract, x[i], y[i], visible[i],
+                                                        arrayTolerance);
+                QVERIFY2(error.isEmpty(), qPrintable(QString("Arrays, ground %1, refract %2, %3")
+                                                     .arg(fillGround).arg(oRefract).arg(error)));
+            }
+
+            projector->toScreenBatch(count, pointers.data(), x.data(), y.data(), visible.get(), oRefract);
+            for (int i = 0; i < count; i++)
+            {
+                const QString error = compareProjection(*projector, vp, points[i], oRefract, x[i], y[i], visible[i],
+                                                        pointTolerance);
+                QVERIFY2(error.isEmpty(), qPrintable(QString("SkyPoints, ground %1, refract %2, %3")
+                                                     .arg(fillGround).arg(oRefract).arg(error)));
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestProjectors)
@@ -0,0 +1,26 @@
+/*  KStars tests
+    Batch projection of points against the projection of single points.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef TEST_PROJECTORS_H
+#define TEST_PROJECTORS_H
+
+#include <QObject>
+
+class TestProjectors : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestProjectors(QObject *parent = nullptr);
+
+    private slots:
+        void testToScreenBatch_data();
+        void testToScreenBatch();
+};
+
+#endif // TEST_PROJECTORS_H
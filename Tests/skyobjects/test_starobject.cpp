@@ -20,6 +20,7 @@
 
 #include "skyobjects/skypoint.h"
 #include "skyobjects/starobject.h"
+#include "skyobjects/epochtransform.h"
 #include "ksnumbers.h"
 #include "time/kstarsdatetime.h"
 #include "auxiliary/dms.h"
@@ -32,6 +33,7 @@
 #endif
 
 #include <utility>
+#include <vector>
 
 TestStarObject::TestStarObject() : QObject()
 {
@@ -303,6 +305,86 @@ void TestStarObject::testUpdateCoords()
 
 }
 
+void TestStarObject::testEpochTransform_data()
+{
+    QTest::addColumn<QString>("date");
+    QTest::addColumn<double>("latitude");
+    QTest::addColumn<double>("LST");
+
+    QTest::newRow("Before 2000") << "1998-01-25T19:12" << 51.5 << 97.3;
+    QTest::newRow("After 2000") << "2021-06-10T13:12" << -33.9 << 245.8;
+    QTest::newRow("Far from J2000") << "2087-11-02T03:40" << 0.0 << 3.2;
+    QTest::newRow("Near the pole") << "2010-11-14T00:00" << 78.2 << 181.0;
+}
+
+void TestStarObject::testEpochTransform()
+{
+    /*
+     * The batched transform used to update the deep stars must put
+     * them where StarObject::updateCoords() followed by
+     * SkyPoint::EquatorialToHorizontal() does
+     */
+    QFETCH(QString, date);
+    QFETCH(double, latitude);
+    QFETCH(double, LST);
+
+    struct Star
+    {
+        float ra0, dec0, pmRa, pmDec;
+    };
+
+    // RA in hours, Dec in degrees, proper motions in mas/yr
+    const std::vector<Star> stars
+    {
+        { 3.720805f, -9.763392f, -93.16f, 743.64f },    // HIP17378
+        { 2.530303f, 89.264108f, 44.48f, -11.85f },     // Polaris
+        { 6.399197f, -52.695661f, 19.9f, 23.2f },       // Canopus
+        { 14.658256f, -60.832222f, -3608.f, 686.0f },   // alp Cen, high proper motion
+        { 21.146344f, -88.956503f, 26.671f, 5.612f },   // sig Oct, near the south pole
+        { 19.209250f, 67.661539f, 95.74f, 91.92f },     // del Dra, near the NEP
+        { 23.999722f, 0.5f, 0.0f, 0.0f },               // just before 0h
+        { 0.000278f, -0.5f, 0.01f, -0.02f },            // just after 0h, negligible proper motion
+        { 12.0f, 0.0f, 0.0f, 0.0f },
+    };
+
+    const KStarsDateTime dt = KStarsDateTime::fromString(date);
+    KSNumbers num(dt.djd());
+    const dms lat(latitude), lst(LST);
+
+    const int count = stars.size();
+    std::vector<float> ra0(count), dec0(count), pmRa(count), pmDec(count);
+    for (int i = 0; i < count; ++i)
+    {
+        ra0[i]   = stars[i].ra0;
+        dec0[i]  = stars[i].dec0;
+        pmRa[i]  = stars[i].pmRa;
+        pmDec[i] = stars[i].pmDec;
+    }
+
+    std::vector<float> ra(count), dec(count), alt(count), az(count);
+    const EpochTransform transform(&num, &lst, &lat);
+    transform.apparent(count, ra0.data(), dec0.data(), pmRa.data(), pmDec.data(), ra.data(), dec.data());
+    transform.horizontal(count, ra.data(), dec.data(), alt.data(), az.data());
+
+    constexpr double subarcsecond_tolerance = 0.25 / 3600.0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        StarObject s { dms(ra0[i] * 15.0), dms(dec0[i]), 0.0, "", "", "K0", pmRa[i], pmDec[i], 0.0, false, false, 0 };
+        s.updateCoordsNow(&num);
+        s.EquatorialToHorizontal(&lst, &lat);
+
+        // Compare across 0h and 360 degrees
+        const double dRA = dms(ra[i] * 15.0 - s.ra().Degrees() + 180.0).reduce().Degrees() - 180.0;
+        compare(QString("Apparent place of star %1").arg(i), s.ra().Degrees() + dRA, dec[i], s.ra().Degrees(), s.dec().Degrees(),
+                subarcsecond_tolerance);
+
+        const double dAz = dms(az[i] - s.az().Degrees() + 180.0).reduce().Degrees() - 180.0;
+        compare(QString("Horizontal coordinates of star %1").arg(i), s.az().Degrees() + dAz, alt[i], s.az().Degrees(),
+                s.alt().Degrees(), subarcsecond_tolerance);
+    }
+}
+
 #ifdef HAVE_LIBERFA
 void TestStarObject::compareProperMotionAgainstErfa_data()
 {
@@ -47,6 +47,8 @@ class TestStarObject : public QObject
     private slots:
         void testUpdateCoordsStepByStep();
         void testUpdateCoords();
+        void testEpochTransform_data();
+        void testEpochTransform();
 #ifdef HAVE_LIBERFA
         void compareProperMotionAgainstErfa_data();
         void compareProperMotionAgainstErfa();
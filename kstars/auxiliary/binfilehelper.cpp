@@ -23,6 +23,11 @@
 
 #include <QStandardPaths>
 
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 class BinFileHelper;
 
 BinFileHelper::BinFileHelper()
@@ -40,6 +45,7 @@ BinFileHelper::~BinFileHelper()
 
 void BinFileHelper::init()
 {
+    unmapFile();
     if (fileHandle)
         fclose(fileHandle);
 
@@ -287,10 +293,71 @@ bool BinFileHelper::readHeader()
 
 void BinFileHelper::closeFile()
 {
+    unmapFile();
     fclose(fileHandle);
     fileHandle = nullptr;
 }
 
+bool BinFileHelper::mapFile()
+{
+    if (mapping)
+        return true;
+    if (!fileHandle)
+        return false;
+
+    // The handle stays owned by us, QFile only gives access to the platform mapping
+    if (!mappedFile.open(fileHandle, QIODevice::ReadOnly, QFileDevice::DontCloseHandle))
+        return false;
+
+    const qint64 size = mappedFile.size();
+    if (size > 0)
+        mapping = mappedFile.map(0, size);
+
+    if (!mapping)
+    {
+        mappedFile.close();
+        return false;
+    }
+
+    mappingSize = size;
+    return true;
+}
+
+void BinFileHelper::unmapFile()
+{
+    if (mapping)
+        mappedFile.unmap(mapping);
+    mapping     = nullptr;
+    mappingSize = 0;
+    if (mappedFile.isOpen())
+        mappedFile.close();
+}
+
+const uchar *BinFileHelper::mappedData(quint64 offset, quint64 size) const
+{
+    if (!mapping || offset > mappingSize || size > mappingSize - offset)
+        return nullptr;
+    return mapping + offset;
+}
+
+void BinFileHelper::adviseWillNeed(quint64 offset, quint64 size) const
+{
+#ifdef Q_OS_UNIX
+    if (!mapping || size == 0 || offset >= mappingSize)
+        return;
+    size = qMin(size, mappingSize - offset);
+
+    // madvise() wants a page aligned start
+    static const quintptr pageSize = sysconf(_SC_PAGESIZE);
+    const quintptr start = reinterpret_cast<quintptr>(mapping + offset) & ~(pageSize - 1);
+    const quintptr end   = reinterpret_cast<quintptr>(mapping + offset + size);
+    madvise(reinterpret_cast<void *>(start), end - start, MADV_WILLNEED);
+#else
+    Q_UNUSED(offset)
+    Q_UNUSED(size)
+#endif
+}
+
 int BinFileHelper::getErrorNumber()
 {
     int err = errnum;
@@ -18,10 +18,12 @@
 
 #pragma once
 
+#include <QFile>
 #include <QString>
 #include <QVector>
 
 #include <cstdio>
+#include <cstring>
 
 class QString;
 
@@ -42,7 +44,9 @@ typedef struct dataElement
  * This class provides utility functions to handle binary data files in the format prescribed
  * by KStars. The file format is designed specifically to support data that has the form of an
  * array of structures. See data/README.fileformat for details.
- * The methods use primitive C file I/O routines defined in stdio.h to obtain efficiency
+ * The methods use primitive C file I/O routines defined in stdio.h to obtain efficiency.
+ * Once opened, a file may also be mapped into memory with mapFile(), so that records are decoded
+ * straight from the mapping instead of being read one at a time.
  * @short Implements an interface to handle binary data files used by KStars
  * @author Akarsh Simha
  * @version 1.0
@@ -77,10 +81,66 @@ class BinFileHelper
     bool readHeader();
 
     /**
-     * @short  Close the binary data file
+     * @short  Close the binary data file, unmapping it first if it was mapped
      */
     void closeFile();
 
+    /**
+     * @short  Map the whole open file into memory
+     * @note   Mapping may fail, for instance for large files on 32-bit systems. The file handle
+     *         remains usable in any case, so callers should fall back to reading through it.
+     * @return True if the file is mapped, false if it is not open or could not be mapped
+     */
+    bool mapFile();
+
+    /**
+     * @short  Unmap the file, leaving the file handle open
+     */
+    void unmapFile();
+
+    /**
+     * @return True if the file is mapped into memory
+     */
+    inline bool isMapped() const { return mapping != nullptr; }
+
+    /**
+     * @short  Returns the mapped bytes of the file starting at the given offset
+     * @param  offset Offset of the first byte in the file
+     * @param  size Number of bytes the caller is going to read
+     * @return Pointer to the byte at offset, or nullptr if the file is not mapped or the
+     *         requested bytes extend past its end
+     */
+    const uchar *mappedData(quint64 offset, quint64 size) const;
+
+    /**
+     * @short  Hint that the given bytes of the mapping are about to be read, so that they are
+     *         paged in ahead of time. Does nothing if the file is not mapped.
+     * @param  offset Offset of the first byte in the file
+     * @param  size Number of bytes
+     */
+    void adviseWillNeed(quint64 offset, quint64 size) const;
+
+    /**
+     * @short  Read one record, either from the mapping or through the file handle
+     *
+     * If data is not nullptr, the record is copied from there and data is advanced past it,
+     * else it is read from the current position of file.
+     *
+     * @return True if the record was read
+     */
+    template <typename T>
+    static inline bool readRecord(T &record, const uchar *&data, FILE *file)
+    {
+        if (data)
+        {
+            // The mapping has no alignment guarantee for T
+            memcpy(&record, data, sizeof(T));
+            data += sizeof(T);
+            return true;
+        }
+        return fread(&record, sizeof(T), 1, file) == 1;
+    }
+
     /**
      * @short   Get error number
      * @return  A number corresponding to the error
@@ -241,6 +301,12 @@ class BinFileHelper
 
     /// Handle to the file.
     FILE *fileHandle { nullptr};
+    /// Wraps fileHandle to map the file into memory
+    QFile mappedFile;
+    /// Start of the mapping of the whole file, nullptr if not mapped
+    uchar *mapping { nullptr };
+    /// Size of the mapping in bytes
+    quint64 mappingSize { 0 };
     /// Stores offsets corresponding to each index table entry
     QVector<unsigned long> indexOffset;
     /// Stores number of records under each index table entry
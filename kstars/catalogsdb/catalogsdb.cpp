@@ -15,6 +15,7 @@
  *                                                                         *
  ***************************************************************************/
 
+#include <atomic>
 #include <limits>
 #include <cmath>
 #include <QSqlDriver>
@@ -31,13 +32,15 @@
 
 using namespace CatalogsDB;
 QSet<QString> DBManager::m_db_paths{};
+QMutex DBManager::m_db_paths_mutex{};
 
 /**
- * Get an increasing index for new connections.
+ * Get an increasing index for new connections. Connections may be
+ * opened from any thread.
  */
 int get_connection_index()
 {
-    static int connection_index = 0;
+    static std::atomic<int> connection_index{ 0 };
     return connection_index++;
 }
 
@@ -88,10 +91,18 @@ std::pair<bool, QString> migrate_db(const int version, QSqlDatabase &db,
     return { true, "" };
 }
 
+const QString &DBManager::add_db_path(const QString &filename)
+{
+    QMutexLocker _{ &m_db_paths_mutex };
+
+    // the elements of a QSet are not moved when it grows
+    return *m_db_paths.insert(filename);
+}
+
 DBManager::DBManager(const QString &filename)
     : m_db{ QSqlDatabase::addDatabase(
           "QSQLITE", QString("cat_%1_%2").arg(filename).arg(get_connection_index())) },
-      m_db_file{ *m_db_paths.insert(filename) }
+      m_db_file{ add_db_path(filename) }
 
 {
     m_db.setDatabaseName(m_db_file);
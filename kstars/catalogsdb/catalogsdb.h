@@ -648,6 +648,19 @@ class DBManager
      * database.
      */
     static QSet<QString> m_db_paths;
+
+    /**
+     * Guards `m_db_paths`, as managers may be created on any thread.
+     */
+    static QMutex m_db_paths_mutex;
+
+    /**
+     * Add \p filename to `m_db_paths`.
+     *
+     * \return a reference to the stored path, valid for the lifetime
+     * of the program.
+     */
+    static const QString &add_db_path(const QString &filename);
     //@}
 };
 
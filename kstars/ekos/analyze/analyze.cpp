@@ -11,13 +11,16 @@
 
 #include <KNotifications/KNotification>
 #include <QDateTime>
+#include <QFutureWatcher>
 #include <QShortcut>
+#include <QtConcurrent>
 #include <QtGlobal>
 
 #include "auxiliary/kspaths.h"
 #include "dms.h"
 #include "ekos/manager.h"
 #include "fitsviewer/fitsdata.h"
+#include "fitsviewer/fitsthumbnailcache.h"
 #include "fitsviewer/fitsviewer.h"
 #include "ksmessagebox.h"
 #include "kstars.h"
@@ -987,7 +990,10 @@ void Analyze::captureSessionClicked(CaptureSession &c, bool doubleClick)
 
     c.addRow("Exposure", QString::number(c.duration, 'f', 2));
     if (!c.isTemporary())
+    {
         c.addRow("Filename", c.filename);
+        displayThumbnail(findFilename(c.filename, alternateFolder), detailsTable->rowCount() - 1);
+    }
 
     if (doubleClick && !c.isTemporary())
     {
@@ -1936,6 +1942,30 @@ void Analyze::displayFITS(const QString &filename)
     fitsViewer->show();
 }
 
+void Analyze::displayThumbnail(const QString &filename, int row)
+{
+    if (filename.isEmpty() || detailsTable->item(row, 1) == nullptr)
+        return;
+    const QString text = detailsTable->item(row, 1)->text();
+
+    QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, row, text]()
+    {
+        const QString thumbnail = watcher->result();
+        watcher->deleteLater();
+
+        // The details may show another session by now.
+        QTableWidgetItem *value = detailsTable->item(row, 1);
+        if (thumbnail.isEmpty() || value == nullptr || value->text() != text)
+            return;
+        value->setToolTip(QString("<img src=\"%1\">").arg(thumbnail.toHtmlEscaped()));
+    });
+    watcher->setFuture(QtConcurrent::run([filename]()
+    {
+        return FITSThumbnailCache::Instance()->thumbnailFile(filename);
+    }));
+}
+
 void Analyze::helpMessage()
 {
     KHelpClient::invokeHelp(QStringLiteral("tool-ekos.html#ekos-analyze"), QStringLiteral("kstars"));
@@ -341,6 +341,9 @@ class Analyze : public QWidget, public Ui::Analyze
         // Opens a FITS file for viewing.
         void displayFITS(const QString &filename);
 
+        // Shows a preview of a FITS file as the tooltip of a details row, made in the background.
+        void displayThumbnail(const QString &filename, int row);
+
         // Pop up a help-message window.
         void helpMessage();
 
@@ -0,0 +1,292 @@
+/*  Calibration Cache
+    Memory budgeted cache of calibration masters.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "calibrationcache.h"
+
+#include "ekos_debug.h"
+
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+namespace
+{
+qint64 frameBytes(const QSharedPointer<FITSData> &data)
+{
+    return static_cast<qint64>(data->samplesPerChannel()) * data->channels() * data->getBytesPerPixel();
+}
+
+qint64 defectMapBytes(const QSharedPointer<DefectMap> &map)
+{
+    // Pixels are stored in tree nodes of about four pointers in addition to the pixel itself.
+    const qint64 pixels = map->hotPixels().size() + map->coldPixels().size();
+    return pixels * static_cast<qint64>(sizeof(BadPixel) + 4 * sizeof(void *));
+}
+
+qint64 darkModelBytes(const QSharedPointer<DarkModel> &model)
+{
+    return static_cast<qint64>(model->bias().size() + model->thermal().size()) * sizeof(float);
+}
+}
+
+CalibrationCache::CalibrationCache(qint64 budget, QObject *parent) : QObject(parent), m_Budget(budget)
+{
+}
+
+CalibrationCache::~CalibrationCache()
+{
+    clear();
+}
+
+void CalibrationCache::setBudget(qint64 budget)
+{
+    m_Budget = budget;
+    evict();
+}
+
+QString CalibrationCache::cacheKey(MasterType type, const QString &key)
+{
+    return QString("%1:%2").arg(type).arg(key);
+}
+
+QSharedPointer<FITSData> CalibrationCache::frame(MasterType type, const QString &filename)
+{
+    Entry *entry = lookup(cacheKey(type, filename));
+    return entry ? entry->frame : QSharedPointer<FITSData>();
+}
+
+QSharedPointer<DefectMap> CalibrationCache::defectMap(const QString &key)
+{
+    Entry *entry = lookup(cacheKey(DEFECT_MAP, key));
+    return entry ? entry->defectMap : QSharedPointer<DefectMap>();
+}
+
+QSharedPointer<DarkModel> CalibrationCache::darkModel(const QString &key)
+{
+    Entry *entry = lookup(cacheKey(DARK_MODEL, key));
+    return entry ? entry->darkModel : QSharedPointer<DarkModel>();
+}
+
+bool CalibrationCache::isPending(MasterType type, const QString &key) const
+{
+    return m_PendingLoads.contains(cacheKey(type, key));
+}
+
+void CalibrationCache::insertFrame(MasterType type, const QString &filename, const QSharedPointer<FITSData> &data)
+{
+    Entry entry;
+    entry.key = cacheKey(type, filename);
+    entry.frame = data;
+    entry.bytes = frameBytes(data);
+    insertEntry(entry);
+}
+
+void CalibrationCache::insertDefectMap(const QString &key, const QSharedPointer<DefectMap> &map)
+{
+    Entry entry;
+    entry.key = cacheKey(DEFECT_MAP, key);
+    entry.defectMap = map;
+    entry.bytes = defectMapBytes(map);
+    insertEntry(entry);
+}
+
+void CalibrationCache::insertDarkModel(const QString &key, const QSharedPointer<DarkModel> &model)
+{
+    Entry entry;
+    entry.key = cacheKey(DARK_MODEL, key);
+    entry.darkModel = model;
+    entry.bytes = darkModelBytes(model);
+    insertEntry(entry);
+}
+
+void CalibrationCache::prefetchFrame(MasterType type, const QString &filename)
+{
+    const QString key = cacheKey(type, filename);
+    if (m_Index.contains(key) || m_PendingLoads.contains(key))
+        return;
+
+    PendingLoad load;
+    load.type = type;
+    load.name = filename;
+    load.frame.reset(new FITSData(), &QObject::deleteLater);
+    load.future = load.frame->loadFromFile(filename);
+    startLoad(key, load);
+}
+
+void CalibrationCache::prefetchDefectMap(const QString &key, const QString &filename)
+{
+    const QString defectKey = cacheKey(DEFECT_MAP, key);
+    if (m_Index.contains(defectKey) || m_PendingLoads.contains(defectKey))
+        return;
+
+    PendingLoad load;
+    load.type = DEFECT_MAP;
+    load.name = key;
+    load.defectMap.reset(new DefectMap());
+    QSharedPointer<DefectMap> map = load.defectMap;
+    load.future = QtConcurrent::run([map, filename]()
+    {
+        return map->load(filename);
+    });
+    startLoad(defectKey, load);
+}
+
+void CalibrationCache::prefetchDarkModel(const QString &key, const QList<QPair<QString, double>> &masters)
+{
+    const QString modelKey = cacheKey(DARK_MODEL, key);
+    if (m_Index.contains(modelKey) || m_PendingLoads.contains(modelKey))
+        return;
+
+    PendingLoad load;
+    load.type = DARK_MODEL;
+    load.name = key;
+    load.darkModel.reset(new DarkModel());
+    QSharedPointer<DarkModel> model = load.darkModel;
+    load.future = QtConcurrent::run([model, masters]()
+    {
+        // Only one master is in memory at a time, the model accumulates it before the next one is loaded.
+        for (const auto &master : masters)
+        {
+            QSharedPointer<FITSData> dark(new FITSData());
+            QFuture<bool> rc = dark->loadFromFile(master.first);
+            rc.waitForFinished();
+            if (!rc.result() || !model->addDark(dark, master.second))
+                qCWarning(KSTARS_EKOS) << "Dark frame" << master.first << "cannot be used for scaled darks.";
+        }
+        return model->fit();
+    });
+    startLoad(modelKey, load);
+}
+
+void CalibrationCache::remove(MasterType type, const QString &key)
+{
+    const QString entryKey = cacheKey(type, key);
+
+    // A load cannot be cancelled, wait for it so that its master is not destroyed while loading
+    auto pending = m_PendingLoads.find(entryKey);
+    if (pending != m_PendingLoads.end())
+    {
+        pending->future.waitForFinished();
+        m_PendingLoads.erase(pending);
+    }
+
+    removeEntry(entryKey);
+}
+
+void CalibrationCache::clear()
+{
+    for (auto &load : m_PendingLoads)
+        load.future.waitForFinished();
+    m_PendingLoads.clear();
+
+    m_Entries.clear();
+    m_Index.clear();
+    m_UsedBytes = 0;
+}
+
+CalibrationCache::Entry *CalibrationCache::lookup(const QString &key)
+{
+    if (m_PendingLoads.contains(key))
+        completeLoad(key);
+
+    auto found = m_Index.constFind(key);
+    if (found == m_Index.constEnd())
+    {
+        m_Counters.misses++;
+        return nullptr;
+    }
+
+    m_Counters.hits++;
+    m_Entries.splice(m_Entries.begin(), m_Entries, found.value());
+    return &m_Entries.front();
+}
+
+void CalibrationCache::insertEntry(const Entry &entry)
+{
+    removeEntry(entry.key);
+
+    m_Entries.push_front(entry);
+    m_Index.insert(entry.key, m_Entries.begin());
+    m_UsedBytes += entry.bytes;
+    evict();
+}
+
+void CalibrationCache::removeEntry(const QString &key)
+{
+    auto found = m_Index.find(key);
+    if (found == m_Index.end())
+        return;
+
+    m_UsedBytes -= found.value()->bytes;
+    m_Entries.erase(found.value());
+    m_Index.erase(found);
+}
+
+void CalibrationCache::startLoad(const QString &key, const PendingLoad &load)
+{
+    m_PendingLoads.insert(key, load);
+    m_Counters.prefetches++;
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, key, watcher]()
+    {
+        // The load may have been completed by a lookup, or dropped, in the meantime.
+        auto pending = m_PendingLoads.constFind(key);
+        if (pending != m_PendingLoads.constEnd() && pending->future == watcher->future())
+            completeLoad(key);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(load.future);
+}
+
+void CalibrationCache::completeLoad(const QString &key)
+{
+    PendingLoad load = m_PendingLoads.take(key);
+    load.future.waitForFinished();
+
+    if (!load.future.result())
+    {
+        qCWarning(KSTARS_EKOS) << "Failed to prefetch calibration master" << key;
+        emit loadFailed(load.type, load.name);
+        return;
+    }
+
+    Entry entry;
+    entry.key = key;
+    if (load.frame)
+    {
+        entry.frame = load.frame;
+        entry.bytes = frameBytes(load.frame);
+    }
+    else if (load.darkModel)
+    {
+        entry.darkModel = load.darkModel;
+        entry.bytes = darkModelBytes(load.darkModel);
+    }
+    else
+    {
+        load.defectMap->filterPixels();
+        entry.defectMap = load.defectMap;
+        entry.bytes = defectMapBytes(load.defectMap);
+    }
+    insertEntry(entry);
+}
+
+void CalibrationCache::evict()
+{
+    // The most recent master is kept even if it exceeds the budget alone, it is about to be used.
+    while (m_UsedBytes > m_Budget && m_Entries.size() > 1)
+    {
+        const Entry &last = m_Entries.back();
+        qCDebug(KSTARS_EKOS) << "Evicting calibration master" << last.key << "of" << last.bytes << "bytes";
+        m_UsedBytes -= last.bytes;
+        m_Index.remove(last.key);
+        m_Entries.pop_back();
+        m_Counters.evictions++;
+    }
+}
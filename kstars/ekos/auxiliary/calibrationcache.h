@@ -0,0 +1,174 @@
+/*  Calibration Cache
+    Memory budgeted cache of calibration masters.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include "darkmodel.h"
+#include "defectmap.h"
+#include "fitsviewer/fitsdata.h"
+
+#include <QFuture>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QSharedPointer>
+
+#include <list>
+
+/**
+ * @brief The CalibrationCache class keeps recently used calibration masters in memory within a byte budget.
+ *
+ * Masters are evicted in least recently used order once the budget is exceeded, the most recent master being
+ * always kept. Masters expected to be needed soon can be prefetched, they are loaded in the background and
+ * inserted in the cache when ready. Looking up a master that is still loading waits for it. Dark models are
+ * only ever built in the background, from master darks loaded one at a time.
+ */
+class CalibrationCache : public QObject
+{
+        Q_OBJECT
+
+    public:
+        typedef enum
+        {
+            DARK_FRAME,
+            DEFECT_MAP,
+            FLAT_FRAME,
+            DARK_MODEL
+        } MasterType;
+
+        typedef struct
+        {
+            uint32_t hits {0};
+            uint32_t misses {0};
+            uint32_t evictions {0};
+            uint32_t prefetches {0};
+        } Counters;
+
+        /**
+         * @param budget Maximum size in bytes of the cached masters.
+         */
+        explicit CalibrationCache(qint64 budget, QObject *parent = nullptr);
+        ~CalibrationCache();
+
+        void setBudget(qint64 budget);
+        qint64 budget() const
+        {
+            return m_Budget;
+        }
+        qint64 usedBytes() const
+        {
+            return m_UsedBytes;
+        }
+        int count() const
+        {
+            return m_Index.size();
+        }
+        const Counters &counters() const
+        {
+            return m_Counters;
+        }
+
+        /**
+         * @brief frame Look up a master frame, marking it as the most recently used.
+         * @param type DARK_FRAME or FLAT_FRAME.
+         * @param filename Path of the master frame.
+         * @return The master frame, or a null pointer if it is not cached.
+         */
+        QSharedPointer<FITSData> frame(MasterType type, const QString &filename);
+
+        /**
+         * @brief defectMap Look up a defect map, marking it as the most recently used.
+         * @param key Path of the master dark the defect map was created from.
+         * @return The defect map, or a null pointer if it is not cached.
+         */
+        QSharedPointer<DefectMap> defectMap(const QString &key);
+
+        /**
+         * @brief darkModel Look up a dark model, marking it as the most recently used.
+         * @param key Identifier of the master darks the model was fitted from.
+         * @return The dark model, or a null pointer if it is not cached.
+         */
+        QSharedPointer<DarkModel> darkModel(const QString &key);
+
+        /**
+         * @brief isPending Check whether a master is loading in the background, without waiting for it.
+         */
+        bool isPending(MasterType type, const QString &key) const;
+
+        void insertFrame(MasterType type, const QString &filename, const QSharedPointer<FITSData> &data);
+        void insertDefectMap(const QString &key, const QSharedPointer<DefectMap> &map);
+        void insertDarkModel(const QString &key, const QSharedPointer<DarkModel> &model);
+
+        /**
+         * @brief prefetchFrame Load a master frame in the background, unless it is already cached or loading.
+         */
+        void prefetchFrame(MasterType type, const QString &filename);
+
+        /**
+         * @brief prefetchDefectMap Load a defect map in the background, unless it is already cached or loading.
+         * @param key Path of the master dark the defect map was created from.
+         * @param filename Path of the defect map.
+         */
+        void prefetchDefectMap(const QString &key, const QString &filename);
+
+        /**
+         * @brief prefetchDarkModel Fit a dark model in the background, unless it is already cached or fitting.
+         * @param key Identifier of the master darks the model is fitted from.
+         * @param masters Path and exposure duration of each master dark.
+         */
+        void prefetchDarkModel(const QString &key, const QList<QPair<QString, double>> &masters);
+
+        void remove(MasterType type, const QString &key);
+        void clear();
+
+    signals:
+        /**
+         * @brief loadFailed A master could not be loaded or fitted in the background.
+         */
+        void loadFailed(CalibrationCache::MasterType type, const QString &key);
+
+    private:
+        typedef struct
+        {
+            QString key;
+            QSharedPointer<FITSData> frame;
+            QSharedPointer<DefectMap> defectMap;
+            QSharedPointer<DarkModel> darkModel;
+            qint64 bytes {0};
+        } Entry;
+
+        typedef struct
+        {
+            MasterType type;
+            QString name;
+            QFuture<bool> future;
+            QSharedPointer<FITSData> frame;
+            QSharedPointer<DefectMap> defectMap;
+            QSharedPointer<DarkModel> darkModel;
+        } PendingLoad;
+
+        static QString cacheKey(MasterType type, const QString &key);
+        // Find an entry, waiting for its load if pending, and count the hit or miss.
+        Entry *lookup(const QString &key);
+        void insertEntry(const Entry &entry);
+        void removeEntry(const QString &key);
+        void startLoad(const QString &key, const PendingLoad &load);
+        // Wait for a pending load and insert its master if successful.
+        void completeLoad(const QString &key);
+        void evict();
+
+        qint64 m_Budget {0};
+        qint64 m_UsedBytes {0};
+        Counters m_Counters;
+
+        // Most recently used first
+        std::list<Entry> m_Entries;
+        QHash<QString, std::list<Entry>::iterator> m_Index;
+        QHash<QString, PendingLoad> m_PendingLoads;
+};
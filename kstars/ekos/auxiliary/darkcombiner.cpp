@@ -0,0 +1,249 @@
+/*  Dark Combiner
+    Combine dark frames into a master with outlier rejection.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "darkcombiner.h"
+
+#include "fitsviewer/fitsconvolution.h"
+
+#include <QDir>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+// Size of the scratch file regions mapped at once, all frames together. It is only exceeded if one pixel
+// of all frames does not fit, that is with tens of millions of frames.
+const qint64 MaxMappedChunkSize = 256 * 1024 * 1024;
+// Iterations of the winsorization and of the rejection in sigma clipping.
+const int MaxClipIterations = 10;
+
+double mean(double const *values, uint32_t count)
+{
+    return std::accumulate(values, values + count, 0.0) / count;
+}
+
+double sortedMedian(double const *values, uint32_t count)
+{
+    return (count % 2) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+// Robust standard deviation of sorted values around their median, values beyond 1.5 sigma
+// being replaced by the limit until the estimate converges.
+double winsorizedSigma(double const *values, uint32_t count, double median)
+{
+    double sigma = 0;
+    for (uint32_t i = 0; i < count; i++)
+        sigma += (values[i] - median) * (values[i] - median);
+    sigma = std::sqrt(sigma / (count - 1));
+
+    for (int iteration = 0; iteration < MaxClipIterations && sigma > 0; iteration++)
+    {
+        const double low = median - 1.5 * sigma, high = median + 1.5 * sigma;
+        double sum = 0, squares = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const double value = std::min(std::max(values[i], low), high);
+            sum += value;
+            squares += value * value;
+        }
+
+        // 1.134 corrects the bias of the winsorized deviation for normal distributions
+        const double next = 1.134 * std::sqrt(std::max(0.0, (squares - sum * sum / count) / (count - 1)));
+        const bool converged = std::fabs(next - sigma) <= 5e-4 * sigma;
+        sigma = next;
+        if (converged)
+            break;
+    }
+
+    return sigma;
+}
+}
+
+DarkCombiner::DarkCombiner(const QString &scratchDirectory, Algorithm algorithm) : m_Algorithm(algorithm)
+{
+    m_ScratchFile.setFileTemplate(QDir(scratchDirectory).filePath("dark_combine_XXXXXX"));
+}
+
+void DarkCombiner::setSigmaLimits(double low, double high)
+{
+    m_SigmaLow = low;
+    m_SigmaHigh = high;
+}
+
+bool DarkCombiner::addFrame(const QSharedPointer<FITSData> &data)
+{
+    if (data.isNull() || data->getImageBuffer() == nullptr)
+        return false;
+
+    if (m_Count == 0)
+    {
+        if (!m_ScratchFile.open())
+            return false;
+
+        m_Width = data->width();
+        m_Height = data->height();
+        m_Channels = data->channels();
+        m_DataType = data->dataType();
+        m_BytesPerPixel = data->getBytesPerPixel();
+    }
+    else if (data->width() != m_Width || data->height() != m_Height || data->channels() != m_Channels ||
+             data->dataType() != m_DataType)
+        return false;
+
+    const qint64 size = static_cast<qint64>(m_Width) * m_Height * m_Channels * m_BytesPerPixel;
+    if (m_ScratchFile.write(reinterpret_cast<const char *>(data->getImageBuffer()), size) != size)
+        return false;
+
+    m_Count++;
+    return true;
+}
+
+bool DarkCombiner::combine(uint8_t *destination)
+{
+    if (m_Count == 0 || destination == nullptr || !m_ScratchFile.flush())
+        return false;
+
+    switch (m_DataType)
+    {
+        case TBYTE:
+            return combineInternal(reinterpret_cast<uint8_t *>(destination));
+        case TSHORT:
+            return combineInternal(reinterpret_cast<int16_t *>(destination));
+        case TUSHORT:
+            return combineInternal(reinterpret_cast<uint16_t *>(destination));
+        case TLONG:
+            return combineInternal(reinterpret_cast<int32_t *>(destination));
+        case TULONG:
+            return combineInternal(reinterpret_cast<uint32_t *>(destination));
+        case TFLOAT:
+            return combineInternal(reinterpret_cast<float *>(destination));
+        case TLONGLONG:
+            return combineInternal(reinterpret_cast<int64_t *>(destination));
+        case TDOUBLE:
+            return combineInternal(reinterpret_cast<double *>(destination));
+        default:
+            return false;
+    }
+}
+
+template <typename T>
+bool DarkCombiner::combineInternal(T *destination)
+{
+    // Pixels are combined independently, so each frame is handled as one run of pixels, channels included.
+    // Chunks are runs of pixels rather than rows, so that a single row of many wide frames is still split.
+    const qint64 pixels = static_cast<qint64>(m_Width) * m_Height * m_Channels;
+    const qint64 frameSize = pixels * static_cast<qint64>(sizeof(T));
+    const uint32_t count = m_Count;
+    const qint64 chunkPixels = std::max<qint64>(1, MaxMappedChunkSize / (static_cast<qint64>(sizeof(T)) * count));
+
+    QVector<T const *> frames(count);
+    for (qint64 firstPixel = 0; firstPixel < pixels; firstPixel += chunkPixels)
+    {
+        const int chunkSize = static_cast<int>(std::min(chunkPixels, pixels - firstPixel));
+
+        // Map the same pixels of every frame
+        QVector<uchar *> mapped;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uchar *region = m_ScratchFile.map(i * frameSize + firstPixel * static_cast<qint64>(sizeof(T)),
+                                              chunkSize * static_cast<qint64>(sizeof(T)));
+            if (region == nullptr)
+                break;
+            mapped.append(region);
+            frames[i] = reinterpret_cast<T const *>(region);
+        }
+
+        if (mapped.size() == static_cast<int>(count))
+        {
+            T *output = destination + firstPixel;
+            QVector<QPair<int, int>> bands = FITSConvolution::rowBands(chunkSize, 4096);
+            QtConcurrent::blockingMap(bands, [&](const QPair<int, int> &band)
+            {
+                std::vector<double> values(count);
+                for (int i = band.first; i < band.second; i++)
+                {
+                    for (uint32_t n = 0; n < count; n++)
+                        values[n] = frames[n][i];
+
+                    const double value = combinePixel(values.data(), count);
+                    output[i] = static_cast<T>(std::is_integral<T>::value ? std::round(value) : value);
+                }
+            });
+        }
+
+        for (uchar *region : mapped)
+            m_ScratchFile.unmap(region);
+
+        if (mapped.size() != static_cast<int>(count))
+            return false;
+    }
+
+    return true;
+}
+
+double DarkCombiner::combinePixel(double *values, uint32_t count) const
+{
+    switch (m_Algorithm)
+    {
+        case COMBINE_MEDIAN:
+        {
+            double *middle = values + count / 2;
+            std::nth_element(values, middle, values + count);
+            if (count % 2)
+                return *middle;
+            // The other middle value is the largest of the lower half
+            return (*middle + *std::max_element(values, middle)) / 2;
+        }
+
+        case COMBINE_SIGMA_CLIP:
+            return sigmaClip(values, count);
+
+        case COMBINE_AVERAGE:
+        default:
+            return mean(values, count);
+    }
+}
+
+double DarkCombiner::sigmaClip(double *values, uint32_t count) const
+{
+    // Rejection needs a few values to estimate the deviation
+    if (count < 3)
+        return mean(values, count);
+
+    // Sorted values are rejected from both ends by moving the bounds of the kept range
+    std::sort(values, values + count);
+    uint32_t low = 0, high = count;
+
+    for (int iteration = 0; iteration < MaxClipIterations && high - low >= 3; iteration++)
+    {
+        const double median = sortedMedian(values + low, high - low);
+        const double sigma = winsorizedSigma(values + low, high - low, median);
+        if (sigma <= 0)
+            break;
+
+        const double minimum = median - m_SigmaLow * sigma, maximum = median + m_SigmaHigh * sigma;
+        uint32_t newLow = low, newHigh = high;
+        while (newLow < newHigh && values[newLow] < minimum)
+            newLow++;
+        while (newHigh > newLow && values[newHigh - 1] > maximum)
+            newHigh--;
+
+        if (newLow == low && newHigh == high)
+            break;
+        low = newLow;
+        high = newHigh;
+    }
+
+    return mean(values + low, high - low);
+}
@@ -0,0 +1,83 @@
+/*  Dark Combiner
+    Combine dark frames into a master with outlier rejection.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include "fitsviewer/fitsdata.h"
+
+#include <QSharedPointer>
+#include <QTemporaryFile>
+
+/**
+ * @brief The DarkCombiner class combines a series of frames into a master frame.
+ *
+ * Frames are spilled to a scratch file as they are added, so the number of frames is not limited by the
+ * available memory. They are combined by chunks of pixels mapped from the scratch file, each chunk being
+ * split in bands processed in parallel.
+ */
+class DarkCombiner
+{
+    public:
+        typedef enum
+        {
+            COMBINE_AVERAGE,
+            COMBINE_MEDIAN,
+            COMBINE_SIGMA_CLIP
+        } Algorithm;
+
+        /**
+         * @param scratchDirectory Directory of the scratch file. It should be on disk next to the masters, as
+         * the system temporary directory is often a memory file system.
+         */
+        explicit DarkCombiner(const QString &scratchDirectory, Algorithm algorithm = COMBINE_AVERAGE);
+
+        /**
+         * @brief setSigmaLimits Rejection limits of the sigma clipping algorithm, in standard deviations
+         * below and above the median.
+         */
+        void setSigmaLimits(double low, double high);
+
+        /**
+         * @brief addFrame Append a frame to the scratch file.
+         * @return False if the frame does not match the first frame or cannot be written.
+         */
+        bool addFrame(const QSharedPointer<FITSData> &data);
+
+        /**
+         * @brief combine Combine all frames added so far.
+         * @param destination Buffer receiving the master frame, in the data type of the frames.
+         * @return False if there is no frame or the scratch file cannot be read.
+         * @note Blocks until complete. It may be called from a worker thread once all frames are added.
+         */
+        bool combine(uint8_t *destination);
+
+        uint32_t count() const
+        {
+            return m_Count;
+        }
+
+    private:
+        template <typename T>
+        bool combineInternal(T *destination);
+        // Combine the values of one pixel, values may be reordered.
+        double combinePixel(double *values, uint32_t count) const;
+        double sigmaClip(double *values, uint32_t count) const;
+
+        Algorithm m_Algorithm;
+        double m_SigmaLow { 3.0 };
+        double m_SigmaHigh { 3.0 };
+
+        QTemporaryFile m_ScratchFile;
+        uint32_t m_Count { 0 };
+        uint32_t m_Width { 0 };
+        uint32_t m_Height { 0 };
+        uint8_t m_Channels { 0 };
+        int m_DataType { 0 };
+        int m_BytesPerPixel { 0 };
+};
@@ -32,6 +32,7 @@
 #include <QtConcurrent>
 #include <algorithm>
 #include <array>
+#include <numeric>
 
 namespace Ekos
 {
@@ -68,7 +69,14 @@ DarkLibrary::DarkLibrary(QWidget *parent) : QDialog(parent)
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Dark Generation Connections
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    m_CurrentDarkFrame.reset(new FITSData(), &QObject::deleteLater);
+    resetDarkFrame();
+
+    m_MasterCache = new CalibrationCache(static_cast<qint64>(Options::calibrationCacheSize()) * 1024 * 1024, this);
+    connect(m_MasterCache, &CalibrationCache::loadFailed, this, [this](CalibrationCache::MasterType type, const QString & key)
+    {
+        if (type == CalibrationCache::DARK_MODEL)
+            m_FailedDarkModels.insert(key);
+    });
 
     m_DarkCameras = Options::darkCameras();
     m_DefectCameras = Options::defectCameras();
@@ -122,13 +130,6 @@ DarkLibrary::DarkLibrary(QWidget *parent) : QDialog(parent)
             m_FileLabel->setText(i18n("Failed to load %1: %2",  m_MasterDarkFrameFilename, m_CurrentDarkFrame->getLastError()));
 
     });
-    connect(m_CurrentDarkFrame.data(), &FITSData::histogramReady, [this]()
-    {
-        histogramView->setEnabled(true);
-        histogramView->reset();
-        histogramView->syncGUI();
-    });
-
     connect(masterDarksCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [this](int index)
     {
         DarkLibrary::loadCurrentMasterDark(cameraS->currentText(), index);
@@ -188,6 +189,7 @@ DarkLibrary::DarkLibrary(QWidget *parent) : QDialog(parent)
     });
 
     KStarsData::Instance()->userdb()->GetAllDarkFrames(m_DarkFramesDatabaseList);
+    indexDarkFrames();
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Defect Map Connections
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -246,91 +248,57 @@ DarkLibrary::~DarkLibrary()
 void DarkLibrary::refreshFromDB()
 {
     KStarsData::Instance()->userdb()->GetAllDarkFrames(m_DarkFramesDatabaseList);
+    indexDarkFrames();
+    m_FailedDarkModels.clear();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
-bool DarkLibrary::findDarkFrame(ISD::CCDChip *m_TargetChip, double duration, QSharedPointer<FITSData> &darkData)
+void DarkLibrary::indexDarkFrames()
 {
-    QVariantMap bestCandidate;
-    for (auto &map : m_DarkFramesDatabaseList)
+    m_DarkFramesIndex.clear();
+    for (int i = 0; i < m_DarkFramesDatabaseList.size(); i++)
     {
-        // First check CCD name matches and check if we are on the correct chip
-        if (map["ccd"].toString() == m_TargetChip->getCCD()->getDeviceName() &&
-                map["chip"].toInt() == static_cast<int>(m_TargetChip->getType()))
-        {
-            int binX, binY;
-            m_TargetChip->getBinning(&binX, &binY);
-
-            // Then check if binning is the same
-            if (map["binX"].toInt() == binX && map["binY"].toInt() == binY)
-            {
-                // If camera has an active cooler, then we check temperature against the absolute threshold.
-                if (m_TargetChip->getCCD()->hasCoolerControl())
-                {
-                    double temperature = 0;
-                    m_TargetChip->getCCD()->getTemperature(&temperature);
-                    double darkTemperature = map["temperature"].toDouble();
-                    // If different is above threshold, it is completely rejected.
-                    if (darkTemperature != INVALID_VALUE && fabs(darkTemperature - temperature) > Options::maxDarkTemperatureDiff())
-                        continue;
-                }
-
-                if (bestCandidate.isEmpty())
-                {
-                    bestCandidate = map;
-                    continue;
-                }
-
-                // We try to find the best frame
-                // Frame closest in exposure duration wins
-                // Frame with temperature closest to stored temperature wins (if temperature is reported)
-                uint32_t thisMapScore = 0;
-                uint32_t bestCandidateScore = 0;
-
-                // Else we check for the closest passive temperature
-                if (m_TargetChip->getCCD()->hasCooler())
-                {
-                    double temperature = 0;
-                    m_TargetChip->getCCD()->getTemperature(&temperature);
-                    double diffMap = std::fabs(temperature - map["temperature"].toDouble());
-                    double diffBest = std::fabs(temperature - bestCandidate["temperature"].toDouble());
-                    // Prefer temperatures closest to target
-                    if (diffMap < diffBest)
-                        thisMapScore++;
-                    else if (diffBest < diffMap)
-                        bestCandidateScore++;
-                }
-
-                // Duration has a higher score priority over temperature
-                {
-                    double diffMap = std::fabs(map["duration"].toDouble() - duration);
-                    double diffBest = std::fabs(bestCandidate["duration"].toDouble() - duration);
-                    if (diffMap < diffBest)
-                        thisMapScore += 2;
-                    else if (diffBest < diffMap)
-                        bestCandidateScore += 2;
-                }
-
-                // More recent has a higher score than older.
-                {
-                    const QDateTime now = QDateTime::currentDateTime();
-                    int64_t diffMap  = map["timestamp"].toDateTime().secsTo(now);
-                    int64_t diffBest = bestCandidate["timestamp"].toDateTime().secsTo(now);
-                    if (diffMap < diffBest)
-                        thisMapScore += 2;
-                    else if (diffBest < diffMap)
-                        bestCandidateScore += 2;
-                }
-
-                // Find candidate with closest time in case we have multiple defect maps
-                if (thisMapScore > bestCandidateScore)
-                    bestCandidate = map;
-            }
-        }
+        const QVariantMap &map = m_DarkFramesDatabaseList.at(i);
+        m_DarkFramesIndex[darkFramesKey(map["ccd"].toString(), map["chip"].toInt(), map["binX"].toInt(),
+                                        map["binY"].toInt())].append(i);
     }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+QString DarkLibrary::darkFramesKey(const QString &ccd, int chip, int binX, int binY)
+{
+    return QString("%1/%2/%3x%4").arg(ccd).arg(chip).arg(binX).arg(binY);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+QVector<int> DarkLibrary::chipDarkFrames(ISD::CCDChip *m_TargetChip, int binX, int binY) const
+{
+    return m_DarkFramesIndex.value(darkFramesKey(m_TargetChip->getCCD()->getDeviceName(),
+                                   static_cast<int>(m_TargetChip->getType()), binX, binY));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::findDarkFrame(ISD::CCDChip *m_TargetChip, double duration, QSharedPointer<FITSData> &darkData)
+{
+    int binX, binY;
+    m_TargetChip->getBinning(&binX, &binY);
+
+    return loadDarkFrame(selectDarkFrames(m_TargetChip, binX, binY, duration).nearest, duration, darkData);
+}
 
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::loadDarkFrame(const QVariantMap &bestCandidate, double duration, QSharedPointer<FITSData> &darkData)
+{
     if (bestCandidate.isEmpty())
         return false;
 
@@ -349,22 +317,17 @@ bool DarkLibrary::findDarkFrame(ISD::CCDChip *m_TargetChip, double duration, QSh
         return false;
     }
 
-    if (m_CachedDarkFrames.contains(filename))
-    {
-        darkData = m_CachedDarkFrames[filename];
+    darkData = m_MasterCache->frame(CalibrationCache::DARK_FRAME, filename);
+    if (darkData)
         return true;
-    }
 
-    // Finally we made it, let's put it in the hash
-    if (cacheDarkFrameFromFile(filename))
-    {
-        darkData = m_CachedDarkFrames[filename];
+    // Finally we made it, let's put it in the cache
+    if (cacheDarkFrameFromFile(filename, darkData))
         return true;
-    }
 
     // Remove bad dark frame
     emit newLog(i18n("Removing bad dark frame file %1", filename));
-    m_CachedDarkFrames.remove(filename);
+    m_MasterCache->remove(CalibrationCache::DARK_FRAME, filename);
     QFile::remove(filename);
     KStarsData::Instance()->userdb()->DeleteDarkFrame(filename);
     return false;
@@ -374,66 +337,109 @@ bool DarkLibrary::findDarkFrame(ISD::CCDChip *m_TargetChip, double duration, QSh
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
-bool DarkLibrary::findDefectMap(ISD::CCDChip *m_TargetChip, double duration, QSharedPointer<DefectMap> &defectMap)
+DarkLibrary::DarkSelection DarkLibrary::selectDarkFrames(ISD::CCDChip *m_TargetChip, int binX, int binY,
+        double duration)
 {
-    QVariantMap bestCandidate;
-    for (auto &map : m_DarkFramesDatabaseList)
+    DarkSelection selection;
+
+    double temperature = 0;
+    const bool cooled = m_TargetChip->getCCD()->hasCoolerControl();
+    if (cooled)
+        m_TargetChip->getCCD()->getTemperature(&temperature);
+
+    const QDateTime now = QDateTime::currentDateTime();
+    const QVector<int> indexes = chipDarkFrames(m_TargetChip, binX, binY);
+    for (int index : indexes)
     {
-        if (map["defectmap"].toString().isEmpty())
-            continue;
+        const QVariantMap &map = m_DarkFramesDatabaseList.at(index);
 
-        // First check CCD name matches and check if we are on the correct chip
-        if (map["ccd"].toString() == m_TargetChip->getCCD()->getDeviceName() &&
-                map["chip"].toInt() == static_cast<int>(m_TargetChip->getType()))
+        // If camera has an active cooler, then we check temperature against the absolute threshold.
+        if (cooled)
         {
-            int binX, binY;
-            m_TargetChip->getBinning(&binX, &binY);
-
-            // Then check if binning is the same
-            if (map["binX"].toInt() == binX && map["binY"].toInt() == binY)
-            {
-                if (bestCandidate.isEmpty())
-                {
-                    bestCandidate = map;
-                    continue;
-                }
-
-                // We try to find the best frame
-                // Frame closest in exposure duration wins
-                // Frame with temperature closest to stored temperature wins (if temperature is reported)
-                uint32_t thisMapScore = 0;
-                uint32_t bestCandidateScore = 0;
-
-                // Else we check for the closest passive temperature
-                if (m_TargetChip->getCCD()->hasCooler())
-                {
-                    double temperature = 0;
-                    m_TargetChip->getCCD()->getTemperature(&temperature);
-                    double diffMap = std::fabs(temperature - map["temperature"].toDouble());
-                    double diffBest = std::fabs(temperature - bestCandidate["temperature"].toDouble());
-                    // Prefer temperatures closest to target
-                    if (diffMap < diffBest)
-                        thisMapScore++;
-                    else if (diffBest < diffMap)
-                        bestCandidateScore++;
-                }
-
-                // Duration has a higher score priority over temperature
-                double diffMap = std::fabs(map["duration"].toDouble() - duration);
-                double diffBest = std::fabs(bestCandidate["duration"].toDouble() - duration);
-                if (diffMap < diffBest)
-                    thisMapScore += 2;
-                else if (diffBest < diffMap)
-                    bestCandidateScore += 2;
-
-                // Find candidate with closest time in case we have multiple defect maps
-                if (thisMapScore > bestCandidateScore)
-                    bestCandidate = map;
-            }
+            double darkTemperature = map["temperature"].toDouble();
+            // If different is above threshold, it is completely rejected.
+            if (darkTemperature != INVALID_VALUE && fabs(darkTemperature - temperature) > Options::maxDarkTemperatureDiff())
+                continue;
         }
+
+        if (selection.nearest.isEmpty() || isBetterDarkCandidate(m_TargetChip, map, selection.nearest, duration))
+            selection.nearest = map;
+
+        // Most recent master dark of each duration, for the model
+        const QDateTime frameTime = map["timestamp"].toDateTime();
+        if (frameTime.daysTo(now) > Options::darkLibraryDuration())
+            continue;
+
+        const double frameDuration = map["duration"].toDouble();
+        auto existing = selection.modelMasters.find(frameDuration);
+        if (existing == selection.modelMasters.end() || existing.value()["timestamp"].toDateTime() < frameTime)
+            selection.modelMasters[frameDuration] = map;
+    }
+
+    selection.exact = !selection.nearest.isEmpty() && fabs(selection.nearest["duration"].toDouble() - duration) < 0.001 &&
+                      selection.nearest["timestamp"].toDateTime().daysTo(now) <= Options::darkLibraryDuration();
+    return selection;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::isBetterDarkCandidate(ISD::CCDChip *m_TargetChip, const QVariantMap &map,
+                                        const QVariantMap &bestCandidate, double duration)
+{
+    // We try to find the best frame
+    // Frame closest in exposure duration wins
+    // Frame with temperature closest to stored temperature wins (if temperature is reported)
+    uint32_t thisMapScore = 0;
+    uint32_t bestCandidateScore = 0;
+
+    // Else we check for the closest passive temperature
+    if (m_TargetChip->getCCD()->hasCooler())
+    {
+        double temperature = 0;
+        m_TargetChip->getCCD()->getTemperature(&temperature);
+        double diffMap = std::fabs(temperature - map["temperature"].toDouble());
+        double diffBest = std::fabs(temperature - bestCandidate["temperature"].toDouble());
+        // Prefer temperatures closest to target
+        if (diffMap < diffBest)
+            thisMapScore++;
+        else if (diffBest < diffMap)
+            bestCandidateScore++;
     }
 
+    // Duration has a higher score priority over temperature
+    {
+        double diffMap = std::fabs(map["duration"].toDouble() - duration);
+        double diffBest = std::fabs(bestCandidate["duration"].toDouble() - duration);
+        if (diffMap < diffBest)
+            thisMapScore += 2;
+        else if (diffBest < diffMap)
+            bestCandidateScore += 2;
+    }
 
+    // More recent has a higher score than older.
+    {
+        const QDateTime now = QDateTime::currentDateTime();
+        int64_t diffMap  = map["timestamp"].toDateTime().secsTo(now);
+        int64_t diffBest = bestCandidate["timestamp"].toDateTime().secsTo(now);
+        if (diffMap < diffBest)
+            thisMapScore += 2;
+        else if (diffBest < diffMap)
+            bestCandidateScore += 2;
+    }
+
+    return thisMapScore > bestCandidateScore;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::findDefectMap(ISD::CCDChip *m_TargetChip, double duration, QSharedPointer<DefectMap> &defectMap)
+{
+    int binX, binY;
+    m_TargetChip->getBinning(&binX, &binY);
+
+    QVariantMap bestCandidate = findDefectCandidate(m_TargetChip, binX, binY, duration);
     if (bestCandidate.isEmpty())
         return false;
 
@@ -443,18 +449,13 @@ bool DarkLibrary::findDefectMap(ISD::CCDChip *m_TargetChip, double duration, QSh
     if (darkFilename.isEmpty() || defectFilename.isEmpty())
         return false;
 
-    if (m_CachedDefectMaps.contains(darkFilename))
-    {
-        defectMap = m_CachedDefectMaps[darkFilename];
+    defectMap = m_MasterCache->defectMap(darkFilename);
+    if (defectMap)
         return true;
-    }
 
-    // Finally we made it, let's put it in the hash
-    if (cacheDefectMapFromFile(darkFilename, defectFilename))
-    {
-        defectMap = m_CachedDefectMaps[darkFilename];
+    // Finally we made it, let's put it in the cache
+    if (cacheDefectMapFromFile(darkFilename, defectFilename, defectMap))
         return true;
-    }
     else
     {
         // Remove bad dark frame
@@ -466,7 +467,167 @@ bool DarkLibrary::findDefectMap(ISD::CCDChip *m_TargetChip, double duration, QSh
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
-bool DarkLibrary::cacheDefectMapFromFile(const QString &key, const QString &filename)
+QVariantMap DarkLibrary::findDefectCandidate(ISD::CCDChip *m_TargetChip, int binX, int binY, double duration)
+{
+    QVariantMap bestCandidate;
+    const QVector<int> indexes = chipDarkFrames(m_TargetChip, binX, binY);
+    for (int index : indexes)
+    {
+        const QVariantMap &map = m_DarkFramesDatabaseList.at(index);
+        if (map["defectmap"].toString().isEmpty())
+            continue;
+
+        if (bestCandidate.isEmpty())
+        {
+            bestCandidate = map;
+            continue;
+        }
+
+        // We try to find the best frame
+        // Frame closest in exposure duration wins
+        // Frame with temperature closest to stored temperature wins (if temperature is reported)
+        uint32_t thisMapScore = 0;
+        uint32_t bestCandidateScore = 0;
+
+        // Else we check for the closest passive temperature
+        if (m_TargetChip->getCCD()->hasCooler())
+        {
+            double temperature = 0;
+            m_TargetChip->getCCD()->getTemperature(&temperature);
+            double diffMap = std::fabs(temperature - map["temperature"].toDouble());
+            double diffBest = std::fabs(temperature - bestCandidate["temperature"].toDouble());
+            // Prefer temperatures closest to target
+            if (diffMap < diffBest)
+                thisMapScore++;
+            else if (diffBest < diffMap)
+                bestCandidateScore++;
+        }
+
+        // Duration has a higher score priority over temperature
+        double diffMap = std::fabs(map["duration"].toDouble() - duration);
+        double diffBest = std::fabs(bestCandidate["duration"].toDouble() - duration);
+        if (diffMap < diffBest)
+            thisMapScore += 2;
+        else if (diffBest < diffMap)
+            bestCandidateScore += 2;
+
+        // Find candidate with closest time in case we have multiple defect maps
+        if (thisMapScore > bestCandidateScore)
+            bestCandidate = map;
+    }
+
+    return bestCandidate;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::findDarkModel(ISD::CCDChip *m_TargetChip, QSharedPointer<DarkModel> &darkModel)
+{
+    int binX, binY;
+    m_TargetChip->getBinning(&binX, &binY);
+
+    return findDarkModel(selectDarkFrames(m_TargetChip, binX, binY, 0).modelMasters, darkModel);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::findDarkModel(const QMap<double, QVariantMap> &masters, QSharedPointer<DarkModel> &darkModel)
+{
+    if (masters.size() < 2)
+        return false;
+
+    // Never wait for the fit here, the caller falls back to the closest master dark meanwhile.
+    const QString key = darkModelKey(masters);
+    if (m_FailedDarkModels.contains(key) || m_MasterCache->isPending(CalibrationCache::DARK_MODEL, key))
+        return false;
+
+    darkModel = m_MasterCache->darkModel(key);
+    if (darkModel)
+        return true;
+
+    fitDarkModel(key, masters);
+    emit newLog(i18n("Fitting scaled darks from master darks of %1 to %2 seconds.",
+                     QString::number(masters.firstKey(), 'f', 1), QString::number(masters.lastKey(), 'f', 1)));
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+void DarkLibrary::fitDarkModel(const QString &key, const QMap<double, QVariantMap> &masters)
+{
+    QList<QPair<QString, double>> files;
+    for (const auto &map : masters)
+        files.append(qMakePair(map["filename"].toString(), map["duration"].toDouble()));
+    m_MasterCache->prefetchDarkModel(key, files);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+QString DarkLibrary::darkModelKey(const QMap<double, QVariantMap> &masters)
+{
+    QStringList filenames;
+    for (const auto &map : masters)
+        filenames << map["filename"].toString();
+    return filenames.join(';');
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+void DarkLibrary::prewarmMasters(const QList<SequenceJob *> &jobs)
+{
+    for (auto &job : jobs)
+    {
+        ISD::CCDChip *targetChip = job->getActiveChip();
+        if (targetChip == nullptr || job->getFrameType() != FRAME_LIGHT)
+            continue;
+
+        // Same preference as denoise: defect map first if the camera prefers it, dark frame or model otherwise.
+        if (m_DefectCameras.contains(targetChip->getCCD()->getDeviceName()))
+        {
+            QVariantMap candidate = findDefectCandidate(targetChip, job->getXBin(), job->getYBin(), job->getExposure());
+            if (!candidate.isEmpty())
+            {
+                m_MasterCache->prefetchDefectMap(candidate["filename"].toString(), candidate["defectmap"].toString());
+                continue;
+            }
+        }
+
+        // Then the exact master dark, else the dark model if one can be fitted.
+        const DarkSelection selection = selectDarkFrames(targetChip, job->getXBin(), job->getYBin(), job->getExposure());
+        if (!selection.exact)
+        {
+            const QString key = darkModelKey(selection.modelMasters);
+            if (selection.modelMasters.size() >= 2 && !m_FailedDarkModels.contains(key))
+            {
+                fitDarkModel(key, selection.modelMasters);
+                continue;
+            }
+        }
+
+        const QVariantMap &candidate = selection.nearest;
+        if (candidate.isEmpty() ||
+                candidate["timestamp"].toDateTime().daysTo(QDateTime::currentDateTime()) > Options::darkLibraryDuration())
+            continue;
+
+        m_MasterCache->prefetchFrame(CalibrationCache::DARK_FRAME, candidate["filename"].toString());
+    }
+
+    const CalibrationCache::Counters &counters = m_MasterCache->counters();
+    qCDebug(KSTARS_EKOS) << "Calibration cache:" << m_MasterCache->count() << "masters," << m_MasterCache->usedBytes()
+                         << "of" << m_MasterCache->budget() << "bytes," << counters.hits << "hits," << counters.misses
+                         << "misses," << counters.evictions << "evictions," << counters.prefetches << "prefetches";
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::cacheDefectMapFromFile(const QString &key, const QString &filename,
+                                         QSharedPointer<DefectMap> &defectMap)
 {
     QSharedPointer<DefectMap> oneMap;
     oneMap.reset(new DefectMap());
@@ -474,7 +635,8 @@ bool DarkLibrary::cacheDefectMapFromFile(const QString &key, const QString &file
     if (oneMap->load(filename))
     {
         oneMap->filterPixels();
-        m_CachedDefectMaps[key] = oneMap;
+        m_MasterCache->insertDefectMap(key, oneMap);
+        defectMap = oneMap;
         return true;
     }
 
@@ -485,19 +647,24 @@ bool DarkLibrary::cacheDefectMapFromFile(const QString &key, const QString &file
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
-bool DarkLibrary::cacheDarkFrameFromFile(const QString &filename)
+bool DarkLibrary::cacheDarkFrameFromFile(const QString &filename, QSharedPointer<FITSData> &darkData)
 {
-    QFuture<bool> rc = m_CurrentDarkFrame->loadFromFile(filename);
+    // Each master gets its own data, the current dark frame belongs to the view.
+    QSharedPointer<FITSData> oneFrame(new FITSData(), &QObject::deleteLater);
+    QFuture<bool> rc = oneFrame->loadFromFile(filename);
 
     rc.waitForFinished();
     if (rc.result())
-        m_CachedDarkFrames[filename] = m_CurrentDarkFrame;
+    {
+        m_MasterCache->insertFrame(CalibrationCache::DARK_FRAME, filename, oneFrame);
+        darkData = oneFrame;
+    }
     else
     {
         emit newLog(i18n("Failed to load dark frame file %1", filename));
     }
 
-    return rc;
+    return rc.result();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -553,7 +720,6 @@ template <typename T>
 void DarkLibrary::normalizeDefectsInternal(const QSharedPointer<DefectMap> &defectMap,
         const QSharedPointer<FITSData> &lightData, FITSScale filter, uint16_t offsetX, uint16_t offsetY)
 {
-
     Q_UNUSED(filter);
     T *lightBuffer = reinterpret_cast<T *>(lightData->getWritableImageBuffer());
     const uint32_t width = lightData->width();
@@ -562,67 +728,35 @@ void DarkLibrary::normalizeDefectsInternal(const QSharedPointer<DefectMap> &defe
     // e.g. if we send a subframed light frame 100x100 pixels wide
     // but the source defect map covers 1000x1000 pixels array, then we need to only compensate
     // for the 100x100 region.
-    for (BadPixelSet::const_iterator onePixel = defectMap->hotThreshold();
-            onePixel != defectMap->hotPixels().cend(); ++onePixel)
+    QSharedPointer<DefectTable> table = defectMap->defectTable(QRect(offsetX, offsetY, width, lightData->height()));
+    uint32_t const *offsets = table->offsets.constData();
+    uint32_t const *buckets = table->buckets.constData();
+
+    // Medians are all computed before any defect is replaced, so that neighbouring defects
+    // do not depend on the order in which they are corrected.
+    std::vector<T> values(table->offsets.size());
+    QVector<uint32_t> bucketIndexes(table->bucketCount());
+    std::iota(bucketIndexes.begin(), bucketIndexes.end(), 0);
+    QtConcurrent::blockingMap(bucketIndexes, [&](uint32_t bucket)
     {
-        const uint16_t x = (*onePixel).x;
-        const uint16_t y = (*onePixel).y;
-
-        if (x <= offsetX || y <= offsetY)
-            continue;
-
-        uint32_t offset = (x - offsetX) + (y - offsetY) * width;
-
-        lightBuffer[offset] = median3x3Filter(x - offsetX, y - offsetY, width, lightBuffer);
-    }
+        for (uint32_t i = buckets[bucket]; i < buckets[bucket + 1]; i++)
+            values[i] = DefectMap::median3x3Filter(offsets[i], width, lightBuffer);
+    });
 
-    for (BadPixelSet::const_iterator onePixel = defectMap->coldPixels().cbegin();
-            onePixel != defectMap->coldThreshold(); ++onePixel)
+    // Replace the defects, keeping their values for the statistics update.
+    std::vector<double> oldValues(values.size()), newValues(values.size());
+    QtConcurrent::blockingMap(bucketIndexes, [&](uint32_t bucket)
     {
-        const uint16_t x = (*onePixel).x;
-        const uint16_t y = (*onePixel).y;
-
-        if (x <= offsetX || y <= offsetY)
-            continue;
-
-        uint32_t offset = (x - offsetX) + (y - offsetY) * width;
-
-        lightBuffer[offset] = median3x3Filter(x - offsetX, y - offsetY, width, lightBuffer);
-    }
+        for (uint32_t i = buckets[bucket]; i < buckets[bucket + 1]; i++)
+        {
+            oldValues[i] = lightBuffer[offsets[i]];
+            newValues[i] = values[i];
+            lightBuffer[offsets[i]] = values[i];
+        }
+    });
 
-    lightData->calculateStats(true);
+    lightData->updateStatistics(oldValues, newValues);
     emit darkFrameCompleted(true);
-
-}
-
-///////////////////////////////////////////////////////////////////////////////////////
-///
-///////////////////////////////////////////////////////////////////////////////////////
-template <typename T>
-T DarkLibrary::median3x3Filter(uint16_t x, uint16_t y, uint32_t width, T *buffer)
-{
-    T *top = buffer + (y - 1) * width + (x - 1);
-    T *mid = buffer + (y - 0) * width + (x - 1);
-    T *bot = buffer + (y + 1) * width + (x - 1);
-
-    std::array<T, 8> elements;
-
-    // Top
-    elements[0] = *(top + 0);
-    elements[1] = *(top + 1);
-    elements[2] = *(top + 2);
-    // Mid
-    elements[3] = *(mid + 0);
-    // Mid+1 is the defective value, so we skip and go for + 2
-    elements[4] = *(mid + 2);
-    // Bottom
-    elements[5] = *(bot + 0);
-    elements[6] = *(bot + 1);
-    elements[7] = *(bot + 2);
-
-    std::sort(elements.begin(), elements.end());
-    auto median = (elements[3] + elements[4]) / 2;
-    return median;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -722,9 +856,24 @@ void DarkLibrary::denoise(ISD::CCDChip *m_TargetChip, const QSharedPointer<FITSD
         }
     }
 
+    // A master dark of the same duration is used as is. Otherwise, synthesize the dark from bias and thermal
+    // current if the library covers enough durations. One pass over the masters of the chip selects both.
+    int binX, binY;
+    m_TargetChip->getBinning(&binX, &binY);
+    const DarkSelection selection = selectDarkFrames(m_TargetChip, binX, binY, duration);
+    QSharedPointer<DarkModel> darkModel;
+    if (!selection.exact && findDarkModel(selection.modelMasters, darkModel) &&
+            darkModel->subtract(targetData, duration, offsetX, offsetY))
+    {
+        targetData->calculateStats(true);
+        qCDebug(KSTARS_EKOS) << "Scaled dark frame subtraction applied";
+        emit darkFrameCompleted(true);
+        return;
+    }
+
     // Check if we have valid dark data and then use it.
     QSharedPointer<FITSData> darkData;
-    if (findDarkFrame(m_TargetChip, duration, darkData))
+    if (loadDarkFrame(selection.nearest, duration, darkData))
     {
         subtractDarkData(darkData, targetData, filter, offsetX, offsetY);
         qCDebug(KSTARS_EKOS) << "Dark frame subtraction applied";
@@ -760,13 +909,7 @@ void DarkLibrary::processNewImage(SequenceJob *job, const QSharedPointer<FITSDat
         if (m_CurrentCamera->hasCooler())
             metadata["temperature"] = job->getCurrentTemperature();
 
-        metadata["count"] = job->getCount();
         generateMasterFrame(m_CurrentDarkFrame, metadata);
-        reloadDarksFromDatabase();
-        populateMasterMetedata();
-        histogramView->setImageData(m_CurrentDarkFrame);
-        if (!Options::nonLinearHistogram() && !m_CurrentDarkFrame->isHistogramConstructed())
-            m_CurrentDarkFrame->constructHistogram();
     }
 }
 
@@ -784,11 +927,17 @@ void DarkLibrary::processNewBLOB(IBLOB *bp)
 
     m_DarkView->loadData(m_CurrentDarkFrame);
 
-    uint32_t totalElements = m_CurrentDarkFrame->channels() * m_CurrentDarkFrame->samplesPerChannel();
-    if (totalElements != m_DarkMasterBuffer.size())
-        m_DarkMasterBuffer.assign(totalElements, 0);
+    // Frames are stacked next to the masters, the temporary directory is often in memory
+    if (m_DarkCombiner.isNull())
+        m_DarkCombiner.reset(new DarkCombiner(QDir(KSPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("darks"),
+                                              static_cast<DarkCombiner::Algorithm>(combinAlgorithmCombo->currentIndex())));
+
+    if (!m_DarkCombiner->addFrame(m_CurrentDarkFrame))
+    {
+        m_FileLabel->setText(i18n("Failed to store dark frame for stacking."));
+        return;
+    }
 
-    aggregate(m_CurrentDarkFrame);
     darkProgress->setValue(darkProgress->value() + 1);
     m_StatusLabel->setText(i18n("Received %1/%2 images.", darkProgress->value(), darkProgress->maximum()));
 }
@@ -881,6 +1030,17 @@ void DarkLibrary::clearBuffers()
 {
     m_CurrentDarkFrame.clear();
     // Should clear existing view
+    resetDarkFrame();
+    m_DarkView->clearData();
+    m_CurrentDefectMap.clear();
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+void DarkLibrary::resetDarkFrame()
+{
     m_CurrentDarkFrame.reset(new FITSData(), &QObject::deleteLater);
     connect(m_CurrentDarkFrame.data(), &FITSData::histogramReady, [this]()
     {
@@ -888,9 +1048,6 @@ void DarkLibrary::clearBuffers()
         histogramView->reset();
         histogramView->syncGUI();
     });
-    m_DarkView->clearData();
-    m_CurrentDefectMap.clear();
-
 }
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
@@ -1093,11 +1250,12 @@ void DarkLibrary::loadCurrentMasterDark(const QString &camera, int masterIndex)
 void DarkLibrary::loadCurrentMasterDefectMap()
 {
     // Find if we have an existing map
-    if (m_CachedDefectMaps.contains(m_MasterDarkFrameFilename))
+    QSharedPointer<DefectMap> cachedMap = m_MasterCache->defectMap(m_MasterDarkFrameFilename);
+    if (cachedMap)
     {
-        if (m_CurrentDefectMap != m_CachedDefectMaps.value(m_MasterDarkFrameFilename))
+        if (m_CurrentDefectMap != cachedMap)
         {
-            m_CurrentDefectMap = m_CachedDefectMaps.value(m_MasterDarkFrameFilename);
+            m_CurrentDefectMap = cachedMap;
             m_DarkView->setDefectMap(m_CurrentDefectMap);
             m_CurrentDefectMap->setDarkData(m_CurrentDarkFrame);
         }
@@ -1115,7 +1273,7 @@ void DarkLibrary::loadCurrentMasterDefectMap()
         });
 
         if (!m_DefectMapFilename.isEmpty())
-            cacheDefectMapFromFile(m_MasterDarkFrameFilename, m_DefectMapFilename);
+            cacheDefectMapFromFile(m_MasterDarkFrameFilename, m_DefectMapFilename, cachedMap);
 
         m_DarkView->setDefectMap(m_CurrentDefectMap);
         m_CurrentDefectMap->setDarkData(m_CurrentDarkFrame);
@@ -1387,6 +1545,7 @@ void DarkLibrary::generateDarkJobs()
 void DarkLibrary::executeDarkJobs()
 {
     m_DarkImagesCounter = 0;
+    m_DarkCombiner.clear();
     darkProgress->setValue(0);
     darkProgress->setTextVisible(true);
     connect(m_CaptureModule, &Capture::newImage, this, &DarkLibrary::processNewImage, Qt::UniqueConnection);
@@ -1409,6 +1568,7 @@ void DarkLibrary::executeDarkJobs()
 void DarkLibrary::stopDarkJobs()
 {
     m_CaptureModule->abort();
+    m_DarkCombiner.clear();
     darkProgress->setValue(0);
     m_DarkView->reset();
 }
@@ -1428,121 +1588,53 @@ void DarkLibrary::initView()
     //connect(m_DarkView, &FITSView::loaded, this, &DarkLibrary::loadCurrentMasterDefectMap);
 }
 
-///////////////////////////////////////////////////////////////////////////////////////
-///
-///////////////////////////////////////////////////////////////////////////////////////
-void DarkLibrary::aggregate(const QSharedPointer<FITSData> &data)
-{
-    switch (data->dataType())
-    {
-        case TBYTE:
-            aggregateInternal<uint8_t>(data);
-            break;
-
-        case TSHORT:
-            aggregateInternal<int16_t>(data);
-            break;
-
-        case TUSHORT:
-            aggregateInternal<uint16_t>(data);
-            break;
-
-        case TLONG:
-            aggregateInternal<int32_t>(data);
-            break;
-
-        case TULONG:
-            aggregateInternal<uint32_t>(data);
-            break;
-
-        case TFLOAT:
-            aggregateInternal<float>(data);
-            break;
-
-        case TLONGLONG:
-            aggregateInternal<int64_t>(data);
-            break;
-
-        case TDOUBLE:
-            aggregateInternal<double>(data);
-            break;
-
-        default:
-            break;
-    }
-}
-
-///////////////////////////////////////////////////////////////////////////////////////
-///
-///////////////////////////////////////////////////////////////////////////////////////
-template <typename T>
-void DarkLibrary::aggregateInternal(const QSharedPointer<FITSData> &data)
-{
-    T const *darkBuffer  = reinterpret_cast<T const*>(data->getImageBuffer());
-    for (uint32_t i = 0; i < m_DarkMasterBuffer.size(); i++)
-        m_DarkMasterBuffer[i] += darkBuffer[i];
-}
-
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
 void DarkLibrary::generateMasterFrame(const QSharedPointer<FITSData> &data, const QJsonObject &metadata)
 {
-    switch (data->dataType())
-    {
-        case TBYTE:
-            generateMasterFrameInternal<uint8_t>(data, metadata);
-            break;
-
-        case TSHORT:
-            generateMasterFrameInternal<int16_t>(data, metadata);
-            break;
-
-        case TUSHORT:
-            generateMasterFrameInternal<uint16_t>(data, metadata);
-            break;
-
-        case TLONG:
-            generateMasterFrameInternal<int32_t>(data, metadata);
-            break;
-
-        case TULONG:
-            generateMasterFrameInternal<uint32_t>(data, metadata);
-            break;
-
-        case TFLOAT:
-            generateMasterFrameInternal<float>(data, metadata);
-            break;
+    // The frames of this job are stacked in the background while the next job is captured.
+    QSharedPointer<DarkCombiner> combiner = m_DarkCombiner;
+    m_DarkCombiner.clear();
+    if (combiner.isNull() || combiner->count() == 0)
+        return;
 
-        case TLONGLONG:
-            generateMasterFrameInternal<int64_t>(data, metadata);
-            break;
+    if (data == m_CurrentDarkFrame)
+        resetDarkFrame();
 
-        case TDOUBLE:
-            generateMasterFrameInternal<double>(data, metadata);
-            break;
+    QJsonObject masterMetadata = metadata;
+    masterMetadata["count"] = static_cast<int>(combiner->count());
 
-        default:
-            break;
-    }
+    uint8_t *buffer = data->getWritableImageBuffer();
+    auto *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, data, masterMetadata]()
+    {
+        if (watcher->result())
+        {
+            saveMasterFrame(data, masterMetadata);
+            reloadDarksFromDatabase();
+            populateMasterMetedata();
+            histogramView->setImageData(data);
+            if (!Options::nonLinearHistogram() && !data->isHistogramConstructed())
+                data->constructHistogram();
+        }
+        else
+            m_FileLabel->setText(i18n("Failed to stack dark frames."));
+        watcher->deleteLater();
+    });
 
-    // Reset Master Buffer
-    m_DarkMasterBuffer.assign(m_DarkMasterBuffer.size(), 0);
+    m_StatusLabel->setText(i18n("Stacking %1 dark frames...", combiner->count()));
+    watcher->setFuture(QtConcurrent::run([combiner, buffer]()
+    {
+        return combiner->combine(buffer);
+    }));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
-template <typename T>  void DarkLibrary::generateMasterFrameInternal(const QSharedPointer<FITSData> &data,
-        const QJsonObject &metadata)
+void DarkLibrary::saveMasterFrame(const QSharedPointer<FITSData> &data, const QJsonObject &metadata)
 {
-    T *writableBuffer = reinterpret_cast<T *>(data->getWritableImageBuffer());
-    const uint32_t count = metadata["count"].toInt();
-    // Average the values
-    for (uint32_t i = 0; i < m_DarkMasterBuffer.size(); i++)
-        writableBuffer[i] = m_DarkMasterBuffer[i] / count;
-
-
     QString ts = QDateTime::currentDateTime().toString("yyyy-MM-ddThh-mm-ss");
     QString path = QDir(KSPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("darks/darkframe_" + ts + ".fits");
 
@@ -1553,7 +1645,7 @@ template <typename T>  void DarkLibrary::generateMasterFrameInternal(const QShar
         return;
     }
 
-    m_CachedDarkFrames[path] = data;
+    m_MasterCache->insertFrame(CalibrationCache::DARK_FRAME, path, data);
 
     QVariantMap map;
     map["ccd"]         = metadata["camera"].toString();
@@ -1565,6 +1657,8 @@ template <typename T>  void DarkLibrary::generateMasterFrameInternal(const QShar
     map["filename"]    = path;
 
     m_DarkFramesDatabaseList.append(map);
+    m_DarkFramesIndex[darkFramesKey(map["ccd"].toString(), map["chip"].toInt(), map["binX"].toInt(),
+                                    map["binY"].toInt())].append(m_DarkFramesDatabaseList.size() - 1);
     m_FileLabel->setText(i18n("Master Dark saved to %1", path));
     KStarsData::Instance()->userdb()->AddDarkFrame(map);
 }
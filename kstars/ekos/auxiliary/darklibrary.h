@@ -11,12 +11,17 @@
 
 #include "indi/indiccd.h"
 #include "indi/indicap.h"
+#include "calibrationcache.h"
+#include "darkcombiner.h"
+#include "darkmodel.h"
 #include "darkview.h"
 #include "defectmap.h"
 #include "ekos/ekos.h"
 
 #include <QDialog>
+#include <QHash>
 #include <QPointer>
+#include <QSet>
 #include "ui_darklibrary.h"
 
 class QSqlTableModel;
@@ -47,6 +52,29 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
 
         bool findDarkFrame(ISD::CCDChip *targetChip, double duration, QSharedPointer<FITSData> &darkData);
         bool findDefectMap(ISD::CCDChip *targetChip, double duration, QSharedPointer<DefectMap> &defectMap);
+        /**
+         * @brief findDarkModel Find the bias and thermal current model of the chip in its current conditions.
+         * The model is fitted in the background from the most recent master darks of each duration, and kept
+         * in the master cache.
+         * @return False if the library does not hold masters of at least two durations for the chip, or if the
+         * model is still being fitted.
+         */
+        bool findDarkModel(ISD::CCDChip *targetChip, QSharedPointer<DarkModel> &darkModel);
+
+        /**
+         * @brief prewarmMasters Load in the background the masters that denoising the light frames of the jobs
+         * would use, so that the first frame of each job does not wait for them.
+         */
+        void prewarmMasters(const QList<SequenceJob *> &jobs);
+
+        /**
+         * @brief masterCache Memory budgeted cache of the loaded masters, its counters help diagnose the
+         * budget.
+         */
+        const CalibrationCache *masterCache() const
+        {
+            return m_MasterCache;
+        }
         // Return false if canceled. True if dark capture proceeds
         void denoise(ISD::CCDChip *targetChip, const QSharedPointer<FITSData> &targetData, double duration,
                      FITSScale filter, uint16_t offsetX, uint16_t offsetY);
@@ -109,33 +137,18 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
         void stopDarkJobs();
 
         /**
-         * @brief generateMasterFrameHelper Calls templated generateMasterFrame with the correct data type.
-         * @param data Passed dark frame data to generateMasterFrame
-         * @param metadata passed metadata to generateMasterFrame
-         */
-        void generateMasterFrame(const QSharedPointer<FITSData> &data, const QJsonObject &metadata);
-
-        /**
-         * @brief generateMasterFrame After data aggregation is done, the selected stacking algorithm is applied and the master dark
-         * frame is saved to disk and user database along with the metadata.
-         * @param data last used data. This is not used for reading, but to simply apply the algorithm to the FITSData buffer
-         * and then save it to disk.
+         * @brief generateMasterFrame After all frames of a job are received, the selected stacking algorithm is applied
+         * in the background, then the master dark frame is saved by saveMasterFrame.
+         * @param data last used data. This is not used for reading, but to receive the master frame
+         * and then save it to disk. Following frames are received in a new dark frame.
          * @param metadata information on frame to help in the stacking process.
          */
-        template <typename T>  void generateMasterFrameInternal(const QSharedPointer<FITSData> &data, const QJsonObject &metadata);
-
-        /**
-         * @brief aggregateHelper Calls tempelated aggregate function with the appropiate data type.
-         * @param data Dark frame data to pass on to aggregate function.
-         */
-        void aggregate(const QSharedPointer<FITSData> &data);
+        void generateMasterFrame(const QSharedPointer<FITSData> &data, const QJsonObject &metadata);
 
         /**
-         * @brief aggregate Aggregate the data as per the selected algorithm. Each time a new dark frame is received, this function
-         * adds the frame data to the dark buffer.
-         * @param data Dark frame data.
+         * @brief saveMasterFrame Save the master dark frame to disk and user database along with the metadata.
          */
-        template <typename T> void aggregateInternal(const QSharedPointer<FITSData> &data);
+        void saveMasterFrame(const QSharedPointer<FITSData> &data, const QJsonObject &metadata);
 
         /**
          * @brief subtractHelper Calls tempelated subtract function
@@ -163,9 +176,61 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
         /**
          * @brief cacheDarkFrameFromFile Load dark frame from disk and saves it in the local dark frames cache
          * @param filename path of dark frame to load
+         * @param darkData loaded dark frame
          * @return True if file is successfully loaded, false otherwise.
          */
-        bool cacheDarkFrameFromFile(const QString &filename);
+        bool cacheDarkFrameFromFile(const QString &filename, QSharedPointer<FITSData> &darkData);
+
+        /**
+         * @brief loadDarkFrame Get the master dark of a database record from the master cache, or load it.
+         * @return False if the record is empty, expired or cannot be loaded.
+         */
+        bool loadDarkFrame(const QVariantMap &bestCandidate, double duration, QSharedPointer<FITSData> &darkData);
+
+        typedef struct
+        {
+            // Master dark best matching the duration, empty if none matches
+            QVariantMap nearest;
+            // Most recent valid master dark of each duration, to fit a model
+            QMap<double, QVariantMap> modelMasters;
+            // Whether the nearest master is valid and of the exact duration
+            bool exact {false};
+        } DarkSelection;
+
+        /**
+         * @brief selectDarkFrames Select the masters of the chip for the duration in a single pass over the
+         * records of the chip and binning.
+         */
+        DarkSelection selectDarkFrames(ISD::CCDChip *targetChip, int binX, int binY, double duration);
+
+        /**
+         * @brief isBetterDarkCandidate Check if a master dark matches the duration and conditions better than
+         * the best candidate so far.
+         */
+        bool isBetterDarkCandidate(ISD::CCDChip *targetChip, const QVariantMap &map, const QVariantMap &bestCandidate,
+                                   double duration);
+
+        /**
+         * @brief findDarkModel Find the model fitted from the masters, or start fitting it.
+         */
+        bool findDarkModel(const QMap<double, QVariantMap> &masters, QSharedPointer<DarkModel> &darkModel);
+
+        /**
+         * @brief indexDarkFrames Index the records of the library by camera, chip and binning.
+         */
+        void indexDarkFrames();
+        static QString darkFramesKey(const QString &ccd, int chip, int binX, int binY);
+        QVector<int> chipDarkFrames(ISD::CCDChip *targetChip, int binX, int binY) const;
+
+        /**
+         * @brief darkModelKey Cache key of the model fitted from the masters, a new master makes a new key.
+         */
+        static QString darkModelKey(const QMap<double, QVariantMap> &masters);
+
+        /**
+         * @brief fitDarkModel Fit the model of the masters in the background, and keep it in the master cache.
+         */
+        void fitDarkModel(const QString &key, const QMap<double, QVariantMap> &masters);
 
 
         ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -176,6 +241,7 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
         void reloadDarksFromDatabase();
         void loadCurrentMasterDefectMap();
         void clearBuffers();
+        void resetDarkFrame();
 
         ////////////////////////////////////////////////////////////////////////////////////////////////
         /// Defect Map Functions
@@ -186,14 +252,22 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
         /**
          * @brief cacheDefectMapFromFile Load defect map from disk and saves it in the local defect maps cache
          * @param key dark file name that is used as the key in the defect map cache
-         * @param filename path of dark frame to load
+         * @param filename path of defect map to load
+         * @param defectMap loaded defect map
          * @return True if file is successfully loaded, false otherwise.
          */
-        bool cacheDefectMapFromFile(const QString &key, const QString &filename);
+        bool cacheDefectMapFromFile(const QString &key, const QString &filename, QSharedPointer<DefectMap> &defectMap);
+
+        /**
+         * @brief findDefectCandidate Select the master dark with a defect map best matching the chip and duration.
+         * @return Database record of the master, empty if none matches.
+         */
+        QVariantMap findDefectCandidate(ISD::CCDChip *targetChip, int binX, int binY, double duration);
 
         /**
          * @brief normalizeDefects Remove defects from LIGHT image by replacing bad pixels with a 3x3 median filter around
-         * them.
+         * them. Defects are looked up in the table cached by the defect map for the subframe and corrected in parallel
+         * row buckets. Statistics of the light data are updated incrementally.
          * @param defectMap Defect Map containing a list of hot and cold pixels.
          * @param lightData Target light data to remove noise from.
          * @param filter Filter used for light data
@@ -207,8 +281,6 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
         void normalizeDefectsInternal(const QSharedPointer<DefectMap> &defectMap, const QSharedPointer<FITSData> &lightData,
                                       FITSScale filter, uint16_t offsetX, uint16_t offsetY);
 
-        template <typename T>
-        T median3x3Filter(uint16_t x, uint16_t y, uint32_t width, T *buffer);
 
 
         ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -216,8 +288,12 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
         ////////////////////////////////////////////////////////////////////////////////////////////////
 
         QList<QVariantMap> m_DarkFramesDatabaseList;
-        QMap<QString, QSharedPointer<FITSData>> m_CachedDarkFrames;
-        QMap<QString, QSharedPointer<DefectMap>> m_CachedDefectMaps;
+        // Positions of the records in the list by camera, chip and binning
+        QHash<QString, QVector<int>> m_DarkFramesIndex;
+        // Dark frames by path and defect maps by path of their dark frame
+        CalibrationCache *m_MasterCache {nullptr};
+        // Dark models that could not be fitted, by cache key
+        QSet<QString> m_FailedDarkModels;
 
         ISD::CCD *m_CurrentCamera {nullptr};
         ISD::CCDChip *m_TargetChip {nullptr};
@@ -228,7 +304,8 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
         QSqlTableModel *darkFramesModel = nullptr;
         QSortFilterProxyModel *sortFilter = nullptr;
 
-        std::vector<uint32_t> m_DarkMasterBuffer;
+        // Frames of the dark job being captured
+        QSharedPointer<DarkCombiner> m_DarkCombiner;
         uint32_t m_DarkImagesCounter {0};
         bool m_RememberFITSViewer {true};
         bool m_RememberSummaryView {true};
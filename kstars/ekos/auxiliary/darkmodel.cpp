@@ -0,0 +1,240 @@
+/*  Dark Model
+    Scaled dark frames from bias and thermal current masters.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "darkmodel.h"
+
+#include "fitsviewer/fitsconvolution.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace
+{
+// Precision used to synthesize darks: single precision is plenty for 8 and 16 bit sensors.
+template <typename T>
+using DarkReal = typename std::conditional < (sizeof(T) <= 2), float, double >::type;
+
+template <typename T, typename R>
+inline T toPixel(R value)
+{
+    return static_cast<T>(std::is_integral<T>::value ? value + R(0.5) : value);
+}
+}
+
+bool DarkModel::addDark(const QSharedPointer<FITSData> &data, double duration)
+{
+    if (data.isNull() || data->getImageBuffer() == nullptr)
+        return false;
+
+    if (m_Count == 0)
+    {
+        m_Width = data->width();
+        m_Height = data->height();
+        m_Channels = data->channels();
+        m_ReferenceDuration = duration;
+        m_SumValues.assign(static_cast<size_t>(data->samplesPerChannel()) * m_Channels, 0.0f);
+        m_SumProducts.assign(m_SumValues.size(), 0.0f);
+        m_Bias.clear();
+        m_Thermal.clear();
+    }
+    else if (data->width() != m_Width || data->height() != m_Height || data->channels() != m_Channels)
+        return false;
+
+    const double relativeDuration = duration - m_ReferenceDuration;
+    switch (data->dataType())
+    {
+        case TBYTE:
+            accumulate(reinterpret_cast<uint8_t const *>(data->getImageBuffer()), relativeDuration);
+            break;
+
+        case TSHORT:
+            accumulate(reinterpret_cast<int16_t const *>(data->getImageBuffer()), relativeDuration);
+            break;
+
+        case TUSHORT:
+            accumulate(reinterpret_cast<uint16_t const *>(data->getImageBuffer()), relativeDuration);
+            break;
+
+        case TLONG:
+            accumulate(reinterpret_cast<int32_t const *>(data->getImageBuffer()), relativeDuration);
+            break;
+
+        case TULONG:
+            accumulate(reinterpret_cast<uint32_t const *>(data->getImageBuffer()), relativeDuration);
+            break;
+
+        case TFLOAT:
+            accumulate(reinterpret_cast<float const *>(data->getImageBuffer()), relativeDuration);
+            break;
+
+        case TLONGLONG:
+            accumulate(reinterpret_cast<int64_t const *>(data->getImageBuffer()), relativeDuration);
+            break;
+
+        case TDOUBLE:
+            accumulate(reinterpret_cast<double const *>(data->getImageBuffer()), relativeDuration);
+            break;
+
+        default:
+            return false;
+    }
+
+    m_Count++;
+    m_SumDurations += relativeDuration;
+    m_SumSquaredDurations += relativeDuration * relativeDuration;
+    return true;
+}
+
+template <typename T>
+void DarkModel::accumulate(T const *buffer, double duration)
+{
+    float * const sums = m_SumValues.data();
+    float * const products = m_SumProducts.data();
+    const float scale = static_cast<float>(duration);
+
+    // Planes are contiguous, so all channels are processed as one tall image.
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands(m_Height * m_Channels);
+    const size_t width = m_Width;
+    QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
+    {
+        for (size_t i = band.first * width; i < band.second * width; i++)
+        {
+            const float value = static_cast<float>(buffer[i]);
+            sums[i] += value;
+            products[i] += value * scale;
+        }
+    });
+}
+
+bool DarkModel::fit()
+{
+    // Spread of the durations, zero if all darks have the same duration
+    const double spread = m_Count > 0 ? m_SumSquaredDurations - m_SumDurations * m_SumDurations / m_Count : 0;
+    if (m_Count < 2 || spread <= 1e-9 * m_SumSquaredDurations)
+        return false;
+
+    // Bias and thermal current overwrite the sums they are solved from, the model never holds more than
+    // two single precision values per pixel.
+    float * const sums = m_SumValues.data();
+    float * const products = m_SumProducts.data();
+    const double count = m_Count, meanDuration = m_SumDurations / m_Count;
+    const double referenceDuration = m_ReferenceDuration;
+
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands(m_Height * m_Channels);
+    const size_t width = m_Width;
+    QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
+    {
+        for (size_t i = band.first * width; i < band.second * width; i++)
+        {
+            const double slope = (products[i] - sums[i] * meanDuration) / spread;
+            sums[i] = static_cast<float>(sums[i] / count - slope * (meanDuration + referenceDuration));
+            products[i] = static_cast<float>(slope);
+        }
+    });
+
+    m_Bias.swap(m_SumValues);
+    m_Thermal.swap(m_SumProducts);
+    m_SumValues.clear();
+    m_SumValues.shrink_to_fit();
+    m_SumProducts.clear();
+    m_SumProducts.shrink_to_fit();
+    m_Count = 0;
+    m_ReferenceDuration = m_SumDurations = m_SumSquaredDurations = 0;
+    return true;
+}
+
+bool DarkModel::subtract(const QSharedPointer<FITSData> &lightData, double duration, uint16_t offsetX,
+                         uint16_t offsetY) const
+{
+    const uint32_t width = lightData->width();
+    const uint32_t height = lightData->height();
+    if (!isValid() || lightData->channels() != m_Channels || offsetX + width > m_Width || offsetY + height > m_Height)
+        return false;
+
+    uint8_t *buffer = lightData->getWritableImageBuffer();
+    switch (lightData->dataType())
+    {
+        case TBYTE:
+            subtractInternal(reinterpret_cast<uint8_t *>(buffer), width, height, duration, offsetX, offsetY);
+            break;
+
+        case TSHORT:
+            subtractInternal(reinterpret_cast<int16_t *>(buffer), width, height, duration, offsetX, offsetY);
+            break;
+
+        case TUSHORT:
+            subtractInternal(reinterpret_cast<uint16_t *>(buffer), width, height, duration, offsetX, offsetY);
+            break;
+
+        case TLONG:
+            subtractInternal(reinterpret_cast<int32_t *>(buffer), width, height, duration, offsetX, offsetY);
+            break;
+
+        case TULONG:
+            subtractInternal(reinterpret_cast<uint32_t *>(buffer), width, height, duration, offsetX, offsetY);
+            break;
+
+        case TFLOAT:
+            subtractInternal(reinterpret_cast<float *>(buffer), width, height, duration, offsetX, offsetY);
+            break;
+
+        case TLONGLONG:
+            subtractInternal(reinterpret_cast<int64_t *>(buffer), width, height, duration, offsetX, offsetY);
+            break;
+
+        case TDOUBLE:
+            subtractInternal(reinterpret_cast<double *>(buffer), width, height, duration, offsetX, offsetY);
+            break;
+
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+template <typename T>
+void DarkModel::subtractInternal(T *buffer, uint32_t width, uint32_t height, double duration, uint16_t offsetX,
+                                 uint16_t offsetY) const
+{
+    using R = DarkReal<T>;
+
+    float const * const bias = m_Bias.data();
+    float const * const thermal = m_Thermal.data();
+    const size_t modelPlane = static_cast<size_t>(m_Width) * m_Height;
+    const size_t lightPlane = static_cast<size_t>(width) * height;
+    const size_t modelStride = m_Width;
+    const R scale = static_cast<R>(duration);
+
+    // The dark is synthesized and subtracted in the same pass, one row at a time.
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands(height);
+    const uint8_t channels = m_Channels;
+    QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
+    {
+        for (uint8_t c = 0; c < channels; c++)
+        {
+            for (int y = band.first; y < band.second; y++)
+            {
+                T *light = buffer + c * lightPlane + static_cast<size_t>(y) * width;
+                const size_t offset = c * modelPlane + (y + offsetY) * modelStride + offsetX;
+                float const *b = bias + offset;
+                float const *t = thermal + offset;
+
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    const R dark = static_cast<R>(b[x]) + static_cast<R>(t[x]) * scale;
+                    light[x] = toPixel<T>(std::max(static_cast<R>(light[x]) - dark, R(0)));
+                }
+            }
+        }
+    });
+}
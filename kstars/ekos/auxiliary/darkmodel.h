@@ -0,0 +1,99 @@
+/*  Dark Model
+    Scaled dark frames from bias and thermal current masters.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include "fitsviewer/fitsdata.h"
+
+#include <QSharedPointer>
+
+#include <vector>
+
+/**
+ * @brief The DarkModel class decomposes master darks into a bias and a thermal current per pixel.
+ *
+ * The dark signal of each pixel is modeled as bias + thermal * duration. Both terms are fitted by least
+ * squares over master darks of at least two different durations, taken in the same conditions. A dark
+ * frame of any duration is then synthesized while it is subtracted from a light frame.
+ */
+class DarkModel
+{
+    public:
+        DarkModel() = default;
+
+        /**
+         * @brief addDark Accumulate a master dark frame.
+         * @param data Master dark, all darks of a model must have the same size.
+         * @param duration Exposure duration of the dark in seconds.
+         * @return False if the dark does not match the previous darks.
+         */
+        bool addDark(const QSharedPointer<FITSData> &data, double duration);
+
+        /**
+         * @brief fit Solve bias and thermal current of every pixel from the accumulated darks.
+         * @return False if the darks do not span at least two different durations.
+         */
+        bool fit();
+
+        /**
+         * @brief subtract Subtract the dark of the given duration from the light frame, clamping at zero.
+         * @param lightData Light frame, modified in place.
+         * @param duration Exposure duration of the light frame in seconds.
+         * @param offsetX Horizontal offset of a subframed light frame in the full frame.
+         * @param offsetY Vertical offset of a subframed light frame in the full frame.
+         * @return False if the light frame does not fit in the model.
+         */
+        bool subtract(const QSharedPointer<FITSData> &lightData, double duration, uint16_t offsetX, uint16_t offsetY) const;
+
+        bool isValid() const
+        {
+            return !m_Bias.empty();
+        }
+        uint32_t width() const
+        {
+            return m_Width;
+        }
+        uint32_t height() const
+        {
+            return m_Height;
+        }
+        /** Bias level per pixel, channel after channel. */
+        const std::vector<float> &bias() const
+        {
+            return m_Bias;
+        }
+        /** Thermal current per pixel and per second, channel after channel. */
+        const std::vector<float> &thermal() const
+        {
+            return m_Thermal;
+        }
+
+    private:
+        template <typename T>
+        void accumulate(T const *buffer, double duration);
+        template <typename T>
+        void subtractInternal(T *buffer, uint32_t width, uint32_t height, double duration, uint16_t offsetX,
+                              uint16_t offsetY) const;
+
+        uint32_t m_Width { 0 };
+        uint32_t m_Height { 0 };
+        uint8_t m_Channels { 0 };
+
+        // Least squares sums, fitted in place into bias and thermal current. Durations are taken relative to
+        // the first dark so that single precision sums keep enough significant digits.
+        std::vector<float> m_SumValues;
+        std::vector<float> m_SumProducts;
+        uint32_t m_Count { 0 };
+        double m_ReferenceDuration { 0 };
+        double m_SumDurations { 0 };
+        double m_SumSquaredDurations { 0 };
+
+        std::vector<float> m_Bias;
+        std::vector<float> m_Thermal;
+};
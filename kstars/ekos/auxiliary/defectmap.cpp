@@ -9,6 +9,13 @@
 
 #include "defectmap.h"
 #include <QJsonDocument>
+#include <algorithm>
+
+namespace
+{
+// Subframes whose defect tables are kept, captures rarely alternate between more.
+const int MaxDefectTables = 4;
+}
 
 //////////////////////////////////////////////////////////////////////////////
 ///
@@ -77,6 +84,7 @@ bool DefectMap::load(const QString &filename)
     }
 
     m_ColdPixelsCount = m_ColdPixels.size();
+    m_DefectTables.clear();
     return true;
 }
 
@@ -267,6 +275,8 @@ void DefectMap::filterPixels()
     else
         m_ColdPixelsCount = std::distance(m_ColdPixels.cbegin(), m_ColdPixelsThreshold);
 
+    m_DefectTables.clear();
+
     emit pixelsUpdated(m_HotPixelsCount, m_ColdPixelsCount);
 }
 
@@ -276,6 +286,7 @@ void DefectMap::filterPixels()
 void DefectMap::setHotEnabled(bool enabled)
 {
     m_HotEnabled = enabled;
+    m_DefectTables.clear();
     emit pixelsUpdated(m_HotEnabled ? m_HotPixelsCount : 0, m_ColdPixelsCount);
 }
 
@@ -285,5 +296,66 @@ void DefectMap::setHotEnabled(bool enabled)
 void DefectMap::setColdEnabled(bool enabled)
 {
     m_ColdEnabled = enabled;
+    m_DefectTables.clear();
     emit pixelsUpdated(m_HotPixelsCount, m_ColdEnabled ? m_ColdPixelsCount : 0);
 }
+
+//////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////
+QSharedPointer<DefectTable> DefectMap::defectTable(const QRect &subFrame)
+{
+    for (int i = 0; i < m_DefectTables.size(); i++)
+    {
+        if (m_DefectTables[i].first == subFrame)
+        {
+            m_DefectTables.move(i, 0);
+            return m_DefectTables.first().second;
+        }
+    }
+
+    QSharedPointer<DefectTable> table(new DefectTable());
+    appendDefects(hotThreshold(), m_HotPixels.cend(), subFrame, table->offsets);
+    appendDefects(m_ColdPixels.cbegin(), coldThreshold(), subFrame, table->offsets);
+
+    // Pixels are sorted by value in the sets, so sort them by position and drop duplicates.
+    std::sort(table->offsets.begin(), table->offsets.end());
+    table->offsets.erase(std::unique(table->offsets.begin(), table->offsets.end()), table->offsets.end());
+
+    const uint32_t width = subFrame.width();
+    const uint32_t bucketCount = (subFrame.height() + DefectTable::RowsPerBucket - 1) / DefectTable::RowsPerBucket;
+    table->buckets.reserve(bucketCount + 1);
+    for (uint32_t i = 0; i < bucketCount; i++)
+    {
+        const uint32_t firstOffset = i * DefectTable::RowsPerBucket * width;
+        table->buckets.append(std::lower_bound(table->offsets.cbegin(), table->offsets.cend(), firstOffset) -
+                              table->offsets.cbegin());
+    }
+    table->buckets.append(table->offsets.size());
+
+    m_DefectTables.prepend(qMakePair(subFrame, table));
+    while (m_DefectTables.size() > MaxDefectTables)
+        m_DefectTables.removeLast();
+    return table;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////
+void DefectMap::appendDefects(BadPixelSet::const_iterator begin, BadPixelSet::const_iterator end,
+                              const QRect &subFrame, QVector<uint32_t> &offsets) const
+{
+    const int width = subFrame.width();
+    const int height = subFrame.height();
+
+    for (auto onePixel = begin; onePixel != end; ++onePixel)
+    {
+        // Coordinates in the subframe, the median filter needs the whole neighbourhood.
+        const int x = onePixel->x - subFrame.x();
+        const int y = onePixel->y - subFrame.y();
+        if (x < 1 || y < 1 || x >= width - 1 || y >= height - 1)
+            continue;
+
+        offsets.append(static_cast<uint32_t>(x) + static_cast<uint32_t>(y) * width);
+    }
+}
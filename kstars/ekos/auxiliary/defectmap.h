@@ -9,9 +9,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <set>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QList>
+#include <QPair>
+#include <QRect>
+#include <QVector>
 
 #include "fitsviewer/fitsdata.h"
 
@@ -31,6 +37,29 @@ class BadPixel
 
 typedef std::multiset<BadPixel> BadPixelSet;
 
+/**
+ * @brief The DefectTable class lists the enabled defects found in a subframe as buffer offsets.
+ *
+ * Offsets are relative to the subframe and sorted in row-major order. They are grouped in buckets of
+ * RowsPerBucket rows so that buckets can be corrected in parallel. Only defects with all eight neighbours
+ * within the subframe are listed.
+ */
+class DefectTable
+{
+    public:
+        static const uint32_t RowsPerBucket = 64;
+
+        uint32_t bucketCount() const
+        {
+            return buckets.size() - 1;
+        }
+
+        // Offsets of the defects in the subframe buffer.
+        QVector<uint32_t> offsets;
+        // Index in offsets of the first defect of each bucket, followed by the number of offsets.
+        QVector<uint32_t> buckets;
+};
+
 class DefectMap : public QObject
 {
         Q_OBJECT
@@ -94,6 +123,23 @@ class DefectMap : public QObject
         }
 
         void filterPixels();
+
+        /**
+         * @brief defectTable Get the enabled defects located in a subframe.
+         * @param subFrame Subframe geometry in the full frame coordinates of the defect map.
+         * @return Table of defect offsets. The tables of the last few subframes are cached until the defects or
+         * thresholds change.
+         */
+        QSharedPointer<DefectTable> defectTable(const QRect &subFrame);
+
+        /**
+         * @brief median3x3Filter Median of the eight neighbours of a defect.
+         * @param offset Offset of the defect in the buffer, all its neighbours must be in the buffer.
+         * @param width Width of the buffer.
+         */
+        template <typename T>
+        static T median3x3Filter(uint32_t offset, uint32_t width, T const *buffer);
+
     signals:
         //        void hotPixelsUpdated(const BadPixelSet::const_iterator &start, const BadPixelSet::const_iterator &end);
         //        void coldPixelsUpdated(const BadPixelSet::const_iterator &start, const BadPixelSet::const_iterator &end);
@@ -105,6 +151,8 @@ class DefectMap : public QObject
         double calculateSigma(uint8_t aggressiveness);
         template <typename T>
         void initBadPixelsInternal(double hotPixelThreshold, double coldPixelThreshold);
+        void appendDefects(BadPixelSet::const_iterator begin, BadPixelSet::const_iterator end, const QRect &subFrame,
+                           QVector<uint32_t> &offsets) const;
 
         BadPixelSet m_ColdPixels, m_HotPixels;
         BadPixelSet::const_iterator m_ColdPixelsThreshold, m_HotPixelsThreshold;
@@ -116,6 +164,35 @@ class DefectMap : public QObject
         QString m_Filename, m_Camera;
 
         QSharedPointer<FITSData> m_DarkData;
+        // Defect tables of the most recently used subframes, most recent first
+        QList<QPair<QRect, QSharedPointer<DefectTable>>> m_DefectTables;
 
 };
 
+template <typename T>
+T DefectMap::median3x3Filter(uint32_t offset, uint32_t width, T const *buffer)
+{
+    T const *top = buffer + offset - width - 1;
+    T const *mid = buffer + offset - 1;
+    T const *bot = buffer + offset + width - 1;
+
+    // Mid+1 is the defective value, so we skip and go for + 2
+    std::array<T, 8> e = {{ top[0], top[1], top[2], mid[0], mid[2], bot[0], bot[1], bot[2] }};
+
+    // Optimal 19 comparators sorting network for 8 elements, branchless on most types.
+    auto sort2 = [&e](int i, int j)
+    {
+        const T a = e[i], b = e[j];
+        e[i] = std::min(a, b);
+        e[j] = std::max(a, b);
+    };
+    sort2(0, 2); sort2(1, 3); sort2(4, 6); sort2(5, 7);
+    sort2(0, 4); sort2(1, 5); sort2(2, 6); sort2(3, 7);
+    sort2(0, 1); sort2(2, 3); sort2(4, 5); sort2(6, 7);
+    sort2(2, 4); sort2(3, 5);
+    sort2(1, 4); sort2(3, 6);
+    sort2(1, 2); sort2(3, 4); sort2(5, 6);
+
+    auto median = (e[3] + e[4]) / 2;
+    return median;
+}
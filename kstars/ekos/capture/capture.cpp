@@ -25,6 +25,7 @@
 #include "scriptsmanager.h"
 #include "fitsviewer/fitsdata.h"
 #include "fitsviewer/fitsview.h"
+#include "fitsviewer/fitswritequeue.h"
 #include "indi/driverinfo.h"
 #include "indi/indifilter.h"
 #include "indi/clientmanager.h"
@@ -341,6 +342,22 @@ Capture::Capture()
     observerB->setAttribute(Qt::WA_LayoutUsesWidgetRect);
     connect(observerB, &QPushButton::clicked, this, &Ekos::Capture::showObserverDialog);
 
+    // Frames are written to disk in the background
+    connect(FITSWriteQueue::Instance(), &FITSWriteQueue::statusChanged, this, [this](int pending, double throughput)
+    {
+        writeQueueOUT->setText(i18n("%1 queued, %2 MB/s", pending, QString::number(throughput / (1024 * 1024), 'f', 1)));
+    });
+    connect(FITSWriteQueue::Instance(), &FITSWriteQueue::writeFailed, this, [this](const QString & filename)
+    {
+        appendLogText(i18n("Failed to save %1.", filename));
+    });
+    connect(FITSWriteQueue::Instance(), &FITSWriteQueue::fileWritten, this,
+            [this](const QString & filename, const QString & savedAs)
+    {
+        if (!savedAs.isEmpty() && savedAs != filename)
+            appendLogText(i18n("Failed to compress %1, saved it uncompressed as %2.", filename, savedAs));
+    });
+
     // Exposure Timeout
     captureTimeout.setSingleShot(true);
     connect(&captureTimeout, &QTimer::timeout, this, &Ekos::Capture::processCaptureTimeout);
@@ -720,6 +737,9 @@ void Capture::stop(CaptureState targetState)
 
     captureTimeout.stop();
 
+    disconnect(m_WriteQueueWait);
+    m_WriteQueueWait = QMetaObject::Connection();
+
     ADURaw.clear();
     ExpRaw.clear();
 
@@ -1588,6 +1608,25 @@ IPState Capture::startNextExposure()
             return pending;
     }
 
+    // Let the disk catch up instead of piling frames up in memory. The exposure is started once a
+    // frame is written.
+    if (FITSWriteQueue::Instance()->isFull())
+    {
+        if (!m_WriteQueueWait)
+        {
+            appendLogText(i18n("Waiting for captured frames to be written to disk..."));
+            m_WriteQueueWait = connect(FITSWriteQueue::Instance(), &FITSWriteQueue::statusChanged, this, [this]()
+            {
+                if (FITSWriteQueue::Instance()->isFull())
+                    return;
+                disconnect(m_WriteQueueWait);
+                m_WriteQueueWait = QMetaObject::Connection();
+                checkNextExposure();
+            });
+        }
+        return IPS_OK;
+    }
+
     // nothing pending, let's start the next exposure
     if (seqDelay > 0)
     {
@@ -1879,9 +1918,13 @@ IPState Capture::setCaptureComplete()
         const QString postCaptureScript = activeJob->getScript(SCRIPT_POST_CAPTURE);
         if (postCaptureScript.isEmpty() == false)
         {
+            // The script may use the file, so it is started once the file is on disk
             m_CaptureScriptType = SCRIPT_POST_CAPTURE;
-            m_CaptureScript.start(postCaptureScript, generateScriptArguments());
-            appendLogText(i18n("Executing post capture script %1", postCaptureScript));
+            FITSWriteQueue::Instance()->whenWritten(filename, this, [this, postCaptureScript](const QString &)
+            {
+                m_CaptureScript.start(postCaptureScript, generateScriptArguments());
+                appendLogText(i18n("Executing post capture script %1", postCaptureScript));
+            });
             return IPS_OK;
         }
 
@@ -4107,6 +4150,10 @@ bool Capture::loadSequenceQueue(const QString &fileURL)
     // update save button tool tip
     queueSaveB->setToolTip("Save to " + sFile.fileName());
 
+    // Load the masters needed to denoise the upcoming frames while the sequence gets ready
+    if (darkB->isChecked())
+        DarkLibrary::Instance()->prewarmMasters(jobs);
+
     return true;
 }
 
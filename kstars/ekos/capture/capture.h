@@ -1054,6 +1054,9 @@ class Capture : public QWidget, public Ui::Capture
         ISD::CCD::UploadMode rememberUploadMode { ISD::CCD::UPLOAD_CLIENT };
         QMap<ScriptTypes, QString> m_Scripts;
 
+        // Resumes the sequence once the write queue has room again
+        QMetaObject::Connection m_WriteQueueWait;
+
         QUrl dirPath;
 
         // Misc
@@ -15,6 +15,7 @@
 #include <QObject>
 
 #include "ekos_guide_debug.h"
+#include "fitsviewer/fitsintegralimage.h"
 #include "ekos/auxiliary/stellarsolverprofileeditor.h"
 #include "Options.h"
 
@@ -135,36 +136,6 @@ void psf_conv(float *dst, const float *src, int width, int height)
     }
 }
 
-void GetStats(double *mean, double *stdev, int width, const float *img, const QRect &win)
-{
-    // Determine the mean and standard deviation
-    double sum = 0.0;
-    double a = 0.0;
-    double q = 0.0;
-    double k = 1.0;
-    double km1 = 0.0;
-
-    const float *p0 = img + win.top() * width + win.left();
-    for (int y = 0; y < win.height(); y++)
-    {
-        const float *end = p0 + win.height();
-        for (const float *p = p0; p < end; p++)
-        {
-            double const x = (double) * p;
-            sum += x;
-            double const a0 = a;
-            a += (x - a) / k;
-            q += (x - a0) * (x - a);
-            km1 = k;
-            k += 1.0;
-        }
-        p0 += width;
-    }
-
-    *mean = sum / km1;
-    *stdev = sqrt(q / km1);
-}
-
 void RemoveItems(std::set<Peak> &stars, const std::set<int> &to_erase)
 {
     int n = 0;
@@ -320,8 +291,12 @@ QList<Edge*> GuideAlgorithms::detectStars(const QSharedPointer<FITSData> &imageD
     enum { TOP_N = 100 };  // keep track of the brightest stars
     std::set<Peak> stars;  // sorted by ascending intensity
 
+    // Local statistics are taken around every local maximum, so sum the image once for all of them
+    FITSIntegralImage integral;
+    integral.build(conv, subW, subH);
+
     double global_mean, global_stdev;
-    GetStats(&global_mean, &global_stdev, subW, conv, convRect);
+    integral.statistics(convRect, &global_mean, &global_stdev);
 
     //Debug.Write(wxString::Format("AutoFind: global mean = %.1f, stdev %.1f\n", global_mean, global_stdev));
 
@@ -361,7 +336,7 @@ QList<Edge*> GuideAlgorithms::detectStars(const QSharedPointer<FITSData> &imageD
             double local_mean, local_stdev;
             QRect localRect(x - local, y - local, 2 * local + 1, 2 * local + 1);
             localRect = localRect.intersected(convRect);
-            GetStats(&local_mean, &local_stdev, subW, conv, localRect);
+            integral.statistics(localRect, &local_mean, &local_stdev);
 
             // this is our measure of star intensity
             double h = (val - local_mean) / global_stdev;
@@ -0,0 +1,175 @@
+/*  FITS Buffer Pool
+    Recycle image buffers between frames of the same geometry.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "fitsbufferpool.h"
+
+#include <KFormat>
+
+#include <new>
+
+#include <fits_debug.h>
+
+namespace
+{
+// Smaller buffers are cheap to allocate and would only clutter the pool.
+const size_t MinPooledSize = 64 * 1024;
+// Acquisitions between two statistics reports.
+const uint64_t ReportInterval = 500;
+}
+
+FITSBufferPool *FITSBufferPool::Instance()
+{
+    static FITSBufferPool pool;
+    return &pool;
+}
+
+FITSBufferPool::~FITSBufferPool()
+{
+    // Buffers still in use belong to their FITSData, only the idle ones are freed here.
+    for (uint8_t *buffer : qAsConst(m_IdleOrder))
+        delete[] buffer;
+}
+
+size_t FITSBufferPool::sizeClass(size_t size)
+{
+    // Classes are spaced by a sixteenth of the size, so a buffer wastes at most about 6%.
+    size_t granularity = 4096;
+    while (granularity * 32 <= size)
+        granularity *= 2;
+    return (size + granularity - 1) / granularity * granularity;
+}
+
+uint8_t *FITSBufferPool::acquire(size_t size)
+{
+    if (size < MinPooledSize)
+        return new (std::nothrow) uint8_t[size];
+
+    const size_t capacity = sizeClass(size);
+    const char *report = nullptr;
+    QMutexLocker locker(&m_Mutex);
+
+    uint8_t *buffer = nullptr;
+    auto idle = m_IdleBuffers.find(capacity);
+    if (idle != m_IdleBuffers.end() && !idle->isEmpty())
+    {
+        buffer = idle->takeLast();
+        m_IdleOrder.removeOne(buffer);
+        m_Statistics.idleBytes -= capacity;
+        m_Statistics.reuses++;
+    }
+    else
+    {
+        buffer = new (std::nothrow) uint8_t[capacity];
+        if (buffer == nullptr)
+        {
+            // Give the idle memory back and try again
+            freeIdle(m_IdleBudget);
+            buffer = new (std::nothrow) uint8_t[capacity];
+            if (buffer == nullptr)
+                return nullptr;
+        }
+        m_Capacities.insert(buffer, capacity);
+        m_Statistics.allocations++;
+    }
+
+    m_Statistics.inUseBytes += capacity;
+    if (m_Statistics.inUseBytes > m_Statistics.highWaterBytes)
+    {
+        m_Statistics.highWaterBytes = m_Statistics.inUseBytes;
+        // Only report marks that grew noticeably
+        if (m_Statistics.highWaterBytes > m_LoggedHighWater + m_LoggedHighWater / 10)
+        {
+            m_LoggedHighWater = m_Statistics.highWaterBytes;
+            report = "new high-water mark";
+        }
+    }
+
+    if ((m_Statistics.allocations + m_Statistics.reuses) % ReportInterval == 0)
+        report = "periodic report";
+
+    // Log a copy of the statistics once unlocked, so that other threads do not wait for the logging.
+    if (report != nullptr)
+    {
+        const Statistics statistics = m_Statistics;
+        locker.unlock();
+        logStatistics(report, statistics);
+    }
+
+    return buffer;
+}
+
+void FITSBufferPool::release(uint8_t *buffer)
+{
+    if (buffer == nullptr)
+        return;
+
+    QMutexLocker locker(&m_Mutex);
+
+    auto found = m_Capacities.constFind(buffer);
+    if (found == m_Capacities.constEnd())
+    {
+        delete[] buffer;
+        return;
+    }
+
+    const size_t capacity = found.value();
+    m_Statistics.inUseBytes -= capacity;
+
+    freeIdle(capacity);
+    if (m_Statistics.idleBytes + capacity > m_IdleBudget)
+    {
+        m_Capacities.remove(buffer);
+        delete[] buffer;
+        return;
+    }
+
+    m_IdleBuffers[capacity].append(buffer);
+    m_IdleOrder.append(buffer);
+    m_Statistics.idleBytes += capacity;
+}
+
+void FITSBufferPool::setIdleBudget(size_t budget)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_IdleBudget = budget;
+    freeIdle(0);
+}
+
+void FITSBufferPool::trim()
+{
+    QMutexLocker locker(&m_Mutex);
+    freeIdle(m_IdleBudget);
+}
+
+FITSBufferPool::Statistics FITSBufferPool::statistics() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_Statistics;
+}
+
+void FITSBufferPool::freeIdle(size_t size)
+{
+    while (!m_IdleOrder.isEmpty() && m_Statistics.idleBytes + size > m_IdleBudget)
+    {
+        uint8_t *buffer = m_IdleOrder.takeFirst();
+        const size_t capacity = m_Capacities.take(buffer);
+        m_IdleBuffers[capacity].removeOne(buffer);
+        m_Statistics.idleBytes -= capacity;
+        delete[] buffer;
+    }
+}
+
+void FITSBufferPool::logStatistics(const char *reason, const Statistics &statistics)
+{
+    KFormat format;
+    qCDebug(KSTARS_FITS) << "Image buffer pool" << reason << ":" << statistics.allocations << "allocations,"
+                         << statistics.reuses << "reuses," << format.formatByteSize(statistics.inUseBytes) << "in use,"
+                         << format.formatByteSize(statistics.idleBytes) << "idle, high-water mark"
+                         << format.formatByteSize(statistics.highWaterBytes);
+}
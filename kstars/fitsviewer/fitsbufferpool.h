@@ -0,0 +1,87 @@
+/*  FITS Buffer Pool
+    Recycle image buffers between frames of the same geometry.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QVector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief The FITSBufferPool class recycles the image buffers of FITSData.
+ *
+ * Cameras stream frames of the same geometry and type, each one replacing the previous one. Released buffers
+ * are kept idle by size class and handed over to the next frame of the same class, instead of going back
+ * to the heap. Idle buffers are limited by a byte budget, the oldest being freed first. Small buffers are not
+ * pooled. The pool is shared by all modules and is thread safe.
+ */
+class FITSBufferPool
+{
+    public:
+        typedef struct
+        {
+            uint64_t allocations {0};
+            uint64_t reuses {0};
+            size_t inUseBytes {0};
+            size_t idleBytes {0};
+            size_t highWaterBytes {0};
+        } Statistics;
+
+        static FITSBufferPool *Instance();
+
+        /**
+         * @brief acquire Get a buffer of at least size bytes, with undefined content.
+         * @return The buffer, or nullptr if it cannot be allocated.
+         */
+        uint8_t *acquire(size_t size);
+
+        /**
+         * @brief release Return a buffer to the pool. Buffers not allocated by the pool are deleted.
+         */
+        void release(uint8_t *buffer);
+
+        /**
+         * @brief setIdleBudget Maximum size in bytes of the idle buffers kept for reuse.
+         */
+        void setIdleBudget(size_t budget);
+
+        /**
+         * @brief trim Free all idle buffers.
+         */
+        void trim();
+
+        Statistics statistics() const;
+
+        /**
+         * @brief sizeClass Capacity of the buffers the pool allocates for a request of size bytes.
+         */
+        static size_t sizeClass(size_t size);
+
+    private:
+        FITSBufferPool() = default;
+        ~FITSBufferPool();
+
+        // Free the oldest idle buffers until size more bytes fit in the budget.
+        void freeIdle(size_t size);
+        static void logStatistics(const char *reason, const Statistics &statistics);
+
+        mutable QMutex m_Mutex;
+        // Capacity of every buffer allocated by the pool, in use or idle.
+        QHash<uint8_t *, size_t> m_Capacities;
+        QHash<size_t, QVector<uint8_t *>> m_IdleBuffers;
+        // Idle buffers, oldest first.
+        QList<uint8_t *> m_IdleOrder;
+        size_t m_IdleBudget { 512 * 1024 * 1024 };
+        size_t m_LoggedHighWater {0};
+        Statistics m_Statistics;
+};
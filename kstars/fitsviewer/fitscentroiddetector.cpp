@@ -91,6 +91,111 @@ QFuture<bool> FITSCentroidDetector::findSources(const QRect &boundary)
     }
 }
 
+namespace
+{
+// Parameters of a pass looking for edges, runs of pixels above threshold along a row.
+struct EdgeScan
+{
+    int subX;
+    int subW;
+    double threshold;
+    double min;
+    int minEdgeWidth;
+    float dispersion_ratio;
+};
+
+// Edges found in a tile of rows.
+struct EdgeTile
+{
+    QPair<int, int> rows;
+    QList<Edge *> edges;
+};
+
+// Centers found in a tile of rows, by index of the edge they started from.
+struct CenterTile
+{
+    QPair<int, int> rows;
+    QVector<int> candidates;
+    QMap<int, Edge *> centers;
+    int width_sum;
+};
+
+/* Find the edges in rows [firstRow, lastRow) of the search area. Edges do not span rows,
+ * so tiles of rows may be scanned independently and their edges concatenated. */
+template <typename T>
+QList<Edge *> scanEdges(T const * buffer, int width, int firstRow, int lastRow, EdgeScan const &scan)
+{
+    QList<Edge *> edges;
+    double const min = scan.min;
+
+    for (int i = firstRow; i < lastRow; i++)
+    {
+        double sum = 0, avg = 0;
+        int starDiameter = 0;
+
+        for (int j = scan.subX; j < scan.subW; j++)
+        {
+            int pixVal = buffer[j + (i * width)] - min;
+
+            // If pixel value > threshold, let's get its weighted average
+            if (pixVal >= scan.threshold)
+            {
+                avg += j * pixVal;
+                sum += pixVal;
+                starDiameter++;
+            }
+            // Value < threshold but avg exists
+            else if (sum > 0)
+            {
+                // We found a potential centroid edge
+                if (starDiameter >= scan.minEdgeWidth)
+                {
+                    float center = avg / sum + 0.5;
+                    if (center > 0)
+                    {
+                        int i_center = std::floor(center);
+
+                        // Check if center is 10% or more brighter than edge, if not skip
+                        if (((buffer[i_center + (i * width)] - min) /
+                                (buffer[i_center + (i * width) - starDiameter / 2] - min) >=
+                                scan.dispersion_ratio) &&
+                                ((buffer[i_center + (i * width)] - min) /
+                                 (buffer[i_center + (i * width) + starDiameter / 2] - min) >=
+                                 scan.dispersion_ratio))
+                        {
+                            qCDebug(KSTARS_FITS)
+                                    << "Edge center is " << buffer[i_center + (i * width)] - min
+                                    << " Edge is " << buffer[i_center + (i * width) - starDiameter / 2] - min
+                                    << " and ratio is "
+                                    << ((buffer[i_center + (i * width)] - min) /
+                                        (buffer[i_center + (i * width) - starDiameter / 2] - min))
+                                    << " located at X: " << center << " Y: " << i + 0.5;
+
+                            auto * newEdge = new Edge();
+
+                            newEdge->x       = center;
+                            newEdge->y       = i + 0.5;
+                            newEdge->scanned = 0;
+                            newEdge->val     = buffer[i_center + (i * width)] - min;
+                            newEdge->width   = starDiameter;
+                            newEdge->HFR     = 0;
+                            newEdge->sum     = sum;
+
+                            edges.append(newEdge);
+                        }
+                    }
+                }
+
+                // Reset
+                avg = sum = starDiameter = 0;
+            }
+        }
+    }
+
+    return edges;
+}
+}
+
 template <typename T>
 bool FITSCentroidDetector::findSources(const QRect &boundary)
 {
@@ -102,9 +207,7 @@ bool FITSCentroidDetector::findSources(const QRect &boundary)
     double JMIndex = getValue("JMINDEX", 100.0).toDouble();
 
     int initStdDev = MINIMUM_STDVAR;
-    double threshold = 0, sum = 0, avg = 0, min = 0;
-    int starDiameter     = 0;
-    int pixVal           = 0;
+    double threshold = 0, min = 0;
     int minimumEdgeCount = MINIMUM_EDGE_LIMIT;
 
     auto * buffer = reinterpret_cast<T const *>(m_ImageData->getImageBuffer());
@@ -113,6 +216,8 @@ bool FITSCentroidDetector::findSources(const QRect &boundary)
 
     QList<Edge *> edges;
 
+    int subX = 0, subY = 0, subW = 0, subH = 0;
+
     if (JMIndex < DIFFUSE_THRESHOLD)
     {
         minEdgeWidth     = JMIndex * 35 + 1;
@@ -160,8 +265,6 @@ bool FITSCentroidDetector::findSources(const QRect &boundary)
 
         threshold -= min;
 
-        int subX, subY, subW, subH;
-
         if (boundary.isNull())
         {
             if (m_Mode == FITS_GUIDE || m_Mode == FITS_FOCUS)
@@ -189,69 +292,20 @@ bool FITSCentroidDetector::findSources(const QRect &boundary)
             subH = subY + boundary.height();
         }
 
-        // Detect "edges" that are above threshold
-        for (int i = subY; i < subH; i++)
-        {
-            starDiameter = 0;
-
-            for (int j = subX; j < subW; j++)
-            {
-                pixVal = buffer[j + (i * stats.width)] - min;
+        // Detect "edges" that are above threshold, each tile of rows in parallel
+        EdgeScan const scan { subX, subW, threshold, min, minEdgeWidth, dispersion_ratio };
+        QVector<EdgeTile> tiles;
+        for (auto const &rows : rowTiles(subY, subH))
+            tiles.append({rows, QList<Edge *>()});
 
-                // If pixel value > threshold, let's get its weighted average
-                if (pixVal >= threshold)
-                {
-                    avg += j * pixVal;
-                    sum += pixVal;
-                    starDiameter++;
-                }
-                // Value < threshold but avg exists
-                else if (sum > 0)
-                {
-                    // We found a potential centroid edge
-                    if (starDiameter >= minEdgeWidth)
-                    {
-                        float center = avg / sum + 0.5;
-                        if (center > 0)
-                        {
-                            int i_center = std::floor(center);
-
-                            // Check if center is 10% or more brighter than edge, if not skip
-                            if (((buffer[i_center + (i * stats.width)] - min) /
-                                    (buffer[i_center + (i * stats.width) - starDiameter / 2] - min) >=
-                                    dispersion_ratio) &&
-                                    ((buffer[i_center + (i * stats.width)] - min) /
-                                     (buffer[i_center + (i * stats.width) + starDiameter / 2] - min) >=
-                                     dispersion_ratio))
-                            {
-                                qCDebug(KSTARS_FITS)
-                                        << "Edge center is " << buffer[i_center + (i * stats.width)] - min
-                                        << " Edge is " << buffer[i_center + (i * stats.width) - starDiameter / 2] - min
-                                        << " and ratio is "
-                                        << ((buffer[i_center + (i * stats.width)] - min) /
-                                            (buffer[i_center + (i * stats.width) - starDiameter / 2] - min))
-                                        << " located at X: " << center << " Y: " << i + 0.5;
-
-                                auto * newEdge = new Edge();
-
-                                newEdge->x       = center;
-                                newEdge->y       = i + 0.5;
-                                newEdge->scanned = 0;
-                                newEdge->val     = buffer[i_center + (i * stats.width)] - min;
-                                newEdge->width   = starDiameter;
-                                newEdge->HFR     = 0;
-                                newEdge->sum     = sum;
-
-                                edges.append(newEdge);
-                            }
-                        }
-                    }
+        QtConcurrent::blockingMap(tiles, [ = ](EdgeTile & tile)
+        {
+            tile.edges = scanEdges(buffer, stats.width, tile.rows.first, tile.rows.second, scan);
+        });
 
-                    // Reset
-                    avg = sum = starDiameter = 0;
-                }
-            }
-        }
+        // Tiles are in row order, so edges are listed as a serial scan finds them
+        for (auto const &tile : tiles)
+            edges.append(tile.edges);
 
         qCDebug(KSTARS_FITS) << "Total number of edges found is: " << edges.count();
 
@@ -277,13 +331,6 @@ bool FITSCentroidDetector::findSources(const QRect &boundary)
         initStdDev--;
     }
 
-    int cen_count = 0;
-    int cen_x     = 0;
-    int cen_y     = 0;
-    int cen_v     = 0;
-    int cen_w     = 0;
-    int width_sum = 0;
-
     // Let's sort edges, starting with widest
     auto const greaterThan = [](Edge const * a, Edge const * b)
     {
@@ -291,15 +338,117 @@ bool FITSCentroidDetector::findSources(const QRect &boundary)
     };
     std::sort(edges.begin(), edges.end(), greaterThan);
 
-    QList<Edge*> starCenters;
+    int cen_limit = (MINIMUM_ROWS_PER_CENTER - (MINIMUM_STDVAR - initStdDev));
+
+    if (edges.count() < LOW_EDGE_CUTOFF_1)
+    {
+        if (edges.count() < LOW_EDGE_CUTOFF_2)
+            cen_limit = 1;
+        else
+            cen_limit = 2;
+    }
+
+    qCDebug(KSTARS_FITS) << "initstdDev= " << initStdDev << " and limit is " << cen_limit;
+
+    /* Centers are searched for in each tile of rows in parallel. A tile also considers the edges in a margin
+     * around its rows, as these may join its centers or be merged in centers started from the margin first.
+     * The margin covers the chains of overlapping edges of sources, so that each tile keeps the centers started
+     * from its own rows as the serial search finds them. */
+    float maxWidth = 0;
+    for (auto const * edge : edges)
+        maxWidth = std::max(maxWidth, edge->width);
+    int const margin = 4 * std::ceil(maxWidth) + 1;
+
+    QVector<CenterTile> tiles;
+    for (auto const &rows : rowTiles(subY, subH))
+    {
+        CenterTile tile { rows, QVector<int>(), QMap<int, Edge *>(), 0 };
+        for (int i = 0; i < edges.count(); i++)
+        {
+            int const row = std::floor(edges[i]->y);
+            if (row >= rows.first - margin && row < rows.second + margin)
+                tile.candidates.append(i);
+        }
+        tiles.append(tile);
+    }
+
+    QtConcurrent::blockingMap(tiles, [&](CenterTile & tile)
+    {
+        tile.centers = findCenters<T>(edges, tile.candidates, tile.rows, cen_limit, min, tile.width_sum);
+    });
+
+    // Duplicates of centers started from a margin are in the tile owning their first edge only
+    QMap<int, Edge *> centers;
+    int width_sum = 0;
+    for (auto const &tile : tiles)
+    {
+        for (auto center = tile.centers.cbegin(); center != tile.centers.cend(); ++center)
+            centers.insert(center.key(), center.value());
+        width_sum += tile.width_sum;
+    }
+
+    // Listed in the order of their first edge, as the serial search finds them
+    QList<Edge*> starCenters = centers.values();
+
+    if (starCenters.count() > 1 && m_Mode != FITS_FOCUS)
+    {
+        float width_avg = (float)width_sum / starCenters.count();
+        float lsum = 0, sdev = 0;
+
+        for (auto &center : starCenters)
+            lsum += (center->width - width_avg) * (center->width - width_avg);
+
+        sdev = (std::sqrt(lsum / (starCenters.count() - 1))) * 4;
+
+        // Reject stars > 4 * stddev
+        foreach (Edge * center, starCenters)
+            if (center->width > sdev)
+                starCenters.removeOne(center);
+
+        //foreach(Edge *center, starCenters)
+        //qDebug() << center->x << "," << center->y << "," << center->width << "," << center->val << endl;
+    }
+
+    m_ImageData->setStarCenters(starCenters);
+    // Release memory
+    qDeleteAll(edges);
+
+    return true;
+}
+
+template <typename T>
+QMap<int, Edge *> FITSCentroidDetector::findCenters(QList<Edge *> const &edges, QVector<int> const &candidates,
+        QPair<int, int> const &rows, int cen_limit, double min, int &width_sum) const
+{
+    FITSImage::Statistic const &stats = m_ImageData->getStatistics();
+    auto * buffer = reinterpret_cast<T const *>(m_ImageData->getImageBuffer());
+
+    QMap<int, Edge *> starCenters;
+    width_sum = 0;
+
+    if (cen_limit < 1)
+        return starCenters;
+
+    int cen_count = 0;
+    int cen_x     = 0;
+    int cen_y     = 0;
+    int cen_v     = 0;
+    int cen_w     = 0;
+    double sum    = 0;
+
+    // Edges shared with neighbouring tiles are not flagged, so that tiles do not interfere
+    QVector<bool> scanned(candidates.size(), false);
+
     // Now, let's scan the edges and find the maximum centroid vertically
-    for (int i = 0; i < edges.count(); i++)
+    for (int c = 0; c < candidates.size(); c++)
     {
+        int const i = candidates[c];
+
         qCDebug(KSTARS_FITS) << "# " << i << " Edge at (" << edges[i]->x << "," << edges[i]->y << ") With a value of "
                              << edges[i]->val << " and width of " << edges[i]->width << " pixels. with sum " << edges[i]->sum;
 
         // If edge scanned already, skip
-        if (edges[i]->scanned == 1)
+        if (scanned[c])
         {
             qCDebug(KSTARS_FITS) << "Skipping check for center " << i << " because it was already counted";
             continue;
@@ -320,44 +469,36 @@ bool FITSCentroidDetector::findSources(const QRect &boundary)
         cen_count = 0;
 
         // Now let's compare to other edges until we hit a maxima
-        for (int j = 0; j < edges.count(); j++)
+        for (int d = 0; d < candidates.size(); d++)
         {
-            if (edges[j]->scanned)
+            if (scanned[d])
                 continue;
 
-            if (checkCollision(edges[j], edges[i]))
+            Edge * const edge = edges[candidates[d]];
+            if (checkCollision(edge, edges[i]))
             {
-                if (edges[j]->sum >= cen_v)
+                if (edge->sum >= cen_v)
                 {
-                    cen_v = edges[j]->sum;
-                    cen_w = edges[j]->width;
+                    cen_v = edge->sum;
+                    cen_w = edge->width;
                 }
 
-                edges[j]->scanned = 1;
+                scanned[d] = true;
                 cen_count++;
 
-                avg_x += edges[j]->x * edges[j]->val;
-                avg_y += edges[j]->y * edges[j]->val;
-                sum += edges[j]->val;
+                avg_x += edge->x * edge->val;
+                avg_y += edge->y * edge->val;
+                sum += edge->val;
 
                 continue;
             }
         }
 
-        int cen_limit = (MINIMUM_ROWS_PER_CENTER - (MINIMUM_STDVAR - initStdDev));
-
-        if (edges.count() < LOW_EDGE_CUTOFF_1)
-        {
-            if (edges.count() < LOW_EDGE_CUTOFF_2)
-                cen_limit = 1;
-            else
-                cen_limit = 2;
-        }
-
-        qCDebug(KSTARS_FITS) << "center_count: " << cen_count << " and initstdDev= " << initStdDev << " and limit is "
-                             << cen_limit;
+        qCDebug(KSTARS_FITS) << "center_count: " << cen_count << " and limit is " << cen_limit;
 
-        if (cen_limit < 1)
+        // Centers started from the margin belong to the neighbouring tile
+        int const row = std::floor(edges[i]->y);
+        if (row < rows.first || row >= rows.second)
             continue;
 
         // If centroid count is within acceptable range
@@ -426,34 +567,9 @@ bool FITSCentroidDetector::findSources(const QRect &boundary)
 
             qCDebug(KSTARS_FITS) << "HFR for this center is " << rCenter->HFR << " pixels and the total flux is " << FSum;
 
-            starCenters.append(rCenter);
+            starCenters.insert(i, rCenter);
         }
     }
 
-    if (starCenters.count() > 1 && m_Mode != FITS_FOCUS)
-    {
-        float width_avg = (float)width_sum / starCenters.count();
-        float lsum = 0, sdev = 0;
-
-        for (auto &center : starCenters)
-            lsum += (center->width - width_avg) * (center->width - width_avg);
-
-        sdev = (std::sqrt(lsum / (starCenters.count() - 1))) * 4;
-
-        // Reject stars > 4 * stddev
-        foreach (Edge * center, starCenters)
-            if (center->width > sdev)
-                starCenters.removeOne(center);
-
-        //foreach(Edge *center, starCenters)
-        //qDebug() << center->x << "," << center->y << "," << center->width << "," << center->val << endl;
-    }
-
-    m_ImageData->setStarCenters(starCenters);
-    // Release memory
-    qDeleteAll(edges);
-
-    return true;
+    return starCenters;
 }
-
-
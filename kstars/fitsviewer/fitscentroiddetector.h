@@ -72,6 +72,19 @@ class FITSCentroidDetector: public FITSStarDetector
         template <typename T>
         bool findSources(const QRect &boundary);
 
+        /** @internal Merge overlapping edges into centers and measure their HFR.
+         * @param edges are all the edges found, sorted by decreasing sum.
+         * @param candidates are the indices of the edges in a tile of rows and its margin, in increasing order.
+         * @param rows are the rows of the tile, only edges in these rows may start a center.
+         * @param cen_limit is the number of edges a center requires.
+         * @param min is the background level subtracted from pixels.
+         * @param width_sum is set to the sum of the widths of the centers found.
+         * @return The centers found, by index of the edge they started from.
+         */
+        template <typename T>
+        QMap<int, Edge *> findCenters(QList<Edge *> const &edges, QVector<int> const &candidates, QPair<int, int> const &rows,
+                                      int cen_limit, double min, int &width_sum) const;
+
         /** @internal Check whether two sources overlap.
          * @param s1, s2 are the two sources to check collision on.
          * @return true if the sources collide, else false.
@@ -0,0 +1,253 @@
+/*  FITS Convolution
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+*/
+
+#pragma once
+
+#include <QPair>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Convolution kernels operating directly on FITSData image buffers.
+ *
+ * All filters work out of place: the source plane is never read after it has been
+ * partially overwritten. Borders are handled by replicating the edge pixels into a
+ * padded line buffer, so the inner loops carry no bounds checks. Work is split into
+ * row bands which run on the global thread pool.
+ *
+ * The planes are expected to be stored one after another, as in FITSData.
+ */
+namespace FITSConvolution
+{
+
+/**
+ * @brief gaussianKernel Build a normalized one dimensional Gaussian kernel.
+ * @param size Kernel size, must be odd.
+ * @param sigma Standard deviation in pixels.
+ */
+inline QVector<float> gaussianKernel(int size, double sigma)
+{
+    QVector<float> kernel(size);
+    const int fOff = (size - 1) / 2;
+    double sum = 0;
+    for (int i = -fOff; i <= fOff; i++)
+    {
+        const double value = std::exp(-(i * i) / (2.0 * sigma * sigma));
+        kernel[i + fOff] = value;
+        sum += value;
+    }
+    for (auto &value : kernel)
+        value /= sum;
+    return kernel;
+}
+
+/**
+ * @brief gaussianKernel2D Build the equivalent size x size two dimensional Gaussian kernel.
+ * This is the outer product of gaussianKernel(), useful with filter2D().
+ */
+inline QVector<float> gaussianKernel2D(int size, double sigma)
+{
+    const QVector<float> kernel = gaussianKernel(size, sigma);
+    QVector<float> kernel2D(size * size);
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            kernel2D[y * size + x] = kernel[y] * kernel[x];
+    return kernel2D;
+}
+
+/**
+ * @brief rowBands Split [0, count) into contiguous bands, a few per worker thread.
+ * Bands are large enough to amortize the scheduling cost of each task.
+ */
+inline QVector<QPair<int, int>> rowBands(int count, int minBandSize = 16)
+{
+    QVector<QPair<int, int>> bands;
+    const int nBands = qBound(1, count / qMax(1, minBandSize), QThreadPool::globalInstance()->maxThreadCount() * 4);
+    const int bandSize = (count + nBands - 1) / nBands;
+    for (int start = 0; start < count; start += bandSize)
+        bands.append(qMakePair(start, qMin(count, start + bandSize)));
+    return bands;
+}
+
+// Convert an accumulated value back to the pixel type, rounding and clamping integer types.
+template <typename T>
+inline T saturate(float value)
+{
+    if (std::is_integral<T>::value)
+    {
+        if (value <= static_cast<float>(std::numeric_limits<T>::min()))
+            return std::numeric_limits<T>::min();
+        if (value >= static_cast<float>(std::numeric_limits<T>::max()))
+            return std::numeric_limits<T>::max();
+        return static_cast<T>(std::lround(value));
+    }
+    return static_cast<T>(value);
+}
+
+// Copy a source row into a float line padded by radius replicated pixels on each side.
+template <typename T>
+inline void padLine(T const *source, int width, int radius, float *line)
+{
+    const float first = source[0], last = source[width - 1];
+    for (int i = 0; i < radius; i++)
+    {
+        line[i] = first;
+        line[radius + width + i] = last;
+    }
+    for (int x = 0; x < width; x++)
+        line[radius + x] = source[x];
+}
+
+/**
+ * @brief separableFilter Convolve every plane of the image with rowKernel along X and then colKernel along Y.
+ * @param image Image buffer, modified in place once both passes are complete.
+ * @param width Plane width in pixels.
+ * @param height Plane height in pixels.
+ * @param channels Number of planes.
+ * @param rowKernel Odd sized horizontal kernel.
+ * @param colKernel Odd sized vertical kernel.
+ * @note Blocks until all bands are complete. Uses a float scratch plane the size of one channel.
+ */
+template <typename T>
+void separableFilter(T *image, int width, int height, int channels,
+                     const QVector<float> &rowKernel, const QVector<float> &colKernel)
+{
+    if (image == nullptr || width <= 0 || height <= 0 || rowKernel.isEmpty() || colKernel.isEmpty())
+        return;
+
+    const int rowRadius = (rowKernel.size() - 1) / 2;
+    const int colRadius = (colKernel.size() - 1) / 2;
+    const float * const rk = rowKernel.constData();
+    const float * const ck = colKernel.constData();
+    const int rkSize = rowKernel.size();
+    const int ckSize = colKernel.size();
+    const uint32_t samples = static_cast<uint32_t>(width) * height;
+
+    std::vector<float> scratch(samples);
+    float * const scratchPtr = scratch.data();
+    QVector<QPair<int, int>> bands = rowBands(height);
+
+    for (int n = 0; n < channels; n++)
+    {
+        T * const plane = image + n * samples;
+
+        // Horizontal pass: plane -> scratch
+        QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
+        {
+            std::vector<float> line(width + 2 * rowRadius);
+            for (int y = band.first; y < band.second; y++)
+            {
+                padLine(plane + y * width, width, rowRadius, line.data());
+                float * const out = scratchPtr + y * width;
+                const float * const in = line.data();
+                std::fill(out, out + width, 0.0f);
+                for (int k = 0; k < rkSize; k++)
+                {
+                    const float weight = rk[k];
+                    const float * const tap = in + k;
+                    for (int x = 0; x < width; x++)
+                        out[x] += weight * tap[x];
+                }
+            }
+        });
+
+        // Vertical pass: scratch -> plane. Rows outside the image are clamped to the edge rows.
+        QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
+        {
+            std::vector<float> accumulator(width);
+            float * const acc = accumulator.data();
+            for (int y = band.first; y < band.second; y++)
+            {
+                std::fill(acc, acc + width, 0.0f);
+                for (int k = 0; k < ckSize; k++)
+                {
+                    const int sourceY = qBound(0, y - colRadius + k, height - 1);
+                    const float weight = ck[k];
+                    const float * const in = scratchPtr + sourceY * width;
+                    for (int x = 0; x < width; x++)
+                        acc[x] += weight * in[x];
+                }
+                T * const out = plane + y * width;
+                for (int x = 0; x < width; x++)
+                    out[x] = saturate<T>(acc[x]);
+            }
+        });
+    }
+}
+
+/**
+ * @brief separableFilter Convolve every plane with the same kernel along both axes.
+ */
+template <typename T>
+void separableFilter(T *image, int width, int height, int channels, const QVector<float> &kernel)
+{
+    separableFilter<T>(image, width, height, channels, kernel, kernel);
+}
+
+/**
+ * @brief filter2D Convolve every plane of the image with a full kernelSize x kernelSize kernel.
+ * This is the general path for kernels that cannot be separated. It costs kernelSize^2 taps
+ * per pixel, against 2 * kernelSize for separableFilter().
+ * @note Blocks until complete. Uses a scratch plane of type T the size of one channel.
+ */
+template <typename T>
+void filter2D(T *image, int width, int height, int channels, const QVector<float> &kernel, int kernelSize)
+{
+    if (image == nullptr || width <= 0 || height <= 0 || kernel.size() != kernelSize * kernelSize)
+        return;
+
+    const int radius = (kernelSize - 1) / 2;
+    const float * const kernelPtr = kernel.constData();
+    const uint32_t samples = static_cast<uint32_t>(width) * height;
+
+    std::vector<T> scratch(samples);
+    T * const scratchPtr = scratch.data();
+    QVector<QPair<int, int>> bands = rowBands(height);
+
+    for (int n = 0; n < channels; n++)
+    {
+        T * const plane = image + n * samples;
+
+        QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
+        {
+            std::vector<float> line(width + 2 * radius);
+            std::vector<float> accumulator(width);
+            float * const acc = accumulator.data();
+            for (int y = band.first; y < band.second; y++)
+            {
+                std::fill(acc, acc + width, 0.0f);
+                for (int ky = 0; ky < kernelSize; ky++)
+                {
+                    const int sourceY = qBound(0, y - radius + ky, height - 1);
+                    padLine(plane + sourceY * width, width, radius, line.data());
+                    const float * const weights = kernelPtr + ky * kernelSize;
+                    for (int kx = 0; kx < kernelSize; kx++)
+                    {
+                        const float weight = weights[kx];
+                        const float * const tap = line.data() + kx;
+                        for (int x = 0; x < width; x++)
+                            acc[x] += weight * tap[x];
+                    }
+                }
+                T * const out = scratchPtr + y * width;
+                for (int x = 0; x < width; x++)
+                    out[x] = saturate<T>(acc[x]);
+            }
+        });
+
+        std::copy(scratchPtr, scratchPtr + samples, plane);
+    }
+}
+}
@@ -18,14 +18,14 @@
  ***************************************************************************/
 
 #include "fitsdata.h"
+#include "fitsbufferpool.h"
+#include "fitsconvolution.h"
 #include "fitsbahtinovdetector.h"
 #include "fitsthresholddetector.h"
 #include "fitsgradientdetector.h"
 #include "fitscentroiddetector.h"
 #include "fitssepdetector.h"
 
-#include "fpack.h"
-
 #include "kstarsdata.h"
 #include "ksutils.h"
 #include "kspaths.h"
@@ -38,6 +38,7 @@
 #include <QImage>
 #include <QtConcurrent>
 #include <QImageReader>
+#include <QThread>
 
 #if !defined(KSTARS_LITE) && defined(HAVE_WCSLIB)
 #include <wcshdr.h>
@@ -48,8 +49,13 @@
 #include <libraw/libraw.h>
 #endif
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <type_traits>
 
 #include <fits_debug.h>
 
@@ -95,7 +101,8 @@ FITSData::FITSData(const QSharedPointer<FITSData> &other)
     this->m_Mode = other->m_Mode;
     this->m_Statistics.channels = other->m_Statistics.channels;
     memcpy(&m_Statistics, &(other->m_Statistics), sizeof(m_Statistics));
-    m_ImageBuffer = new uint8_t[m_Statistics.samples_per_channel * m_Statistics.channels * m_Statistics.bytesPerPixel];
+    m_ImageBuffer = FITSBufferPool::Instance()->acquire(m_Statistics.samples_per_channel * m_Statistics.channels *
+                    m_Statistics.bytesPerPixel);
     memcpy(m_ImageBuffer, other->m_ImageBuffer,
            m_Statistics.samples_per_channel * m_Statistics.channels * m_Statistics.bytesPerPixel);
 }
@@ -142,6 +149,22 @@ void FITSData::loadCommon(const QString &inFilename)
     }
 
     m_Filename = inFilename;
+    m_isSuperPixel = false;
+    m_isHeaderOnly = false;
+    m_PercentilesReady = false;
+    clearIntegralImages();
+}
+
+bool FITSData::loadHeader(const QString &inFilename, bool silent)
+{
+    loadCommon(inFilename);
+    m_isHeaderOnly = true;
+    QFileInfo info(m_Filename);
+    QString extension = info.completeSuffix().toLower();
+    if (!extension.contains("fit"))
+        return false;
+    m_isTemporary = m_Filename.startsWith(getTemporaryPath());
+    return loadFITSImage(QByteArray(), extension, silent);
 }
 
 bool FITSData::loadFromBuffer(const QByteArray &buffer, const QString &extension, const QString &inFilename, bool silent)
@@ -175,6 +198,15 @@ bool fitsOpenError(int status, const QString &message, bool silent)
     qCCritical(KSTARS_FITS) << errMessage;
     return false;
 }
+
+// Compressed images keep their keywords in a binary table header. Translate them
+// to the equivalent uncompressed image keywords so they read like any other image.
+int headerToString(fitsfile *fptr, int nocomments, char **header, int *nkeys, int *status)
+{
+    if (fits_is_compressed_image(fptr, status))
+        return fits_convert_hdr2str(fptr, nocomments, nullptr, 0, header, nkeys, status);
+    return fits_hdr2str(fptr, nocomments, nullptr, 0, header, nkeys, status);
+}
 }
 
 bool FITSData::privateLoad(const QByteArray &buffer, const QString &extension, bool silent)
@@ -195,33 +227,15 @@ bool FITSData::loadFITSImage(const QByteArray &buffer, const QString &extension,
 {
     int status = 0, anynull = 0;
     long naxes[3];
-    QString errMessage;
 
     m_HistogramConstructed = false;
 
-    if (buffer.isEmpty() && extension.contains(".fz"))
-    {
-        // Store so we don't lose.
+    // Tile compressed (fpack) images are decompressed by CFITSIO straight into the image buffer,
+    // so no uncompressed copy is ever written to disk.
+    m_isCompressed = extension.contains(".fz");
+    if (m_isCompressed)
         m_compressedFilename = m_Filename;
 
-        QString uncompressedFile = QDir::tempPath() + QString("/%1").arg(QUuid::createUuid().toString().remove(
-                                       QRegularExpression("[-{}]")));
-        fpstate fpvar;
-        fp_init (&fpvar);
-        if (fp_unpack(m_Filename.toLocal8Bit().data(), uncompressedFile.toLocal8Bit().data(), fpvar) < 0)
-        {
-            errMessage = i18n("Failed to unpack compressed fits");
-            if (!silent)
-                KSNotification::error(errMessage, i18n("FITS Open"));
-            qCCritical(KSTARS_FITS) << errMessage;
-            return false;
-        }
-
-        m_Filename = uncompressedFile;
-        m_isTemporary = true;
-        m_isCompressed = true;
-    }
-
     if (buffer.isEmpty())
     {
         // Use open diskfile as it does not use extended file names which has problems opening
@@ -249,7 +263,8 @@ bool FITSData::loadFITSImage(const QByteArray &buffer, const QString &extension,
         m_Statistics.size = temp_size;
     }
 
-    if (fits_movabs_hdu(fptr, 1, IMAGE_HDU, &status))
+    // Compressed images live in the first extension, behind an empty primary HDU.
+    if (fits_movabs_hdu(fptr, m_isCompressed ? 2 : 1, IMAGE_HDU, &status))
     {
         recordLastError(status);
         return fitsOpenError(status, i18n("Could not locate image HDU."), silent);
@@ -342,13 +357,28 @@ bool FITSData::loadFITSImage(const QByteArray &buffer, const QString &extension,
         m_Statistics.channels = 1;
 
     m_ImageBufferSize = m_Statistics.samples_per_channel * m_Statistics.channels * m_Statistics.bytesPerPixel;
-    m_ImageBuffer = new uint8_t[m_ImageBufferSize];
-    if (m_ImageBuffer == nullptr)
+
+    // The header alone needs no pixels, only the keywords and the WCS.
+    if (m_isHeaderOnly)
     {
-        qCWarning(KSTARS_FITS) << "FITSData: Not enough memory for image_buffer channel. Requested: "
-                               << m_ImageBufferSize << " bytes.";
-        clearImageBuffers();
-        return false;
+        m_ImageBufferSize = 0;
+        parseHeader();
+        parseDateTime();
+        checkForWCS();
+        return true;
+    }
+
+    // Optionally use the data unit of the file directly instead of reading a copy of it.
+    if (!(Options::memoryMapFITS() && buffer.isEmpty() && !m_isCompressed && mapImageBuffer()))
+    {
+        m_ImageBuffer = FITSBufferPool::Instance()->acquire(m_ImageBufferSize);
+        if (m_ImageBuffer == nullptr)
+        {
+            qCWarning(KSTARS_FITS) << "FITSData: Not enough memory for image_buffer channel. Requested: "
+                                   << m_ImageBufferSize << " bytes.";
+            clearImageBuffers();
+            return false;
+        }
     }
 
     rotCounter     = 0;
@@ -356,21 +386,26 @@ bool FITSData::loadFITSImage(const QByteArray &buffer, const QString &extension,
     flipVCounter   = 0;
     long nelements = m_Statistics.samples_per_channel * m_Statistics.channels;
 
-    if (fits_read_img(fptr, m_Statistics.dataType, 1, nelements, nullptr, m_ImageBuffer, &anynull, &status))
+    if (m_isMapped)
+    {
+        qCDebug(KSTARS_FITS) << "Memory mapped" << KFormat().formatByteSize(m_ImageBufferSize) << "of image data.";
+    }
+    else if (m_isCompressed && buffer.isEmpty())
+    {
+        if (!readCompressedImage(status))
+        {
+            recordLastError(status);
+            return fitsOpenError(status, i18n("Error reading compressed image."), silent);
+        }
+    }
+    else if (fits_read_img(fptr, m_Statistics.dataType, 1, nelements, nullptr, m_ImageBuffer, &anynull, &status))
     {
         recordLastError(status);
         return fitsOpenError(status, i18n("Error reading image."), silent);
     }
 
     parseHeader();
-
-    // Get UTC date time
-    QVariant value;
-    if (getRecordValue("DATE-OBS", value) && value.isValid())
-    {
-        QDateTime ts = value.toDateTime();
-        m_DateTime = KStarsDateTime(ts.date(), ts.time());
-    }
+    parseDateTime();
 
     // Only check for debayed IF the original naxes[2] is 1
     // which is for single channels.
@@ -398,6 +433,69 @@ bool FITSData::loadFITSImage(const QByteArray &buffer, const QString &extension,
     return true;
 }
 
+bool FITSData::readCompressedImage(int &status)
+{
+    int anynull = 0;
+    int hdu = 1;
+    long tileSize[3] = {0, 1, 1};
+    const long width = m_Statistics.width;
+    const long height = m_Statistics.height;
+    const long nelements = m_Statistics.samples_per_channel * m_Statistics.channels;
+    const int nThreads = QThread::idealThreadCount();
+
+    fits_get_hdu_num(fptr, &hdu);
+    fits_get_tile_dim(fptr, 3, tileSize, &status);
+    const long tileRows = qMax(1L, tileSize[1]);
+
+    // Each parallel reader needs its own handle, which is only safe with a reentrant CFITSIO.
+    // Small images or images compressed as a single tile gain nothing from splitting.
+    if (status || !fits_is_reentrant() || nThreads < 2 || height < 2 * tileRows)
+    {
+        status = 0;
+        return (fits_read_img(fptr, m_Statistics.dataType, 1, nelements, nullptr, m_ImageBuffer, &anynull, &status) == 0);
+    }
+
+    // Bands are whole multiples of the tile height so that no tile gets decompressed twice.
+    const long tilesPerBand = qMax(1L, (height / tileRows + nThreads - 1) / nThreads);
+    const long bandRows = tilesPerBand * tileRows;
+    const QByteArray filename = m_Filename.toLocal8Bit();
+
+    QList<QFuture<int>> futures;
+    for (int channel = 0; channel < m_Statistics.channels; channel++)
+    {
+        for (long y = 0; y < height; y += bandRows)
+        {
+            futures.append(QtConcurrent::run([ = ]()
+            {
+                int bandStatus = 0, bandNull = 0;
+                fitsfile *bandFptr = nullptr;
+                long firstPixel[3] = {1, y + 1, channel + 1};
+                const long rows = qMin(bandRows, height - y);
+                uint8_t *destination = m_ImageBuffer + (channel * m_Statistics.samples_per_channel + y * width) *
+                                       m_Statistics.bytesPerPixel;
+
+                if (fits_open_diskfile(&bandFptr, filename.constData(), READONLY, &bandStatus) == 0)
+                {
+                    fits_movabs_hdu(bandFptr, hdu, nullptr, &bandStatus);
+                    fits_read_pix(bandFptr, m_Statistics.dataType, firstPixel, rows * width, nullptr, destination, &bandNull,
+                                  &bandStatus);
+                    int closeStatus = 0;
+                    fits_close_file(bandFptr, &closeStatus);
+                }
+                return bandStatus;
+            }));
+        }
+    }
+
+    for (auto &future : futures)
+    {
+        if (future.result() != 0)
+            status = future.result();
+    }
+
+    return (status == 0);
+}
+
 bool FITSData::loadCanonicalImage(const QByteArray &buffer, const QString &extension, bool silent)
 {
     // TODO need to add error popups as well later on
@@ -482,7 +580,7 @@ bool FITSData::loadCanonicalImage(const QByteArray &buffer, const QString &exten
     clearImageBuffers();
     m_ImageBufferSize = m_Statistics.samples_per_channel * m_Statistics.channels * static_cast<uint16_t>
                         (m_Statistics.bytesPerPixel);
-    m_ImageBuffer = new uint8_t[m_ImageBufferSize];
+    m_ImageBuffer = FITSBufferPool::Instance()->acquire(m_ImageBufferSize);
     if (m_ImageBuffer == nullptr)
     {
         qCCritical(KSTARS_FITS) << QString("FITSData: Not enough memory for image_buffer channel. Requested: %1 bytes ").arg(
@@ -598,7 +696,7 @@ bool FITSData::loadRAWImage(const QByteArray &buffer, const QString &extension,
     m_Statistics.samples_per_channel = m_Statistics.width * m_Statistics.height;
     clearImageBuffers();
     m_ImageBufferSize = m_Statistics.samples_per_channel * m_Statistics.channels * m_Statistics.bytesPerPixel;
-    m_ImageBuffer = new uint8_t[m_ImageBufferSize];
+    m_ImageBuffer = FITSBufferPool::Instance()->acquire(m_ImageBufferSize);
     if (m_ImageBuffer == nullptr)
     {
         qCCritical(KSTARS_FITS) << QString("FITSData: Not enough memory for image_buffer channel. Requested: %1 bytes ").arg(
@@ -943,227 +1041,350 @@ bool FITSData::saveImage(const QString &newFilename)
 
 void FITSData::clearImageBuffers()
 {
-    delete[] m_ImageBuffer;
+    emit dataAboutToChange();
+
+    if (m_isMapped)
+    {
+        m_MappedFile.unmap(m_ImageBuffer);
+        m_MappedFile.close();
+        m_isMapped = false;
+    }
+    else
+        FITSBufferPool::Instance()->release(m_ImageBuffer);
     m_ImageBuffer = nullptr;
+    m_PercentilesReady = false;
+    m_ValueCountsUpdatable = false;
+    clearIntegralImages();
     //m_BayerBuffer = nullptr;
 }
 
-void FITSData::calculateStats(bool refresh)
+bool FITSData::mapImageBuffer()
 {
-    // Calculate min max
-    calculateMinMax(refresh);
-    calculateMedian(refresh);
-
-    // Try to read mean/median/stddev if in file
-    if (refresh == false && fptr)
-    {
-        int status = 0;
-        int nfound = 0;
-        if (fits_read_key_dbl(fptr, "MEAN1", &m_Statistics.mean[0], nullptr, &status) == 0)
-            nfound++;
-        // NB. These could fail if missing, which is OK.
-        fits_read_key_dbl(fptr, "MEAN2", & m_Statistics.mean[1], nullptr, &status);
-        fits_read_key_dbl(fptr, "MEAN3", &m_Statistics.mean[2], nullptr, &status);
-
-        status = 0;
-        if (fits_read_key_dbl(fptr, "STDDEV1", &m_Statistics.stddev[0], nullptr, &status) == 0)
-            nfound++;
-        // NB. These could fail if missing, which is OK.
-        fits_read_key_dbl(fptr, "STDDEV2", &m_Statistics.stddev[1], nullptr, &status);
-        fits_read_key_dbl(fptr, "STDDEV3", &m_Statistics.stddev[2], nullptr, &status);
-
-        // If all is OK, we're done
-        if (nfound == 2)
-            return;
-    }
-
-    // Get standard deviation and mean in one run
-    switch (m_Statistics.dataType)
-    {
-        case TBYTE:
-            runningAverageStdDev<uint8_t>();
-            break;
+    int status = 0;
+    double bscale = 1, bzero = 0;
+    LONGLONG headStart = 0, dataStart = 0, dataEnd = 0;
 
-        case TSHORT:
-            runningAverageStdDev<int16_t>();
-            break;
+    // FITS data is big endian, so on little endian hosts only bytes can be used as they are.
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    if (m_FITSBITPIX != BYTE_IMG)
+        return false;
+#else
+    if (m_FITSBITPIX != BYTE_IMG && m_FITSBITPIX != FLOAT_IMG && m_FITSBITPIX != DOUBLE_IMG && m_FITSBITPIX != LONGLONG_IMG)
+        return false;
+#endif
 
-        case TUSHORT:
-            runningAverageStdDev<uint16_t>();
-            break;
+    // Scaled data has to go through CFITSIO.
+    if (fits_read_key_dbl(fptr, "BSCALE", &bscale, nullptr, &status))
+        bscale = 1;
+    status = 0;
+    if (fits_read_key_dbl(fptr, "BZERO", &bzero, nullptr, &status))
+        bzero = 0;
+    status = 0;
+    if (bscale != 1 || bzero != 0)
+        return false;
 
-        case TLONG:
-            runningAverageStdDev<int32_t>();
-            break;
+    if (fits_get_hduaddrll(fptr, &headStart, &dataStart, &dataEnd, &status) || dataEnd - dataStart < m_ImageBufferSize)
+        return false;
 
-        case TULONG:
-            runningAverageStdDev<uint32_t>();
-            break;
+    m_MappedFile.setFileName(m_Filename);
+    if (!m_MappedFile.open(QIODevice::ReadOnly))
+        return false;
 
-        case TFLOAT:
-            runningAverageStdDev<float>();
-            break;
+    uint8_t *data = m_MappedFile.map(dataStart, m_ImageBufferSize);
+    if (data == nullptr)
+    {
+        m_MappedFile.close();
+        return false;
+    }
 
-        case TLONGLONG:
-            runningAverageStdDev<int64_t>();
-            break;
+    m_ImageBuffer = data;
+    m_isMapped = true;
+    return true;
+}
 
-        case TDOUBLE:
-            runningAverageStdDev<double>();
-            break;
+void FITSData::detachImageBuffer()
+{
+    if (!m_isMapped)
+        return;
 
-        default:
-            return;
-    }
+    auto *copy = FITSBufferPool::Instance()->acquire(m_ImageBufferSize);
+    if (copy == nullptr)
+        return;
+    memcpy(copy, m_ImageBuffer, m_ImageBufferSize);
+    clearImageBuffers();
+    m_ImageBuffer = copy;
+}
 
-    // FIXME That's not really SNR, must implement a proper solution for this value
-    m_Statistics.SNR = m_Statistics.mean[0] / m_Statistics.stddev[0];
+namespace
+{
+// Samples handled per block of the statistics kernel. A block stays in L1 cache
+// while every statistic is gathered from it.
+const uint32_t StatsBlockSize = 4096;
+// Maximum number of samples per channel used for the median.
+const uint32_t MaxMedianSize = 500000;
+
+// Rows decoded above and below each band of a parallel debayer. This covers the support of all
+// the interpolating methods but AHD.
+const int DebayerBandMargin = 8;
+
+inline dc1394error_t bayerDecode(const uint8_t *bayer, uint8_t *rgb, uint32_t width, uint32_t height,
+                                 dc1394color_filter_t tile, dc1394bayer_method_t method)
+{
+    return dc1394_bayer_decoding_8bit(bayer, rgb, width, height, tile, method);
 }
 
-void FITSData::calculateMinMax(bool refresh)
+inline dc1394error_t bayerDecode(const uint16_t *bayer, uint16_t *rgb, uint32_t width, uint32_t height,
+                                 dc1394color_filter_t tile, dc1394bayer_method_t method)
 {
-    int status, nfound = 0;
+    return dc1394_bayer_decoding_16bit(bayer, rgb, width, height, tile, method, 16);
+}
 
-    status = 0;
+// Partial statistics of a contiguous range of one channel.
+struct StatsPartition
+{
+    uint8_t channel { 0 };
+    uint32_t start { 0 };
+    uint32_t end { 0 };
+    double min { 0 };
+    double max { 0 };
+    double mean { 0 };
+    // Sum of squared deviations from the mean
+    double m2 { 0 };
+};
+
+// 8 and 16 bit integer images are small enough to count every possible value.
+template <typename T>
+struct HasValueCounts : std::integral_constant<bool, std::is_integral<T>::value && sizeof(T) <= 2> {};
 
-    // Only fetch from header if we have a single channel
-    // Otherwise, calculate manually.
-    if (fptr != nullptr && !refresh)
-    {
+// Index of a value in the counting histogram.
+template <typename T>
+inline uint32_t valueIndex(T value)
+{
+    return static_cast<uint32_t>(static_cast<int32_t>(value) - std::numeric_limits<T>::min());
+}
 
-        status = 0;
+// Block sums are exact 64-bit integers for 8 and 16 bit data, doubles otherwise.
+template <typename T>
+using BlockSum = typename std::conditional<HasValueCounts<T>::value, int64_t, double>::type;
 
-        if (fits_read_key_dbl(fptr, "DATAMIN", &(m_Statistics.min[0]), nullptr, &status) == 0)
-            nfound++;
-        else if (fits_read_key_dbl(fptr, "MIN1", &(m_Statistics.min[0]), nullptr, &status) == 0)
-            nfound++;
+// Gather the requested statistics of one partition in a single sweep. Each block is
+// scanned by short branch-free loops the compiler can vectorize, and the block results
+// are merged with the pairwise update of Chan et al. Pixel values are counted into
+// counts when given, otherwise one every downsample pixels of the channel is copied
+// to samples when given.
+template <typename T>
+void partitionStats(T const *channel, StatsPartition &partition, bool minMax, bool meanStdDev,
+                    uint32_t *counts, double *samples, uint32_t downsample)
+{
+    T min = std::numeric_limits<T>::max();
+    T max = std::numeric_limits<T>::lowest();
+    double mean = 0, m2 = 0;
+    uint32_t count = 0;
+    uint32_t nextSample = (partition.start + downsample - 1) / downsample * downsample;
 
-        // NB. These could fail if missing, which is OK.
-        fits_read_key_dbl(fptr, "MIN2", &m_Statistics.min[1], nullptr, &status);
-        fits_read_key_dbl(fptr, "MIN3", &m_Statistics.min[2], nullptr, &status);
+    for (uint32_t blockStart = partition.start; blockStart < partition.end; blockStart += StatsBlockSize)
+    {
+        T const * const block = channel + blockStart;
+        const uint32_t n = qMin(StatsBlockSize, partition.end - blockStart);
 
-        status = 0;
+        if (minMax)
+        {
+            T blockMin = block[0], blockMax = block[0];
+            for (uint32_t i = 0; i < n; i++)
+            {
+                blockMin = block[i] < blockMin ? block[i] : blockMin;
+                blockMax = block[i] > blockMax ? block[i] : blockMax;
+            }
+            min = qMin(min, blockMin);
+            max = qMax(max, blockMax);
+        }
 
-        if (fits_read_key_dbl(fptr, "DATAMAX", &(m_Statistics.max[0]), nullptr, &status) == 0)
-            nfound++;
-        else if (fits_read_key_dbl(fptr, "MAX1", &(m_Statistics.max[0]), nullptr, &status) == 0)
-            nfound++;
+        if (meanStdDev)
+        {
+            // Shift by the first sample so the sum of squares stays well conditioned
+            const BlockSum<T> shift = block[0];
+            BlockSum<T> sum = 0, squares = 0;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                const BlockSum<T> value = static_cast<BlockSum<T>>(block[i]) - shift;
+                sum += value;
+                squares += value * value;
+            }
+            const double blockMean = shift + static_cast<double>(sum) / n;
+            const double blockM2 = static_cast<double>(squares) - static_cast<double>(sum) * sum / n;
+            const double delta = blockMean - mean;
+            const uint32_t total = count + n;
+            mean += delta * n / total;
+            m2 += blockM2 + delta * delta * count / total * n;
+        }
 
-        // NB. These could fail if missing, which is OK.
-        fits_read_key_dbl(fptr, "MAX2", &m_Statistics.max[1], nullptr, &status);
-        fits_read_key_dbl(fptr, "MAX3", &m_Statistics.max[2], nullptr, &status);
+        if (counts != nullptr)
+        {
+            for (uint32_t i = 0; i < n; i++)
+                counts[valueIndex(block[i])]++;
+        }
+        else if (samples != nullptr)
+        {
+            for (; nextSample < blockStart + n; nextSample += downsample)
+                *samples++ = channel[nextSample];
+        }
 
-        // If we found both keywords, no need to calculate them, unless they are both zeros
-        if (nfound == 2 && !(m_Statistics.min[0] == 0 && m_Statistics.max[0] == 0))
-            return;
+        count += n;
     }
 
-    m_Statistics.min[0] = 1.0E30;
-    m_Statistics.max[0] = -1.0E30;
-
-    m_Statistics.min[1] = 1.0E30;
-    m_Statistics.max[1] = -1.0E30;
+    partition.min = min;
+    partition.max = max;
+    partition.mean = mean;
+    partition.m2 = m2;
+}
+}
 
-    m_Statistics.min[2] = 1.0E30;
-    m_Statistics.max[2] = -1.0E30;
+void FITSData::calculateStats(bool refresh)
+{
+    // Statistics stored in the header are used as is, unless a refresh is requested
+    const bool minMax = refresh || !readMinMaxKeywords();
+    const bool median = refresh || !readMedianKeywords();
+    const bool meanStdDev = refresh || !readMeanStdDevKeywords();
 
-    switch (m_Statistics.dataType)
+    if (minMax || median || meanStdDev)
     {
-        case TBYTE:
-            calculateMinMax<uint8_t>();
-            break;
+        switch (m_Statistics.dataType)
+        {
+            case TBYTE:
+                calculateStatsInternal<uint8_t>(minMax, median, meanStdDev);
+                break;
 
-        case TSHORT:
-            calculateMinMax<int16_t>();
-            break;
+            case TSHORT:
+                calculateStatsInternal<int16_t>(minMax, median, meanStdDev);
+                break;
 
-        case TUSHORT:
-            calculateMinMax<uint16_t>();
-            break;
+            case TUSHORT:
+                calculateStatsInternal<uint16_t>(minMax, median, meanStdDev);
+                break;
 
-        case TLONG:
-            calculateMinMax<int32_t>();
-            break;
+            case TLONG:
+                calculateStatsInternal<int32_t>(minMax, median, meanStdDev);
+                break;
 
-        case TULONG:
-            calculateMinMax<uint32_t>();
-            break;
+            case TULONG:
+                calculateStatsInternal<uint32_t>(minMax, median, meanStdDev);
+                break;
 
-        case TFLOAT:
-            calculateMinMax<float>();
-            break;
+            case TFLOAT:
+                calculateStatsInternal<float>(minMax, median, meanStdDev);
+                break;
 
-        case TLONGLONG:
-            calculateMinMax<int64_t>();
-            break;
+            case TLONGLONG:
+                calculateStatsInternal<int64_t>(minMax, median, meanStdDev);
+                break;
 
-        case TDOUBLE:
-            calculateMinMax<double>();
-            break;
+            case TDOUBLE:
+                calculateStatsInternal<double>(minMax, median, meanStdDev);
+                break;
 
-        default:
-            break;
+            default:
+                return;
+        }
     }
+
+    // FIXME That's not really SNR, must implement a proper solution for this value
+    m_Statistics.SNR = m_Statistics.mean[0] / m_Statistics.stddev[0];
 }
 
-void FITSData::calculateMedian(bool refresh)
+void FITSData::updateStatistics(const std::vector<double> &oldValues, const std::vector<double> &newValues,
+                                uint8_t channel)
 {
-    int status, nfound = 0;
+    const bool updatable = m_ValueCountsUpdatable;
+    m_ValueCountsUpdatable = false;
 
-    status = 0;
+    const double samples = m_Statistics.samples_per_channel;
+    if (samples == 0 || channel >= m_Statistics.channels || oldValues.empty() || oldValues.size() != newValues.size())
+        return;
 
-    // Only fetch from header if we have a single channel
-    // Otherwise, calculate manually.
-    if (fptr != nullptr && !refresh)
+    double sumDelta = 0, squaresDelta = 0;
+    bool minMaxReplaced = false;
+    const double min = m_Statistics.min[channel], max = m_Statistics.max[channel];
+    for (size_t i = 0; i < oldValues.size(); i++)
     {
-        status = 0;
-        if (fits_read_key_dbl(fptr, "MEDIAN1", &m_Statistics.median[0], nullptr, &status) == 0)
-            nfound++;
+        sumDelta += newValues[i] - oldValues[i];
+        squaresDelta += newValues[i] * newValues[i] - oldValues[i] * oldValues[i];
+        minMaxReplaced |= (oldValues[i] <= min || oldValues[i] >= max || newValues[i] < min || newValues[i] > max);
+    }
 
-        // NB. These could fail if missing, which is OK.
-        fits_read_key_dbl(fptr, "MEDIAN2", &m_Statistics.median[1], nullptr, &status);
-        fits_read_key_dbl(fptr, "MEDIAN3", &m_Statistics.median[2], nullptr, &status);
+    // Population variance from the change of the sums, written in differences to keep its precision
+    const double mean = m_Statistics.mean[channel];
+    const double newMean = mean + sumDelta / samples;
+    const double variance = m_Statistics.stddev[channel] * m_Statistics.stddev[channel] + squaresDelta / samples -
+                            (newMean - mean) * (newMean + mean);
+    m_Statistics.mean[channel] = newMean;
+    m_Statistics.stddev[channel] = std::sqrt(std::max(0.0, variance));
 
-        if (nfound == 1)
-            return;
-    }
+    // FIXME That's not really SNR, must implement a proper solution for this value
+    m_Statistics.SNR = m_Statistics.mean[0] / m_Statistics.stddev[0];
+
+    std::vector<uint32_t> &cumulative = m_ValueCounts[channel];
+    if (updatable && m_PercentileSamples.empty() && !cumulative.empty())
+    {
+        // Each replaced value leaves the counts from its old value up, and joins them from its new value up.
+        std::vector<int32_t> changes(cumulative.size(), 0);
+        for (size_t i = 0; i < oldValues.size(); i++)
+        {
+            changes[static_cast<size_t>(oldValues[i] - m_PercentileOffset)]--;
+            changes[static_cast<size_t>(newValues[i] - m_PercentileOffset)]++;
+        }
+
+        int32_t change = 0;
+        for (size_t bin = 0; bin < cumulative.size(); bin++)
+        {
+            change += changes[bin];
+            cumulative[bin] += change;
+        }
 
-    m_Statistics.median[RED_CHANNEL] = 0;
-    m_Statistics.median[GREEN_CHANNEL] = 0;
-    m_Statistics.median[BLUE_CHANNEL] = 0;
+        m_PercentilesReady = true;
+        m_Statistics.median[channel] = getPercentile(0.5, channel);
+        if (minMaxReplaced)
+        {
+            m_Statistics.min[channel] = (std::upper_bound(cumulative.begin(), cumulative.end(), 0u) - cumulative.begin()) +
+                                        m_PercentileOffset;
+            m_Statistics.max[channel] = (std::lower_bound(cumulative.begin(), cumulative.end(), cumulative.back()) -
+                                         cumulative.begin()) + m_PercentileOffset;
+        }
+        return;
+    }
 
+    // The median is resampled, which only reads the image in full when counting values or scanning the extremes.
     switch (m_Statistics.dataType)
     {
         case TBYTE:
-            calculateMedian<uint8_t>();
+            calculateStatsInternal<uint8_t>(minMaxReplaced, true, false);
             break;
 
         case TSHORT:
-            calculateMedian<int16_t>();
+            calculateStatsInternal<int16_t>(minMaxReplaced, true, false);
             break;
 
         case TUSHORT:
-            calculateMedian<uint16_t>();
+            calculateStatsInternal<uint16_t>(minMaxReplaced, true, false);
             break;
 
         case TLONG:
-            calculateMedian<int32_t>();
+            calculateStatsInternal<int32_t>(minMaxReplaced, true, false);
             break;
 
         case TULONG:
-            calculateMedian<uint32_t>();
+            calculateStatsInternal<uint32_t>(minMaxReplaced, true, false);
             break;
 
         case TFLOAT:
-            calculateMedian<float>();
+            calculateStatsInternal<float>(minMaxReplaced, true, false);
             break;
 
         case TLONGLONG:
-            calculateMedian<int64_t>();
+            calculateStatsInternal<int64_t>(minMaxReplaced, true, false);
             break;
 
         case TDOUBLE:
-            calculateMedian<double>();
+            calculateStatsInternal<double>(minMaxReplaced, true, false);
             break;
 
         default:
@@ -1171,242 +1392,393 @@ void FITSData::calculateMedian(bool refresh)
     }
 }
 
-template <typename T>
-void FITSData::calculateMedian()
+bool FITSData::readMinMaxKeywords()
 {
-    auto * buffer = reinterpret_cast<T *>(m_ImageBuffer);
-    const uint32_t maxMedianSize = 500000;
-    uint32_t medianSize = m_Statistics.samples_per_channel;
-    uint8_t downsample = 1;
-    if (medianSize > maxMedianSize)
-    {
-        downsample = (static_cast<double>(medianSize) / maxMedianSize) + 0.999;
-        medianSize /= downsample;
-    }
-    std::vector<T> samples;
-    samples.reserve(medianSize);
+    if (fptr == nullptr)
+        return false;
 
-    for (uint8_t n = 0; n < m_Statistics.channels; n++)
-    {
-        auto *oneChannel = buffer + n * m_Statistics.samples_per_channel;
-        for (uint32_t upto = 0; upto < m_Statistics.samples_per_channel; upto += downsample)
-            samples.push_back(oneChannel[upto]);
-        const uint32_t middle = samples.size() / 2;
-        std::nth_element(samples.begin(), samples.begin() + middle, samples.end());
-        m_Statistics.median[n] = samples[middle];
-    }
-}
+    int status = 0, nfound = 0;
 
-template <typename T>
-QPair<T, T> FITSData::getParitionMinMax(uint32_t start, uint32_t stride)
-{
-    auto * buffer = reinterpret_cast<T *>(m_ImageBuffer);
-    T min = std::numeric_limits<T>::max();
-    T max = std::numeric_limits<T>::min();
+    if (fits_read_key_dbl(fptr, "DATAMIN", &(m_Statistics.min[0]), nullptr, &status) == 0)
+        nfound++;
+    else if (fits_read_key_dbl(fptr, "MIN1", &(m_Statistics.min[0]), nullptr, &status) == 0)
+        nfound++;
 
-    uint32_t end = start + stride;
+    // NB. These could fail if missing, which is OK.
+    fits_read_key_dbl(fptr, "MIN2", &m_Statistics.min[1], nullptr, &status);
+    fits_read_key_dbl(fptr, "MIN3", &m_Statistics.min[2], nullptr, &status);
 
-    for (uint32_t i = start; i < end; i++)
-    {
-        min = qMin(buffer[i], min);
-        max = qMax(buffer[i], max);
-        //        if (buffer[i] < min)
-        //            min = buffer[i];
-        //        else if (buffer[i] > max)
-        //            max = buffer[i];
-    }
+    status = 0;
+
+    if (fits_read_key_dbl(fptr, "DATAMAX", &(m_Statistics.max[0]), nullptr, &status) == 0)
+        nfound++;
+    else if (fits_read_key_dbl(fptr, "MAX1", &(m_Statistics.max[0]), nullptr, &status) == 0)
+        nfound++;
 
-    return qMakePair(min, max);
+    // NB. These could fail if missing, which is OK.
+    fits_read_key_dbl(fptr, "MAX2", &m_Statistics.max[1], nullptr, &status);
+    fits_read_key_dbl(fptr, "MAX3", &m_Statistics.max[2], nullptr, &status);
+
+    // If we found both keywords, no need to calculate them, unless they are both zeros
+    return (nfound == 2 && !(m_Statistics.min[0] == 0 && m_Statistics.max[0] == 0));
 }
 
-template <typename T>
-void FITSData::calculateMinMax()
+bool FITSData::readMedianKeywords()
 {
-    T min = std::numeric_limits<T>::max();
-    T max = std::numeric_limits<T>::min();
-
+    if (fptr == nullptr)
+        return false;
 
-    // Create N threads
-    const uint8_t nThreads = 16;
+    int status = 0;
+    if (fits_read_key_dbl(fptr, "MEDIAN1", &m_Statistics.median[0], nullptr, &status) != 0)
+        return false;
 
-    for (int n = 0; n < m_Statistics.channels; n++)
-    {
-        uint32_t cStart = n * m_Statistics.samples_per_channel;
+    // NB. These could fail if missing, which is OK.
+    fits_read_key_dbl(fptr, "MEDIAN2", &m_Statistics.median[1], nullptr, &status);
+    fits_read_key_dbl(fptr, "MEDIAN3", &m_Statistics.median[2], nullptr, &status);
+    return true;
+}
 
-        // Calculate how many elements we process per thread
-        uint32_t tStride = m_Statistics.samples_per_channel / nThreads;
+bool FITSData::readMeanStdDevKeywords()
+{
+    if (fptr == nullptr)
+        return false;
 
-        // Calculate the final stride since we can have some left over due to division above
-        uint32_t fStride = tStride + (m_Statistics.samples_per_channel - (tStride * nThreads));
+    int status = 0, nfound = 0;
+    if (fits_read_key_dbl(fptr, "MEAN1", &m_Statistics.mean[0], nullptr, &status) == 0)
+        nfound++;
+    // NB. These could fail if missing, which is OK.
+    fits_read_key_dbl(fptr, "MEAN2", & m_Statistics.mean[1], nullptr, &status);
+    fits_read_key_dbl(fptr, "MEAN3", &m_Statistics.mean[2], nullptr, &status);
 
-        // Start location for inspecting elements
-        uint32_t tStart = cStart;
+    status = 0;
+    if (fits_read_key_dbl(fptr, "STDDEV1", &m_Statistics.stddev[0], nullptr, &status) == 0)
+        nfound++;
+    // NB. These could fail if missing, which is OK.
+    fits_read_key_dbl(fptr, "STDDEV2", &m_Statistics.stddev[1], nullptr, &status);
+    fits_read_key_dbl(fptr, "STDDEV3", &m_Statistics.stddev[2], nullptr, &status);
 
-        // List of futures
-        QList<QFuture<QPair<T, T>>> futures;
+    return (nfound == 2);
+}
 
-        for (int i = 0; i < nThreads; i++)
-        {
-            // Run threads
-            futures.append(QtConcurrent::run(this, &FITSData::getParitionMinMax<T>, tStart, (i == (nThreads - 1)) ? fStride : tStride));
-            tStart += tStride;
-        }
+template <typename T>
+void FITSData::calculateStatsInternal(bool minMax, bool median, bool meanStdDev)
+{
+    const uint32_t samples = m_Statistics.samples_per_channel;
+    if (m_ImageBuffer == nullptr || samples == 0 || !(minMax || median || meanStdDev))
+        return;
 
-        // Now wait for results
-        for (int i = 0; i < nThreads; i++)
+    auto * const buffer = reinterpret_cast<T const *>(m_ImageBuffer);
+    const uint8_t channels = m_Statistics.channels;
+
+    // The median comes from a count of every value for 8 and 16 bit images. Other types use a regular
+    // subsample of the channel. Both are collected during the same sweep, in buffers kept between frames.
+    const bool counting = median && HasValueCounts<T>::value;
+    const uint32_t bins = counting ? (1u << (8 * sizeof(T))) : 0;
+    const uint32_t downsample = (samples + MaxMedianSize - 1) / MaxMedianSize;
+    const uint32_t sampleSize = (median && !counting) ? (samples + downsample - 1) / downsample : 0;
+
+    // Split every channel in a few partitions per thread, all of them run in a single fan-out.
+    // Counting uses one partition per thread, each with private counts merged at the end.
+    const int maxPartitions = QThreadPool::globalInstance()->maxThreadCount() * (counting ? 1 : 4);
+    const uint32_t nPartitions = qBound<uint32_t>(1, samples / (StatsBlockSize * 4), maxPartitions);
+    // Partitions start on a block boundary
+    const uint32_t partitionSize = ((samples + nPartitions - 1) / nPartitions + StatsBlockSize - 1) / StatsBlockSize *
+                                   StatsBlockSize;
+
+    QVector<StatsPartition> partitions;
+    for (uint8_t n = 0; n < channels; n++)
+    {
+        for (uint32_t start = 0; start < samples; start += partitionSize)
         {
-            QPair<T, T> result = futures[i].result();
-            min = qMin(result.first, min);
-            max = qMax(result.second, max);
+            StatsPartition partition;
+            partition.channel = n;
+            partition.start = start;
+            partition.end = qMin(samples, start + partitionSize);
+            partitions.append(partition);
         }
-
-        m_Statistics.min[n] = min;
-        m_Statistics.max[n] = max;
     }
-}
-
-template <typename T>
-QPair<double, double> FITSData::getSquaredSumAndMean(uint32_t start, uint32_t stride)
-{
-    uint32_t m_n       = 2;
-    double m_oldM = 0, m_newM = 0, m_oldS = 0, m_newS = 0;
-
-    auto * buffer = reinterpret_cast<T *>(m_ImageBuffer);
-    uint32_t end = start + stride;
 
-    for (uint32_t i = start; i < end; i++)
+    if (counting)
     {
-        m_newM = m_oldM + (buffer[i] - m_oldM) / m_n;
-        m_newS = m_oldS + (buffer[i] - m_oldM) * (buffer[i] - m_newM);
-
-        m_oldM = m_newM;
-        m_oldS = m_newS;
-        m_n++;
+        m_PartitionCounts.resize(static_cast<size_t>(partitions.size()) * bins);
+        std::fill(m_PartitionCounts.begin(), m_PartitionCounts.end(), 0);
     }
+    if (median)
+        m_PercentileSamples.resize(static_cast<size_t>(sampleSize) * channels);
 
-    return qMakePair<double, double>(m_newM, m_newS);
-}
-
-template <typename T>
-void FITSData::runningAverageStdDev()
-{
-    // Create N threads
-    const uint8_t nThreads = 16;
+    StatsPartition const * const firstPartition = partitions.constData();
+    QtConcurrent::blockingMap(partitions, [&](StatsPartition & partition)
+    {
+        uint32_t *counts = nullptr;
+        double *sampleOut = nullptr;
+        if (counting)
+            counts = m_PartitionCounts.data() + (&partition - firstPartition) * bins;
+        else if (median)
+            sampleOut = m_PercentileSamples.data() + partition.channel * sampleSize + (partition.start + downsample - 1) / downsample;
+        partitionStats<T>(buffer + partition.channel * samples, partition, minMax, meanStdDev, counts, sampleOut, downsample);
+    });
 
-    for (int n = 0; n < m_Statistics.channels; n++)
+    for (uint8_t n = 0; n < channels; n++)
     {
-        uint32_t cStart = n * m_Statistics.samples_per_channel;
+        double min = std::numeric_limits<double>::max();
+        double max = std::numeric_limits<double>::lowest();
+        double mean = 0, m2 = 0;
+        uint32_t count = 0;
+
+        if (counting)
+        {
+            m_ValueCounts[n].resize(bins);
+            std::fill(m_ValueCounts[n].begin(), m_ValueCounts[n].end(), 0);
+        }
 
-        // Calculate how many elements we process per thread
-        uint32_t tStride = m_Statistics.samples_per_channel / nThreads;
+        for (int i = 0; i < partitions.size(); i++)
+        {
+            const StatsPartition &partition = partitions[i];
+            if (partition.channel != n)
+                continue;
 
-        // Calculate the final stride since we can have some left over due to division above
-        uint32_t fStride = tStride + (m_Statistics.samples_per_channel - (tStride * nThreads));
+            const uint32_t size = partition.end - partition.start;
+            min = qMin(min, partition.min);
+            max = qMax(max, partition.max);
 
-        // Start location for inspecting elements
-        uint32_t tStart = cStart;
+            const double delta = partition.mean - mean;
+            const uint32_t total = count + size;
+            mean += delta * size / total;
+            m2 += partition.m2 + delta * delta * count / total * size;
+            count = total;
 
-        // List of futures
-        QList<QFuture<QPair<double, double>>> futures;
+            if (counting)
+            {
+                uint32_t const * const counts = m_PartitionCounts.data() + static_cast<size_t>(i) * bins;
+                uint32_t * const merged = m_ValueCounts[n].data();
+                for (uint32_t bin = 0; bin < bins; bin++)
+                    merged[bin] += counts[bin];
+            }
+        }
 
-        for (int i = 0; i < nThreads; i++)
+        if (minMax)
         {
-            // Run threads
-            futures.append(QtConcurrent::run(this, &FITSData::getSquaredSumAndMean<T>, tStart,
-                                             (i == (nThreads - 1)) ? fStride : tStride));
-            tStart += tStride;
+            m_Statistics.min[n] = min;
+            m_Statistics.max[n] = max;
         }
 
-        double mean = 0, squared_sum = 0;
-
-        // Now wait for results
-        for (int i = 0; i < nThreads; i++)
+        if (meanStdDev)
         {
-            QPair<double, double> result = futures[i].result();
-            mean += result.first;
-            squared_sum += result.second;
+            m_Statistics.mean[n] = mean;
+            m_Statistics.stddev[n] = std::sqrt(m2 / samples);
         }
 
-        double variance = squared_sum / m_Statistics.samples_per_channel;
+        if (counting)
+        {
+            // Turn the counts into the number of pixels up to and including each value
+            std::partial_sum(m_ValueCounts[n].begin(), m_ValueCounts[n].end(), m_ValueCounts[n].begin());
+        }
+    }
 
-        m_Statistics.mean[n]   = mean / nThreads;
-        m_Statistics.stddev[n] = sqrt(variance);
+    if (median)
+    {
+        m_PercentileOffset = counting ? std::numeric_limits<T>::min() : 0;
+        m_PercentilesReady = true;
+        for (uint8_t n = 0; n < channels; n++)
+            m_Statistics.median[n] = getPercentile(0.5, n);
     }
 }
 
-QVector<double> FITSData::createGaussianKernel(int size, double sigma)
+double FITSData::getPercentile(double fraction, uint8_t channel)
 {
-    QVector<double> kernel(size * size);
-    kernel.fill(0.0, size * size);
+    if (channel >= m_Statistics.channels)
+        return 0;
 
-    double kernelSum = 0.0;
-    int fOff = (size - 1) / 2;
-    double normal = 1.0 / (2.0 * M_PI * sigma * sigma);
-    for (int y = -fOff; y <= fOff; y++)
+    if (!m_PercentilesReady)
     {
-        for (int x = -fOff; x <= fOff; x++)
+        switch (m_Statistics.dataType)
         {
-            double distance = ((y * y) + (x * x)) / (2.0 * sigma * sigma);
-            int index = (y + fOff) * size + (x + fOff);
-            kernel[index] = normal * qExp(-distance);
-            kernelSum += kernel.at(index);
+            case TBYTE:
+                calculateStatsInternal<uint8_t>(false, true, false);
+                break;
+
+            case TSHORT:
+                calculateStatsInternal<int16_t>(false, true, false);
+                break;
+
+            case TUSHORT:
+                calculateStatsInternal<uint16_t>(false, true, false);
+                break;
+
+            case TLONG:
+                calculateStatsInternal<int32_t>(false, true, false);
+                break;
+
+            case TULONG:
+                calculateStatsInternal<uint32_t>(false, true, false);
+                break;
+
+            case TFLOAT:
+                calculateStatsInternal<float>(false, true, false);
+                break;
+
+            case TLONGLONG:
+                calculateStatsInternal<int64_t>(false, true, false);
+                break;
+
+            case TDOUBLE:
+                calculateStatsInternal<double>(false, true, false);
+                break;
+
+            default:
+                return 0;
         }
+
+        if (!m_PercentilesReady)
+            return 0;
     }
-    for (int y = 0; y < size; y++)
+
+    fraction = qBound(0.0, fraction, 1.0);
+
+    // Exact value from the cumulative counts
+    if (m_PercentileSamples.empty())
     {
-        for (int x = 0; x < size; x++)
-        {
-            int index = y * size + x;
-            kernel[index] = kernel.at(index) * 1.0 / kernelSum;
-        }
+        const std::vector<uint32_t> &cumulative = m_ValueCounts[channel];
+        if (cumulative.empty() || cumulative.back() == 0)
+            return 0;
+        const uint32_t rank = static_cast<uint32_t>(std::lround(fraction * (cumulative.back() - 1)));
+        const auto bin = std::upper_bound(cumulative.begin(), cumulative.end(), rank);
+        return static_cast<double>(bin - cumulative.begin()) + m_PercentileOffset;
     }
 
-    return kernel;
+    // Estimate from the subsample of the channel
+    const size_t sampleSize = m_PercentileSamples.size() / m_Statistics.channels;
+    const auto begin = m_PercentileSamples.begin() + channel * sampleSize;
+    const auto nth = begin + std::lround(fraction * (sampleSize - 1));
+    std::nth_element(begin, nth, begin + sampleSize);
+    return *nth;
+}
+
+void FITSData::buildIntegralImages()
+{
+    if (!m_IntegralImages[0].isNull())
+        return;
+
+    switch (m_Statistics.dataType)
+    {
+        case TBYTE:
+            buildIntegralImagesInternal<uint8_t>();
+            break;
+
+        case TSHORT:
+            buildIntegralImagesInternal<int16_t>();
+            break;
+
+        case TUSHORT:
+            buildIntegralImagesInternal<uint16_t>();
+            break;
+
+        case TLONG:
+            buildIntegralImagesInternal<int32_t>();
+            break;
+
+        case TULONG:
+            buildIntegralImagesInternal<uint32_t>();
+            break;
+
+        case TFLOAT:
+            buildIntegralImagesInternal<float>();
+            break;
+
+        case TLONGLONG:
+            buildIntegralImagesInternal<int64_t>();
+            break;
+
+        case TDOUBLE:
+            buildIntegralImagesInternal<double>();
+            break;
+
+        default:
+            break;
+    }
 }
 
 template <typename T>
-void FITSData::convolutionFilter(const QVector<double> &kernel, int kernelSize)
+void FITSData::buildIntegralImagesInternal()
+{
+    auto const * buffer = reinterpret_cast<T const *>(m_ImageBuffer);
+    for (int n = 0; n < m_Statistics.channels; n++)
+        m_IntegralImages[n].build(buffer + n * m_Statistics.samples_per_channel, m_Statistics.width, m_Statistics.height);
+}
+
+void FITSData::clearIntegralImages()
 {
-    T * imagePtr = reinterpret_cast<T *>(m_ImageBuffer);
+    for (auto &integral : m_IntegralImages)
+        integral.clear();
+}
 
-    // Create variable for pixel data for each kernel
-    T gt = 0;
+bool FITSData::getRegionStatistics(const QRect &region, double &mean, double &stddev, uint8_t channel) const
+{
+    if (channel >= m_Statistics.channels || m_ImageBuffer == nullptr)
+        return false;
 
-    // This is how much your center pixel is offset from the border of your kernel
-    int fOff = (kernelSize - 1) / 2;
+    if (!m_IntegralImages[channel].isNull())
+        return m_IntegralImages[channel].statistics(region, &mean, &stddev);
 
-    // Start with the pixel that is offset fOff from top and fOff from the left side
-    // this is so entire kernel is on your image
-    for (int offsetY = 0; offsetY < m_Statistics.height; offsetY++)
+    switch (m_Statistics.dataType)
     {
-        for (int offsetX = 0; offsetX < m_Statistics.width; offsetX++)
-        {
-            // reset gray value to 0
-            gt = 0;
-            // position of the kernel center pixel
-            int byteOffset = offsetY * m_Statistics.width + offsetX;
+        case TBYTE:
+            return regionStatistics<uint8_t>(region, mean, stddev, channel);
 
-            // kernel calculations
-            for (int filterY = -fOff; filterY <= fOff; filterY++)
-            {
-                for (int filterX = -fOff; filterX <= fOff; filterX++)
-                {
-                    if ((offsetY + filterY) >= 0 && (offsetY + filterY) < m_Statistics.height
-                            && ((offsetX + filterX) >= 0 && (offsetX + filterX) < m_Statistics.width ))
-                    {
+        case TSHORT:
+            return regionStatistics<int16_t>(region, mean, stddev, channel);
 
-                        int calcOffset = byteOffset + filterX + filterY * m_Statistics.width;
-                        int index = (filterY + fOff) * kernelSize + (filterX + fOff);
-                        double kernelValue = kernel.at(index);
-                        gt += (imagePtr[calcOffset]) * kernelValue;
-                    }
-                }
-            }
+        case TUSHORT:
+            return regionStatistics<uint16_t>(region, mean, stddev, channel);
+
+        case TLONG:
+            return regionStatistics<int32_t>(region, mean, stddev, channel);
+
+        case TULONG:
+            return regionStatistics<uint32_t>(region, mean, stddev, channel);
+
+        case TFLOAT:
+            return regionStatistics<float>(region, mean, stddev, channel);
+
+        case TLONGLONG:
+            return regionStatistics<int64_t>(region, mean, stddev, channel);
+
+        case TDOUBLE:
+            return regionStatistics<double>(region, mean, stddev, channel);
+
+        default:
+            return false;
+    }
+}
+
+template <typename T>
+bool FITSData::regionStatistics(const QRect &region, double &mean, double &stddev, uint8_t channel) const
+{
+    const QRect area = region & QRect(0, 0, m_Statistics.width, m_Statistics.height);
+    if (area.isEmpty())
+        return false;
 
-            // set new data in the other byte array for your image data
-            imagePtr[byteOffset] = gt;
+    auto const * buffer = reinterpret_cast<T const *>(m_ImageBuffer) + channel * m_Statistics.samples_per_channel;
+
+    // Sums are shifted by the first pixel to keep the variance accurate
+    const double pivot = buffer[area.y() * m_Statistics.width + area.x()];
+    double sum = 0, squares = 0;
+    for (int y = area.top(); y <= area.bottom(); y++)
+    {
+        T const * row = buffer + y * m_Statistics.width;
+        for (int x = area.left(); x <= area.right(); x++)
+        {
+            const double value = row[x] - pivot;
+            sum += value;
+            squares += value * value;
         }
     }
+
+    const double count = static_cast<double>(area.width()) * area.height();
+    sum /= count;
+    mean = sum + pivot;
+    stddev = std::sqrt(std::max(0.0, squares / count - sum * sum));
+    return true;
 }
 
 template <typename T>
@@ -1424,8 +1796,10 @@ void FITSData::gaussianBlur(int kernelSize, double sigma)
         kernelSize = 1;
     }
 
-    QVector<double> gaussianKernel = createGaussianKernel(kernelSize, sigma);
-    convolutionFilter<T>(gaussianKernel, kernelSize);
+    // The Gaussian is separable, so a row pass followed by a column pass is equivalent
+    // to the full 2D kernel at a fraction of the cost.
+    FITSConvolution::separableFilter<T>(reinterpret_cast<T *>(m_ImageBuffer), m_Statistics.width, m_Statistics.height,
+                                        m_Statistics.channels, FITSConvolution::gaussianKernel(kernelSize, sigma));
 }
 
 void FITSData::setMinMax(double newMin, double newMax, uint8_t channel)
@@ -1439,7 +1813,7 @@ bool FITSData::parseHeader()
     char * header = nullptr;
     int status = 0, nkeys = 0;
 
-    if (fits_hdr2str(fptr, 0, nullptr, 0, &header, &nkeys, &status))
+    if (headerToString(fptr, 0, &header, &nkeys, &status))
     {
         fits_report_error(stderr, status);
         free(header);
@@ -1493,6 +1867,17 @@ bool FITSData::parseHeader()
     return true;
 }
 
+void FITSData::parseDateTime()
+{
+    // Get UTC date time
+    QVariant value;
+    if (getRecordValue("DATE-OBS", value) && value.isValid())
+    {
+        QDateTime ts = value.toDateTime();
+        m_DateTime = KStarsDateTime(ts.date(), ts.time());
+    }
+}
+
 bool FITSData::getRecordValue(const QString &key, QVariant &value) const
 {
     auto result = std::find_if(m_HeaderRecords.begin(), m_HeaderRecords.end(), [&key](const Record & oneRecord)
@@ -1853,6 +2238,12 @@ void FITSData::applyFilter(FITSScale type, uint8_t * image, QVector<double> * mi
     if (type == FITS_NONE)
         return;
 
+    if (image == nullptr)
+        emit dataAboutToChange();
+
+    m_PercentilesReady = false;
+    clearIntegralImages();
+
     QVector<double> dataMin(3);
     QVector<double> dataMax(3);
 
@@ -2011,6 +2402,7 @@ void FITSData::applyFilter(FITSScale type, uint8_t * targetImage, QVector<double
         image = reinterpret_cast<T *>(targetImage);
     else
     {
+        detachImageBuffer();
         image     = reinterpret_cast<T *>(m_ImageBuffer);
         calcStats = true;
     }
@@ -2125,8 +2517,7 @@ void FITSData::applyFilter(FITSScale type, uint8_t * targetImage, QVector<double
                     m_Statistics.max[i] = max[i];
                 }
                 //if (type != FITS_AUTO && type != FITS_LINEAR)
-                runningAverageStdDev<T>();
-                //QtConcurrent::run(this, &FITSData::runningAverageStdDev<T>);
+                calculateStatsInternal<T>(false, false, true);
             }
         }
         break;
@@ -2230,7 +2621,7 @@ void FITSData::applyFilter(FITSScale type, uint8_t * targetImage, QVector<double
             delete[] extension;
 
             if (calcStats)
-                runningAverageStdDev<T>();
+                calculateStatsInternal<T>(false, false, true);
         }
         break;
 
@@ -2285,6 +2676,10 @@ bool FITSData::checkForWCS()
 #ifndef KSTARS_LITE
 #ifdef HAVE_WCSLIB
 
+    // The solution in the header describes the full resolution mosaic, not the super-pixel image
+    if (m_isSuperPixel)
+        return false;
+
     int status = 0;
     char * header;
     int nkeyrec, nreject;
@@ -2295,8 +2690,9 @@ bool FITSData::checkForWCS()
         wcsvfree(&m_nwcs, &m_WCSHandle);
         m_WCSHandle = nullptr;
     }
+    resetWCSCache();
 
-    if (fits_hdr2str(fptr, 1, nullptr, 0, &header, &nkeyrec, &status))
+    if (headerToString(fptr, 1, &header, &nkeyrec, &status))
     {
         char errmsg[512];
         fits_get_errstatus(status, errmsg);
@@ -2359,6 +2755,7 @@ bool FITSData::loadWCS(bool extras)
         wcsvfree(&m_nwcs, &m_WCSHandle);
         m_WCSHandle = nullptr;
     }
+    resetWCSCache();
 
     qCDebug(KSTARS_FITS) << "Started WCS Data Processing...";
 
@@ -2366,7 +2763,7 @@ bool FITSData::loadWCS(bool extras)
     char * header;
     int nkeyrec, nreject, nwcs;
 
-    if (fits_hdr2str(fptr, 1, nullptr, 0, &header, &nkeyrec, &status))
+    if (headerToString(fptr, 1, &header, &nkeyrec, &status))
     {
         char errmsg[512];
         fits_get_errstatus(status, errmsg);
@@ -2498,23 +2895,48 @@ bool FITSData::pixelToWCS(const QPointF &wcsPixelPoint, SkyPoint &wcsCoord)
 }
 
 #if !defined(KSTARS_LITE) && defined(HAVE_WCSLIB)
-bool FITSData::searchObjects()
+namespace
 {
-    if (m_ObjectsSearched)
-        return true;
+// Points converted per wcslib call, and the smallest share of a batch worth a thread.
+const int WCSChunkSize = 4096;
+// Distance in pixels between the nodes of the interpolation grid.
+const int WCSGridStep = 64;
 
-    m_ObjectsSearched = true;
+// Convert points in chunks with the given solution, which must not be used by another thread meanwhile.
+int convertWCSPoints(wcsprm *wcs, bool toPixel, const QPointF *input, QPointF *output, bool *valid, int count)
+{
+    const int chunkSize = std::min(count, WCSChunkSize);
+    std::vector<double> in(2 * chunkSize), out(2 * chunkSize), imgcrd(2 * chunkSize), phi(chunkSize), theta(chunkSize);
+    std::vector<int> stat(chunkSize);
 
-    SkyPoint startPoint;
-    SkyPoint endPoint;
+    for (int first = 0; first < count; first += chunkSize)
+    {
+        const int n = std::min(chunkSize, count - first);
+        for (int i = 0; i < n; i++)
+        {
+            in[2 * i] = input[first + i].x();
+            in[2 * i + 1] = input[first + i].y();
+        }
 
-    pixelToWCS(QPointF(0, 0), startPoint);
-    pixelToWCS(QPointF(width() - 1, height() - 1), endPoint);
+        int status = toPixel ? wcss2p(wcs, n, 2, in.data(), phi.data(), theta.data(), imgcrd.data(), out.data(), stat.data()) :
+                     wcsp2s(wcs, n, 2, in.data(), imgcrd.data(), phi.data(), theta.data(), out.data(), stat.data());
 
-    return findObjectsInImage(startPoint, endPoint);
+        // Coordinates out of the projection are flagged one by one, anything else fails the whole batch
+        if (status != 0 && status != (toPixel ? WCSERR_BAD_WORLD : WCSERR_BAD_PIX))
+            return status;
+
+        for (int i = 0; i < n; i++)
+        {
+            output[first + i] = QPointF(out[2 * i], out[2 * i + 1]);
+            valid[first + i] = (stat[i] == 0);
+        }
+    }
+
+    return 0;
+}
 }
 
-bool FITSData::findWCSBounds(double &minRA, double &maxRA, double &minDec, double &maxDec)
+bool FITSData::convertWCS(bool toPixel, const QVector<QPointF> &input, QVector<QPointF> &output, QVector<bool> *valid)
 {
     if (m_WCSHandle == nullptr)
     {
@@ -2522,90 +2944,296 @@ bool FITSData::findWCSBounds(double &minRA, double &maxRA, double &minDec, doubl
         return false;
     }
 
-    maxRA  = -1000;
-    minRA  = 1000;
-    maxDec = -1000;
-    minDec = 1000;
+    const int count = input.size();
+    output.resize(count);
+    std::unique_ptr<bool[]> status(new bool[count]);
+    QPointF const *in = input.constData();
+    QPointF *out = output.data();
 
-    auto updateMinMax = [&](int x, int y)
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands(count, WCSChunkSize);
+    QAtomicInt error(0);
+    if (bands.size() <= 1)
+        error.store(convertWCSPoints(m_WCSHandle, toPixel, in, out, status.get(), count));
+    else
     {
-        int stat[2];
-        double imgcrd[2], phi, pixcrd[2], theta, world[2];
-
-        pixcrd[0] = x;
-        pixcrd[1] = y;
-
-        if (wcsp2s(m_WCSHandle, 1, 2, &pixcrd[0], &imgcrd[0], &phi, &theta, &world[0], &stat[0]))
-            return;
-
-        minRA = std::min(minRA, world[0]);
-        maxRA = std::max(maxRA, world[0]);
-        minDec = std::min(minDec, world[1]);
-        maxDec = std::max(maxDec, world[1]);
-    };
+        // wcslib keeps intermediate results in the solution, so each band works on its own copy.
+        wcsprm *handle = m_WCSHandle;
+        QtConcurrent::blockingMap(bands, [&](const QPair<int, int> &band)
+        {
+            wcsprm wcs;
+            wcs.flag = -1;
+            int rc = wcssub(1, handle, nullptr, nullptr, &wcs);
+            if (rc == 0)
+                rc = wcsset(&wcs);
+            if (rc == 0)
+                rc = convertWCSPoints(&wcs, toPixel, in + band.first, out + band.first, status.get() + band.first,
+                                      band.second - band.first);
+            wcsfree(&wcs);
+            if (rc != 0)
+                error.testAndSetRelaxed(0, rc);
+        });
+    }
 
-    // Find min and max values from edges
-    for (int y = 0; y < height(); y++)
+    const int errorCode = error.load();
+    if (errorCode != 0)
     {
-        updateMinMax(0, y);
-        updateMinMax(width() - 1, y);
+        m_LastError = QString("%1 error %2: %3.").arg(toPixel ? "wcss2p" : "wcsp2s").arg(errorCode).arg(wcs_errmsg[errorCode]);
+        return false;
     }
 
-    for (int x = 1; x < width() - 1; x++)
+    if (valid != nullptr)
     {
-        updateMinMax(x, 0);
-        updateMinMax(x, height() - 1);
+        valid->resize(count);
+        std::copy(status.get(), status.get() + count, valid->begin());
     }
 
-    // Check if either pole is in the image
-    SkyPoint NCP(0, 90);
-    SkyPoint SCP(0, -90);
-    QPointF pixelPoint, imagePoint, pPoint;
-    if (wcsToPixel(NCP, pPoint, imagePoint))
+    return true;
+}
+
+void FITSData::resetWCSCache()
+{
+    m_WCSGrid.clear();
+    m_WCSGridValid.clear();
+    m_WCSGridColumns = m_WCSGridRows = 0;
+    m_WCSBoundsReady = false;
+}
+
+void FITSData::buildWCSGrid()
+{
+    // Nodes every WCSGridStep pixels, the last column and row being on the image edges
+    m_WCSGridColumns = (width() - 1 + WCSGridStep - 1) / WCSGridStep + 1;
+    m_WCSGridRows = (height() - 1 + WCSGridStep - 1) / WCSGridStep + 1;
+
+    QVector<QPointF> nodes;
+    nodes.reserve(m_WCSGridColumns * m_WCSGridRows);
+    for (int row = 0; row < m_WCSGridRows; row++)
+        for (int column = 0; column < m_WCSGridColumns; column++)
+            nodes.append(QPointF(std::min(column * WCSGridStep, width() - 1), std::min(row * WCSGridStep, height() - 1)));
+
+    QVector<QPointF> world;
+    QVector<bool> valid;
+    if (!pixelsToWCS(nodes, world, &valid))
     {
-        if (pPoint.x() > 0 && pPoint.x() < width() && pPoint.y() > 0 && pPoint.y() < height())
-        {
-            maxDec = 90;
-        }
+        m_WCSGridColumns = m_WCSGridRows = 0;
+        return;
     }
-    if (wcsToPixel(SCP, pPoint, imagePoint))
+
+    // Unit vectors interpolate across the RA wrap and close to the poles
+    m_WCSGrid.resize(3 * nodes.size());
+    m_WCSGridValid.assign(valid.constBegin(), valid.constEnd());
+    for (int i = 0; i < nodes.size(); i++)
     {
-        if (pPoint.x() > 0 && pPoint.x() < width() && pPoint.y() > 0 && pPoint.y() < height())
-        {
-            minDec = -90;
-        }
+        const double ra = world[i].x() * dms::DegToRad, de = world[i].y() * dms::DegToRad;
+        m_WCSGrid[3 * i] = std::cos(de) * std::cos(ra);
+        m_WCSGrid[3 * i + 1] = std::cos(de) * std::sin(ra);
+        m_WCSGrid[3 * i + 2] = std::sin(de);
     }
-    return true;
 }
 #endif
 
+bool FITSData::wcsToPixels(const QVector<QPointF> &wcsCoords, QVector<QPointF> &wcsPixelPoints, QVector<bool> *valid)
+{
 #if !defined(KSTARS_LITE) && defined(HAVE_WCSLIB)
-bool FITSData::findObjectsInImage(SkyPoint startPoint, SkyPoint endPoint)
+    return convertWCS(true, wcsCoords, wcsPixelPoints, valid);
+#else
+    Q_UNUSED(wcsCoords);
+    Q_UNUSED(wcsPixelPoints);
+    Q_UNUSED(valid);
+    return false;
+#endif
+}
+
+bool FITSData::pixelsToWCS(const QVector<QPointF> &wcsPixelPoints, QVector<QPointF> &wcsCoords, QVector<bool> *valid)
 {
-    if (KStarsData::Instance() == nullptr)
+#if !defined(KSTARS_LITE) && defined(HAVE_WCSLIB)
+    return convertWCS(false, wcsPixelPoints, wcsCoords, valid);
+#else
+    Q_UNUSED(wcsPixelPoints);
+    Q_UNUSED(wcsCoords);
+    Q_UNUSED(valid);
+    return false;
+#endif
+}
+
+bool FITSData::interpolatePixelToWCS(const QPointF &wcsPixelPoint, SkyPoint &wcsCoord)
+{
+#if !defined(KSTARS_LITE) && defined(HAVE_WCSLIB)
+    if (m_WCSHandle == nullptr)
+    {
+        m_LastError = i18n("No world coordinate systems found.");
         return false;
+    }
 
-    int w = width();
-    int h = height();
-    QVariant date;
-    KSNumbers * num = nullptr;
+    if (m_WCSGridColumns == 0)
+        buildWCSGrid();
 
-    if (getRecordValue("DATE-OBS", date))
+    const double x = wcsPixelPoint.x(), y = wcsPixelPoint.y();
+    if (m_WCSGridColumns < 2 || m_WCSGridRows < 2 || x < 0 || y < 0 || x > width() - 1 || y > height() - 1)
+        return pixelToWCS(wcsPixelPoint, wcsCoord);
+
+    const int column = std::min(static_cast<int>(x) / WCSGridStep, m_WCSGridColumns - 2);
+    const int row = std::min(static_cast<int>(y) / WCSGridStep, m_WCSGridRows - 2);
+    const int corners[4] = { row * m_WCSGridColumns + column, row * m_WCSGridColumns + column + 1,
+                             (row + 1) * m_WCSGridColumns + column, (row + 1) * m_WCSGridColumns + column + 1
+                           };
+    for (int corner : corners)
     {
-        QString tsString(date.toString());
-        tsString = tsString.remove('\'').trimmed();
-        // Add Zulu time to indicate UTC
-        tsString += "Z";
+        if (!m_WCSGridValid[corner])
+            return pixelToWCS(wcsPixelPoint, wcsCoord);
+    }
 
-        QDateTime ts = QDateTime::fromString(tsString, Qt::ISODate);
+    // The last cells are narrower when the size is not a multiple of the step
+    const double x0 = column * WCSGridStep, y0 = row * WCSGridStep;
+    const double fx = (x - x0) / (std::min<double>(x0 + WCSGridStep, width() - 1) - x0);
+    const double fy = (y - y0) / (std::min<double>(y0 + WCSGridStep, height() - 1) - y0);
+    const double weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
 
-        if (ts.isValid())
-            num = new KSNumbers(KStarsDateTime(ts).djd());
-    }
+    double v[3] = { 0, 0, 0 };
+    for (int i = 0; i < 4; i++)
+        for (int axis = 0; axis < 3; axis++)
+            v[axis] += weights[i] * m_WCSGrid[3 * corners[i] + axis];
 
-    //Set to current time if the above does not work.
-    if (num == nullptr)
-        num = new KSNumbers(KStarsData::Instance()->ut().djd());
+    double ra = std::atan2(v[1], v[0]) / dms::DegToRad;
+    if (ra < 0)
+        ra += 360;
+    const double de = std::atan2(v[2], std::hypot(v[0], v[1])) / dms::DegToRad;
+
+    wcsCoord.setRA0(ra / 15.0);
+    wcsCoord.setDec0(de);
+    return true;
+#else
+    Q_UNUSED(wcsPixelPoint);
+    Q_UNUSED(wcsCoord);
+    return false;
+#endif
+}
+
+#if !defined(KSTARS_LITE) && defined(HAVE_WCSLIB)
+bool FITSData::searchObjects()
+{
+    if (m_ObjectsSearched)
+        return true;
+
+    m_ObjectsSearched = true;
+
+    SkyPoint startPoint;
+    SkyPoint endPoint;
+
+    pixelToWCS(QPointF(0, 0), startPoint);
+    pixelToWCS(QPointF(width() - 1, height() - 1), endPoint);
+
+    return findObjectsInImage(startPoint, endPoint);
+}
+
+bool FITSData::findWCSBounds(double &minRA, double &maxRA, double &minDec, double &maxDec)
+{
+    if (m_WCSHandle == nullptr)
+    {
+        m_LastError = i18n("No world coordinate systems found.");
+        return false;
+    }
+
+    if (m_WCSBoundsReady)
+    {
+        minRA = m_WCSBounds[0];
+        maxRA = m_WCSBounds[1];
+        minDec = m_WCSBounds[2];
+        maxDec = m_WCSBounds[3];
+        return true;
+    }
+
+    maxRA  = -1000;
+    minRA  = 1000;
+    maxDec = -1000;
+    minDec = 1000;
+
+    // Find min and max values from edges, converted in one batch
+    QVector<QPointF> edges;
+    edges.reserve(2 * (width() + height()));
+    for (int y = 0; y < height(); y++)
+    {
+        edges.append(QPointF(0, y));
+        edges.append(QPointF(width() - 1, y));
+    }
+
+    for (int x = 1; x < width() - 1; x++)
+    {
+        edges.append(QPointF(x, 0));
+        edges.append(QPointF(x, height() - 1));
+    }
+
+    QVector<QPointF> world;
+    QVector<bool> valid;
+    if (!pixelsToWCS(edges, world, &valid))
+        return false;
+
+    for (int i = 0; i < world.size(); i++)
+    {
+        if (!valid[i])
+            continue;
+
+        minRA = std::min(minRA, world[i].x());
+        maxRA = std::max(maxRA, world[i].x());
+        minDec = std::min(minDec, world[i].y());
+        maxDec = std::max(maxDec, world[i].y());
+    }
+
+    // Check if either pole is in the image
+    SkyPoint NCP(0, 90);
+    SkyPoint SCP(0, -90);
+    QPointF pixelPoint, imagePoint, pPoint;
+    if (wcsToPixel(NCP, pPoint, imagePoint))
+    {
+        if (pPoint.x() > 0 && pPoint.x() < width() && pPoint.y() > 0 && pPoint.y() < height())
+        {
+            maxDec = 90;
+        }
+    }
+    if (wcsToPixel(SCP, pPoint, imagePoint))
+    {
+        if (pPoint.x() > 0 && pPoint.x() < width() && pPoint.y() > 0 && pPoint.y() < height())
+        {
+            minDec = -90;
+        }
+    }
+
+    // The solution does not change until it is reloaded
+    m_WCSBounds[0] = minRA;
+    m_WCSBounds[1] = maxRA;
+    m_WCSBounds[2] = minDec;
+    m_WCSBounds[3] = maxDec;
+    m_WCSBoundsReady = true;
+    return true;
+}
+#endif
+
+#if !defined(KSTARS_LITE) && defined(HAVE_WCSLIB)
+bool FITSData::findObjectsInImage(SkyPoint startPoint, SkyPoint endPoint)
+{
+    if (KStarsData::Instance() == nullptr)
+        return false;
+
+    int w = width();
+    int h = height();
+    QVariant date;
+    KSNumbers * num = nullptr;
+
+    if (getRecordValue("DATE-OBS", date))
+    {
+        QString tsString(date.toString());
+        tsString = tsString.remove('\'').trimmed();
+        // Add Zulu time to indicate UTC
+        tsString += "Z";
+
+        QDateTime ts = QDateTime::fromString(tsString, Qt::ISODate);
+
+        if (ts.isValid())
+            num = new KSNumbers(KStarsDateTime(ts).djd());
+    }
+
+    //Set to current time if the above does not work.
+    if (num == nullptr)
+        num = new KSNumbers(KStarsData::Instance()->ut().djd());
 
     startPoint.updateCoordsNow(num);
     endPoint.updateCoordsNow(num);
@@ -2621,20 +3249,24 @@ bool FITSData::findObjectsInImage(SkyPoint startPoint, SkyPoint endPoint)
                 type == SkyObject::SATELLITE);
     }), list.end());
 
-    double world[2], phi, theta, imgcrd[2], pixcrd[2];
-    int stat[2];
+    QVector<QPointF> world, pixels;
+    QVector<bool> valid;
+    world.reserve(list.size());
     for (auto &object : list)
-    {
-        world[0] = object->ra0().Degrees();
-        world[1] = object->dec0().Degrees();
+        world.append(QPointF(object->ra0().Degrees(), object->dec0().Degrees()));
 
-        if (wcss2p(m_WCSHandle, 1, 2, &world[0], &phi, &theta, &imgcrd[0], &pixcrd[0], &stat[0]) == 0)
+    if (wcsToPixels(world, pixels, &valid))
+    {
+        for (int i = 0; i < list.size(); i++)
         {
+            if (!valid[i])
+                continue;
+
             //The X and Y are set to the found position if it does work.
-            int x = pixcrd[0];
-            int y = pixcrd[1];
+            int x = pixels[i].x();
+            int y = pixels[i].y();
             if (x > 0 && y > 0 && x < w && y < h)
-                m_SkyObjects.append(new FITSSkyObject(object, x, y));
+                m_SkyObjects.append(new FITSSkyObject(list[i], x, y));
         }
     }
 
@@ -2673,260 +3305,213 @@ void FITSData::setRotCounter(int value)
     rotCounter = value;
 }
 
-/* Rotate an image by 90, 180, or 270 degrees, with an optional
- * reflection across the vertical or horizontal axis.
- * verbose generates extra info on stdout.
- * return nullptr if successful or rotated image.
- */
+namespace
+{
+// Edge of the square tiles planes are transposed by. A source and a destination tile
+// of at most 32 KiB each stay in cache while the tile is transposed.
 template <typename T>
-bool FITSData::rotFITS(int rotate, int mirror)
+constexpr int transposeTileSize()
 {
-    int ny, nx;
-    int x1, y1, x2, y2;
-    uint8_t * rotimage = nullptr;
-    int offset        = 0;
-
-    if (rotate == 1)
-        rotate = 90;
-    else if (rotate == 2)
-        rotate = 180;
-    else if (rotate == 3)
-        rotate = 270;
-    else if (rotate < 0)
-        rotate = rotate + 360;
-
-    nx = m_Statistics.width;
-    ny = m_Statistics.height;
-
-    int BBP = m_Statistics.bytesPerPixel;
-
-    /* Allocate buffer for rotated image */
-    rotimage = new uint8_t[m_Statistics.samples_per_channel * m_Statistics.channels * BBP];
-
-    if (rotimage == nullptr)
-    {
-        qWarning() << "Unable to allocate memory for rotated image buffer!";
-        return false;
-    }
+    return sizeof(T) <= 2 ? 128 : 64;
+}
 
-    auto * rotBuffer = reinterpret_cast<T *>(rotimage);
-    auto * buffer    = reinterpret_cast<T *>(m_ImageBuffer);
+// Mirror a plane in place, swapping pixels pairwise.
+template <typename T>
+void mirrorPlane(T *plane, int width, int height, bool horizontal, bool vertical)
+{
+    if (!horizontal && !vertical)
+        return;
 
-    /* Mirror image without rotation */
-    if (rotate < 45 && rotate > -45)
+    // When mirroring vertically, row y is swapped with its opposite row, so only the top half is visited.
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands(vertical ? (height + 1) / 2 : height);
+    QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
     {
-        if (mirror == 1)
+        for (int y = band.first; y < band.second; y++)
         {
-            for (int i = 0; i < m_Statistics.channels; i++)
-            {
-                offset = m_Statistics.samples_per_channel * i;
-                for (x1 = 0; x1 < nx; x1++)
-                {
-                    x2 = nx - x1 - 1;
-                    for (y1 = 0; y1 < ny; y1++)
-                        rotBuffer[(y1 * nx) + x2 + offset] = buffer[(y1 * nx) + x1 + offset];
-                }
-            }
-        }
-        else if (mirror == 2)
-        {
-            for (int i = 0; i < m_Statistics.channels; i++)
+            T *top = plane + static_cast<size_t>(y) * width;
+            T *bottom = plane + static_cast<size_t>(height - 1 - y) * width;
+
+            if (!vertical)
+                std::reverse(top, top + width);
+            else if (top == bottom)
             {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    y2 = ny - y1 - 1;
-                    for (x1 = 0; x1 < nx; x1++)
-                        rotBuffer[(y2 * nx) + x1 + offset] = buffer[(y1 * nx) + x1 + offset];
-                }
+                // Middle row of an odd height
+                if (horizontal)
+                    std::reverse(top, top + width);
             }
-        }
-        else
-        {
-            for (int i = 0; i < m_Statistics.channels; i++)
+            else if (horizontal)
             {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    for (x1 = 0; x1 < nx; x1++)
-                        rotBuffer[(y1 * nx) + x1 + offset] = buffer[(y1 * nx) + x1 + offset];
-                }
+                for (int x = 0; x < width; x++)
+                    std::swap(top[x], bottom[width - 1 - x]);
             }
+            else
+                std::swap_ranges(top, top + width, bottom);
         }
-    }
+    });
+}
 
-    /* Rotate by 90 degrees */
-    else if (rotate >= 45 && rotate < 135)
+// Transpose a width x height plane into a height x width one, mirroring the result on the fly.
+template <typename T>
+void transposePlane(T const *source, T *destination, int width, int height, bool horizontal, bool vertical)
+{
+    const int tile = transposeTileSize<T>();
+
+    // Each band produces a range of destination rows, i.e. reads a range of source columns.
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands(width, tile);
+    QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
     {
-        if (mirror == 1)
+        for (int y0 = 0; y0 < height; y0 += tile)
         {
-            for (int i = 0; i < m_Statistics.channels; i++)
+            const int y1 = std::min(y0 + tile, height);
+            for (int x0 = band.first; x0 < band.second; x0 += tile)
             {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
+                const int x1 = std::min(x0 + tile, band.second);
+                for (int x = x0; x < x1; x++)
                 {
-                    x2 = ny - y1 - 1;
-                    for (x1 = 0; x1 < nx; x1++)
+                    T const *in = source + x;
+                    T *out = destination + static_cast<size_t>(vertical ? width - 1 - x : x) * height;
+                    if (horizontal)
                     {
-                        y2                                 = nx - x1 - 1;
-                        rotBuffer[(y2 * ny) + x2 + offset] = buffer[(y1 * nx) + x1 + offset];
+                        for (int y = y0; y < y1; y++)
+                            out[height - 1 - y] = in[static_cast<size_t>(y) * width];
                     }
-                }
-            }
-        }
-        else if (mirror == 2)
-        {
-            for (int i = 0; i < m_Statistics.channels; i++)
-            {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    for (x1 = 0; x1 < nx; x1++)
-                        rotBuffer[(x1 * ny) + y1 + offset] = buffer[(y1 * nx) + x1 + offset];
-                }
-            }
-        }
-        else
-        {
-            for (int i = 0; i < m_Statistics.channels; i++)
-            {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    x2 = ny - y1 - 1;
-                    for (x1 = 0; x1 < nx; x1++)
+                    else
                     {
-                        y2                                 = x1;
-                        rotBuffer[(y2 * ny) + x2 + offset] = buffer[(y1 * nx) + x1 + offset];
+                        for (int y = y0; y < y1; y++)
+                            out[y] = in[static_cast<size_t>(y) * width];
                     }
                 }
             }
         }
+    });
+}
 
-        m_Statistics.width  = ny;
-        m_Statistics.height = nx;
-    }
+// Transpose a square plane in place, swapping tiles across the diagonal.
+template <typename T>
+void transposeSquarePlane(T *plane, int size)
+{
+    const int tile = transposeTileSize<T>();
 
-    /* Rotate by 180 degrees */
-    else if (rotate >= 135 && rotate < 225)
+    QVector<int> tileRows;
+    for (int y0 = 0; y0 < size; y0 += tile)
+        tileRows.append(y0);
+
+    QtConcurrent::blockingMap(tileRows, [ = ](int y0)
     {
-        if (mirror == 1)
-        {
-            for (int i = 0; i < m_Statistics.channels; i++)
-            {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    y2 = ny - y1 - 1;
-                    for (x1 = 0; x1 < nx; x1++)
-                        rotBuffer[(y2 * nx) + x1 + offset] = buffer[(y1 * nx) + x1 + offset];
-                }
-            }
-        }
-        else if (mirror == 2)
-        {
-            for (int i = 0; i < m_Statistics.channels; i++)
-            {
-                offset = m_Statistics.samples_per_channel * i;
-                for (x1 = 0; x1 < nx; x1++)
-                {
-                    x2 = nx - x1 - 1;
-                    for (y1 = 0; y1 < ny; y1++)
-                        rotBuffer[(y1 * nx) + x2 + offset] = buffer[(y1 * nx) + x1 + offset];
-                }
-            }
-        }
-        else
+        const int y1 = std::min(y0 + tile, size);
+        for (int x0 = y0; x0 < size; x0 += tile)
         {
-            for (int i = 0; i < m_Statistics.channels; i++)
+            const int x1 = std::min(x0 + tile, size);
+            for (int y = y0; y < y1; y++)
             {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    y2 = ny - y1 - 1;
-                    for (x1 = 0; x1 < nx; x1++)
-                    {
-                        x2                                 = nx - x1 - 1;
-                        rotBuffer[(y2 * nx) + x2 + offset] = buffer[(y1 * nx) + x1 + offset];
-                    }
-                }
+                T *row = plane + static_cast<size_t>(y) * size;
+                for (int x = std::max(x0, y + 1); x < x1; x++)
+                    std::swap(row[x], plane[static_cast<size_t>(x) * size + y]);
             }
         }
-    }
+    });
+}
+}
 
+/* Rotate an image by 90, 180, or 270 degrees, with an optional
+ * reflection across the vertical (mirror 1) or horizontal (mirror 2) axis.
+ * Every combination is a transpose followed by horizontal and/or vertical
+ * mirroring. Mirroring and square transposes are done in place, other
+ * transposes go through a single pooled scratch plane.
+ */
+template <typename T>
+bool FITSData::rotFITS(int rotate, int mirror)
+{
+    if (rotate == 1)
+        rotate = 90;
+    else if (rotate == 2)
+        rotate = 180;
+    else if (rotate == 3)
+        rotate = 270;
+    else if (rotate < 0)
+        rotate = rotate + 360;
+
+    bool transpose = false, horizontal = false, vertical = false;
+
+    /* Mirror image without rotation */
+    if (rotate < 45 && rotate > -45)
+    {
+        horizontal = (mirror == 1);
+        vertical   = (mirror == 2);
+    }
+    /* Rotate by 90 degrees */
+    else if (rotate >= 45 && rotate < 135)
+    {
+        transpose  = true;
+        horizontal = (mirror != 2);
+        vertical   = (mirror == 1);
+    }
+    /* Rotate by 180 degrees */
+    else if (rotate >= 135 && rotate < 225)
+    {
+        horizontal = (mirror != 1);
+        vertical   = (mirror != 2);
+    }
     /* Rotate by 270 degrees */
     else if (rotate >= 225 && rotate < 315)
     {
-        if (mirror == 1)
+        transpose  = true;
+        horizontal = (mirror == 2);
+        vertical   = (mirror != 1);
+    }
+    /* If rotating by more than 315 degrees, assume top-bottom reflection */
+    else if (rotate >= 315 && mirror)
+        transpose = true;
+
+    if (!transpose && !horizontal && !vertical)
+        return true;
+
+    const int nx = m_Statistics.width;
+    const int ny = m_Statistics.height;
+    const uint32_t samples = m_Statistics.samples_per_channel;
+    auto * buffer = reinterpret_cast<T *>(m_ImageBuffer);
+
+    if (!transpose || nx == ny)
+    {
+        for (int i = 0; i < m_Statistics.channels; i++)
         {
-            for (int i = 0; i < m_Statistics.channels; i++)
-            {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    for (x1 = 0; x1 < nx; x1++)
-                        rotBuffer[(x1 * ny) + y1 + offset] = buffer[(y1 * nx) + x1 + offset];
-                }
-            }
+            T *plane = buffer + static_cast<size_t>(samples) * i;
+            if (transpose)
+                transposeSquarePlane(plane, nx);
+            mirrorPlane(plane, nx, ny, horizontal, vertical);
         }
-        else if (mirror == 2)
+    }
+    else
+    {
+        auto * scratch = FITSBufferPool::Instance()->acquire(samples * sizeof(T));
+        if (scratch == nullptr)
+            return false;
+
+        if (m_Statistics.channels == 1)
         {
-            for (int i = 0; i < m_Statistics.channels; i++)
-            {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    x2 = ny - y1 - 1;
-                    for (x1 = 0; x1 < nx; x1++)
-                    {
-                        y2                                 = nx - x1 - 1;
-                        rotBuffer[(y2 * ny) + x2 + offset] = buffer[(y1 * nx) + x1 + offset];
-                    }
-                }
-            }
+            // The transposed plane becomes the image buffer, and the original goes back to the pool
+            transposePlane(buffer, reinterpret_cast<T *>(scratch), nx, ny, horizontal, vertical);
+            clearImageBuffers();
+            m_ImageBuffer = scratch;
         }
         else
         {
             for (int i = 0; i < m_Statistics.channels; i++)
             {
-                offset = m_Statistics.samples_per_channel * i;
-                for (y1 = 0; y1 < ny; y1++)
-                {
-                    x2 = y1;
-                    for (x1 = 0; x1 < nx; x1++)
-                    {
-                        y2                                 = nx - x1 - 1;
-                        rotBuffer[(y2 * ny) + x2 + offset] = buffer[(y1 * nx) + x1 + offset];
-                    }
-                }
+                T *plane = buffer + static_cast<size_t>(samples) * i;
+                transposePlane(plane, reinterpret_cast<T *>(scratch), nx, ny, horizontal, vertical);
+                memcpy(plane, scratch, samples * sizeof(T));
             }
+            FITSBufferPool::Instance()->release(scratch);
         }
-
-        m_Statistics.width  = ny;
-        m_Statistics.height = nx;
     }
 
-    /* If rotating by more than 315 degrees, assume top-bottom reflection */
-    else if (rotate >= 315 && mirror)
+    if (transpose)
     {
-        for (int i = 0; i < m_Statistics.channels; i++)
-        {
-            offset = m_Statistics.samples_per_channel * i;
-            for (y1 = 0; y1 < ny; y1++)
-            {
-                for (x1 = 0; x1 < nx; x1++)
-                {
-                    x2                                 = y1;
-                    y2                                 = x1;
-                    rotBuffer[(y2 * ny) + x2 + offset] = buffer[(y1 * nx) + x1 + offset];
-                }
-            }
-        }
+        m_Statistics.width  = ny;
+        m_Statistics.height = nx;
     }
 
-    delete[] m_ImageBuffer;
-    m_ImageBuffer = rotimage;
-
     return true;
 }
 
@@ -3215,6 +3800,11 @@ void FITSData::rotWCSFITS(int angle, int mirror)
 
 uint8_t * FITSData::getWritableImageBuffer()
 {
+    emit dataAboutToChange();
+    detachImageBuffer();
+    m_ValueCountsUpdatable = m_PercentilesReady;
+    m_PercentilesReady = false;
+    clearIntegralImages();
     return m_ImageBuffer;
 }
 
@@ -3225,7 +3815,7 @@ uint8_t const * FITSData::getImageBuffer() const
 
 void FITSData::setImageBuffer(uint8_t * buffer)
 {
-    delete[] m_ImageBuffer;
+    clearImageBuffers();
     m_ImageBuffer = buffer;
 }
 
@@ -3332,10 +3922,38 @@ void FITSData::setBayerParams(BayerParams * param)
 
 bool FITSData::debayer(bool reload)
 {
+    emit dataAboutToChange();
+    m_PercentilesReady = false;
+    clearIntegralImages();
+
     if (reload)
     {
         int anynull = 0, status = 0;
 
+        // A super-pixel debayer halved the image, read it again at the size of the mosaic
+        if (m_isSuperPixel)
+        {
+            long naxes[2] = {0, 0};
+            if (fits_get_img_size(fptr, 2, naxes, &status))
+                return false;
+            m_Statistics.width = naxes[0];
+            m_Statistics.height = naxes[1];
+            m_Statistics.samples_per_channel = m_Statistics.width * m_Statistics.height;
+            m_isSuperPixel = false;
+        }
+
+        detachImageBuffer();
+
+        const uint32_t size = m_Statistics.samples_per_channel * m_Statistics.bytesPerPixel;
+        if (m_ImageBufferSize < size)
+        {
+            clearImageBuffers();
+            m_ImageBuffer = FITSBufferPool::Instance()->acquire(size);
+            if (m_ImageBuffer == nullptr)
+                return false;
+            m_ImageBufferSize = size;
+        }
+
         if (fits_read_img(fptr, m_Statistics.dataType, 1, m_Statistics.samples_per_channel, nullptr, m_ImageBuffer,
                           &anynull, &status))
         {
@@ -3361,174 +3979,181 @@ bool FITSData::debayer(bool reload)
 
 bool FITSData::debayer_8bit()
 {
-    dc1394error_t error_code;
+    return debayer<uint8_t>();
+}
 
-    uint32_t rgb_size = m_Statistics.samples_per_channel * 3 * m_Statistics.bytesPerPixel;
-    uint8_t * destinationBuffer = nullptr;
+bool FITSData::debayer_16bit()
+{
+    return debayer<uint16_t>();
+}
 
-    try
-    {
-        destinationBuffer = new uint8_t[rgb_size];
-    }
-    catch (const std::bad_alloc &e)
+template <typename T>
+bool FITSData::debayer()
+{
+    const int width = m_Statistics.width;
+    int height = m_Statistics.height;
+    auto const * source = reinterpret_cast<T const *>(m_ImageBuffer);
+
+    if (debayerParams.offsetY == 1)
     {
-        KSNotification::error(i18n("Unable to allocate memory for temporary bayer buffer: %1", e.what()), i18n("Debayer error"));
-        return false;
+        source += width;
+        height--;
     }
+    // offsetX == 1 is handled in checkDebayer() and should be 0 here.
 
-    auto * bayer_source_buffer      = reinterpret_cast<uint8_t *>(m_ImageBuffer);
-    auto * bayer_destination_buffer = reinterpret_cast<uint8_t *>(destinationBuffer);
+    if (debayerParams.method == DC1394_BAYER_METHOD_DOWNSAMPLE)
+        return debayerSuperPixel<T>(source, width, height);
 
-    if (bayer_destination_buffer == nullptr)
+    const uint32_t samples = m_Statistics.samples_per_channel;
+    const uint32_t rgb_size = samples * 3 * sizeof(T);
+    uint8_t * destinationBuffer = FITSBufferPool::Instance()->acquire(rgb_size);
+    if (destinationBuffer == nullptr)
     {
         KSNotification::error(i18n("Unable to allocate memory for temporary bayer buffer."), i18n("Debayer error"));
         return false;
     }
 
-    int ds1394_height = m_Statistics.height;
-    auto dc1394_source = bayer_source_buffer;
+    auto * planes = reinterpret_cast<T *>(destinationBuffer);
 
-    if (debayerParams.offsetY == 1)
+    // The row skipped by the Y offset has no color information
+    if (height < m_Statistics.height)
     {
-        dc1394_source += m_Statistics.width;
-        ds1394_height--;
+        for (int n = 0; n < 3; n++)
+            std::fill_n(planes + n * samples + height * width, width, 0);
     }
-    // offsetX == 1 is handled in checkDebayer() and should be 0 here.
 
-    error_code = dc1394_bayer_decoding_8bit(dc1394_source, bayer_destination_buffer, m_Statistics.width, ds1394_height,
-                                            debayerParams.filter,
-                                            debayerParams.method);
+    // Bands hold an even number of rows to keep the phase of the Bayer pattern. They are decoded with
+    // enough rows of context for their own rows to come out as if the whole image was decoded at once.
+    // AHD works on large internal tiles, so it still decodes the whole image in one go.
+    const dc1394bayer_method_t method = debayerParams.method;
+    const dc1394color_filter_t filter = debayerParams.filter;
+    const int margin = (method == DC1394_BAYER_METHOD_AHD) ? 0 : DebayerBandMargin;
+    const int nBands = (method == DC1394_BAYER_METHOD_AHD) ? 1 :
+                       qBound(1, height / 64, QThreadPool::globalInstance()->maxThreadCount() * 4);
+    const int bandSize = (((height + nBands - 1) / nBands) + 1) & ~1;
 
-    if (error_code != DC1394_SUCCESS)
-    {
-        KSNotification::error(i18n("Debayer failed (%1)", error_code), i18n("Debayer error"));
-        m_Statistics.channels = 1;
-        delete[] destinationBuffer;
-        return false;
-    }
+    QVector<QPair<int, int>> bands;
+    for (int start = 0; start < height; start += bandSize)
+        bands.append(qMakePair(start, qMin(height, start + bandSize)));
 
-    if (m_ImageBufferSize != rgb_size)
+    QAtomicInt error_code(DC1394_SUCCESS);
+    QtConcurrent::blockingMap(bands, [&](const QPair<int, int> &band)
     {
-        delete[] m_ImageBuffer;
-        try
+        const int first = qMax(0, band.first - margin);
+        const int last = qMin(height, band.second + margin);
+
+        std::vector<T> rgb(static_cast<size_t>(width) * (last - first) * 3);
+        const dc1394error_t error = bayerDecode(source + static_cast<size_t>(first) * width, rgb.data(), width,
+                                                last - first, filter, method);
+        if (error != DC1394_SUCCESS)
         {
-            m_ImageBuffer = new uint8_t[rgb_size];
+            error_code.testAndSetRelaxed(DC1394_SUCCESS, error);
+            return;
         }
-        catch (const std::bad_alloc &e)
+
+        // Data in R1G1B1, we need to copy them into 3 layers for FITS
+        T const * in = rgb.data() + static_cast<size_t>(band.first - first) * width * 3;
+        T * rBuff = planes + static_cast<size_t>(band.first) * width;
+        T * gBuff = rBuff + samples;
+        T * bBuff = gBuff + samples;
+        const size_t count = static_cast<size_t>(band.second - band.first) * width;
+        for (size_t i = 0; i < count; i++)
         {
-            delete[] destinationBuffer;
-            KSNotification::error(i18n("Unable to allocate memory for temporary bayer buffer: %1", e.what()), i18n("Debayer error"));
-            return false;
+            rBuff[i] = in[i * 3];
+            gBuff[i] = in[i * 3 + 1];
+            bBuff[i] = in[i * 3 + 2];
         }
+    });
 
-        m_ImageBufferSize = rgb_size;
-    }
-
-    auto bayered_buffer = reinterpret_cast<uint8_t *>(m_ImageBuffer);
-
-    // Data in R1G1B1, we need to copy them into 3 layers for FITS
-
-    uint8_t * rBuff = bayered_buffer;
-    uint8_t * gBuff = bayered_buffer + (m_Statistics.width * m_Statistics.height);
-    uint8_t * bBuff = bayered_buffer + (m_Statistics.width * m_Statistics.height * 2);
-
-    int imax = m_Statistics.samples_per_channel * 3 - 3;
-    for (int i = 0; i <= imax; i += 3)
+    if (error_code.load() != DC1394_SUCCESS)
     {
-        *rBuff++ = bayer_destination_buffer[i];
-        *gBuff++ = bayer_destination_buffer[i + 1];
-        *bBuff++ = bayer_destination_buffer[i + 2];
+        KSNotification::error(i18n("Debayer failed (%1)", error_code.load()), i18n("Debayer error"));
+        m_Statistics.channels = 1;
+        FITSBufferPool::Instance()->release(destinationBuffer);
+        return false;
     }
 
+    clearImageBuffers();
+    m_ImageBuffer = destinationBuffer;
+    m_ImageBufferSize = rgb_size;
+
     m_Statistics.channels = (m_Mode == FITS_NORMAL) ? 3 : 1;
-    m_Statistics.dataType = TBYTE;
-    delete[] destinationBuffer;
+    m_Statistics.dataType = std::is_same<T, uint8_t>::value ? TBYTE : TUSHORT;
     return true;
 }
 
-bool FITSData::debayer_16bit()
+template <typename T>
+bool FITSData::debayerSuperPixel(T const * source, int width, int height)
 {
-    dc1394error_t error_code;
-
-    uint32_t rgb_size = m_Statistics.samples_per_channel * 3 * m_Statistics.bytesPerPixel;
-    uint8_t *destinationBuffer = nullptr;
-    try
-    {
-        destinationBuffer = new uint8_t[rgb_size];
-    }
-    catch (const std::bad_alloc &e)
-    {
-        KSNotification::error(i18n("Unable to allocate memory for temporary bayer buffer: %1", e.what()), i18n("Debayer error"));
+    const int outWidth = width / 2;
+    const int outHeight = height / 2;
+    if (outWidth == 0 || outHeight == 0)
         return false;
-    }
-
-    auto * bayer_source_buffer      = reinterpret_cast<uint16_t *>(m_ImageBuffer);
-    auto * bayer_destination_buffer = reinterpret_cast<uint16_t *>(destinationBuffer);
 
-    if (bayer_destination_buffer == nullptr)
+    const uint32_t samples = static_cast<uint32_t>(outWidth) * outHeight;
+    const uint32_t rgb_size = samples * 3 * sizeof(T);
+    uint8_t * destinationBuffer = FITSBufferPool::Instance()->acquire(rgb_size);
+    if (destinationBuffer == nullptr)
     {
         KSNotification::error(i18n("Unable to allocate memory for temporary bayer buffer."), i18n("Debayer error"));
         return false;
     }
 
-    int ds1394_height = m_Statistics.height;
-    auto dc1394_source = bayer_source_buffer;
-
-    if (debayerParams.offsetY == 1)
+    // Offsets of the red, blue and both green samples in each 2x2 cell of the mosaic
+    int red = 0, green1 = 1, green2 = width, blue = width + 1;
+    switch (debayerParams.filter)
     {
-        dc1394_source += m_Statistics.width;
-        ds1394_height--;
-    }
-    // offsetX == 1 is handled in checkDebayer() and should be 0 here.
-
-    error_code = dc1394_bayer_decoding_16bit(dc1394_source, bayer_destination_buffer, m_Statistics.width, ds1394_height,
-                 debayerParams.filter,
-                 debayerParams.method, 16);
-
-    if (error_code != DC1394_SUCCESS)
-    {
-        KSNotification::error(i18n("Debayer failed (%1)", error_code), i18n("Debayer error"));
-        m_Statistics.channels = 1;
-        delete[] destinationBuffer;
-        return false;
+        case DC1394_COLOR_FILTER_GBRG:
+            green1 = 0;
+            blue = 1;
+            red = width;
+            green2 = width + 1;
+            break;
+        case DC1394_COLOR_FILTER_GRBG:
+            green1 = 0;
+            red = 1;
+            blue = width;
+            green2 = width + 1;
+            break;
+        case DC1394_COLOR_FILTER_BGGR:
+            blue = 0;
+            green1 = 1;
+            green2 = width;
+            red = width + 1;
+            break;
+        default:
+            break;
     }
 
-    if (m_ImageBufferSize != rgb_size)
+    auto * planes = reinterpret_cast<T *>(destinationBuffer);
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands(outHeight);
+    QtConcurrent::blockingMap(bands, [ = ](const QPair<int, int> &band)
     {
-        delete[] m_ImageBuffer;
-        try
+        for (int y = band.first; y < band.second; y++)
         {
-            m_ImageBuffer = new uint8_t[rgb_size];
-        }
-        catch (const std::bad_alloc &e)
-        {
-            delete[] destinationBuffer;
-            KSNotification::error(i18n("Unable to allocate memory for temporary bayer buffer: %1", e.what()), i18n("Debayer error"));
-            return false;
+            T const * cell = source + static_cast<size_t>(2 * y) * width;
+            T * rBuff = planes + static_cast<size_t>(y) * outWidth;
+            T * gBuff = rBuff + samples;
+            T * bBuff = gBuff + samples;
+            for (int x = 0; x < outWidth; x++, cell += 2)
+            {
+                rBuff[x] = cell[red];
+                gBuff[x] = (static_cast<uint32_t>(cell[green1]) + cell[green2] + 1) / 2;
+                bBuff[x] = cell[blue];
+            }
         }
+    });
 
-        m_ImageBufferSize = rgb_size;
-    }
-
-    auto bayered_buffer = reinterpret_cast<uint16_t *>(m_ImageBuffer);
-
-    // Data in R1G1B1, we need to copy them into 3 layers for FITS
-
-    uint16_t * rBuff = bayered_buffer;
-    uint16_t * gBuff = bayered_buffer + (m_Statistics.width * m_Statistics.height);
-    uint16_t * bBuff = bayered_buffer + (m_Statistics.width * m_Statistics.height * 2);
-
-    int imax = m_Statistics.samples_per_channel * 3 - 3;
-    for (int i = 0; i <= imax; i += 3)
-    {
-        *rBuff++ = bayer_destination_buffer[i];
-        *gBuff++ = bayer_destination_buffer[i + 1];
-        *bBuff++ = bayer_destination_buffer[i + 2];
-    }
+    clearImageBuffers();
+    m_ImageBuffer = destinationBuffer;
+    m_ImageBufferSize = rgb_size;
 
+    m_Statistics.width = outWidth;
+    m_Statistics.height = outHeight;
+    m_Statistics.samples_per_channel = samples;
     m_Statistics.channels = (m_Mode == FITS_NORMAL) ? 3 : 1;
-    m_Statistics.dataType = TUSHORT;
-    delete[] destinationBuffer;
+    m_Statistics.dataType = std::is_same<T, uint8_t>::value ? TBYTE : TUSHORT;
+    m_isSuperPixel = true;
     return true;
 }
 
@@ -3912,139 +4537,107 @@ void FITSData::constructHistogram()
     }
 }
 
-template <typename T> void FITSData::constructHistogramInternal()
+namespace
 {
-    auto * const buffer = reinterpret_cast<T const *>(m_ImageBuffer);
-    uint32_t samples = m_Statistics.width * m_Statistics.height;
-    const uint32_t sampleBy = samples > 500000 ? samples / 500000 : 1;
+// Bounds of the number of histogram bins. Integer images get one bin per value up to the maximum.
+const int MinHistogramBins = 256;
+const int MaxHistogramBins = 4096;
 
-    m_HistogramBinCount = qMax(0., qMin(m_Statistics.max[0] - m_Statistics.min[0], 256.0));
-    if (m_HistogramBinCount <= 0)
-        m_HistogramBinCount = 256;
-
-    for (int n = 0; n < m_Statistics.channels; n++)
-    {
-        m_HistogramIntensity[n].fill(0, m_HistogramBinCount + 1);
-        m_HistogramFrequency[n].fill(0, m_HistogramBinCount + 1);
-        m_CumulativeFrequency[n].fill(0, m_HistogramBinCount + 1);
-        m_HistogramBinWidth[n] = qMax(1.0, (m_Statistics.max[n] - m_Statistics.min[n]) / (m_HistogramBinCount - 1));
-    }
-
-    QVector<QFuture<void>> futures;
+// Pixels of a channel counted by a single task into its own bins.
+struct HistogramPartition
+{
+    int channel;
+    QPair<int, int> rows;
+    std::vector<uint32_t> counts;
+};
+}
 
-    for (int n = 0; n < m_Statistics.channels; n++)
-    {
-        futures.append(QtConcurrent::run([ = ]()
+template <typename T> void FITSData::constructHistogramInternal()
+{
+    auto * const buffer = reinterpret_cast<T const *>(m_ImageBuffer);
+    const uint32_t width = m_Statistics.width;
+    const uint32_t samples = width * m_Statistics.height;
+    const int channels = m_Statistics.channels;
+
+    // Integer images keep one bin per value while their range allows it, and use wider integral bins beyond.
+    // Floating point images follow the Freedman-Diaconis rule, so that bins are narrow enough to show the
+    // background peak without the noise dominating the shape of the distribution.
+    int binCount = 1;
+    for (int n = 0; n < channels; n++)
+    {
+        const double range = m_Statistics.max[n] - m_Statistics.min[n];
+        if (std::is_integral<T>::value)
+            binCount = std::max(binCount, static_cast<int>(std::min<double>(range + 1, MaxHistogramBins)));
+        else
         {
-            for (int i = 0; i < m_HistogramBinCount; i++)
-                m_HistogramIntensity[n][i] = m_Statistics.min[n] + (m_HistogramBinWidth[n] * i);
-        }));
+            const double iqr = getPercentile(0.75, n) - getPercentile(0.25, n);
+            const double fdWidth = 2 * iqr / std::cbrt(static_cast<double>(samples));
+            const double bins = fdWidth > 0 ? std::ceil(range / fdWidth) : MinHistogramBins;
+            binCount = std::max(binCount, static_cast<int>(qBound<double>(MinHistogramBins, bins, MaxHistogramBins)));
+        }
     }
+    m_HistogramBinCount = binCount;
 
-    for (int n = 0; n < m_Statistics.channels; n++)
+    for (int n = 0; n < channels; n++)
     {
-        futures.append(QtConcurrent::run([ = ]()
-        {
-            uint32_t offset = n * samples;
+        const double range = m_Statistics.max[n] - m_Statistics.min[n];
+        if (std::is_integral<T>::value)
+            m_HistogramBinWidth[n] = std::max(1.0, std::ceil((range + 1) / binCount));
+        else
+            m_HistogramBinWidth[n] = range > 0 ? range / binCount : 1;
 
-            for (uint32_t i = 0; i < samples; i += sampleBy)
-            {
-                int32_t id = qMax(static_cast<T>(0), qMin(static_cast<T>(m_HistogramBinCount),
-                                  static_cast<T>(rint((buffer[i + offset] - m_Statistics.min[n]) / m_HistogramBinWidth[n]))));
-                m_HistogramFrequency[n][id] += sampleBy;
-            }
-        }));
+        m_HistogramIntensity[n].resize(binCount);
+        m_HistogramFrequency[n].fill(0, binCount);
+        m_CumulativeFrequency[n].resize(binCount);
+        for (int i = 0; i < binCount; i++)
+            m_HistogramIntensity[n][i] = m_Statistics.min[n] + m_HistogramBinWidth[n] * i;
     }
 
-    for (QFuture<void> future : futures)
-        future.waitForFinished();
-
-    futures.clear();
+    // Every channel is split in bands of rows, each counted into thread private bins so that tasks do not
+    // contend on shared counters, and the bins are summed afterwards.
+    QVector<HistogramPartition> partitions;
+    const QVector<QPair<int, int>> bands = FITSConvolution::rowBands(m_Statistics.height);
+    for (int n = 0; n < channels; n++)
+        for (const auto &band : bands)
+            partitions.append({n, band, std::vector<uint32_t>()});
 
-    for (int n = 0; n < m_Statistics.channels; n++)
+    QtConcurrent::blockingMap(partitions, [ = ](HistogramPartition & partition)
     {
-        futures.append(QtConcurrent::run([ = ]()
-        {
-            uint32_t accumulator = 0;
-            for (int i = 0; i < m_HistogramBinCount; i++)
-            {
-                accumulator += m_HistogramFrequency[n][i];
-                m_CumulativeFrequency[n].replace(i, accumulator);
-            }
-        }));
-    }
+        const int n = partition.channel;
+        const double minimum = m_Statistics.min[n];
+        const double binWidth = m_HistogramBinWidth[n];
+        const T * const end = buffer + n * samples + partition.rows.second * width;
 
-    for (QFuture<void> future : futures)
-        future.waitForFinished();
+        partition.counts.assign(binCount, 0);
+        uint32_t * const counts = partition.counts.data();
+        for (const T *pixel = buffer + n * samples + partition.rows.first * width; pixel < end; pixel++)
+        {
+            const double bin = (*pixel - minimum) / binWidth;
+            // NaN pixels fail both comparisons and are not counted
+            if (bin < binCount)
+                counts[bin > 0 ? static_cast<int>(bin) : 0]++;
+            else if (bin >= binCount)
+                counts[binCount - 1]++;
+        }
+    });
 
-    futures.clear();
+    for (const auto &partition : partitions)
+    {
+        QVector<double> &frequency = m_HistogramFrequency[partition.channel];
+        for (int i = 0; i < binCount; i++)
+            frequency[i] += partition.counts[i];
+    }
 
-#if 0
-    for (int n = 0; n < m_Statistics.channels; n++)
+    for (int n = 0; n < channels; n++)
     {
-        futures.append(QtConcurrent::run([ = ]()
+        uint32_t accumulator = 0;
+        for (int i = 0; i < binCount; i++)
         {
-            double median[3] = {0};
-            //const bool cutoffSpikes = ui->hideSaturated->isChecked();
-            const uint32_t halfCumulative = m_CumulativeFrequency[n][m_HistogramBinCount - 1] / 2;
-
-            // Find which bin contains the median.
-            int median_bin = -1;
-            for (int i = 0; i < m_HistogramBinCount; i++)
-            {
-                if (m_CumulativeFrequency[n][i] > halfCumulative)
-                {
-                    median_bin = i;
-                    break;
-                }
-            }
-
-            if (median_bin >= 0)
-            {
-                // The number of items in the median bin
-                const uint32_t median_bin_size = m_HistogramFrequency[n][median_bin] / sampleBy;
-                if (median_bin_size > 0)
-                {
-                    // The median is this element inside the sorted median_bin;
-                    const uint32_t samples_before_median_bin = median_bin == 0 ? 0 : m_CumulativeFrequency[n][median_bin - 1];
-                    uint32_t median_position = (halfCumulative - samples_before_median_bin) / sampleBy;
-
-                    if (median_position >= median_bin_size)
-                        median_position = median_bin_size - 1;
-                    if (median_position >= 0 && median_position < median_bin_size)
-                    {
-                        // Fill a vector with the values in the median bin (sampled by sampleBy).
-                        std::vector<T> median_bin_samples(median_bin_size);
-                        uint32_t upto = 0;
-                        const uint32_t offset = n * samples;
-                        for (uint32_t i = 0; i < samples; i += sampleBy)
-                        {
-                            if (upto >= median_bin_size) break;
-                            const int32_t id = rint((buffer[i + offset] - m_Statistics.min[n]) / m_HistogramBinWidth[n]);
-                            if (id == median_bin)
-                                median_bin_samples[upto++] = buffer[i + offset];
-                        }
-                        // Get the Nth value using N = the median position.
-                        if (upto > 0)
-                        {
-                            if (median_position >= upto) median_position = upto - 1;
-                            std::nth_element(median_bin_samples.begin(), median_bin_samples.begin() + median_position,
-                                             median_bin_samples.begin() + upto);
-                            median[n] = median_bin_samples[median_position];
-                        }
-                    }
-                }
-            }
-
-            setMedian(median[n], n);
-
-        }));
+            accumulator += m_HistogramFrequency[n][i];
+            m_CumulativeFrequency[n][i] = accumulator;
+        }
     }
 
-    for (QFuture<void> future : futures)
-        future.waitForFinished();
-#endif
-
     // Custom index to indicate the overall contrast of the image
     if (m_CumulativeFrequency[RED_CHANNEL][m_HistogramBinCount / 4] > 0)
         m_JMIndex = m_CumulativeFrequency[RED_CHANNEL][m_HistogramBinCount / 8] / static_cast<double>
@@ -4053,12 +4646,48 @@ template <typename T> void FITSData::constructHistogramInternal()
     else
         m_JMIndex = 1;
 
-    qCDebug(KSTARS_FITS) << "FITHistogram: JMIndex " << m_JMIndex;
+    qCDebug(KSTARS_FITS) << "FITHistogram: JMIndex " << m_JMIndex << "bins" << m_HistogramBinCount;
 
     m_HistogramConstructed = true;
     emit histogramReady();
 }
 
+double FITSData::getHistogramFraction(double value, uint8_t channel) const
+{
+    if (!m_HistogramConstructed || channel >= m_Statistics.channels || m_CumulativeFrequency[channel].isEmpty())
+        return 0;
+
+    const QVector<uint32_t> &cumulative = m_CumulativeFrequency[channel];
+    const double total = cumulative.last();
+    const double position = (value - m_Statistics.min[channel]) / m_HistogramBinWidth[channel];
+    if (total <= 0 || position <= 0)
+        return 0;
+    if (position >= cumulative.size())
+        return 1;
+
+    // Pixels are assumed evenly spread within their bin
+    const int bin = static_cast<int>(position);
+    const double before = bin > 0 ? cumulative[bin - 1] : 0;
+    return (before + m_HistogramFrequency[channel][bin] * (position - bin)) / total;
+}
+
+double FITSData::getHistogramValue(double fraction, uint8_t channel) const
+{
+    if (!m_HistogramConstructed || channel >= m_Statistics.channels || m_CumulativeFrequency[channel].isEmpty())
+        return 0;
+
+    const QVector<uint32_t> &cumulative = m_CumulativeFrequency[channel];
+    const double target = qBound(0.0, fraction, 1.0) * cumulative.last();
+    const int bin = std::lower_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin();
+    if (bin >= cumulative.size())
+        return m_Statistics.max[channel];
+
+    const double before = bin > 0 ? cumulative[bin - 1] : 0;
+    const double count = m_HistogramFrequency[channel][bin];
+    const double within = count > 0 ? (target - before) / count : 0;
+    return std::min(m_Statistics.max[channel], m_Statistics.min[channel] + m_HistogramBinWidth[channel] * (bin + within));
+}
+
 void FITSData::recordLastError(int errorCode)
 {
     char fitsErrorMessage[512] = {0};
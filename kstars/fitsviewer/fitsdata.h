@@ -32,6 +32,7 @@
 #include "bayer.h"
 #include "skybackground.h"
 #include "fitscommon.h"
+#include "fitsintegralimage.h"
 #include "fitsstardetector.h"
 
 #ifdef WIN32
@@ -41,12 +42,15 @@
 
 #include <fitsio.h>
 
+#include <QFile>
 #include <QFuture>
 #include <QObject>
 #include <QRect>
 #include <QVariant>
 #include <QTemporaryFile>
 
+#include <vector>
+
 #ifndef KSTARS_LITE
 #include <kxmlguiwindow.h>
 #ifdef HAVE_WCSLIB
@@ -119,6 +123,15 @@ class FITSData : public QObject
          */
         QFuture<bool> loadFromFile(const QString &inFilename, bool silent = true);
 
+        /**
+         * @brief loadHeader Read the keywords and the WCS of a FITS file, but not its pixels.
+         * The geometry and data type are known afterwards, there is no image buffer nor statistics.
+         * @param inFilename Path to FITS file (or compressed fits.fz)
+         * @param silent If set, error messages are ignored. If set to false, the error message will get displayed in a popup.
+         * @return bool indicating success or failure.
+         */
+        bool loadHeader(const QString &inFilename, bool silent = true);
+
         /**
          * @brief loadFITSFromMemory Loading FITS from memory buffer.
          * @param buffer The memory buffer containing the fits data.
@@ -142,6 +155,7 @@ class FITSData : public QObject
 
         // Access functions
         void clearImageBuffers();
+        // Takes ownership of a buffer allocated with new[] or FITSBufferPool::acquire().
         void setImageBuffer(uint8_t *buffer);
         uint8_t const *getImageBuffer() const;
         uint8_t *getWritableImageBuffer();
@@ -153,6 +167,17 @@ class FITSData : public QObject
         ////////////////////////////////////////////////////////////////////////////////////////
         // Calculate stats
         void calculateStats(bool refresh = false);
+        /**
+         * @brief updateStatistics Update the statistics of a channel after a few pixels were replaced in the buffer
+         * returned by getWritableImageBuffer(). Mean and standard deviation are updated from the replaced values.
+         * For 8 and 16 bit images, the value counts are updated too, and give the median, and the minimum and
+         * maximum if a replaced pixel held one of them, without reading the image. Other types only resample the
+         * median, and scan the minimum and maximum if a replaced pixel held one of them.
+         * @param oldValues Values of the replaced pixels before they were replaced.
+         * @param newValues Values of the same pixels after they were replaced, in the same order.
+         */
+        void updateStatistics(const std::vector<double> &oldValues, const std::vector<double> &newValues,
+                              uint8_t channel = 0);
         void saveStatistics(FITSImage::Statistic &other);
         void restoreStatistics(FITSImage::Statistic &other);
         FITSImage::Statistic const &getStatistics() const
@@ -229,6 +254,35 @@ class FITSData : public QObject
         {
             return m_Statistics.median[channel];
         }
+        /**
+         * @brief getPercentile Get the pixel value below which a fraction of the pixels of a channel lie.
+         * @param fraction Fraction of the pixels between 0 and 1, 0.5 being the median.
+         * @param channel Channel to query.
+         * @return Exact value for 8 and 16 bit integer images, estimated from a subsample of the channel for other types.
+         * @note The distribution is gathered along with the statistics. If these were read from the header instead, the
+         * first call gathers it. The median of the statistics and the quartiles that size the histogram bins of floating
+         * point images are taken from here.
+         */
+        double getPercentile(double fraction, uint8_t channel = 0);
+
+        /**
+         * @brief buildIntegralImages Build the summed-area tables of every channel, after which getRegionStatistics()
+         * takes constant time whatever the size of the region. This is worth it when many regions of the same frame are
+         * queried. The tables take 16 bytes per pixel and are dropped as soon as the image data changes.
+         */
+        void buildIntegralImages();
+        bool hasIntegralImages() const
+        {
+            return !m_IntegralImages[0].isNull();
+        }
+
+        /**
+         * @brief getRegionStatistics Get the mean and population standard deviation of a rectangle of a channel.
+         * @param region Rectangle in image coordinates, clipped to the image.
+         * @return false if the clipped region is empty.
+         * @note Uses the integral images if they were built, otherwise goes over the pixels of the region.
+         */
+        bool getRegionStatistics(const QRect &region, double &mean, double &stddev, uint8_t channel = 0) const;
 
         int getBytesPerPixel() const
         {
@@ -412,6 +466,35 @@ class FITSData : public QObject
              */
         bool pixelToWCS(const QPointF &wcsPixelPoint, SkyPoint &wcsCoord);
 
+        /**
+             * @brief wcsToPixels Batched wcsToPixel, converting all coordinates in a few wcslib calls. Large batches
+             * are split across threads.
+             * @param wcsCoords J2000 RA and DE of the targets in degrees, as X and Y.
+             * @param wcsPixelPoints Return XY FITS coordinates, in the order of wcsCoords.
+             * @param valid If not null, return whether each coordinate could be converted.
+             * @return True if the batch was converted, even if some coordinates are invalid, false otherwise.
+             */
+        bool wcsToPixels(const QVector<QPointF> &wcsCoords, QVector<QPointF> &wcsPixelPoints, QVector<bool> *valid = nullptr);
+
+        /**
+             * @brief pixelsToWCS Batched pixelToWCS, converting all points in a few wcslib calls. Large batches
+             * are split across threads.
+             * @param wcsPixelPoints Pixel coordinates in XY Image space.
+             * @param wcsCoords Return J2000 RA and DE in degrees as X and Y, in the order of wcsPixelPoints.
+             * @param valid If not null, return whether each point could be converted.
+             * @return True if the batch was converted, even if some points are invalid, false otherwise.
+             */
+        bool pixelsToWCS(const QVector<QPointF> &wcsPixelPoints, QVector<QPointF> &wcsCoords, QVector<bool> *valid = nullptr);
+
+        /**
+             * @brief interpolatePixelToWCS Approximate pixelToWCS from a coarse grid of sky positions computed once
+             * per solution. Meant for overlays and readouts refreshed at interactive rates.
+             * @param wcsPixelPoint Pixel coordinates in XY Image space.
+             * @param wcsCoord Store back WCS world coordinate in wcsCoord
+             * @return True if successful, false otherwise.
+             */
+        bool interpolatePixelToWCS(const QPointF &wcsPixelPoint, SkyPoint &wcsCoord);
+
         /**
              * @brief injectWCS Add WCS keywords to file
              * @param orientation Solver orientation, degrees E of N.
@@ -439,6 +522,8 @@ class FITSData : public QObject
          * @brief debayer the 1-channel data to 3-channel RGB using the default debayer pattern detected in the FITS header.
          * @param reload If true, it will read the image again from disk before performing debayering. This is necessary to attempt
          * subsequent debayering processes on an already debayered image.
+         * @note The DC1394_BAYER_METHOD_DOWNSAMPLE method is a fast super-pixel debayer, which halves the width and height of the
+         * image. It is meant for previews, focusing and alignment, where the full resolution is not needed.
          */
         bool debayer(bool reload = false);
         bool debayer_8bit();
@@ -474,6 +559,19 @@ class FITSData : public QObject
             return m_HistogramFrequency[channel];
         }
 
+        /**
+         * @brief getHistogramFraction Fraction of the pixels of a channel below a value, from the cumulative histogram.
+         * @return Fraction between 0 and 1, interpolated within the bin of the value. 0 if the histogram is not constructed.
+         */
+        double getHistogramFraction(double value, uint8_t channel = 0) const;
+
+        /**
+         * @brief getHistogramValue Value below which a fraction of the pixels of a channel lie, from the cumulative histogram.
+         * Cheaper than getPercentile() once the histogram is constructed, and accurate to a fraction of a bin.
+         * @return Value interpolated within its bin. 0 if the histogram is not constructed.
+         */
+        double getHistogramValue(double fraction, uint8_t channel = 0) const;
+
         /**
          * @brief getJMIndex Overall contrast of the image used in find centeroid algorithm. i.e. is the image diffuse?
          * @return Value of JMIndex
@@ -515,6 +613,16 @@ class FITSData : public QObject
         {
             return m_isCompressed;
         }
+        // Is the image buffer a read-only memory map of the file data?
+        bool isMapped() const
+        {
+            return m_isMapped;
+        }
+        // Was only the header loaded?
+        bool isHeaderOnly() const
+        {
+            return m_isHeaderOnly;
+        }
 
         // Horizontal flip counter. We keep count to rotate WCS keywords on save
         int getFlipHCounter() const;
@@ -573,6 +681,12 @@ class FITSData : public QObject
          */
         void dataChanged();
 
+        /**
+         * @brief dataAboutToChange Sent, from the thread doing it, right before the image buffer is modified,
+         * replaced or released. Receivers reading the buffer in the background must stop before returning.
+         */
+        void dataAboutToChange();
+
     private:
         void loadCommon(const QString &inFilename);
         /**
@@ -589,23 +703,42 @@ class FITSData : public QObject
         bool loadFITSImage(const QByteArray &buffer, const QString &extension, bool silent);
         // Load RAW images.
         bool loadRAWImage(const QByteArray &buffer, const QString &extension, bool silent);
+        // Decompress a tile compressed FITS image from disk directly into the image buffer.
+        bool readCompressedImage(int &status);
+        // Map the data unit of the current HDU as image buffer, if it is stored in native layout.
+        bool mapImageBuffer();
+        // Replace a memory mapped image buffer by a heap copy before it gets modified.
+        void detachImageBuffer();
 
         void rotWCSFITS(int angle, int mirror);
-        void calculateMinMax(bool refresh = false);
-        void calculateMedian(bool refresh = false);
+        // Read statistics stored in the header, return true if they were all found.
+        bool readMinMaxKeywords();
+        bool readMedianKeywords();
+        bool readMeanStdDevKeywords();
         bool checkDebayer();
         void readWCSKeys();
+        // Drop the interpolation grid and the bounds derived from the WCS solution.
+        void resetWCSCache();
+        // Convert a batch of points from sky to pixel coordinates or the reverse, in parallel for large batches.
+        bool convertWCS(bool toPixel, const QVector<QPointF> &input, QVector<QPointF> &output, QVector<bool> *valid);
+        void buildWCSGrid();
 
         // Record last FITS error
         void recordLastError(int errorCode);
 
         // FITS Record
         bool parseHeader();
+        // Set the observation time from DATE-OBS
+        void parseDateTime();
         //int getFITSRecord(QString &recordList, int &nkeys);
 
         // Templated functions
+        /* Decode the mosaic in row bands on the global thread pool */
         template <typename T>
         bool debayer();
+        /* Half resolution debayer, each 2x2 cell of the mosaic becomes one RGB pixel */
+        template <typename T>
+        bool debayerSuperPixel(T const *source, int width, int height);
 
         template <typename T>
         bool rotFITS(int rotate, int mirror);
@@ -614,26 +747,19 @@ class FITSData : public QObject
         template <typename T>
         void applyFilter(FITSScale type, uint8_t *targetImage, QVector<double> * min = nullptr, QVector<double> * max = nullptr);
 
+        /* Calculate the requested statistics of all channels in a single multi-threaded sweep over the image buffer */
         template <typename T>
-        void calculateMinMax();
-        template <typename T>
-        void calculateMedian();
-
-        template <typename T>
-        QPair<T, T> getParitionMinMax(uint32_t start, uint32_t stride);
+        void calculateStatsInternal(bool minMax, bool median, bool meanStdDev);
 
-        /* Calculate the Gaussian blur matrix and apply it to the image using the convolution filter */
-        QVector<double> createGaussianKernel(int size, double sigma);
         template <typename T>
-        void convolutionFilter(const QVector<double> &kernel, int kernelSize);
+        void buildIntegralImagesInternal();
+        void clearIntegralImages();
         template <typename T>
-        void gaussianBlur(int kernelSize, double sigma);
+        bool regionStatistics(const QRect &region, double &mean, double &stddev, uint8_t channel) const;
 
-        /* Calculate running average & standard deviation using Welford’s method for computing variance */
-        template <typename T>
-        void runningAverageStdDev();
+        /* Apply a Gaussian blur to all channels using the separable convolution engine (see fitsconvolution.h) */
         template <typename T>
-        QPair<double, double> getSquaredSumAndMean(uint32_t start, uint32_t stride);
+        void gaussianBlur(int kernelSize, double sigma);
 
         template <typename T>
         void convertToQImage(double dataMin, double dataMax, double scale, double zero, QImage &image);
@@ -651,10 +777,31 @@ class FITSData : public QObject
         uint8_t *m_ImageBuffer { nullptr };
         /// Above buffer size in bytes
         uint32_t m_ImageBufferSize { 0 };
+        /// Is the image buffer mapped from m_MappedFile rather than allocated on the heap?
+        bool m_isMapped { false };
+        /// Backing file of a memory mapped image buffer
+        QFile m_MappedFile;
+
+        /// Pixel distribution used by getPercentile(). For 8 and 16 bit integer images, the number of pixels up to
+        /// and including each value, per channel. Otherwise, a subsample of every channel in m_PercentileSamples.
+        std::vector<uint32_t> m_ValueCounts[3];
+        std::vector<double> m_PercentileSamples;
+        /// Value of the first bin of m_ValueCounts
+        double m_PercentileOffset { 0 };
+        bool m_PercentilesReady { false };
+        /// Were the value counts up to date when the buffer was handed out by getWritableImageBuffer()? If so,
+        /// updateStatistics() updates them from the replaced values instead of counting the image again.
+        bool m_ValueCountsUpdatable { false };
+        /// Thread private value counts, kept to avoid allocations on every frame.
+        std::vector<uint32_t> m_PartitionCounts;
+        /// Summed-area tables per channel, see buildIntegralImages().
+        FITSIntegralImage m_IntegralImages[3];
         /// Is this a temporary file or one loaded from disk?
         bool m_isTemporary { false };
         /// is this file compress (.fits.fz)?
         bool m_isCompressed { false };
+        /// Was only the header read, see loadHeader()?
+        bool m_isHeaderOnly { false };
         /// Did we search for stars yet?
         bool starsSearched { false };
         ///Star Selection Algorithm
@@ -687,6 +834,15 @@ class FITSData : public QObject
         };
         /// Number of coordinate representations found.
         int m_nwcs {0};
+        /// Sky positions on a coarse pixel grid as unit vectors, built on first interpolation.
+        std::vector<double> m_WCSGrid;
+        /// Which grid nodes could be converted.
+        std::vector<bool> m_WCSGridValid;
+        int m_WCSGridColumns {0};
+        int m_WCSGridRows {0};
+        /// Sky bounds of the image, minimum and maximum RA then DE in degrees.
+        double m_WCSBounds[4] {0, 0, 0, 0};
+        bool m_WCSBoundsReady {false};
         WCSState m_WCSState { Idle };
         /// All the stars we detected, if any.
         QList<Edge *> starCenters;
@@ -696,6 +852,8 @@ class FITSData : public QObject
 
         /// Bayer parameters
         BayerParams debayerParams;
+        /// Was the image halved by a super-pixel debayer (DC1394_BAYER_METHOD_DOWNSAMPLE)?
+        bool m_isSuperPixel { false };
         QTemporaryFile m_TemporaryDataFile;
 
         /// Data type of fits pixel in the image. Used when saving FITS again.
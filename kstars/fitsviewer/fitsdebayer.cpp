@@ -16,6 +16,18 @@
 
 #include <QPushButton>
 
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+// Methods in the order of the method combo box
+const dc1394bayer_method_t comboMethods[] = { DC1394_BAYER_METHOD_NEAREST, DC1394_BAYER_METHOD_SIMPLE,
+                                              DC1394_BAYER_METHOD_BILINEAR, DC1394_BAYER_METHOD_HQLINEAR,
+                                              DC1394_BAYER_METHOD_VNG, DC1394_BAYER_METHOD_DOWNSAMPLE
+                                            };
+}
+
 debayerUI::debayerUI(QDialog *parent) : QDialog(parent)
 {
     setupUi(parent);
@@ -40,7 +52,8 @@ void FITSDebayer::applyDebayer()
     {
         const QSharedPointer<FITSData> &image_data = view->imageData();
 
-        dc1394bayer_method_t method = (dc1394bayer_method_t)ui->methodCombo->currentIndex();
+        const int methodCount = std::end(comboMethods) - std::begin(comboMethods);
+        dc1394bayer_method_t method = comboMethods[qBound(0, ui->methodCombo->currentIndex(), methodCount - 1)];
         dc1394color_filter_t filter = (dc1394color_filter_t)(ui->filterCombo->currentIndex() + 512);
 
         int offsetX = ui->XOffsetSpin->value();
@@ -71,7 +84,9 @@ void FITSDebayer::applyDebayer()
 
 void FITSDebayer::setBayerParams(BayerParams *param)
 {
-    ui->methodCombo->setCurrentIndex(param->method);
+    const auto method = std::find(std::begin(comboMethods), std::end(comboMethods), param->method);
+    if (method != std::end(comboMethods))
+        ui->methodCombo->setCurrentIndex(method - std::begin(comboMethods));
     ui->filterCombo->setCurrentIndex(param->filter - 512);
 
     ui->XOffsetSpin->setValue(param->offsetX);
@@ -19,6 +19,7 @@
 
 #include <math.h>
 #include <cmath>
+#include <numeric>
 #include <QtConcurrent>
 
 #include "fits_debug.h"
@@ -116,13 +117,16 @@ bool FITSGradientDetector::findSources(const QRect &boundary)
     QVector<float> gradients;
     QVector<float> directions;
 
+    // Rows are processed in tiles, in parallel unless a single thread is configured
+    QVector<QPair<int, int>> tiles = rowTiles(0, subH);
+
     // TODO Must trace neighbours and assign IDs to each shape so that they can be centered massed
     // and discarded whenever necessary. It won't work on noisy images unless this is done.
-    sobel<T>(boundedImage, gradients, directions);
+    sobel<T>(boundedImage, gradients, directions, tiles);
 
     QVector<int> ids(gradients.size());
 
-    int maxID = partition(subW, subH, gradients, ids);
+    int maxID = tiles.size() > 1 ? partition(subW, subH, gradients, ids, tiles) : partition(subW, subH, gradients, ids);
 
     // Not needed anymore
     delete boundedImage;
@@ -130,41 +134,59 @@ bool FITSGradientDetector::findSources(const QRect &boundary)
     if (maxID == 0)
         return 0;
 
-    typedef struct
+    struct massInfo
     {
         float massX     = 0;
         float massY     = 0;
         float totalMass = 0;
-    } massInfo;
-
-    QMap<int, massInfo> masses;
+    };
 
-    // #7 Calculate center of mass for all detected regions
-    for (int y = 0; y < subH; y++)
+    // #7 Calculate center of mass for all detected regions, summing the masses of each tile
+    QVector<QVector<massInfo>> tileMasses(tiles.size());
+    QVector<int> tileIndices(tiles.size());
+    std::iota(tileIndices.begin(), tileIndices.end(), 0);
+    QtConcurrent::blockingMap(tileIndices, [&](int tile)
     {
-        for (int x = 0; x < subW; x++)
-        {
-            int index = x + y * subW;
+        QVector<massInfo> &masses = tileMasses[tile];
+        masses.resize(maxID + 1);
 
-            int regionID = ids[index];
-            if (regionID > 0)
+        for (int y = tiles[tile].first; y < tiles[tile].second; y++)
+        {
+            for (int x = 0; x < subW; x++)
             {
-                float pixel = gradients[index];
+                int index = x + y * subW;
 
-                masses[regionID].totalMass += pixel;
-                masses[regionID].massX += x * pixel;
-                masses[regionID].massY += y * pixel;
+                int regionID = ids[index];
+                if (regionID > 0)
+                {
+                    float pixel = gradients[index];
+
+                    masses[regionID].totalMass += pixel;
+                    masses[regionID].massX += x * pixel;
+                    masses[regionID].massY += y * pixel;
+                }
             }
         }
+    });
+
+    QVector<massInfo> masses = tileMasses.takeFirst();
+    for (auto const &partial : tileMasses)
+    {
+        for (int id = 1; id <= maxID; id++)
+        {
+            masses[id].totalMass += partial[id].totalMass;
+            masses[id].massX += partial[id].massX;
+            masses[id].massY += partial[id].massY;
+        }
     }
 
     // Compare multiple masses, and only select the highest total mass one as the desired star
     int maxRegionID       = 1;
     int maxTotalMass      = masses[1].totalMass;
     double totalMassRatio = 1e6;
-    for (auto key : masses.keys())
+    for (int key = 1; key <= maxID; key++)
     {
-        massInfo oneMass = masses.value(key);
+        massInfo const &oneMass = masses[key];
         if (oneMass.totalMass > maxTotalMass)
         {
             totalMassRatio = oneMass.totalMass / maxTotalMass;
@@ -310,7 +332,8 @@ bool FITSGradientDetector::findSources(const QRect &boundary)
  */
 
 template <typename T>
-void FITSGradientDetector::sobel(FITSData const *data, QVector<float> &gradient, QVector<float> &direction) const
+void FITSGradientDetector::sobel(FITSData const *data, QVector<float> &gradient, QVector<float> &direction,
+                                 QVector<QPair<int, int>> &tiles) const
 {
     if (data == nullptr)
         return;
@@ -321,7 +344,22 @@ void FITSGradientDetector::sobel(FITSData const *data, QVector<float> &gradient,
     gradient.resize(stats.samples_per_channel);
     direction.resize(stats.samples_per_channel);
 
-    for (int y = 0; y < stats.height; y++)
+    // Each tile reads one row above and below its own, and only writes its own rows
+    float * const gradientData  = gradient.data();
+    float * const directionData = direction.data();
+    QtConcurrent::blockingMap(tiles, [ &, gradientData, directionData](QPair<int, int> const &tile)
+    {
+        sobelRows<T>(data, gradientData, directionData, tile.first, tile.second);
+    });
+}
+
+template <typename T>
+void FITSGradientDetector::sobelRows(FITSData const *data, float *gradient, float *direction, int firstRow,
+                                     int lastRow) const
+{
+    FITSImage::Statistic const &stats = data->getStatistics();
+
+    for (int y = firstRow; y < lastRow; y++)
     {
         size_t yOffset    = y * stats.width;
         const T * grayLine = reinterpret_cast<T const *>(data->getImageBuffer()) + yOffset;
@@ -329,8 +367,8 @@ void FITSGradientDetector::sobel(FITSData const *data, QVector<float> &gradient,
         const T * grayLine_m1 = y < 1 ? grayLine : grayLine - stats.width;
         const T * grayLine_p1 = y >= stats.height - 1 ? grayLine : grayLine + stats.width;
 
-        float * gradientLine  = gradient.data() + yOffset;
-        float * directionLine = direction.data() + yOffset;
+        float * gradientLine  = gradient + yOffset;
+        float * directionLine = direction + yOffset;
 
         for (int x = 0; x < stats.width; x++)
         {
@@ -413,6 +451,135 @@ int FITSGradientDetector::partition(int width, int height, QVector<float> &gradi
     return id;
 }
 
+namespace
+{
+// Root of the region of a pixel, halving the path on the way.
+int findRoot(int * links, int index)
+{
+    while (links[index] != index)
+    {
+        links[index] = links[links[index]];
+        index = links[index];
+    }
+    return index;
+}
+
+// Root of the region of a pixel, leaving links untouched so that tiles may be read concurrently.
+int peekRoot(int const * links, int index)
+{
+    while (links[index] != index)
+        index = links[index];
+    return index;
+}
+
+// Join the regions of two pixels. The root of a region is always its first pixel in raster order.
+void unite(int * links, int a, int b)
+{
+    a = findRoot(links, a);
+    b = findRoot(links, b);
+    if (a < b)
+        links[b] = a;
+    else if (b < a)
+        links[a] = b;
+}
+}
+
+int FITSGradientDetector::partition(int width, int height, QVector<float> &gradient, QVector<int> &ids,
+                                    QVector<QPair<int, int>> &tiles) const
+{
+    float const * const image = gradient.constData();
+    QVector<int> links(width * height, -1);
+    int * const linkData = links.data();
+
+    // #1 Join pixels with their neighbours inside each tile. Neighbours are the same as in trace(), all
+    // but the two on the main diagonal, so only those above, above right and left are visited from a pixel.
+    QtConcurrent::blockingMap(tiles, [ = ](QPair<int, int> const &tile)
+    {
+        for (int y = tile.first; y < tile.second; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int const index = x + y * width;
+                if (image[index] <= 0)
+                    continue;
+
+                linkData[index] = index;
+                if (x > 0 && image[index - 1] > 0)
+                    unite(linkData, index, index - 1);
+                if (y > tile.first)
+                {
+                    if (image[index - width] > 0)
+                        unite(linkData, index, index - width);
+                    if (x < width - 1 && image[index - width + 1] > 0)
+                        unite(linkData, index, index - width + 1);
+                }
+            }
+        }
+    });
+
+    // #2 Join regions across the seams between tiles
+    for (int t = 1; t < tiles.size(); t++)
+    {
+        int const y = tiles[t].first;
+        for (int x = 0; x < width; x++)
+        {
+            int const index = x + y * width;
+            if (image[index] <= 0)
+                continue;
+
+            if (image[index - width] > 0)
+                unite(linkData, index, index - width);
+            if (x < width - 1 && image[index - width + 1] > 0)
+                unite(linkData, index, index - width + 1);
+        }
+    }
+
+    // #3 Like partition(), only regions reaching inside the one pixel border get an ID, in the raster order
+    // of their first inner pixel. Tiles are in row order, so the regions first seen by a tile are numbered
+    // after those of the tiles above it.
+    QVector<QVector<int>> tileRoots(tiles.size());
+    QVector<int> tileIndices(tiles.size());
+    std::iota(tileIndices.begin(), tileIndices.end(), 0);
+    QtConcurrent::blockingMap(tileIndices, [&](int t)
+    {
+        QSet<int> seen;
+        for (int y = qMax(1, tiles[t].first); y < qMin(height - 1, tiles[t].second); y++)
+        {
+            for (int x = 1; x < width - 1; x++)
+            {
+                int const index = x + y * width;
+                if (image[index] <= 0)
+                    continue;
+
+                int const root = peekRoot(linkData, index);
+                if (!seen.contains(root))
+                {
+                    seen.insert(root);
+                    tileRoots[t].append(root);
+                }
+            }
+        }
+    });
+
+    QHash<int, int> regions;
+    for (auto const &roots : tileRoots)
+        for (int root : roots)
+            if (!regions.contains(root))
+                regions.insert(root, regions.size() + 1);
+
+    // #4 Label every pixel with the ID of its region
+    int * const idData = ids.data();
+    QHash<int, int> const &regionIDs = regions;
+    QtConcurrent::blockingMap(tiles, [ =, &regionIDs](QPair<int, int> const &tile)
+    {
+        for (int index = tile.first * width; index < tile.second * width; index++)
+            idData[index] = image[index] > 0 ? regionIDs.value(peekRoot(linkData, index), 0) : 0;
+    });
+
+    // Return max id
+    return regions.size();
+}
+
 void FITSGradientDetector::trace(int width, int height, int id, QVector<float> &image, QVector<int> &ids, int x,
                                  int y) const
 {
@@ -47,9 +47,17 @@ class FITSGradientDetector: public FITSStarDetector
          * @param data is the FITS data to run the detection onto.
          * @param gradient is the vector storing the amount of change in pixel sequences.
          * @param direction is the vector storing the four directions (horizontal, vertical and two diagonals) the changes stored in 'gradient' are detected in.
+         * @param tiles are the tiles of rows processed in parallel.
          */
         template <typename T>
-        void sobel(FITSData const * data, QVector<float> &gradient, QVector<float> &direction) const;
+        void sobel(FITSData const * data, QVector<float> &gradient, QVector<float> &direction,
+                   QVector<QPair<int, int>> &tiles) const;
+
+        /** @internal Sobel operator over rows [firstRow, lastRow) of the frame.
+         * @see sobel().
+         */
+        template <typename T>
+        void sobelRows(FITSData const * data, float * gradient, float * direction, int firstRow, int lastRow) const;
 
         /** @internal Identify gradient connections.
          * @param width, height are the dimensions of the frame to work on.
@@ -58,6 +66,11 @@ class FITSGradientDetector: public FITSStarDetector
          */
         int partition(int width, int height, QVector<float> &gradient, QVector<int> &ids) const;
 
+        /** @internal Identify gradient connections in parallel, with the same result as the serial partition().
+         * @param tiles are the tiles of rows labelled in parallel, whose regions are then joined across the seams.
+         */
+        int partition(int width, int height, QVector<float> &gradient, QVector<int> &ids, QVector<QPair<int, int>> &tiles) const;
+
         /** @internal Trace gradient neighbors.
          * @param width, height are the dimensions of the frame to work on.
          * @param image is the image to work on, actually gradients extracted using the sobel algorithm.
@@ -22,6 +22,12 @@
 #include <QtConcurrent>
 #include <type_traits>
 
+namespace
+{
+// Fraction of the pixels beyond each clipping marker, about what an auto-stretch drops in the shadows.
+const double ClipFraction = 0.001;
+}
+
 FITSHistogramView::FITSHistogramView(QWidget *parent) : QCustomPlot(parent)
 {
     setBackground(QBrush(Qt::black));
@@ -89,6 +95,7 @@ void FITSHistogramView::syncGUI()
     bool isColor = m_ImageData->channels() > 1;
 
     clearGraphs();
+    clearItems();
     graphs.clear();
 
     for (int n = 0; n < m_ImageData->channels(); n++)
@@ -146,6 +153,24 @@ void FITSHistogramView::syncGUI()
     xAxis->rescale();
     yAxis->rescale();
 
+    // Mark the values below and above which only a small fraction of the pixels lie
+    if (m_Linear)
+    {
+        for (int n = 0; n < m_ImageData->channels(); n++)
+        {
+            QPen pen = graphs[n]->pen();
+            pen.setStyle(Qt::DashLine);
+            for (const double fraction : {ClipFraction, 1 - ClipFraction})
+            {
+                const double value = m_ImageData->getHistogramValue(fraction, n);
+                auto *marker = new QCPItemStraightLine(this);
+                marker->point1->setCoords(value, 0);
+                marker->point2->setCoords(value, 1);
+                marker->setPen(pen);
+            }
+        }
+    }
+
     setInteraction(QCP::iRangeDrag, true);
     setInteraction(QCP::iRangeZoom, true);
     setInteraction(QCP::iSelectPlottables, true);
@@ -196,33 +221,45 @@ void FITSHistogramView::driftMouseOverLine(QMouseEvent * event)
             freq[n] = graphs[n]->dataMainValue(index);
         }
 
+        // Share of the pixels below the intensity, from the cumulative distribution
+        QVector<double> below(3, 0);
+        if (m_Linear)
+        {
+            for (int n = 0; n < channels; n++)
+                below[n] = 100 * m_ImageData->getHistogramFraction(intensity, n);
+        }
+
         if (channels == 1 && freq[0] > 0)
         {
             QToolTip::showText(
                 event->globalPos(),
-                i18nc("Histogram tooltip; %1 is intensity; %2 is frequency;",
+                i18nc("Histogram tooltip; %1 is intensity; %2 is frequency; %3 is the percentage of pixels below intensity;",
                       "<table>"
                       "<tr><td>Intensity:   </td><td>%1</td></tr>"
                       "<tr><td>R Frequency:   </td><td>%2</td></tr>"
+                      "<tr><td>Below:   </td><td>%3%</td></tr>"
                       "</table>",
                       QString::number(intensity, 'f', numDecimals[0]),
-                      QString::number(freq[0], 'f', 0)));
+                      QString::number(freq[0], 'f', 0),
+                      QString::number(below[0], 'f', 2)));
         }
         else if (freq[1] > 0)
         {
             QToolTip::showText(
                 event->globalPos(),
-                i18nc("Histogram tooltip; %1 is intensity; %2 is frequency;",
+                i18nc("Histogram tooltip; %1 is intensity; %2 is frequency; %5 is the percentage of pixels below intensity;",
                       "<table>"
                       "<tr><td>Intensity:   </td><td>%1</td></tr>"
                       "<tr><td>R Frequency:   </td><td>%2</td></tr>"
                       "<tr><td>G Frequency:   </td><td>%3</td></tr>"
                       "<tr><td>B Frequency:   </td><td>%4</td></tr>"
+                      "<tr><td>Below:   </td><td>%5</td></tr>"
                       "</table>",
                       QString::number(intensity, 'f', numDecimals[0]),
                       QString::number(freq[0], 'f', 0),
                       QString::number(freq[1], 'f', 0),
-                      QString::number(freq[2], 'f', 0)));
+                      QString::number(freq[2], 'f', 0),
+                      QString("%1% / %2% / %3%").arg(below[0], 0, 'f', 2).arg(below[1], 0, 'f', 2).arg(below[2], 0, 'f', 2)));
         }
         else
             QToolTip::hideText();
@@ -296,14 +333,17 @@ void FITSHistogramView::createNonLinearHistogram()
                 m_HistogramFrequency[0][scanLine[w]] += sampleBy;
         }
     }
-    for (int h = 0; h < height; h += sampleBy)
+    else
     {
-        auto * scanLine = reinterpret_cast<const QRgb *>((rawImage.scanLine(h)));
-        for (int w = 0; w < width; w += sampleBy)
+        for (int h = 0; h < height; h += sampleBy)
         {
-            m_HistogramFrequency[0][qRed(scanLine[w])] += sampleBy;
-            m_HistogramFrequency[1][qGreen(scanLine[w])] += sampleBy;
-            m_HistogramFrequency[2][qBlue(scanLine[w])] += sampleBy;
+            auto * scanLine = reinterpret_cast<const QRgb *>((rawImage.scanLine(h)));
+            for (int w = 0; w < width; w += sampleBy)
+            {
+                m_HistogramFrequency[0][qRed(scanLine[w])] += sampleBy;
+                m_HistogramFrequency[1][qGreen(scanLine[w])] += sampleBy;
+                m_HistogramFrequency[2][qBlue(scanLine[w])] += sampleBy;
+            }
         }
     }
 
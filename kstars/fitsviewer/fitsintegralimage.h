@@ -0,0 +1,168 @@
+/*  FITS Integral Image
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+*/
+
+#pragma once
+
+#include "fitsconvolution.h"
+
+#include <QRect>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief The FITSIntegralImage class holds the summed-area tables of one image plane.
+ *
+ * Once built, the sum, mean and standard deviation of any rectangle are obtained from four
+ * lookups in each table, whatever the size of the rectangle. Values are accumulated relative
+ * to a pivot close to the typical pixel value, which keeps the variance accurate when it is
+ * derived from the sum of squares.
+ *
+ * The tables use two doubles per pixel, so they are only built on request.
+ */
+class FITSIntegralImage
+{
+    public:
+        /**
+         * @brief build Compute the tables of a width x height plane.
+         * @note Blocks until complete, the work is split between the global thread pool threads.
+         */
+        template <typename T>
+        void build(T const *plane, int width, int height)
+        {
+            clear();
+            if (plane == nullptr || width <= 0 || height <= 0)
+                return;
+
+            m_Width = width;
+            m_Height = height;
+
+            // The mean of the first row is a good enough pivot for sky images.
+            double pivot = 0;
+            for (int x = 0; x < width; x++)
+                pivot += plane[x];
+            m_Pivot = pivot / width;
+
+            const int stride = width + 1;
+            m_Sum.assign(static_cast<size_t>(stride) * (height + 1), 0.0);
+            m_Squares.assign(m_Sum.size(), 0.0);
+
+            double * const sums = m_Sum.data();
+            double * const squares = m_Squares.data();
+            const double offset = m_Pivot;
+
+            // Running sums along each row, then down each column. The first row and column stay zero.
+            QVector<QPair<int, int>> rows = FITSConvolution::rowBands(height, 64);
+            QtConcurrent::blockingMap(rows, [ = ](const QPair<int, int> &band)
+            {
+                for (int y = band.first; y < band.second; y++)
+                {
+                    T const *in = plane + static_cast<size_t>(y) * width;
+                    double *sum = sums + static_cast<size_t>(y + 1) * stride + 1;
+                    double *square = squares + static_cast<size_t>(y + 1) * stride + 1;
+                    double rowSum = 0, rowSquares = 0;
+                    for (int x = 0; x < width; x++)
+                    {
+                        const double value = in[x] - offset;
+                        rowSum += value;
+                        rowSquares += value * value;
+                        sum[x] = rowSum;
+                        square[x] = rowSquares;
+                    }
+                }
+            });
+
+            QVector<QPair<int, int>> columns = FITSConvolution::rowBands(width, 64);
+            QtConcurrent::blockingMap(columns, [ = ](const QPair<int, int> &band)
+            {
+                for (int y = 2; y <= height; y++)
+                {
+                    double *sum = sums + static_cast<size_t>(y) * stride + 1;
+                    double *square = squares + static_cast<size_t>(y) * stride + 1;
+                    for (int x = band.first; x < band.second; x++)
+                    {
+                        sum[x] += sum[x - stride];
+                        square[x] += square[x - stride];
+                    }
+                }
+            });
+        }
+
+        void clear()
+        {
+            m_Width = m_Height = 0;
+            m_Pivot = 0;
+            m_Sum.clear();
+            m_Sum.shrink_to_fit();
+            m_Squares.clear();
+            m_Squares.shrink_to_fit();
+        }
+
+        bool isNull() const
+        {
+            return m_Sum.empty();
+        }
+
+        int width() const
+        {
+            return m_Width;
+        }
+        int height() const
+        {
+            return m_Height;
+        }
+
+        /**
+         * @brief statistics Mean and population standard deviation of the pixels in region.
+         * @param region Rectangle in image coordinates, clipped to the image.
+         * @return false if the clipped region is empty or the tables were not built.
+         */
+        bool statistics(const QRect &region, double *mean, double *stddev) const
+        {
+            const QRect area = region & QRect(0, 0, m_Width, m_Height);
+            if (isNull() || area.isEmpty())
+                return false;
+
+            const double count = static_cast<double>(area.width()) * area.height();
+            const double sum = rectangleSum(m_Sum, area) / count;
+            const double variance = rectangleSum(m_Squares, area) / count - sum * sum;
+
+            if (mean)
+                *mean = sum + m_Pivot;
+            if (stddev)
+                *stddev = std::sqrt(std::max(0.0, variance));
+            return true;
+        }
+
+        /**
+         * @brief sum Sum of the pixels in region, clipped to the image.
+         */
+        double sum(const QRect &region) const
+        {
+            const QRect area = region & QRect(0, 0, m_Width, m_Height);
+            if (isNull() || area.isEmpty())
+                return 0;
+            return rectangleSum(m_Sum, area) + m_Pivot * area.width() * area.height();
+        }
+
+    private:
+        double rectangleSum(const std::vector<double> &table, const QRect &area) const
+        {
+            const size_t stride = m_Width + 1;
+            const size_t top = static_cast<size_t>(area.y()) * stride, bottom = static_cast<size_t>(area.y() + area.height()) * stride;
+            const size_t left = area.x(), right = area.x() + area.width();
+            return table[bottom + right] - table[bottom + left] - table[top + right] + table[top + left];
+        }
+
+        int m_Width { 0 };
+        int m_Height { 0 };
+        double m_Pivot { 0 };
+        std::vector<double> m_Sum;
+        std::vector<double> m_Squares;
+};
@@ -27,6 +27,8 @@
 #include "indi/indilistener.h"
 #endif
 
+#include <QPainter>
+#include <QPaintEvent>
 #include <QScrollBar>
 #include <QToolTip>
 
@@ -54,6 +56,20 @@ bool FITSLabel::getMouseButtonDown()
     return mouseButtonDown;
 }
 
+void FITSLabel::paintEvent(QPaintEvent *e)
+{
+    // Very large images have no pixmap, only the tiles visible in the exposed area are painted.
+    if (view->m_TilePyramid.isNull())
+    {
+        QLabel::paintEvent(e);
+        return;
+    }
+
+    QPainter painter(this);
+    painter.fillRect(e->rect(), Qt::black);
+    view->drawTiles(&painter, e->rect());
+}
+
 /**
 This method was added to make the panning function work.
 If the mouse button is released, it resets mouseButtonDown variable and the mouse cursor.
@@ -169,7 +185,7 @@ void FITSLabel::mouseMoveEvent(QMouseEvent *e)
     {
         QPointF wcsPixelPoint(x, y);
         SkyPoint wcsCoord;
-        if(view_data->pixelToWCS(wcsPixelPoint, wcsCoord))
+        if(view_data->interpolatePixelToWCS(wcsPixelPoint, wcsCoord))
         {
             m_RA = wcsCoord.ra0();
             m_DE = wcsCoord.dec0();
@@ -19,6 +19,7 @@
 class FITSView;
 
 class QMouseEvent;
+class QPaintEvent;
 class QString;
 
 class FITSLabel : public QLabel
@@ -38,6 +39,7 @@ class FITSLabel : public QLabel
         virtual void mouseReleaseEvent(QMouseEvent *e) override;
         virtual void mouseDoubleClickEvent(QMouseEvent *e) override;
         virtual void leaveEvent(QEvent *e) override;
+        virtual void paintEvent(QPaintEvent *e) override;
 
     private:
         bool mouseButtonDown { false };
@@ -1,5 +1,9 @@
 #include "fitsstardetector.h"
 
+#include <QThread>
+
+constexpr int FITSStarDetector::MINIMUM_TILE_ROWS;
+
 //void FITSStarDetector::configure(QStandardItemModel const &settings)
 //{
 //    Q_ASSERT(2 <= settings.columnCount());
@@ -20,3 +24,18 @@ QVariant FITSStarDetector::getValue(const QString &key, QVariant defaultValue) c
     else
         return defaultValue;
 }
+
+int FITSStarDetector::threadCount() const
+{
+    return qMax(1, getValue("THREADS", QThread::idealThreadCount()).toInt());
+}
+
+QVector<QPair<int, int>> FITSStarDetector::rowTiles(int first, int last) const
+{
+    QVector<QPair<int, int>> tiles;
+    const int count = qBound(1, (last - first) / MINIMUM_TILE_ROWS, threadCount());
+    const int tileSize = (last - first + count - 1) / count;
+    for (int start = first; start < last; start += tileSize)
+        tiles.append(qMakePair(start, qMin(last, start + tileSize)));
+    return tiles;
+}
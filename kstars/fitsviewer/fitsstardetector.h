@@ -80,6 +80,11 @@ class FITSStarDetector : public QObject
         }
         QVariant getValue(const QString &key, QVariant defaultValue = QVariant()) const;
 
+        /** @brief Number of threads a tiled detection may use, from the "THREADS" setting.
+         * @note Defaults to the number of cores. A value of 1 selects the serial detection.
+         */
+        int threadCount() const;
+
         /** @brief Helper to configure the detection method from a data model.
          * @param settings is the list of key/value pairs for the method to use settings from.
          * @note Data model 'settings' is considered a key/value list, using column 1 text as case-insensitive keys and column 2 data as values.
@@ -88,6 +93,14 @@ class FITSStarDetector : public QObject
         //void configure(QStandardItemModel const &settings);
 
     protected:
+        /** @brief Split rows [first, last) in contiguous tiles, one per thread, processed in parallel by tiled detections.
+         * @note A single tile is returned for the serial detection, or if the rows are too few to be worth splitting.
+         */
+        QVector<QPair<int, int>> rowTiles(int first, int last) const;
+
+        /** @brief Smallest number of rows in a tile. */
+        static constexpr int MINIMUM_TILE_ROWS { 64 };
+
         FITSData *m_ImageData {nullptr};
         QVariantMap m_Settings;
 };
@@ -0,0 +1,209 @@
+/*  FITS Thumbnail Cache
+    Persistent cache of stretched previews of image files.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "fitsthumbnailcache.h"
+
+#include "kspaths.h"
+
+#ifdef WIN32
+// This header must be included before fitsio.h to avoid compiler errors with Visual Studio
+#include <windows.h>
+#endif
+
+#include <fitsio.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <vector>
+
+#include <fits_debug.h>
+
+constexpr int FITSThumbnailCache::DefaultSize;
+constexpr qint64 FITSThumbnailCache::DefaultBudget;
+
+FITSThumbnailCache *FITSThumbnailCache::Instance()
+{
+    static FITSThumbnailCache cache(QDir(KSPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("thumbnails"));
+    return &cache;
+}
+
+FITSThumbnailCache::FITSThumbnailCache(const QString &directory, qint64 budget) : m_Directory(directory),
+    m_Budget(budget)
+{
+    QDir().mkpath(m_Directory);
+    prune();
+}
+
+QString FITSThumbnailCache::cacheKey(const QString &filename, int maxSize, const StretchParams *params) const
+{
+    QFileInfo info(filename);
+    QString key = QString("%1|%2|%3|%4").arg(info.absoluteFilePath()).arg(info.lastModified().toMSecsSinceEpoch())
+                  .arg(info.size()).arg(maxSize);
+
+    if (params == nullptr)
+        key += "|auto";
+    else
+    {
+        for (const StretchParams1Channel &channel : {params->grey_red, params->green, params->blue})
+            key += QString("|%1,%2,%3").arg(channel.shadows).arg(channel.midtones).arg(channel.highlights);
+    }
+
+    return QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+QString FITSThumbnailCache::thumbnailFile(const QString &filename, int maxSize, const StretchParams *params)
+{
+    if (!QFileInfo(filename).isFile())
+        return QString();
+
+    const QString path = QDir(m_Directory).filePath(cacheKey(filename, maxSize, params) + ".png");
+    if (QFileInfo(path).exists())
+        return path;
+
+    QImage image = makeThumbnail(filename, maxSize, params);
+    if (image.isNull())
+        return QString();
+
+    // Concurrent makers of the same preview each write a complete file
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG") || !file.commit())
+    {
+        qCWarning(KSTARS_FITS) << "Failed to save thumbnail of" << filename << "to" << path;
+        return QString();
+    }
+
+    prune();
+    return path;
+}
+
+QImage FITSThumbnailCache::thumbnail(const QString &filename, int maxSize, const StretchParams *params)
+{
+    const QString path = thumbnailFile(filename, maxSize, params);
+    return path.isEmpty() ? QImage() : QImage(path);
+}
+
+void FITSThumbnailCache::prune()
+{
+    QFileInfoList files = QDir(m_Directory).entryInfoList(QStringList("*.png"), QDir::Files, QDir::Time);
+
+    qint64 total = 0;
+    for (const auto &info : files)
+        total += info.size();
+
+    // Newest first, so the oldest are removed from the end. The newest is kept, it was just made.
+    while (total > m_Budget && files.size() > 1)
+    {
+        const QFileInfo oldest = files.takeLast();
+        total -= oldest.size();
+        QFile::remove(oldest.absoluteFilePath());
+    }
+}
+
+void FITSThumbnailCache::clear()
+{
+    for (const auto &info : QDir(m_Directory).entryInfoList(QStringList("*.png"), QDir::Files))
+        QFile::remove(info.absoluteFilePath());
+}
+
+QImage FITSThumbnailCache::makeThumbnail(const QString &filename, int maxSize, const StretchParams *params)
+{
+    int status = 0;
+    fitsfile *fptr = nullptr;
+
+    if (fits_open_diskfile(&fptr, filename.toLocal8Bit(), READONLY, &status))
+        return QImage();
+
+    // The image is the first HDU with at least two axes, compressed images being behind an empty primary array.
+    int hdus = 0, naxis = 0, bitpix = 0;
+    long naxes[3] = {0, 0, 1};
+    fits_get_num_hdus(fptr, &hdus, &status);
+    for (int i = 1; i <= hdus && status == 0; i++)
+    {
+        int hduType = 0;
+        if (fits_movabs_hdu(fptr, i, &hduType, &status) || hduType != IMAGE_HDU)
+            continue;
+        if (fits_get_img_param(fptr, 3, &bitpix, &naxis, naxes, &status) == 0 && naxis >= 2)
+            break;
+        naxis = 0;
+    }
+
+    if (status || naxis < 2 || naxes[0] <= 0 || naxes[1] <= 0)
+    {
+        int closeStatus = 0;
+        fits_close_file(fptr, &closeStatus);
+        return QImage();
+    }
+
+    // Keep integer images in their own range for the stretch, anything else is read as float.
+    fits_get_img_equivtype(fptr, &bitpix, &status);
+    int dataType = TFLOAT, bytesPerPixel = sizeof(float);
+    if (bitpix == BYTE_IMG)
+    {
+        dataType = TBYTE;
+        bytesPerPixel = sizeof(uint8_t);
+    }
+    else if (bitpix == SHORT_IMG)
+    {
+        dataType = TSHORT;
+        bytesPerPixel = sizeof(int16_t);
+    }
+    else if (bitpix == USHORT_IMG)
+    {
+        dataType = TUSHORT;
+        bytesPerPixel = sizeof(uint16_t);
+    }
+
+    // Only every step-th pixel of every step-th row is read and converted
+    const long step = std::max(1L, (std::max(naxes[0], naxes[1]) + maxSize - 1) / maxSize);
+    const long width = (naxes[0] - 1) / step + 1;
+    const long height = (naxes[1] - 1) / step + 1;
+    const int channels = (naxis >= 3 && naxes[2] == 3) ? 3 : 1;
+
+    std::vector<uint8_t> buffer(static_cast<size_t>(width) * height * channels * bytesPerPixel);
+    for (int channel = 0; channel < channels && status == 0; channel++)
+    {
+        long first[3] = {1, 1, channel + 1}, last[3] = {naxes[0], naxes[1], channel + 1}, increment[3] = {step, step, 1};
+        int anynull = 0;
+        fits_read_subset(fptr, dataType, first, last, increment, nullptr,
+                         buffer.data() + static_cast<size_t>(channel) * width * height * bytesPerPixel, &anynull, &status);
+    }
+
+    int closeStatus = 0;
+    fits_close_file(fptr, &closeStatus);
+
+    if (status)
+    {
+        char message[FLEN_ERRMSG];
+        fits_get_errstatus(status, message);
+        qCWarning(KSTARS_FITS) << "Failed to read thumbnail of" << filename << ":" << message;
+        return QImage();
+    }
+
+    Stretch stretch(width, height, channels, dataType);
+    stretch.setParams(params != nullptr ? *params : stretch.computeParams(buffer.data()));
+
+    QImage image;
+    if (channels == 1)
+    {
+        image = QImage(width, height, QImage::Format_Indexed8);
+        image.setColorCount(256);
+        for (int i = 0; i < 256; i++)
+            image.setColor(i, qRgb(i, i, i));
+    }
+    else
+        image = QImage(width, height, QImage::Format_RGB32);
+
+    stretch.run(buffer.data(), &image);
+    return image;
+}
@@ -0,0 +1,73 @@
+/*  FITS Thumbnail Cache
+    Persistent cache of stretched previews of image files.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include "stretch.h"
+
+#include <QImage>
+#include <QString>
+
+/**
+ * @brief The FITSThumbnailCache class keeps small stretched previews of FITS files on disk.
+ *
+ * A preview is made from a decimated read of the image, so only a fraction of the pixels is converted
+ * and stretched, and is then saved as PNG. Previews are keyed by the path and modification time of the
+ * file, their size and the stretch parameters, so a modified file gets a new preview. The oldest
+ * previews are removed once the cache exceeds its size budget. Methods may be called from any thread.
+ */
+class FITSThumbnailCache
+{
+    public:
+        static FITSThumbnailCache *Instance();
+
+        /**
+         * @param directory Where previews are stored, created if needed.
+         * @param budget Size in bytes beyond which the oldest previews are removed.
+         */
+        explicit FITSThumbnailCache(const QString &directory, qint64 budget = DefaultBudget);
+
+        /**
+         * @brief thumbnailFile Path of the preview of an image, made first if not cached yet.
+         * @param filename Path of the FITS image.
+         * @param maxSize Largest side of the preview, in pixels.
+         * @param params Stretch parameters in the scale of the image, or nullptr to stretch automatically.
+         * @return The path of the PNG preview, or an empty string if the image cannot be read.
+         */
+        QString thumbnailFile(const QString &filename, int maxSize = DefaultSize, const StretchParams *params = nullptr);
+
+        /**
+         * @brief thumbnail Preview of an image, made first if not cached yet.
+         * @return The preview, or a null image if the image cannot be read.
+         */
+        QImage thumbnail(const QString &filename, int maxSize = DefaultSize, const StretchParams *params = nullptr);
+
+        /**
+         * @brief prune Remove the oldest previews until the cache fits in its budget, keeping at least the newest
+         * one. Called whenever a preview is added.
+         */
+        void prune();
+
+        void clear();
+
+        const QString &directory() const
+        {
+            return m_Directory;
+        }
+
+        static constexpr int DefaultSize = 256;
+        static constexpr qint64 DefaultBudget = 256 * 1024 * 1024;
+
+    private:
+        QString cacheKey(const QString &filename, int maxSize, const StretchParams *params) const;
+        static QImage makeThumbnail(const QString &filename, int maxSize, const StretchParams *params);
+
+        QString m_Directory;
+        qint64 m_Budget {0};
+};
@@ -0,0 +1,235 @@
+/*  FITS Tile Pyramid
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+*/
+
+#include "fitstilepyramid.h"
+
+#include "fitsdata.h"
+
+#include <QPainter>
+#include <QtConcurrent>
+
+#include <cmath>
+
+namespace
+{
+// Memory allowed for stretched tiles, in KiB.
+constexpr int maxTileCacheCost = 256 * 1024;
+
+bool sameParams(const StretchParams1Channel &a, const StretchParams1Channel &b)
+{
+    return a.shadows == b.shadows && a.highlights == b.highlights && a.midtones == b.midtones &&
+           a.shadows_expansion == b.shadows_expansion && a.highlights_expansion == b.highlights_expansion;
+}
+
+bool sameParams(const StretchParams &a, const StretchParams &b)
+{
+    return sameParams(a.grey_red, b.grey_red) && sameParams(a.green, b.green) && sameParams(a.blue, b.blue);
+}
+}
+
+FITSTilePyramid::FITSTilePyramid(QObject *parent) : QObject(parent)
+{
+    m_Tiles.setMaxCost(maxTileCacheCost);
+    connect(this, &FITSTilePyramid::tileRendered, this, &FITSTilePyramid::storeTile, Qt::QueuedConnection);
+}
+
+FITSTilePyramid::~FITSTilePyramid()
+{
+    waitForTiles();
+}
+
+void FITSTilePyramid::setImageData(const QSharedPointer<FITSData> &data)
+{
+    if (m_ImageData)
+        disconnect(m_ImageData.data(), nullptr, this, nullptr);
+
+    waitForTiles();
+    m_ImageData = data;
+
+    m_Levels = 0;
+    if (m_ImageData)
+    {
+        // Stop reading the image buffer before it gets modified or replaced, whichever thread does it.
+        connect(m_ImageData.data(), &FITSData::dataAboutToChange, this, &FITSTilePyramid::waitForTiles,
+                Qt::DirectConnection);
+
+        // Add levels until the whole image fits in a single tile
+        int size = qMax(m_ImageData->width(), m_ImageData->height());
+        for (m_Levels = 1; size > TileSize; m_Levels++)
+            size = (size + 1) / 2;
+    }
+
+    invalidate();
+}
+
+void FITSTilePyramid::setStretchParams(const StretchParams &params)
+{
+    // Keep the tiles when only the zoom changed, unless the image data was modified since they were stretched.
+    if (sameParams(params, m_StretchParams) && m_CacheGeneration == m_Generation.loadAcquire())
+        return;
+
+    m_StretchParams = params;
+    invalidate();
+}
+
+void FITSTilePyramid::invalidate()
+{
+    m_CacheGeneration = m_Generation.fetchAndAddOrdered(1) + 1;
+    m_Tiles.clear();
+    m_Pending.clear();
+}
+
+void FITSTilePyramid::waitForTiles()
+{
+    // Tiles still queued abort as soon as they start, their generation being outdated.
+    m_Generation.fetchAndAddOrdered(1);
+    m_Pool.waitForDone();
+}
+
+int FITSTilePyramid::levelForScale(double scale) const
+{
+    if (scale >= 1.0)
+        return 0;
+    const int level = static_cast<int>(std::floor(std::log2(1.0 / scale)));
+    return qBound(0, level, m_Levels - 1);
+}
+
+QRect FITSTilePyramid::tileRect(int level, int x, int y) const
+{
+    const int size = TileSize << level;
+    return QRect(x * size, y * size, size, size) & QRect(0, 0, m_ImageData->width(), m_ImageData->height());
+}
+
+QImage FITSTilePyramid::createImage(int width, int height) const
+{
+    if (m_ImageData->channels() == 1)
+    {
+        QImage image(width, height, QImage::Format_Indexed8);
+        image.setColorCount(256);
+        for (int i = 0; i < 256; i++)
+            image.setColor(i, qRgb(i, i, i));
+        return image;
+    }
+
+    return QImage(width, height, QImage::Format_RGB32);
+}
+
+void FITSTilePyramid::draw(QPainter *painter, const QRectF &imageRect, double scale)
+{
+    if (!m_ImageData || m_Levels == 0)
+        return;
+
+    if (m_CacheGeneration != m_Generation.loadAcquire())
+        invalidate();
+
+    const QRect visible = imageRect.toAlignedRect() & QRect(0, 0, m_ImageData->width(), m_ImageData->height());
+    if (visible.isEmpty())
+        return;
+
+    const int level = levelForScale(scale);
+    const int size = TileSize << level;
+
+    for (int y = visible.top() / size; y <= visible.bottom() / size; y++)
+    {
+        for (int x = visible.left() / size; x <= visible.right() / size; x++)
+        {
+            const quint64 key = tileKey(level, x, y);
+            const QRect target = tileRect(level, x, y);
+
+            if (QPixmap *tile = m_Tiles.object(key))
+            {
+                painter->drawPixmap(QRectF(target.topLeft(), QSizeF(tile->width() << level, tile->height() << level)),
+                                    *tile, QRectF(tile->rect()));
+                continue;
+            }
+
+            if (!m_Pending.contains(key))
+                requestTile(key, level, x, y);
+
+            // In the meantime, use the part of a coarser tile covering the same area, if any.
+            for (int coarser = level + 1; coarser < m_Levels; coarser++)
+            {
+                const int coarserSize = TileSize << coarser;
+                const int cx = target.x() / coarserSize, cy = target.y() / coarserSize;
+                QPixmap *tile = m_Tiles.object(tileKey(coarser, cx, cy));
+                if (tile == nullptr)
+                    continue;
+
+                const QRectF source(static_cast<double>(target.x() - cx * coarserSize) / (1 << coarser),
+                                    static_cast<double>(target.y() - cy * coarserSize) / (1 << coarser),
+                                    static_cast<double>(target.width()) / (1 << coarser),
+                                    static_cast<double>(target.height()) / (1 << coarser));
+                painter->drawPixmap(QRectF(target), *tile, source);
+                break;
+            }
+        }
+    }
+}
+
+void FITSTilePyramid::requestTile(quint64 key, int level, int x, int y)
+{
+    const int generation = m_Generation.loadAcquire();
+    m_Pending.insert(key, generation);
+
+    const QSharedPointer<FITSData> data = m_ImageData;
+    const StretchParams params = m_StretchParams;
+    const QRect region = tileRect(level, x, y);
+    const int sampling = 1 << level;
+    QImage tile = createImage((region.width() + sampling - 1) / sampling, (region.height() + sampling - 1) / sampling);
+
+    QtConcurrent::run(&m_Pool, [this, key, generation, data, params, region, sampling, tile]() mutable
+    {
+        // Skip tiles that were invalidated while waiting in the queue
+        if (generation == m_Generation.loadAcquire())
+        {
+            Stretch stretch(data->width(), data->height(), data->channels(), data->dataType());
+            stretch.setParams(params);
+            stretch.run(data->getImageBuffer(), &tile, region, sampling);
+        }
+        else
+            tile = QImage();
+
+        emit tileRendered(key, generation, tile);
+    });
+}
+
+void FITSTilePyramid::storeTile(quint64 key, int generation, const QImage &tile)
+{
+    // Only forget the request if it was not renewed since
+    auto pending = m_Pending.find(key);
+    if (pending != m_Pending.end() && pending.value() == generation)
+        m_Pending.erase(pending);
+
+    if (tile.isNull() || generation != m_Generation.loadAcquire())
+        return;
+
+    QPixmap *pixmap = new QPixmap(QPixmap::fromImage(tile));
+    const int cost = qMax(1, pixmap->width() * pixmap->height() * pixmap->depth() / 8 / 1024);
+    m_Tiles.insert(key, pixmap, cost);
+
+    const int level = static_cast<int>(key >> 48);
+    const int y = static_cast<int>((key >> 24) & 0xFFFFFF);
+    const int x = static_cast<int>(key & 0xFFFFFF);
+    emit updated(tileRect(level, x, y));
+}
+
+QImage FITSTilePyramid::render(const QRect &imageRect) const
+{
+    if (!m_ImageData)
+        return QImage();
+
+    const QRect region = imageRect & QRect(0, 0, m_ImageData->width(), m_ImageData->height());
+    if (region.isEmpty())
+        return QImage();
+
+    QImage image = createImage(region.width(), region.height());
+    Stretch stretch(m_ImageData->width(), m_ImageData->height(), m_ImageData->channels(), m_ImageData->dataType());
+    stretch.setParams(m_StretchParams);
+    stretch.run(m_ImageData->getImageBuffer(), &image, region);
+    return image;
+}
@@ -0,0 +1,123 @@
+/*  FITS Tile Pyramid
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+*/
+
+#pragma once
+
+#include "stretch.h"
+
+#include <QAtomicInt>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+class QPainter;
+class FITSData;
+
+/**
+ * @brief The FITSTilePyramid class renders very large images as a mipmapped pyramid of stretched 8-bit tiles.
+ *
+ * Level 0 holds tiles at the full image resolution, and every following level samples the image
+ * by a further factor of 2. Tiles are stretched lazily in the background, only when they are drawn,
+ * and are kept in a cache with a bounded memory footprint. Changing the stretch parameters invalidates
+ * the tiles instead of stretching the whole image again.
+ *
+ * All functions must be called from the GUI thread.
+ */
+class FITSTilePyramid : public QObject
+{
+        Q_OBJECT
+
+    public:
+        explicit FITSTilePyramid(QObject *parent = nullptr);
+        virtual ~FITSTilePyramid() override;
+
+        /**
+         * @brief setImageData Use the image of data for the tiles, this invalidates all tiles.
+         */
+        void setImageData(const QSharedPointer<FITSData> &data);
+
+        /**
+         * @brief setStretchParams Set the parameters used to stretch tiles.
+         * Tiles are invalidated if the parameters or the image data changed since they were stretched.
+         */
+        void setStretchParams(const StretchParams &params);
+        const StretchParams &getStretchParams() const
+        {
+            return m_StretchParams;
+        }
+
+        /**
+         * @brief invalidate Drop all tiles, for instance because the image data changed.
+         */
+        void invalidate();
+
+        /**
+         * @brief draw Draw the part of the image visible in imageRect.
+         * @param painter Painter whose transformation maps image coordinates to the device.
+         * @param imageRect Visible part of the image, in image coordinates.
+         * @param scale Device pixels per image pixel, used to pick the pyramid level.
+         * @note Missing tiles are requested in the background, and replaced by a coarser level if one is
+         * available in the meantime. updated() is emitted when they are ready.
+         */
+        void draw(QPainter *painter, const QRectF &imageRect, double scale);
+
+        /**
+         * @brief render Stretch a region of the image at full resolution, synchronously.
+         * This is meant for small regions, e.g. the magnifying glass.
+         */
+        QImage render(const QRect &imageRect) const;
+
+        /** Edge of the square tiles, in tile pixels. */
+        static constexpr int TileSize = 256;
+
+    signals:
+        /**
+         * @brief updated Tiles covering imageRect, in image coordinates, became available.
+         */
+        void updated(const QRect &imageRect);
+
+        // Internal, delivers tiles stretched in the background to the GUI thread.
+        void tileRendered(quint64 key, int generation, const QImage &tile);
+
+    private slots:
+        void storeTile(quint64 key, int generation, const QImage &tile);
+
+    private:
+        // Pyramid level whose resolution is just above scale.
+        int levelForScale(double scale) const;
+        // Image area covered by a tile.
+        QRect tileRect(int level, int x, int y) const;
+        // Stretch a tile in the background.
+        void requestTile(quint64 key, int level, int x, int y);
+        // Abort background work before the image buffer changes.
+        void waitForTiles();
+        QImage createImage(int width, int height) const;
+
+        static quint64 tileKey(int level, int x, int y)
+        {
+            return (static_cast<quint64>(level) << 48) | (static_cast<quint64>(y) << 24) | static_cast<quint64>(x);
+        }
+
+        QSharedPointer<FITSData> m_ImageData;
+        StretchParams m_StretchParams;
+        int m_Levels { 0 };
+
+        /// Stretched tiles, the cost is the size in KiB.
+        QCache<quint64, QPixmap> m_Tiles;
+        /// Tiles being stretched, with the generation they were requested for.
+        QHash<quint64, int> m_Pending;
+        /// Incremented every time tiles are invalidated. Background work for an older generation is dropped.
+        QAtomicInt m_Generation { 0 };
+        /// Generation of the tiles in m_Tiles, older than m_Generation once the image data changed.
+        int m_CacheGeneration { 0 };
+        QThreadPool m_Pool;
+};
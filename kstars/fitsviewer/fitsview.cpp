@@ -19,6 +19,7 @@
 #include "Options.h"
 #include "skymap.h"
 #include "fits_debug.h"
+#include "fitstilepyramid.h"
 #include "stretch.h"
 
 #ifdef HAVE_STELLARSOLVER
@@ -54,6 +55,9 @@
 namespace
 {
 
+// Images with at least this many pixels are displayed through a tile pyramid.
+constexpr qint64 tilePyramidNumPixels = 40 * 1000 * 1000;
+
 // Derive the Green and Blue stretch parameters from their previous values and the
 // changes made to the Red parameters. We apply the same offsets used for Red to the
 // other channels' parameters, but clip them.
@@ -92,21 +96,27 @@ void FITSView::doStretch(QImage *outputImage)
                     static_cast<int>(m_ImageData->height()),
                     m_ImageData->channels(), m_ImageData->dataType());
 
-    StretchParams tempParams;
+    stretch.setParams(displayStretchParams());
+    stretch.run(m_ImageData->getImageBuffer(), outputImage, m_PreviewSampling);
+}
+
+// Returns the parameters the image should be displayed with, computing them if auto-stretching.
+StretchParams FITSView::displayStretchParams()
+{
     if (!stretchImage)
-        tempParams = StretchParams();  // Keeping it linear
-    else if (autoStretch)
+        return StretchParams();  // Keeping it linear
+
+    if (autoStretch)
     {
         // Compute new auto-stretch params.
+        Stretch stretch(static_cast<int>(m_ImageData->width()),
+                        static_cast<int>(m_ImageData->height()),
+                        m_ImageData->channels(), m_ImageData->dataType());
         stretchParams = stretch.computeParams(m_ImageData->getImageBuffer());
-        tempParams = stretchParams;
     }
-    else
-        // Use the existing stretch params.
-        tempParams = stretchParams;
 
-    stretch.setParams(tempParams);
-    stretch.run(m_ImageData->getImageBuffer(), outputImage, m_PreviewSampling);
+    // Otherwise use the existing stretch params.
+    return stretchParams;
 }
 
 // Store stretch parameters, and turn on stretching if it isn't already on.
@@ -438,6 +448,27 @@ bool FITSView::processData()
         m_PreviewSampling = m_AdaptiveSampling;
     }
 
+    // Very large images are stretched tile by tile, only where and at the resolution they are displayed,
+    // so there is no need to sample them down.
+    if (static_cast<qint64>(image_width) * image_height >= tilePyramidNumPixels)
+    {
+        if (!m_TilePyramid)
+        {
+            m_TilePyramid = new FITSTilePyramid(this);
+            connect(m_TilePyramid, &FITSTilePyramid::updated, this, [this](const QRect & rect)
+            {
+                const double scale = currentZoom / ZOOM_DEFAULT;
+                m_ImageFrame->update(QRectF(rect.x() * scale, rect.y() * scale, rect.width() * scale,
+                                            rect.height() * scale).toAlignedRect());
+            });
+        }
+        m_TilePyramid->setImageData(m_ImageData);
+        m_AdaptiveSampling = 1;
+        m_PreviewSampling = 1;
+    }
+    else if (m_TilePyramid)
+        delete m_TilePyramid;
+
     // Rescale to fits window on first load
     if (firstLoad)
     {
@@ -514,7 +545,7 @@ bool FITSView::saveImage(const QString &newFilename)
     const QString ext = QFileInfo(newFilename).suffix();
     if (QImageReader::supportedImageFormats().contains(ext.toLatin1()))
     {
-        rawImage.save(newFilename, ext.toLatin1().constData());
+        getDisplayImage().save(newFilename, ext.toLatin1().constData());
         return true;
     }
 
@@ -619,9 +650,19 @@ bool FITSView::rescale(FITSZoom type)
             break;
     }
 
-    initDisplayImage();
     m_ImageFrame->setScaledContents(true);
-    doStretch(&rawImage);
+    if (m_TilePyramid)
+    {
+        // Tiles are stretched when displayed, the full image is only built if getDisplayImage() is called.
+        rawImage = QImage();
+        displayPixmap = QPixmap();
+        m_TilePyramid->setStretchParams(displayStretchParams());
+    }
+    else
+    {
+        initDisplayImage();
+        doStretch(&rawImage);
+    }
     setWidget(m_ImageFrame);
 
     // This is needed by fitstab, even if the zoom doesn't change, to change the stretch UI.
@@ -695,7 +736,7 @@ void FITSView::ZoomToFit()
     if (!m_ImageData)
         return;
 
-    if (rawImage.isNull() == false)
+    if (rawImage.isNull() == false || m_TilePyramid)
     {
         rescale(ZOOM_FIT_WINDOW);
         updateFrame(true);
@@ -718,6 +759,9 @@ int FITSView::filterStars()
 // See the comment below in getScale() for details.
 bool FITSView::isLargeImage()
 {
+    if (m_TilePyramid)
+        return true;
+
     constexpr int largeImageNumPixels = 1000 * 1000;
     return rawImage.width() * rawImage.height() >= largeImageNumPixels;
 }
@@ -769,6 +813,15 @@ void FITSView::updateFrame(bool now)
 
 void FITSView::updateFrameLargeImage()
 {
+    if (m_TilePyramid)
+    {
+        // The label paints the visible tiles and the overlays itself, see drawTiles().
+        m_ImageFrame->clear();
+        m_ImageFrame->resize((currentZoom / ZOOM_DEFAULT) * QSize(m_ImageData->width(), m_ImageData->height()));
+        m_ImageFrame->update();
+        return;
+    }
+
     if (!displayPixmap.convertFromImage(rawImage))
         return;
 
@@ -785,6 +838,51 @@ void FITSView::updateFrameLargeImage()
     m_ImageFrame->resize(((m_PreviewSampling * currentZoom) / 100.0) * displayPixmap.size());
 }
 
+void FITSView::drawTiles(QPainter *painter, const QRect &area)
+{
+    const double scale = currentZoom / ZOOM_DEFAULT;
+
+    painter->save();
+    painter->scale(scale, scale);
+    m_TilePyramid->draw(painter, QRectF(area.x() / scale, area.y() / scale, area.width() / scale, area.height() / scale),
+                        scale);
+
+    // Overlays are drawn in image coordinates, as with the large-image strategy.
+    QFont font = painter->font();
+    font.setPixelSize(scaleSize(FONT_SIZE));
+    painter->setFont(font);
+
+    drawOverlay(painter, 1.0);
+    drawStarFilter(painter, 1.0);
+    painter->restore();
+}
+
+const QImage &FITSView::getDisplayImage()
+{
+    if (m_TilePyramid && rawImage.isNull())
+    {
+        initDisplayImage();
+        doStretch(&rawImage);
+    }
+    return rawImage;
+}
+
+const QPixmap &FITSView::getDisplayPixmap()
+{
+    // The overlays may have changed since the last call, so the pixmap is drawn again every time.
+    if (m_TilePyramid && displayPixmap.convertFromImage(getDisplayImage()))
+    {
+        QPainter painter(&displayPixmap);
+        QFont font = painter.font();
+        font.setPixelSize(scaleSize(FONT_SIZE));
+        painter.setFont(font);
+
+        drawOverlay(&painter, 1.0);
+        drawStarFilter(&painter, 1.0);
+    }
+    return displayPixmap;
+}
+
 void FITSView::updateFrameSmallImage()
 {
     QImage scaledImage = rawImage.scaled(currentWidth, currentHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
@@ -1007,8 +1105,8 @@ void FITSView::drawMagnifyingGlass(QPainter *painter, double scale)
 
         // Normally we place the magnifying glass rectangle to the right and below the mouse curson.
         // However, if it would be rendered outside the image, put it on the other side.
-        int w = rawImage.width();
-        int h = rawImage.height();
+        int w = m_TilePyramid ? m_ImageData->width() : rawImage.width();
+        int h = m_TilePyramid ? m_ImageData->height() : rawImage.height();
         const int rightLimit = std::min(w, static_cast<int>((horizontalScrollBar()->value() + width()) * 100 / currentZoom));
         const int bottomLimit = std::min(h, static_cast<int>((verticalScrollBar()->value() + height()) * 100 / currentZoom));
         if (winLeft + winXOffset + inputDimension > rightLimit)
@@ -1028,9 +1126,21 @@ void FITSView::drawMagnifyingGlass(QPainter *painter, double scale)
         }
 
         // Finally, draw the magnified image.
-        painter->drawImage(QRect(winLeft * scale, winTop * scale, outputDimension, outputDimension),
-                           rawImage,
-                           QRect(imgLeft, imgTop, inputDimension / magAmount, inputDimension / magAmount));
+        const QRect source(imgLeft, imgTop, inputDimension / magAmount, inputDimension / magAmount);
+        if (m_TilePyramid)
+        {
+            // Only stretch the magnified part of the image, clipped to the image.
+            const QImage magnified = m_TilePyramid->render(source);
+            const QRect clipped = source & QRect(0, 0, w, h);
+            const double ratio = static_cast<double>(outputDimension) / source.width();
+            if (!magnified.isNull())
+                painter->drawImage(QRectF(winLeft * scale + (clipped.x() - imgLeft) * ratio,
+                                          winTop * scale + (clipped.y() - imgTop) * ratio,
+                                          clipped.width() * ratio, clipped.height() * ratio),
+                                   magnified);
+        }
+        else
+            painter->drawImage(QRect(winLeft * scale, winTop * scale, outputDimension, outputDimension), rawImage, source);
         // Draw a white border.
         painter->setPen(QPen(Qt::white, scaleSize(1)));
         painter->drawRect(winLeft * scale, winTop * scale, outputDimension, outputDimension);
@@ -1395,7 +1505,22 @@ void FITSView::drawEQGrid(QPainter * painter, double scale)
 
         painter->setPen(QPen(Qt::yellow));
 
-        QPointF pixelPoint, imagePoint, pPoint;
+        QPointF imagePoint, pPoint;
+
+        // Each grid line is projected in a single batch
+        QVector<QPointF> linePoints, linePixels;
+        QVector<bool> lineValid;
+        auto appendGridPoints = [&](const QVector<QPointF> &points)
+        {
+            if (!m_ImageData->wcsToPixels(points, linePixels, &lineValid))
+                return;
+
+            for (int i = 0; i < linePixels.size(); i++)
+            {
+                if (lineValid[i])
+                    eqGridPoints.append(QPointF(linePixels[i].x() * scale, linePixels[i].y() * scale));
+            }
+        };
 
         //This section draws the RA Gridlines
 
@@ -1410,16 +1535,10 @@ void FITSView::drawEQGrid(QPainter * painter, double scale)
             double increment = std::abs((maxDec - minDec) /
                                         100.0); //This will determine how many points to use to create the RA Line
 
+            linePoints.clear();
             for (double targetDec = minDec; targetDec <= maxDec; targetDec += increment)
-            {
-                SkyPoint pointToGet(target / 15.0, targetDec);
-                bool inImage = m_ImageData->wcsToPixel(pointToGet, pixelPoint, imagePoint);
-                if (inImage)
-                {
-                    QPointF pt(pixelPoint.x() * scale, pixelPoint.y() * scale);
-                    eqGridPoints.append(pt);
-                }
-            }
+                linePoints.append(QPointF(target, targetDec));
+            appendGridPoints(linePoints);
 
             if (eqGridPoints.count() > 1)
             {
@@ -1446,16 +1565,10 @@ void FITSView::drawEQGrid(QPainter * painter, double scale)
                                         100.0); //This will determine how many points to use to create the Dec Line
             double target    = targetDec * decConvert;
 
+            linePoints.clear();
             for (double targetRA = minRA; targetRA <= maxRA; targetRA += increment)
-            {
-                SkyPoint pointToGet(targetRA / 15, targetDec * decConvert);
-                bool inImage = m_ImageData->wcsToPixel(pointToGet, pixelPoint, imagePoint);
-                if (inImage)
-                {
-                    QPointF pt(pixelPoint.x() * scale, pixelPoint.y() * scale);
-                    eqGridPoints.append(pt);
-                }
-            }
+                linePoints.append(QPointF(targetRA, target));
+            appendGridPoints(linePoints);
             if (eqGridPoints.count() > 1)
             {
                 for (int i = 1; i < eqGridPoints.count(); i++)
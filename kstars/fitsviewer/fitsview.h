@@ -46,6 +46,7 @@ class QToolBar;
 
 class FITSData;
 class FITSLabel;
+class FITSTilePyramid;
 
 class FITSView : public QScrollArea
 {
@@ -90,14 +91,9 @@ class FITSView : public QScrollArea
         {
             return currentZoom;
         }
-        const QImage &getDisplayImage() const
-        {
-            return rawImage;
-        }
-        const QPixmap &getDisplayPixmap() const
-        {
-            return displayPixmap;
-        }
+        // Very large images are displayed through tiles, their full display image is only built when requested here.
+        const QImage &getDisplayImage();
+        const QPixmap &getDisplayPixmap();
 
         // Tracking square
         void setTrackingBoxEnabled(bool enable);
@@ -249,6 +245,10 @@ class FITSView : public QScrollArea
         // When sampling = 0, reset to the adaptive sampling value
         void setPreviewSampling(uint8_t value)
         {
+            // Tiles are always stretched at the resolution they are displayed with.
+            if (!m_TilePyramid.isNull())
+                return;
+
             if (value == 0)
             {
                 m_PreviewSampling = m_AdaptiveSampling;
@@ -331,9 +331,12 @@ class FITSView : public QScrollArea
     private:
         bool processData();
         void doStretch(QImage *outputImage);
+        StretchParams displayStretchParams();
         double scaleSize(double size);
         bool isLargeImage();
         void updateFrameLargeImage();
+        // Paint the tiles and overlays covering area of the image label, for very large images.
+        void drawTiles(QPainter *painter, const QRect &area);
         void updateFrameSmallImage();
         bool drawHFR(QPainter * painter, const QString &hfr, int x, int y);
 
@@ -353,6 +356,8 @@ class FITSView : public QScrollArea
         QImage rawImage;
         // Actual pixmap after all the overlays
         QPixmap displayPixmap;
+        // Stretched tiles, used instead of rawImage for very large images
+        QPointer<FITSTilePyramid> m_TilePyramid;
 
         bool firstLoad { true };
         bool markStars { false };
@@ -0,0 +1,341 @@
+/*  FITS Write Queue
+    Write captured frames to disk in the background.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "fitswritequeue.h"
+
+#include "fitsbufferpool.h"
+
+#ifdef WIN32
+// This header must be included before fitsio.h to avoid compiler errors with Visual Studio
+#include <windows.h>
+#endif
+
+#include <fitsio.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <fits_debug.h>
+
+namespace
+{
+// Written files synced to disk at once.
+const int SyncBatchSize = 8;
+// Period over which the throughput is measured, in milliseconds.
+const qint64 ThroughputWindow = 10000;
+}
+
+FITSWriteQueue *FITSWriteQueue::Instance()
+{
+    static FITSWriteQueue queue;
+    return &queue;
+}
+
+FITSWriteQueue::FITSWriteQueue()
+{
+    // Writes are bound by the disk, compression by the processor, a few threads cover both.
+    m_Pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+    m_Clock.start();
+}
+
+FITSWriteQueue::~FITSWriteQueue()
+{
+    m_Pool.waitForDone();
+}
+
+bool FITSWriteQueue::write(const QString &filename, const char *data, size_t size, bool compress)
+{
+    Job job;
+    job.filename = filename;
+    job.size = size;
+    job.compress = compress;
+    job.data = FITSBufferPool::Instance()->acquire(size);
+    if (job.data == nullptr)
+    {
+        qCCritical(KSTARS_FITS) << "Not enough memory to queue" << filename << "for writing.";
+        return false;
+    }
+    memcpy(job.data, data, size);
+
+    {
+        QMutexLocker locker(&m_Mutex);
+        if (m_Pending.size() >= m_Capacity)
+            qCWarning(KSTARS_FITS) << "Write queue is over capacity with" << m_Pending.size() << "frames.";
+        m_Pending.append(filename);
+    }
+
+    QtConcurrent::run(&m_Pool, [this, job]()
+    {
+        process(job);
+    });
+    return true;
+}
+
+void FITSWriteQueue::whenWritten(const QString &filename, QObject *context,
+                                 const std::function<void(const QString &)> &callback)
+{
+    QMutexLocker locker(&m_Mutex);
+    if (!m_Pending.contains(filename))
+    {
+        locker.unlock();
+        // Written already, maybe without compression
+        QString savedAs = filename;
+        if (!QFile::exists(savedAs) && savedAs.endsWith(".fz"))
+            savedAs.chop(3);
+        callback(QFile::exists(savedAs) ? savedAs : QString());
+        return;
+    }
+
+    // Workers emit fileWritten() after removing the file from the pending list under the lock,
+    // so connecting under the lock cannot miss it.
+    auto connection = std::make_shared<QMetaObject::Connection>();
+    *connection = connect(this, &FITSWriteQueue::fileWritten, context,
+                          [filename, callback, connection](const QString & written, const QString & savedAs)
+    {
+        if (written != filename)
+            return;
+        QObject::disconnect(*connection);
+        callback(savedAs);
+    });
+}
+
+void FITSWriteQueue::waitForAll()
+{
+    // Workers sync the last files after leaving the pending list, so wait for the workers themselves.
+    m_Pool.waitForDone();
+}
+
+void FITSWriteQueue::setCapacity(int capacity)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_Capacity = std::max(1, capacity);
+}
+
+int FITSWriteQueue::pending() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_Pending.size();
+}
+
+bool FITSWriteQueue::isFull() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_Pending.size() >= m_Capacity;
+}
+
+double FITSWriteQueue::throughput() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return throughputInternal();
+}
+
+double FITSWriteQueue::throughputInternal() const
+{
+    if (m_Samples.isEmpty())
+        return 0;
+
+    // Writes overlap, so the bytes are divided by the time since the oldest write started.
+    qint64 start = m_Samples.head().start, bytes = 0;
+    for (const auto &sample : m_Samples)
+    {
+        start = std::min(start, sample.start);
+        bytes += sample.bytes;
+    }
+    return bytes * 1000.0 / std::max<qint64>(1, m_Clock.elapsed() - start);
+}
+
+void FITSWriteQueue::process(const Job &job)
+{
+    const qint64 start = m_Clock.elapsed();
+
+    QString savedAs = job.filename;
+    bool success = false;
+    if (job.compress)
+    {
+        success = writeCompressed(job.filename, job.data, job.size);
+        if (!success)
+        {
+            // Keep the frame, but as a plain FITS file: a .fz file is read as compressed
+            QFile::remove(job.filename);
+            if (savedAs.endsWith(".fz"))
+                savedAs.chop(3);
+            qCWarning(KSTARS_FITS) << "Failed to compress" << job.filename << ", writing it uncompressed to" << savedAs;
+            success = writeRaw(savedAs, job.data, job.size);
+        }
+    }
+    else
+        success = writeRaw(job.filename, job.data, job.size);
+
+    FITSBufferPool::Instance()->release(job.data);
+
+    if (success)
+        QFile(savedAs).setPermissions(QFileDevice::ReadUser | QFileDevice::WriteUser | QFileDevice::ReadGroup |
+                                      QFileDevice::ReadOther);
+    else
+    {
+        savedAs.clear();
+        emit writeFailed(job.filename);
+    }
+
+    QStringList toSync;
+    int pending = 0;
+    double rate = 0;
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_Pending.removeOne(job.filename);
+
+        Sample sample;
+        sample.start = start;
+        sample.end = m_Clock.elapsed();
+        sample.bytes = job.size;
+        m_Samples.enqueue(sample);
+        while (m_Samples.head().end < sample.end - ThroughputWindow)
+            m_Samples.dequeue();
+
+        if (success)
+        {
+            m_Unsynced.append(savedAs);
+            m_InputBytes += job.size;
+            m_OutputBytes += QFileInfo(savedAs).size();
+        }
+
+        if (m_Unsynced.size() >= SyncBatchSize || m_Pending.isEmpty())
+        {
+            toSync = m_Unsynced;
+            m_Unsynced.clear();
+        }
+
+        pending = m_Pending.size();
+        rate = throughputInternal();
+
+        if (job.compress && success && pending == 0 && m_InputBytes > 0)
+            qCDebug(KSTARS_FITS) << "Compressed frames use" << QString::number(100.0 * m_OutputBytes / m_InputBytes, 'f', 1)
+                                 << "% of their original size.";
+    }
+
+    syncFiles(toSync);
+    emit fileWritten(job.filename, savedAs);
+    emit statusChanged(pending, rate);
+}
+
+bool FITSWriteQueue::writeRaw(const QString &filename, const uint8_t *data, size_t size)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qCCritical(KSTARS_FITS) << "Unable to open write file:" << filename;
+        return false;
+    }
+
+    const char *buffer = reinterpret_cast<const char *>(data);
+    for (size_t written = 0; written < size;)
+    {
+        const qint64 n = file.write(buffer + written, size - written);
+        if (n <= 0)
+        {
+            qCCritical(KSTARS_FITS) << "Unable to write file:" << filename << file.errorString();
+            return false;
+        }
+        written += n;
+    }
+
+    return file.flush();
+}
+
+bool FITSWriteQueue::writeCompressed(const QString &filename, uint8_t *data, size_t size)
+{
+    int status = 0;
+    fitsfile *input = nullptr, *output = nullptr;
+    void *buffer = data;
+
+    if (fits_open_memfile(&input, filename.toLocal8Bit().data(), READONLY, &buffer, &size, 0, nullptr, &status))
+        return false;
+
+    // The placeholder file created with the name is replaced. The name is used as is, without the
+    // extended file name syntax of CFITSIO, as when the file is read with fits_open_diskfile().
+    QFile::remove(filename);
+    if (fits_create_diskfile(&output, filename.toLocal8Bit().data(), &status))
+    {
+        int closeStatus = 0;
+        fits_close_file(input, &closeStatus);
+        return false;
+    }
+
+    int hdus = 0;
+    fits_get_num_hdus(input, &hdus, &status);
+    for (int i = 1; i <= hdus && status == 0; i++)
+    {
+        int hduType = 0, naxis = 0, bitpix = 0;
+        if (fits_movabs_hdu(input, i, &hduType, &status))
+            break;
+        if (hduType == IMAGE_HDU)
+            fits_get_img_dim(input, &naxis, &status);
+
+        if (hduType != IMAGE_HDU || naxis == 0)
+        {
+            fits_copy_hdu(input, output, 0, &status);
+            continue;
+        }
+
+        // Like fpack, compressed images go to extensions behind an empty primary array.
+        if (i == 1)
+            fits_create_img(output, BYTE_IMG, 0, nullptr, &status);
+
+        // Rice is lossless and efficient for integers. Floating point values are kept exact with gzip.
+        fits_get_img_type(input, &bitpix, &status);
+        if (bitpix > 0)
+            fits_set_compression_type(output, RICE_1, &status);
+        else
+        {
+            fits_set_compression_type(output, GZIP_2, &status);
+            fits_set_quantize_level(output, 0, &status);
+        }
+        fits_img_compress(input, output, &status);
+    }
+
+    int closeStatus = 0;
+    fits_close_file(output, &status);
+    fits_close_file(input, &closeStatus);
+
+    if (status)
+    {
+        char message[FLEN_ERRMSG];
+        fits_get_errstatus(status, message);
+        qCWarning(KSTARS_FITS) << "Compression of" << filename << "failed:" << message;
+        return false;
+    }
+    return true;
+}
+
+void FITSWriteQueue::syncFiles(const QStringList &filenames)
+{
+#ifdef Q_OS_UNIX
+    for (const auto &filename : filenames)
+    {
+        const int fd = ::open(QFile::encodeName(filename).constData(), O_RDONLY);
+        if (fd < 0)
+            continue;
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    // Elsewhere files are only flushed to the system when written.
+    Q_UNUSED(filenames)
+#endif
+}
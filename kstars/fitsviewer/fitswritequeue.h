@@ -0,0 +1,132 @@
+/*  FITS Write Queue
+    Write captured frames to disk in the background.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <cstdint>
+#include <functional>
+
+/**
+ * @brief The FITSWriteQueue class writes FITS files on worker threads.
+ *
+ * Frames are copied when queued, so the caller can reuse its buffer right away, and are optionally tile
+ * compressed while written. Queuing never waits: callers check isFull() before producing more frames.
+ * Written files are synced to disk in batches, once several are written or once the queue is empty.
+ * The queue is shared by all cameras.
+ */
+class FITSWriteQueue : public QObject
+{
+        Q_OBJECT
+
+    public:
+        static FITSWriteQueue *Instance();
+
+        /**
+         * @brief write Queue a FITS file for writing.
+         * @param filename Path of the file, which should end with .fz if compressed. If compression fails,
+         * the file is written uncompressed without the .fz extension, see fileWritten().
+         * @param data Content of the file, copied before returning.
+         * @param compress Tile compress the images of the file, losslessly.
+         * @return False if the frame cannot be copied.
+         */
+        bool write(const QString &filename, const char *data, size_t size, bool compress);
+
+        /**
+         * @brief whenWritten Call back once a queued file is written, or right away if it is not queued.
+         * @param context The callback runs in the thread of this object, and not at all once it is destroyed.
+         * @param callback Receives the name the file was saved under, empty if it could not be written.
+         */
+        void whenWritten(const QString &filename, QObject *context, const std::function<void(const QString &)> &callback);
+
+        /**
+         * @brief waitForAll Wait until all queued files are written, called on exit.
+         */
+        void waitForAll();
+
+        /**
+         * @brief setCapacity Number of frames waiting to be written from which isFull() is true. write() does not
+         * wait, capture polls isFull() before starting the next exposure.
+         */
+        void setCapacity(int capacity);
+
+        /**
+         * @return Number of frames waiting to be written.
+         */
+        int pending() const;
+
+        /**
+         * @return True if as many frames as the capacity are waiting to be written.
+         */
+        bool isFull() const;
+
+        /**
+         * @return Bytes of frames written per second over the last few seconds.
+         */
+        double throughput() const;
+
+    signals:
+        /**
+         * @brief statusChanged Emitted from worker threads once a frame is written.
+         */
+        void statusChanged(int pending, double throughput);
+        void writeFailed(const QString &filename);
+
+        /**
+         * @brief fileWritten Emitted from worker threads once a queued file is processed.
+         * @param filename Name the file was queued with.
+         * @param savedAs Name the file was saved under, without .fz if it could not be compressed. Empty if
+         * the file could not be written.
+         */
+        void fileWritten(const QString &filename, const QString &savedAs);
+
+    private:
+        typedef struct
+        {
+            QString filename;
+            uint8_t *data {nullptr};
+            size_t size {0};
+            bool compress {false};
+        } Job;
+
+        typedef struct
+        {
+            qint64 start {0};
+            qint64 end {0};
+            qint64 bytes {0};
+        } Sample;
+
+        FITSWriteQueue();
+        ~FITSWriteQueue();
+
+        void process(const Job &job);
+        double throughputInternal() const;
+
+        static bool writeRaw(const QString &filename, const uint8_t *data, size_t size);
+        static bool writeCompressed(const QString &filename, uint8_t *data, size_t size);
+        static void syncFiles(const QStringList &filenames);
+
+        QThreadPool m_Pool;
+        mutable QMutex m_Mutex;
+        int m_Capacity {8};
+        // Files queued or being written.
+        QStringList m_Pending;
+        // Files written but not synced yet.
+        QStringList m_Unsynced;
+        QElapsedTimer m_Clock;
+        QQueue<Sample> m_Samples;
+        qint64 m_InputBytes {0};
+        qint64 m_OutputBytes {0};
+};
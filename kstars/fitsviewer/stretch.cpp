@@ -8,10 +8,16 @@
 
 #include "stretch.h"
 
+#include "fitsconvolution.h"
+
 #include <fitsio.h>
 #include <math.h>
 #include <QtConcurrent>
 
+#include <limits>
+#include <type_traits>
+#include <vector>
+
 namespace
 {
 
@@ -48,178 +54,177 @@ T median(T const *values, int size, int sampleBy)
     return median(samples);
 }
 
-// This stretches one channel given the input parameters.
+// The stretch of one channel given the input parameters.
 // Based on the spec in section 8.5.6
 // https://pixinsight.com/doc/docs/XISF-1.0-spec/XISF-1.0-spec.html
-// Uses multiple threads, blocks until done.
 // The extension parameters are not used.
+template <typename T>
+class ChannelStretch
+{
+    public:
+        ChannelStretch(const StretchParams1Channel &params, int inputRange)
+        {
+            // Maximum possible input value (e.g. 1024*64 - 1 for a 16 bit unsigned int).
+            const float maxInput = inputRange > 1 ? inputRange - 1 : inputRange;
+
+            const float highlights = params.highlights;
+            const float shadows    = params.shadows;
+            midtones = params.midtones;
+
+            // Precomputed expressions moved out of the loop.
+            // highlights - shadows, protecting for divide-by-0, in a 0->1.0 scale.
+            const float hsRangeFactor = highlights == shadows ? 1.0f : 1.0f / (highlights - shadows);
+            // Shadow and highlight values translated to the ADU scale.
+            nativeShadows = shadows * maxInput;
+            nativeHighlights = highlights * maxInput;
+            // Constants based on above needed for the stretch calculations.
+            k1 = (midtones - 1) * hsRangeFactor * maxOutput / maxInput;
+            k2 = ((2 * midtones) - 1) * hsRangeFactor / maxInput;
+        }
+
+        uint8_t operator()(T input) const
+        {
+            if (input < nativeShadows) return 0;
+            else if (input >= nativeHighlights) return maxOutput;
+            const T inputFloored = (input - nativeShadows);
+            return (inputFloored * k1) / (inputFloored * k2 - midtones);
+        }
+
+    private:
+        // We're outputting uint8, so the max output is 255.
+        static constexpr int maxOutput = 255;
+
+        float midtones;
+        T nativeShadows;
+        T nativeHighlights;
+        float k1;
+        float k2;
+};
+
+// 8 and 16 bit integer inputs have few enough possible values to tabulate the stretch.
+template <typename T>
+struct HasStretchLUT : std::integral_constant<bool, std::is_integral<T>::value && sizeof(T) <= 2> {};
+
+template <typename T>
+struct StretchLUTSize : std::integral_constant<uint32_t, HasStretchLUT<T>::value ? (1u << (8 * (HasStretchLUT<T>::value ? sizeof(T) : 1))) : 0> {};
+
+// The output of a ChannelStretch for every possible input value, so that the
+// per-pixel work becomes a table lookup.
+template <typename T>
+class StretchLUT
+{
+    public:
+        explicit StretchLUT(const ChannelStretch<T> &stretch) : table(StretchLUTSize<T>::value)
+        {
+            for (uint32_t i = 0; i < table.size(); i++)
+                table[i] = stretch(static_cast<T>(static_cast<int32_t>(i) + std::numeric_limits<T>::min()));
+        }
+
+        uint8_t operator()(T input) const
+        {
+            return table[static_cast<int32_t>(input) - std::numeric_limits<T>::min()];
+        }
+
+    private:
+        std::vector<uint8_t> table;
+};
+
+// A table only pays off when there are more output samples than table entries.
+template <typename T>
+bool useStretchLUT(const QRect &region, int sampling)
+{
+    const int64_t outputSize = static_cast<int64_t>((region.height() + sampling - 1) / sampling) *
+                               ((region.width() + sampling - 1) / sampling);
+    return HasStretchLUT<T>::value && outputSize >= StretchLUTSize<T>::value;
+}
+
+// Writes the stretched region of the channel to the output image, using multiple threads, blocks until done.
 // Sampling is applied to the output (that is, with sampling=2, we compute every other output
 // sample both in width and height, so the output would have about 4X fewer pixels.
-template <typename T>
-void stretchOneChannel(T *input_buffer, QImage *output_image,
-                       const StretchParams &stretch_params,
-                       int input_range, int image_height, int image_width, int sampling)
+template <typename T, typename Stretcher>
+void stretchOneChannel(T const *inputBuffer, QImage *outputImage, const Stretcher &stretch,
+                       int imageWidth, const QRect &region, int sampling)
 {
-    QVector<QFuture<void>> futures;
-
-    // We're outputting uint8, so the max output is 255.
-    constexpr int maxOutput = 255;
-
-    // Maximum possible input value (e.g. 1024*64 - 1 for a 16 bit unsigned int).
-    const float maxInput = input_range > 1 ? input_range - 1 : input_range;
-
-    const float midtones   = stretch_params.grey_red.midtones;
-    const float highlights = stretch_params.grey_red.highlights;
-    const float shadows    = stretch_params.grey_red.shadows;
-
-    // Precomputed expressions moved out of the loop.
-    // highlights - shadows, protecting for divide-by-0, in a 0->1.0 scale.
-    const float hsRangeFactor = highlights == shadows ? 1.0f : 1.0f / (highlights - shadows);
-    // Shadow and highlight values translated to the ADU scale.
-    const T nativeShadows = shadows * maxInput;
-    const T nativeHighlights = highlights * maxInput;
-    // Constants based on above needed for the stretch calculations.
-    const float k1 = (midtones - 1) * hsRangeFactor * maxOutput / maxInput;
-    const float k2 = ((2 * midtones) - 1) * hsRangeFactor / maxInput;
-
-    // Increment the input index by the sampling, the output index increments by 1.
-    for (int j = 0, jout = 0; j < image_height; j += sampling, jout++)
+    uchar * const outputBits = outputImage->bits();
+    const int bytesPerLine = outputImage->bytesPerLine();
+    T const * const regionStart = inputBuffer + region.y() * imageWidth + region.x();
+    const int regionWidth = region.width();
+
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands((region.height() + sampling - 1) / sampling);
+    QtConcurrent::blockingMap(bands, [&](const QPair<int, int> &band)
     {
-        futures.append(QtConcurrent::run([ = ]()
+        // Increment the input index by the sampling, the output index increments by 1.
+        for (int jout = band.first; jout < band.second; jout++)
         {
-            T * inputLine  = input_buffer + j * image_width;
-            auto * scanLine = output_image->scanLine(jout);
+            T const * inputLine  = regionStart + jout * sampling * imageWidth;
+            auto * scanLine = outputBits + jout * bytesPerLine;
 
-            for (int i = 0, iout = 0; i < image_width; i += sampling, iout++)
-            {
-                const T input = inputLine[i];
-                if (input < nativeShadows) scanLine[iout] = 0;
-                else if (input >= nativeHighlights) scanLine[iout] = maxOutput;
-                else
-                {
-                    const T inputFloored = (input - nativeShadows);
-                    scanLine[iout] = (inputFloored * k1) / (inputFloored * k2 - midtones);
-                }
-            }
-        }));
-    }
-    for(QFuture<void> future : futures)
-        future.waitForFinished();
+            for (int i = 0, iout = 0; i < regionWidth; i += sampling, iout++)
+                scanLine[iout] = stretch(inputLine[i]);
+        }
+    });
 }
 
 // This is like the above 1-channel stretch, but extended for 3 channels.
-// This could have been more modular, but the three channels are combined
-// into a single qRgb value at the end, so it seems the simplest thing is to
-// replicate the code. It is assume the colors are not interleaved--the red image
+// It is assumed the colors are not interleaved--the red image
 // is stored fully, then the green, then the blue.
-// Sampling is applied to the output (that is, with sampling=2, we compute every other output
-// sample both in width and height, so the output would have about 4X fewer pixels.
-template <typename T>
-void stretchThreeChannels(T *inputBuffer, QImage *outputImage,
-                          const StretchParams &stretchParams,
-                          int inputRange, int imageHeight, int imageWidth, int sampling)
+template <typename T, typename Stretcher>
+void stretchThreeChannels(T const *inputBuffer, QImage *outputImage,
+                          const Stretcher &stretchR, const Stretcher &stretchG, const Stretcher &stretchB,
+                          int imageWidth, int imageHeight, const QRect &region, int sampling)
 {
-    QVector<QFuture<void>> futures;
-
-    // We're outputting uint8, so the max output is 255.
-    constexpr int maxOutput = 255;
-
-    // Maximum possible input value (e.g. 1024*64 - 1 for a 16 bit unsigned int).
-    const float maxInput = inputRange > 1 ? inputRange - 1 : inputRange;
-
-    const float midtonesR   = stretchParams.grey_red.midtones;
-    const float highlightsR = stretchParams.grey_red.highlights;
-    const float shadowsR    = stretchParams.grey_red.shadows;
-    const float midtonesG   = stretchParams.green.midtones;
-    const float highlightsG = stretchParams.green.highlights;
-    const float shadowsG    = stretchParams.green.shadows;
-    const float midtonesB   = stretchParams.blue.midtones;
-    const float highlightsB = stretchParams.blue.highlights;
-    const float shadowsB    = stretchParams.blue.shadows;
-
-    // Precomputed expressions moved out of the loop.
-    // highlights - shadows, protecting for divide-by-0, in a 0->1.0 scale.
-    const float hsRangeFactorR = highlightsR == shadowsR ? 1.0f : 1.0f / (highlightsR - shadowsR);
-    const float hsRangeFactorG = highlightsG == shadowsG ? 1.0f : 1.0f / (highlightsG - shadowsG);
-    const float hsRangeFactorB = highlightsB == shadowsB ? 1.0f : 1.0f / (highlightsB - shadowsB);
-    // Shadow and highlight values translated to the ADU scale.
-    const T nativeShadowsR = shadowsR * maxInput;
-    const T nativeShadowsG = shadowsG * maxInput;
-    const T nativeShadowsB = shadowsB * maxInput;
-    const T nativeHighlightsR = highlightsR * maxInput;
-    const T nativeHighlightsG = highlightsG * maxInput;
-    const T nativeHighlightsB = highlightsB * maxInput;
-    // Constants based on above needed for the stretch calculations.
-    const float k1R = (midtonesR - 1) * hsRangeFactorR * maxOutput / maxInput;
-    const float k1G = (midtonesG - 1) * hsRangeFactorG * maxOutput / maxInput;
-    const float k1B = (midtonesB - 1) * hsRangeFactorB * maxOutput / maxInput;
-    const float k2R = ((2 * midtonesR) - 1) * hsRangeFactorR / maxInput;
-    const float k2G = ((2 * midtonesG) - 1) * hsRangeFactorG / maxInput;
-    const float k2B = ((2 * midtonesB) - 1) * hsRangeFactorB / maxInput;
-
+    uchar * const outputBits = outputImage->bits();
+    const int bytesPerLine = outputImage->bytesPerLine();
     const int size = imageWidth * imageHeight;
+    T const * const regionStart = inputBuffer + region.y() * imageWidth + region.x();
+    const int regionWidth = region.width();
 
-    for (int j = 0, jout = 0; j < imageHeight; j += sampling, jout++)
+    QVector<QPair<int, int>> bands = FITSConvolution::rowBands((region.height() + sampling - 1) / sampling);
+    QtConcurrent::blockingMap(bands, [&](const QPair<int, int> &band)
     {
-        futures.append(QtConcurrent::run([ = ]()
+        for (int jout = band.first; jout < band.second; jout++)
         {
             // R, G, B input images are stored one after another.
-            T * inputLineR  = inputBuffer + j * imageWidth;
-            T * inputLineG  = inputLineR + size;
-            T * inputLineB  = inputLineG + size;
+            T const * inputLineR  = regionStart + jout * sampling * imageWidth;
+            T const * inputLineG  = inputLineR + size;
+            T const * inputLineB  = inputLineG + size;
 
-            auto * scanLine = reinterpret_cast<QRgb*>(outputImage->scanLine(jout));
+            auto * scanLine = reinterpret_cast<QRgb*>(outputBits + jout * bytesPerLine);
 
-            for (int i = 0, iout = 0; i < imageWidth; i += sampling, iout++)
-            {
-                const T inputR = inputLineR[i];
-                const T inputG = inputLineG[i];
-                const T inputB = inputLineB[i];
-
-                uint8_t red, green, blue;
-
-                if (inputR < nativeShadowsR) red = 0;
-                else if (inputR >= nativeHighlightsR) red = maxOutput;
-                else
-                {
-                    const T inputFloored = (inputR - nativeShadowsR);
-                    red = (inputFloored * k1R) / (inputFloored * k2R - midtonesR);
-                }
-
-                if (inputG < nativeShadowsG) green = 0;
-                else if (inputG >= nativeHighlightsG) green = maxOutput;
-                else
-                {
-                    const T inputFloored = (inputG - nativeShadowsG);
-                    green = (inputFloored * k1G) / (inputFloored * k2G - midtonesG);
-                }
-
-                if (inputB < nativeShadowsB) blue = 0;
-                else if (inputB >= nativeHighlightsB) blue = maxOutput;
-                else
-                {
-                    const T inputFloored = (inputB - nativeShadowsB);
-                    blue = (inputFloored * k1B) / (inputFloored * k2B - midtonesB);
-                }
-                scanLine[iout] = qRgb(red, green, blue);
-            }
-        }));
-    }
-    for(QFuture<void> future : futures)
-        future.waitForFinished();
+            for (int i = 0, iout = 0; i < regionWidth; i += sampling, iout++)
+                scanLine[iout] = qRgb(stretchR(inputLineR[i]), stretchG(inputLineG[i]), stretchB(inputLineB[i]));
+        }
+    });
 }
 
 template <typename T>
-void stretchChannels(T *input_buffer, QImage *output_image,
+void stretchChannels(T const *input_buffer, QImage *output_image,
                      const StretchParams &stretch_params,
-                     int input_range, int image_height, int image_width, int num_channels, int sampling)
+                     int input_range, int image_height, int image_width, int num_channels,
+                     const QRect &region, int sampling, bool use_lookup_table)
 {
+    const bool lut = use_lookup_table && useStretchLUT<T>(region, sampling);
+
     if (num_channels == 1)
-        stretchOneChannel(input_buffer, output_image, stretch_params, input_range,
-                          image_height, image_width, sampling);
+    {
+        const ChannelStretch<T> stretch(stretch_params.grey_red, input_range);
+        if (lut)
+            stretchOneChannel(input_buffer, output_image, StretchLUT<T>(stretch), image_width, region, sampling);
+        else
+            stretchOneChannel(input_buffer, output_image, stretch, image_width, region, sampling);
+    }
     else if (num_channels == 3)
-        stretchThreeChannels(input_buffer, output_image, stretch_params, input_range,
-                             image_height, image_width, sampling);
+    {
+        const ChannelStretch<T> stretchR(stretch_params.grey_red, input_range);
+        const ChannelStretch<T> stretchG(stretch_params.green, input_range);
+        const ChannelStretch<T> stretchB(stretch_params.blue, input_range);
+        if (lut)
+            stretchThreeChannels(input_buffer, output_image, StretchLUT<T>(stretchR), StretchLUT<T>(stretchG),
+                                 StretchLUT<T>(stretchB), image_width, image_height, region, sampling);
+        else
+            stretchThreeChannels(input_buffer, output_image, stretchR, stretchG, stretchB,
+                                 image_width, image_height, region, sampling);
+    }
 }
 
 // See section 8.5.7 in above link  https://pixinsight.com/doc/docs/XISF-1.0-spec/XISF-1.0-spec.html
@@ -322,39 +327,45 @@ Stretch::Stretch(int width, int height, int channels, int data_type)
 
 void Stretch::run(uint8_t const *input, QImage *outputImage, int sampling)
 {
-    Q_ASSERT(outputImage->width() == (image_width + sampling - 1) / sampling);
-    Q_ASSERT(outputImage->height() == (image_height + sampling - 1) / sampling);
+    run(input, outputImage, QRect(0, 0, image_width, image_height), sampling);
+}
+
+void Stretch::run(uint8_t const *input, QImage *outputImage, const QRect &region, int sampling)
+{
+    Q_ASSERT(QRect(0, 0, image_width, image_height).contains(region));
+    Q_ASSERT(outputImage->width() == (region.width() + sampling - 1) / sampling);
+    Q_ASSERT(outputImage->height() == (region.height() + sampling - 1) / sampling);
     recalculateInputRange(input);
 
     switch (dataType)
     {
         case TBYTE:
             stretchChannels(reinterpret_cast<uint8_t const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, region, sampling, useLookupTable);
             break;
         case TSHORT:
             stretchChannels(reinterpret_cast<short const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, region, sampling, useLookupTable);
             break;
         case TUSHORT:
             stretchChannels(reinterpret_cast<unsigned short const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, region, sampling, useLookupTable);
             break;
         case TLONG:
             stretchChannels(reinterpret_cast<long const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, region, sampling, useLookupTable);
             break;
         case TFLOAT:
             stretchChannels(reinterpret_cast<float const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, region, sampling, useLookupTable);
             break;
         case TLONGLONG:
             stretchChannels(reinterpret_cast<long long const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, region, sampling, useLookupTable);
             break;
         case TDOUBLE:
             stretchChannels(reinterpret_cast<double const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, region, sampling, useLookupTable);
             break;
         default:
             break;
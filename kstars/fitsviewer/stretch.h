@@ -83,6 +83,20 @@ class Stretch
          */
         void run(uint8_t const *input, QImage *output_image, int sampling=1);
 
+        /**
+         * @brief run Same as above, but only stretches a region of the image.
+         * @param region The part of the image to stretch, in image coordinates.
+         * @note output_image should be the size of the region, divided by sampling.
+         */
+        void run(uint8_t const *input, QImage *output_image, const QRect &region, int sampling=1);
+
+        /**
+         * @brief setUseLookupTable Enables the lookup table path for 8 and 16 bit integer images (the default).
+         * With it, the stretch of every possible input value is computed once per run, and each pixel costs a
+         * table lookup. Disabling it evaluates the stretch for every pixel, the results are identical.
+         */
+        void setUseLookupTable(bool enable) { useLookupTable = enable; }
+
  private:
         // Adjusts input_range for float and double types.
         void recalculateInputRange(const uint8_t *input);
@@ -93,6 +107,7 @@ class Stretch
         int image_channels;
         int input_range;
         int dataType;
+        bool useLookupTable { true };
   
         // Parameters.
         StretchParams params;
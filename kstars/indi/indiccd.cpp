@@ -24,6 +24,7 @@
 //#include "ekos/manager.h"
 #ifdef HAVE_CFITSIO
 #include "fitsviewer/fitsdata.h"
+#include "fitsviewer/fitswritequeue.h"
 #endif
 
 #include <KNotifications/KNotification>
@@ -873,10 +874,6 @@ CCD::~CCD()
 {
     if (m_ImageViewerWindow)
         m_ImageViewerWindow->close();
-    if (fileWriteThread.isRunning())
-        fileWriteThread.waitForFinished();
-    if (fileWriteBuffer != nullptr)
-        delete [] fileWriteBuffer;
 }
 
 void CCD::setBLOBManager(const char *device, INDI::Property prop)
@@ -1401,33 +1398,12 @@ bool CCD::writeImageFile(const QString &filename, IBLOB *bp, bool is_fits)
     // Would need to deal with the raw conversion, etc.
     if (is_fits)
     {
-        // Check if the last write is still ongoing, and if so wait.
-        // It is using the fileWriteBuffer.
-        if (fileWriteThread.isRunning())
-        {
-            fileWriteThread.waitForFinished();
-        }
-
-        // Wait until the file is written before overwritting the filename.
-        fileWriteFilename = filename;
-
-        // Will write blob data in a separate thread, and can't depend on the blob
-        // memory, so copy it first.
-
-        // Check buffer size.
-        if (fileWriteBufferSize != bp->size)
-        {
-            if (fileWriteBuffer != nullptr)
-                delete [] fileWriteBuffer;
-            fileWriteBufferSize = bp->size;
-            fileWriteBuffer = new char[fileWriteBufferSize];
-        }
-
-        // Copy memory, and write file on a separate thread.
+        // The queue copies the blob and writes it on a worker thread, compressed if the name asks for it.
         // Probably too late to return an error if the file couldn't write.
-        memcpy(fileWriteBuffer, bp->blob, bp->size);
-        fileWriteThread = QtConcurrent::run(WriteImageFileInternal, fileWriteFilename, fileWriteBuffer, bp->size);
-        //filter = "";
+        FITSWriteQueue::Instance()->setCapacity(Options::captureWriteQueueDepth());
+        if (!FITSWriteQueue::Instance()->write(filename, static_cast<const char *>(bp->blob), bp->size,
+                                               filename.endsWith(".fz")))
+            return false;
     }
     else
     {
@@ -1536,7 +1512,9 @@ void CCD::processBLOB(IBLOB *bp)
     {
         // If either generating file name or writing the image file fails
         // then return
-        if (!generateFilename(format, targetChip->isBatchMode(), &filename) ||
+        // Captured FITS frames are compressed while written if requested.
+        const QString fileFormat = (BType == BLOB_FITS && Options::compressCapturedFrames()) ? format + ".fz" : format;
+        if (!generateFilename(fileFormat, targetChip->isBatchMode(), &filename) ||
                 !writeImageFile(filename, bp, BType == BLOB_FITS))
         {
             emit BLOBUpdated(nullptr);
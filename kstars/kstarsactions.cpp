@@ -82,6 +82,7 @@
 
 #ifdef HAVE_CFITSIO
 #include "fitsviewer/fitsviewer.h"
+#include "fitsviewer/fitswritequeue.h"
 #include "fitsviewer/opsfits.h"
 #ifdef HAVE_INDI
 #include "ekos/manager.h"
@@ -1953,6 +1954,11 @@ void KStars::slotAboutToQuit()
     //synch the config file with the Config object
     writeConfig();
 
+#ifdef HAVE_CFITSIO
+    // Captured frames still queued for writing must reach the disk before exiting
+    FITSWriteQueue::Instance()->waitForAll();
+#endif
+
     //Terminate Child Processes if on OS X
 #ifdef Q_OS_OSX
     QProcess *quit = new QProcess(this);
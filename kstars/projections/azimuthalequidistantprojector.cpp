@@ -44,6 +44,12 @@ double AzimuthalEquidistantProjector::projectionK(double x) const
     return ((crad != 0) ? crad / sin(crad) : 1); // This handles the 0/0 case. The limit of x / sin(x) is 1 as x -> 0.
 }
 
+Projector::Batch AzimuthalEquidistantProjector::projectionK(const Batch &c) const
+{
+    const Batch crad = c.min(1.0f).acos();
+    return (crad != 0.0f).select(crad / crad.sin(), 1.0f);
+}
+
 double AzimuthalEquidistantProjector::projectionL(double x) const
 {
     return x;
@@ -70,6 +70,21 @@ Vector2f EquirectangularProjector::toScreenVec(const SkyPoint *o, bool oRefract,
     return p;
 }
 
+void EquirectangularProjector::projectBatch(const Batch &dX, const Batch &Y, const Batch &dY, bool oRefract, Batch &x,
+                                            Batch &y, BatchMask &visible) const
+{
+    Q_UNUSED(Y)
+
+    // toScreenVec() refracts the focus like the points, where dY is taken from the refracted focus
+    float shift = 0;
+    if (m_vp.useAltAz && !oRefract)
+        shift = SkyPoint::refract(m_vp.focus->alt(), m_vp.useRefraction).radians() - m_vp.focus->alt().radians();
+
+    x       = 0.5f * m_vp.width - m_vp.zoomFactor * dX;
+    y       = 0.5f * m_vp.height - m_vp.zoomFactor * (dY + shift);
+    visible = x > 0.0f && x < m_vp.width;
+}
+
 SkyPoint EquirectangularProjector::fromScreen(const QPointF &p, dms *LST, const dms *lat, bool onlyAltAz) const
 {
     SkyPoint result;
@@ -39,6 +39,10 @@ class EquirectangularProjector : public Projector
         SkyPoint fromScreen(const QPointF &p, dms *LST, const dms *lat, bool onlyAltAz = false) const override;
         QVector<Vector2f> groundPoly(SkyPoint *labelpoint = nullptr, bool *drawLabel = nullptr) const override;
         void updateClipPoly() override;
+
+    protected:
+        void projectBatch(const Batch &dX, const Batch &Y, const Batch &dY, bool oRefract, Batch &x, Batch &y,
+                          BatchMask &visible) const override;
 };
 
 #endif // EQUIRECTANGULARPROJECTOR_H
@@ -39,6 +39,11 @@ double GnomonicProjector::projectionK(double x) const
     return 1.0 / x;
 }
 
+Projector::Batch GnomonicProjector::projectionK(const Batch &c) const
+{
+    return c.inverse();
+}
+
 double GnomonicProjector::projectionL(double x) const
 {
     return atan(x);
@@ -39,6 +39,11 @@ double LambertProjector::projectionK(double x) const
     return sqrt(2.0 / (1.0 + x));
 }
 
+Projector::Batch LambertProjector::projectionK(const Batch &c) const
+{
+    return (2.0f / (1.0f + c)).sqrt();
+}
+
 double LambertProjector::projectionL(double x) const
 {
     return 2.0 * asin(0.5 * x);
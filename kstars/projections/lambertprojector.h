@@ -36,6 +36,7 @@ class LambertProjector : public Projector
     Projection type() const override;
     double radius() const override;
     double projectionK(double x) const override;
+    Batch projectionK(const Batch &c) const override;
     double projectionL(double x) const override;
 };
 
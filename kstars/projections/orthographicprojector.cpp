@@ -40,6 +40,11 @@ double OrthographicProjector::projectionK(double x) const
     return 1.0;
 }
 
+Projector::Batch OrthographicProjector::projectionK(const Batch &c) const
+{
+    return Batch::Ones(c.size());
+}
+
 double OrthographicProjector::projectionL(double x) const
 {
     return asin(x);
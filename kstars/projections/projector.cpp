@@ -25,8 +25,23 @@
 #endif
 #include "skycomponents/skylabeler.h"
 
+#include <algorithm>
+
 namespace
 {
+typedef Map<const Array<float, Dynamic, 1>> ConstArray;
+
+// SkyPoint::refract() on a batch of altitudes in degrees
+Projector::Batch refract(const Projector::Batch &alt)
+{
+    static const float corrCrit = SkyPoint::refractionCorr(SkyPoint::altCrit);
+    const float altCrit         = SkyPoint::altCrit;
+
+    const Projector::Batch angle = (alt + 10.3f / (alt + 5.11f)) * float(dms::DegToRad);
+    const Projector::Batch corr  = angle.cos() / angle.sin() * float(1.02 / 60);
+    return (alt > altCrit).select(alt + corr, alt + corrCrit * (alt + 90.0f) / (altCrit + 90.0f));
+}
+
 void toXYZ(const SkyPoint *p, double *x, double *y, double *z)
 {
     double sinRa, sinDec, cosRa, cosDec;
@@ -48,6 +63,8 @@ SkyPoint Projector::pointAt(double az)
     return p;
 }
 
+constexpr int Projector::BatchSize;
+
 Projector::Projector(const ViewParams &p)
 {
     m_data = KStarsData::Instance();
@@ -563,3 +580,140 @@ Vector2f Projector::toScreenVec(const SkyPoint *o, bool oRefract, bool *onVisibl
 #endif
     return Vector2f(x, y);
 }
+
+void Projector::toScreenBatch(int count, const float *ra, const float *dec, const float *alt, const float *az, float *x,
+                              float *y, bool *visible, bool oRefract) const
+{
+    oRefract &= m_vp.useRefraction;
+
+    // Offsets from the focus are taken in double precision, before the single precision arithmetic
+    double X0, Y0;
+    if (m_vp.useAltAz)
+    {
+        X0 = m_vp.focus->az().radians();
+        Y0 = SkyPoint::refract(m_vp.focus->alt(), m_vp.useRefraction).radians();
+    }
+    else
+    {
+        X0 = m_vp.focus->ra().radians();
+        Y0 = m_vp.focus->dec().radians();
+    }
+
+    for (int first = 0; first < count; first += BatchSize)
+    {
+        const int n           = std::min(BatchSize, count - first);
+        const Batch altitudes = ConstArray(alt + first, n);
+        Array<double, Dynamic, 1, 0, BatchSize, 1> offsets;
+        Batch Y;
+
+        if (m_vp.useAltAz)
+        {
+            offsets = X0 - ConstArray(az + first, n).cast<double>() * dms::DegToRad;
+            Y       = (oRefract ? refract(altitudes) : altitudes) * float(dms::DegToRad);
+        }
+        else
+        {
+            offsets = ConstArray(ra + first, n).cast<double>() * (M_PI / 12.0) - X0;
+            Y       = ConstArray(dec + first, n) * float(dms::DegToRad);
+        }
+        // Reduced before the single precision, points across 0h would be a full turn away otherwise
+        const Batch dX = (offsets - (2 * M_PI) * (offsets * (0.5 / M_PI)).round()).cast<float>();
+        const Batch dY = (Y.cast<double>() - Y0).cast<float>();
+
+        screenBatch(dX, Y, dY, altitudes, oRefract, x + first, y + first, visible + first);
+    }
+}
+
+void Projector::toScreenBatch(int count, const SkyPoint *const *points, float *x, float *y, bool *visible,
+                              bool oRefract) const
+{
+    oRefract &= m_vp.useRefraction;
+
+    Batch dX(BatchSize), Y(BatchSize), dY(BatchSize), alt(BatchSize);
+    const double Y0 = m_vp.useAltAz ? SkyPoint::refract(m_vp.focus->alt(), m_vp.useRefraction).radians() :
+                      m_vp.focus->dec().radians();
+
+    for (int first = 0; first < count; first += BatchSize)
+    {
+        const int n = std::min(BatchSize, count - first);
+        dX.resize(n);
+        Y.resize(n);
+        dY.resize(n);
+        alt.resize(n);
+
+        for (int i = 0; i < n; ++i)
+        {
+            const SkyPoint *o = points[first + i];
+            double Yo, offset;
+            if (m_vp.useAltAz)
+            {
+                Yo     = SkyPoint::refract(o->alt(), oRefract).radians();
+                offset = m_vp.focus->az().radians() - o->az().radians();
+            }
+            else
+            {
+                Yo     = o->dec().radians();
+                offset = o->ra().radians() - m_vp.focus->ra().radians();
+            }
+            dX[i]  = KSUtils::reduceAngle(offset, -dms::PI, dms::PI);
+            Y[i]   = Yo;
+            dY[i]  = Yo - Y0;
+            alt[i] = o->alt().Degrees();
+        }
+
+        screenBatch(dX, Y, dY, alt, oRefract, x + first, y + first, visible + first);
+    }
+}
+
+void Projector::screenBatch(const Batch &dX, const Batch &Y, const Batch &dY, const Batch &alt, bool oRefract, float *x,
+                            float *y, bool *visible) const
+{
+    const int n = dX.size();
+    Batch px(n), py(n);
+    BatchMask mask(n);
+
+    projectBatch(dX, Y, dY, oRefract, px, py, mask);
+
+    // As checkVisibility() and onScreen()
+    mask = mask && px.isFinite() && py.isFinite() && px >= 0.0f && px <= m_vp.width && py >= 0.0f && py <= m_vp.height;
+    if (m_vp.fillGround)
+        mask = mask && alt > float(SkyPoint::altCrit);
+
+    Map<Array<float, Dynamic, 1>>(x, n) = px;
+    Map<Array<float, Dynamic, 1>>(y, n) = py;
+    Map<Array<bool, Dynamic, 1>>(visible, n) = mask;
+}
+
+void Projector::projectBatch(const Batch &dX, const Batch &Y, const Batch &dY, bool oRefract, Batch &x, Batch &y,
+                             BatchMask &visible) const
+{
+    Q_UNUSED(oRefract)
+
+    const float sinY0 = m_sinY0, cosY0 = m_cosY0;
+    const Batch cosY  = Y.cos();
+    const Batch sindX = dX.sin();
+    // 1 - cos(dX), without the cancellation near the focus
+    const Batch versdX = 2.0f * (0.5f * dX).sin().square();
+
+    // The same as in toScreenVec(), as offsets from the focus
+    const Batch c = dY.cos() - cosY0 * cosY * versdX;
+    visible       = c > float(cosMaxFieldAngle());
+
+    const Batch k = projectionK(c) * m_vp.zoomFactor;
+    x             = 0.5f * m_vp.width - k * cosY * sindX;
+    y             = 0.5f * m_vp.height - k * (dY.sin() + sinY0 * cosY * versdX);
+#ifdef KSTARS_LITE
+    double skyRotation = SkyMapLite::Instance()->getSkyRotation();
+    if (skyRotation != 0)
+    {
+        dms rotation(skyRotation);
+        double cosT, sinT;
+
+        rotation.SinCos(sinT, cosT);
+
+        const Batch dx = x - 0.5f * m_vp.width, dy = y - 0.5f * m_vp.height;
+        x = 0.5f * m_vp.width + dx * float(cosT) - dy * float(sinT);
+        y = 0.5f * m_vp.height + dx * float(sinT) + dy * float(cosT);
+    }
+#endif
+}
@@ -99,6 +99,12 @@ class Projector
         };
         Q_ENUM(Projection)
 
+        /** Number of points projected together by toScreenBatch() */
+        static constexpr int BatchSize = 256;
+        /** A batch of values, kept on the stack */
+        typedef Array<float, Dynamic, 1, 0, BatchSize, 1> Batch;
+        typedef Array<bool, Dynamic, 1, 0, BatchSize, 1> BatchMask;
+
         /** Return the type of this projection */
         Q_INVOKABLE virtual Projection type() const = 0;
 
@@ -146,6 +152,34 @@ class Projector
          */
         QPointF toScreen(const SkyPoint *o, bool oRefract = true, bool *onVisibleHemisphere = nullptr) const;
 
+        /**
+         * Project many points at once, as toScreenVec() does for each of them.
+         *
+         * The points are given by their current coordinates, the way StarBlock keeps them: right
+         * ascensions in hours, declinations, altitudes and azimuths in degrees. Only the pair used by
+         * the view is read, except for the altitudes which are always needed for the ground.
+         *
+         * The projection is done on batches of points with Eigen, so that it runs on SIMD registers,
+         * and the projection-specific code is called once per batch instead of once per point.
+         *
+         * @param count the number of points
+         * @param x screen pixel x coordinates
+         * @param y screen pixel y coordinates
+         * @param visible set to whether each point can be drawn: on the visible part of the
+         *   projection, on screen, and not under the ground if it is filled. This is what
+         *   SkyPainter::drawPointSource() checks with checkVisibility(), toScreen() and onScreen().
+         * @param oRefract true = use Options::useRefraction() value.
+         */
+        void toScreenBatch(int count, const float *ra, const float *dec, const float *alt, const float *az, float *x,
+                           float *y, bool *visible, bool oRefract = true) const;
+
+        /**
+         * This is the same as the toScreenBatch() above, for points given as SkyPoints. Their
+         * horizontal coordinates must be correct, as for checkVisibility().
+         */
+        void toScreenBatch(int count, const SkyPoint *const *points, float *x, float *y, bool *visible,
+                           bool oRefract = true) const;
+
         /**
          * @short Determine RA, Dec coordinates of the pixel at (dx, dy), which are the
          * screen pixel coordinate offsets from the center of the Sky pixmap.
@@ -297,6 +331,31 @@ class Projector
             return 0;
         }
 
+        /**
+         * This is the batch version of projectionK(double), which must be reimplemented along with it.
+         * @see toScreenBatch()
+         */
+        virtual Batch projectionK(const Batch &c) const
+        {
+            return c;
+        }
+
+        /**
+         * Project a batch of points, as toScreenVec() does. Equirectangular projection needs its own.
+         *
+         * @param dX the offsets in azimuth or right ascension, in radians, with the same sign as in
+         *   toScreenVec(), reduced to [-PI, PI] as in toScreenVec().
+         * @param Y the altitudes, refracted as needed, or declinations, in radians
+         * @param dY the offsets from the altitude or declination of the focus, in radians. They are
+         *   passed separately so that points close to the focus keep their precision in single
+         *   precision arithmetic.
+         * @param oRefract whether the points were refracted
+         * @param x, y screen pixel coordinates of the points
+         * @param visible whether the points are on the visible part of the projection
+         */
+        virtual void projectBatch(const Batch &dX, const Batch &Y, const Batch &dY, bool oRefract, Batch &x, Batch &y,
+                                  BatchMask &visible) const;
+
         /**
          * Helper function for drawing ground.
          * @return the point with Alt = 0, az = @p az
@@ -311,6 +370,10 @@ class Projector
         QPolygonF m_clipPolygon;
 
     private:
+        /** Project a batch, then mask the points off screen or under the ground */
+        void screenBatch(const Batch &dX, const Batch &Y, const Batch &dY, const Batch &alt, bool oRefract, float *x,
+                         float *y, bool *visible) const;
+
         //Used by CheckVisibility
         double m_xrange { 0 };
         bool m_isPoleVisible { false };
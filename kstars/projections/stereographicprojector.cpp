@@ -39,6 +39,11 @@ double StereographicProjector::projectionK(double x) const
     return 2.0 / (1.0 + x);
 }
 
+Projector::Batch StereographicProjector::projectionK(const Batch &c) const
+{
+    return 2.0f / (1.0f + c);
+}
+
 double StereographicProjector::projectionL(double x) const
 {
     return 2.0 * atan2(x, 2.0);
@@ -46,6 +46,8 @@
 #include <QPen>
 
 #include <cmath>
+#include <memory>
+#include <vector>
 
 AsteroidsComponent::AsteroidsComponent(SolarSystemComposite *parent) : BinaryListComponent(this, "asteroids"),
     SolarSystemListComponent(parent)
@@ -214,6 +216,11 @@ void AsteroidsComponent::draw(SkyPainter *skyp)
 
     skyp->setBrush(QBrush(QColor("gray")));
 
+    // Asteroids without an image are drawn as point sources, projected together
+    std::vector<const SkyPoint *> points;
+    std::vector<KSAsteroid *> sources;
+    std::vector<float> mags;
+
     foreach (SkyObject *so, m_ObjectList)
     {
         KSAsteroid *ast = dynamic_cast<KSAsteroid *>(so);
@@ -221,16 +228,26 @@ void AsteroidsComponent::draw(SkyPainter *skyp)
         if (!ast->toDraw() || std::isnan(ast->mag()) || ast->mag() > showLimit)
             continue;
 
-        bool drawn = false;
-
-        if (ast->image().isNull() == false)
-            drawn = skyp->drawPlanet(ast);
-        else
-            drawn = skyp->drawPointSource(ast, ast->mag());
+        if (ast->image().isNull())
+        {
+            points.push_back(ast);
+            sources.push_back(ast);
+            mags.push_back(ast->mag());
+            continue;
+        }
 
-        if (drawn && !(hideLabels || ast->mag() >= labelMagLimit))
+        if (skyp->drawPlanet(ast) && !(hideLabels || ast->mag() >= labelMagLimit))
             SkyLabeler::AddLabel(ast, SkyLabeler::ASTEROID_LABEL);
     }
+
+    std::unique_ptr<bool[]> drawn(new bool[sources.size()]);
+    skyp->drawPointSources(sources.size(), points.data(), mags.data(), drawn.get());
+
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        if (drawn[i] && !(hideLabels || sources[i]->mag() >= labelMagLimit))
+            SkyLabeler::AddLabel(sources[i], SkyLabeler::ASTEROID_LABEL);
+    }
 #endif
 }
 
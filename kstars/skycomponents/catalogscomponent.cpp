@@ -16,6 +16,7 @@
  ***************************************************************************/
 
 #include <cmath>
+#include <memory>
 #include "catalogscomponent.h"
 #include "skypainter.h"
 #include "skymap.h"
@@ -49,6 +50,16 @@ CatalogsComponent::CatalogsComponent(SkyComposite *parent, const QString &db_fil
 
     m_catalog_colors = m_db_manager.get_catalog_colors();
     tryImportSkyComponents();
+
+    m_loader.reset(new CatalogsLoader(m_db_manager.db_file_name()));
+    QObject::connect(m_loader.get(), &CatalogsLoader::loaded, m_loader.get(),
+                     []() { SkyMap::Instance()->forceUpdate(); });
+    QObject::connect(m_loader.get(), &CatalogsLoader::failed, m_loader.get(),
+                     [](const QString &message, const QString &details) {
+                         KMessageBox::detailedError(nullptr, message, details);
+                     });
+    m_loader->start(QThread::LowPriority);
+
     qCInfo(KSTARS) << "Loaded DSO catalogs.";
 }
 
@@ -95,9 +106,14 @@ void CatalogsComponent::draw(SkyPainter *skyp)
 
     updateSkyMesh(map);
 
+    takeLoadedTrixels();
+
     MeshIterator region(m_skyMesh, DRAW_BUF);
 
     size_t num_trixels{ 0 };
+    std::vector<Trixel> misses;
+    std::vector<CatalogObject *> candidates;
+    std::vector<const SkyPoint *> points;
 
     while (region.hasNext())
     {
@@ -107,6 +123,14 @@ void CatalogsComponent::draw(SkyPainter *skyp)
         auto &objects = m_cache[trixel];
         if (!objects.is_set())
         {
+            if (m_loader->isRunning())
+            {
+                // drawn once the loader is done with it
+                misses.push_back(trixel);
+                continue;
+            }
+
+            // the loader could not open the database
             try
             {
                 objects = m_db_manager.get_objects_in_trixel(trixel);
@@ -117,11 +141,8 @@ void CatalogsComponent::draw(SkyPainter *skyp)
                     << "Could not load catalog objects in trixel: " << trixel << ", "
                     << e.what();
 
-                KMessageBox::detailedError(
-                    nullptr, i18n("Could not load catalog objects in trixel: %1", trixel),
-                    e.what());
-
-                throw; // do not silently fail
+                // nothing is stored, so the trixel is retried next frame
+                continue;
             }
         }
 
@@ -145,35 +166,110 @@ void CatalogsComponent::draw(SkyPainter *skyp)
             if (sizeCriterion)
             {
                 object.JITupdate();
-                auto &color = m_catalog_colors[object.catalogId()][color_scheme];
-                if (!color.isValid())
-                {
-                    color = m_catalog_colors[object.catalogId()]["default"];
+                candidates.push_back(&object);
+                points.push_back(&object);
+            }
+        }
+    }
 
-                    if (!color.isValid())
-                    {
-                        color = default_color;
-                    }
-                }
+    // the objects are projected together, then only the visible ones are drawn
+    const auto num_candidates = candidates.size();
+    std::vector<float> x(num_candidates), y(num_candidates);
+    std::unique_ptr<bool[]> visible(new bool[num_candidates]);
+    proj.toScreenBatch(num_candidates, points.data(), x.data(), y.data(),
+                       visible.get());
 
-                skyp->setPen(color);
+    for (size_t i = 0; i < num_candidates; ++i)
+    {
+        if (!visible[i])
+            continue;
 
-                if (Options::showInlineImages())
-                    object.load_image();
+        auto &object = *candidates[i];
+        auto &color  = m_catalog_colors[object.catalogId()][color_scheme];
+        if (!color.isValid())
+        {
+            color = m_catalog_colors[object.catalogId()]["default"];
 
-                if (skyp->drawCatalogObject(object) && !hideLabels)
-                {
-                    labeler.drawNameLabel(&object, proj.toScreen(&object), label_padding);
-                }
+            if (!color.isValid())
+            {
+                color = default_color;
             }
         }
+
+        skyp->setPen(color);
+
+        if (Options::showInlineImages())
+            object.load_image();
+
+        const QPointF pos{ x[i], y[i] };
+        if (skyp->drawCatalogObject(object, pos) && !hideLabels)
+            labeler.drawNameLabel(&object, pos, label_padding);
     }
 
+    m_loader->request(misses, prefetchTrixels(map));
+
+    m_last_frame_misses = misses.size();
+    if (!misses.empty())
+        qCDebug(KSTARS) << "DSO cache missed" << misses.size() << "of" << num_trixels
+                        << "trixels," << m_loader->pending() << "pending.";
+
     // prune only if the to-be-pruned trixels are likely not visible
     // and we are not zooming
-    m_cache.prune(num_trixels * 1.2);
+    m_cache.prune((num_trixels + m_num_prefetch_trixels) * 1.2);
 };
 
+void CatalogsComponent::takeLoadedTrixels()
+{
+    for (auto &result : m_loader->take_loaded())
+        m_cache[result.trixel] = std::move(result.objects);
+}
+
+std::vector<Trixel> CatalogsComponent::prefetchTrixels(SkyMap &map)
+{
+    std::vector<Trixel> trixels;
+
+    SkyPoint *focus        = map.focus();
+    const SkyPoint last    = m_last_focus;
+    m_last_focus           = *focus;
+    m_num_prefetch_trixels = 0;
+
+    if (!map.isSlewing())
+        return trixels;
+
+    // direction of the slew since the last frame, in degrees on the sky
+    const double cos_dec = std::max(0.01, cos(focus->dec().radians()));
+    const double d_ra =
+        remainder(focus->ra().Degrees() - last.ra().Degrees(), 360.0) * cos_dec;
+    const double d_dec = focus->dec().Degrees() - last.dec().Degrees();
+    const double step  = std::hypot(d_ra, d_dec);
+
+    // not moving, or jumping to another place
+    if (step < 1e-6 || step > 90)
+        return trixels;
+
+    float radius = map.projector()->fov();
+    if (radius > 180.0)
+        radius = 180.0;
+
+    const double scale = radius / step;
+    SkyPoint ahead{ dms(focus->ra().Degrees() + d_ra * scale / cos_dec).reduce(),
+                    dms(qBound(-90.0, focus->dec().Degrees() + d_dec * scale, 90.0)) };
+
+    m_skyMesh->aperture(&ahead, radius + 1.0, PREFETCH_BUF);
+    MeshIterator region(m_skyMesh, PREFETCH_BUF);
+
+    while (region.hasNext())
+    {
+        Trixel trixel = region.next();
+        m_num_prefetch_trixels++;
+
+        if (!m_cache[trixel].is_set())
+            trixels.push_back(trixel);
+    }
+
+    return trixels;
+}
+
 void CatalogsComponent::updateSkyMesh(SkyMap &map, MeshBufNum_t buf)
 {
     SkyPoint *focus = map.focus();
@@ -19,10 +19,12 @@
 
 #include "skycomponent.h"
 #include "catalogsdb.h"
+#include "catalogsloader.h"
 #include "catalogobject.h"
 #include "skymesh.h"
 #include "trixelcache.h"
 #include "Options.h"
+#include <memory>
 #include <unordered_map>
 
 class SkyMesh;
@@ -33,7 +35,10 @@ class SkyMap;
  * indexed catalog.
  *
  * The component doesn't follow the traditional list approach and
- * loads it's skyobjects into an LRU cache (`TrixelCache`). For
+ * loads it's skyobjects into an LRU cache (`TrixelCache`). Missing
+ * trixels are loaded in the background by a `CatalogsLoader` and
+ * drawn once they are available, and while slewing the trixels ahead
+ * of the slew are prefetched. For
  * puproses of compatiblility with object search etc. some of the
  * brightest objects are loaded into `m_static_objects` and registered
  * within the component system. Furthermore, if some part of the code
@@ -68,9 +73,18 @@ class CatalogsComponent : public SkyComponent
         /**
          * Draws the objects in the currently visible trixels by
          * dynamically loading them from the database.
+         *
+         * Trixels missing from the cache are requested from the
+         * background loader and drawn in a later frame.
          */
         void draw(SkyPainter *skyp) override;
 
+        /**
+         * \return the number of visible trixels missing from the cache in
+         * the last frame, to help tuning Options::dSOCachePercentage.
+         */
+        size_t lastFrameMisses() const { return m_last_frame_misses; };
+
         /**
          * Set the cache size to the new \p percentage.
          *
@@ -117,6 +131,7 @@ class CatalogsComponent : public SkyComponent
          */
         void dropCache()
         {
+            m_loader->reset();
             m_cache.clear();
             m_catalog_colors = m_db_manager.get_catalog_colors();
         };
@@ -178,10 +193,39 @@ class CatalogsComponent : public SkyComponent
          */
         CatalogsDB::ColorMap m_catalog_colors;
 
+        /**
+         * Loads the trixels missing from the cache in the background.
+         */
+        std::unique_ptr<CatalogsLoader> m_loader;
+
+        /**
+         * The focus of the last frame, from which the direction of a
+         * slew is found.
+         */
+        SkyPoint m_last_focus;
+
+        /**
+         * The number of trixels around the point the slew is heading to.
+         */
+        size_t m_num_prefetch_trixels{ 0 };
+
+        size_t m_last_frame_misses{ 0 };
+
         //@{
         /** Helpers */
 
         void updateSkyMesh(SkyMap &map, MeshBufNum_t buf = DRAW_BUF);
+
+        /**
+         * Store the trixels loaded in the background into the cache.
+         */
+        void takeLoadedTrixels();
+
+        /**
+         * \return the trixels missing from the cache around the point
+         * the map is slewing to, one field of view ahead of the focus.
+         */
+        std::vector<Trixel> prefetchTrixels(SkyMap &map);
         size_t calculateCacheSize(const unsigned int percentage)
         {
             return m_skyMesh->size() * percentage / 100;
@@ -0,0 +1,179 @@
+/*  Catalogs Loader
+    Load the catalog objects of trixels on a worker thread.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "catalogsloader.h"
+
+#include <KLocalizedString>
+
+#include <memory>
+
+#include "kstars_debug.h"
+
+CatalogsLoader::CatalogsLoader(const QString &db_filename, QObject *parent)
+    : QThread(parent), m_db_filename{ db_filename }
+{
+}
+
+CatalogsLoader::~CatalogsLoader()
+{
+    {
+        QMutexLocker _{ &m_mutex };
+        m_stop = true;
+        m_wake.wakeAll();
+    }
+
+    wait();
+}
+
+void CatalogsLoader::request(const std::vector<Trixel> &visible,
+                             const std::vector<Trixel> &prefetch)
+{
+    QMutexLocker _{ &m_mutex };
+
+    for (const auto trixel : m_visible)
+        m_pending.erase(trixel);
+    for (const auto trixel : m_prefetch)
+        m_pending.erase(trixel);
+
+    m_visible.clear();
+    m_prefetch.clear();
+
+    for (const auto trixel : visible)
+    {
+        if (m_pending.insert(trixel).second)
+            m_visible.push_back(trixel);
+    }
+
+    for (const auto trixel : prefetch)
+    {
+        if (m_pending.insert(trixel).second)
+            m_prefetch.push_back(trixel);
+    }
+
+    if (!m_visible.empty() || !m_prefetch.empty())
+        m_wake.wakeAll();
+}
+
+std::vector<CatalogsLoader::Result> CatalogsLoader::take_loaded()
+{
+    QMutexLocker _{ &m_mutex };
+
+    std::vector<Result> loaded;
+    loaded.swap(m_loaded);
+
+    for (const auto &result : loaded)
+        m_pending.erase(result.trixel);
+
+    return loaded;
+}
+
+void CatalogsLoader::reset()
+{
+    QMutexLocker _{ &m_mutex };
+
+    m_visible.clear();
+    m_prefetch.clear();
+    m_pending.clear();
+    m_loaded.clear();
+    m_generation++;
+    m_failure_reported = false;
+    m_visible_loaded   = false;
+}
+
+size_t CatalogsLoader::pending()
+{
+    QMutexLocker _{ &m_mutex };
+    return m_pending.size();
+}
+
+void CatalogsLoader::run()
+{
+    // the connection has to be opened, used and closed in this thread
+    std::unique_ptr<CatalogsDB::DBManager> db_manager;
+    try
+    {
+        db_manager.reset(new CatalogsDB::DBManager(m_db_filename));
+    }
+    catch (const CatalogsDB::DatabaseError &e)
+    {
+        qCCritical(KSTARS) << "Could not open the catalog database for loading: "
+                           << e.what();
+        emit failed(i18n("Could not open the catalog database for loading."), e.what());
+        return;
+    }
+
+    QMutexLocker lock{ &m_mutex };
+    while (true)
+    {
+        while (!m_stop && m_visible.empty() && m_prefetch.empty())
+            m_wake.wait(&m_mutex);
+
+        if (m_stop)
+            break;
+
+        const bool visible = !m_visible.empty();
+        auto &queue        = visible ? m_visible : m_prefetch;
+        Result result{ queue.front(), {} };
+        queue.pop_front();
+        const auto generation = m_generation;
+
+        lock.unlock();
+
+        QString error;
+        try
+        {
+            result.objects = db_manager->get_objects_in_trixel(result.trixel);
+        }
+        catch (const CatalogsDB::DatabaseError &e)
+        {
+            error = e.what();
+        }
+
+        lock.relock();
+
+        // the database changed in the meantime
+        if (generation != m_generation)
+            continue;
+
+        const Trixel trixel = result.trixel;
+        const bool report   = !error.isEmpty() && !m_failure_reported;
+        if (error.isEmpty())
+        {
+            m_loaded.push_back(std::move(result));
+            m_visible_loaded = m_visible_loaded || visible;
+        }
+        else
+        {
+            // nothing is stored, so that the trixel is requested again
+            // by the next frame
+            m_pending.erase(trixel);
+
+            if (report)
+                qCCritical(KSTARS) << "Could not load catalog objects in trixel: "
+                                   << trixel << ", " << error;
+            m_failure_reported = true;
+        }
+
+        // failures alone do not trigger a redraw, which would retry them
+        // at once
+        const bool done = visible && m_visible.empty() && m_visible_loaded;
+        if (done)
+            m_visible_loaded = false;
+
+        lock.unlock();
+
+        if (report)
+            emit failed(i18n("Could not load catalog objects in trixel: %1", trixel),
+                        error);
+        if (done)
+            emit loaded();
+
+        lock.relock();
+    }
+}
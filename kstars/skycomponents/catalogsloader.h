@@ -0,0 +1,129 @@
+/*  Catalogs Loader
+    Load the catalog objects of trixels on a worker thread.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include "catalogsdb.h"
+#include "typedef.h"
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * \brief Loads the catalog objects of trixels from the database on a
+ * worker thread, so that drawing never waits for a query.
+ *
+ * The worker opens its own connection to the database, as an sqlite
+ * connection may only be used from the thread that opened it.
+ *
+ * Trixels visible in the current frame are loaded before those
+ * prefetched ahead of a slew. Each call to `request` replaces the
+ * queued trixels, so that the loader follows the sky map instead of
+ * working through regions already left behind.
+ *
+ * Loaded objects are collected with `take_loaded` by the thread owning
+ * the cache.
+ */
+class CatalogsLoader : public QThread
+{
+        Q_OBJECT
+
+    public:
+        struct Result
+        {
+            Trixel trixel;
+            CatalogsDB::CatalogObjectVector objects;
+        };
+
+        /**
+         * Constructs a loader for the database under the path \p
+         * db_filename. The database is opened once the thread is started.
+         */
+        explicit CatalogsLoader(const QString &db_filename, QObject *parent = nullptr);
+
+        ~CatalogsLoader() override;
+
+        /**
+         * Replace the queued trixels by the \p visible ones and those to
+         * \p prefetch, in order of priority. Trixels being loaded, or
+         * loaded and not taken yet, are not queued again.
+         */
+        void request(const std::vector<Trixel> &visible, const std::vector<Trixel> &prefetch);
+
+        /**
+         * \return the trixels loaded since the last call.
+         */
+        std::vector<Result> take_loaded();
+
+        /**
+         * Drop the queued trixels and the objects loaded so far, to be
+         * called when the content of the database changes.
+         */
+        void reset();
+
+        /**
+         * \return the number of trixels queued, being loaded or not taken yet.
+         */
+        size_t pending();
+
+    signals:
+        /**
+         * Emitted from the worker thread once all the visible trixels
+         * requested are loaded, if at least one of them was loaded.
+         */
+        void loaded();
+
+        /**
+         * Emitted from the worker thread when the database cannot be
+         * read, once until the next reset. Trixels that fail to load are
+         * not returned, and are loaded again when requested next.
+         */
+        void failed(const QString &message, const QString &details);
+
+    protected:
+        void run() override;
+
+    private:
+        QString m_db_filename;
+
+        QMutex m_mutex;
+        QWaitCondition m_wake;
+        bool m_stop{ false };
+
+        std::deque<Trixel> m_visible;
+        std::deque<Trixel> m_prefetch;
+
+        /**
+         * Trixels queued, being loaded or loaded and not taken yet.
+         */
+        std::unordered_set<Trixel> m_pending;
+
+        std::vector<Result> m_loaded;
+
+        /**
+         * Incremented by `reset` to discard the trixel being loaded.
+         */
+        unsigned int m_generation{ 0 };
+
+        /**
+         * Whether a failure was already reported since the last reset.
+         */
+        bool m_failure_reported{ false };
+
+        /**
+         * Whether a visible trixel was loaded since `loaded` was last
+         * emitted.
+         */
+        bool m_visible_loaded{ false };
+};
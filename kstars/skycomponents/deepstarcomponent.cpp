@@ -29,6 +29,9 @@
 #include "starcomponent.h"
 #include "htmesh/MeshIterator.h"
 #include "projections/projector.h"
+#ifndef KSTARS_LITE
+#include "skyobjects/epochtransform.h"
+#endif
 
 #include <qplatformdefs.h>
 #include <QtConcurrent>
@@ -85,19 +88,23 @@ bool DeepStarComponent::loadStaticStars()
         return false;
     }
 
-    //KDE_fseek(dataFile, starReader.getDataOffset(), SEEK_SET);
-    QT_FSEEK(dataFile, starReader.getDataOffset(), SEEK_SET);
+    // Decode everything straight from the mapping if the file is mapped, reading it through once
+    const quint64 dataSize = 5 + quint64(starReader.getRecordCount()) * recordSize;
+    const uchar *data      = starReader.mappedData(starReader.getDataOffset(), dataSize);
+    if (data)
+        starReader.adviseWillNeed(starReader.getDataOffset(), dataSize);
+    else
+        QT_FSEEK(dataFile, starReader.getDataOffset(), SEEK_SET);
 
     qint16 faintmag;
     quint8 htm_level;
     quint16 t_MSpT;
-    int ret = 0;
 
-    ret = fread(&faintmag, 2, 1, dataFile);
+    BinFileHelper::readRecord(faintmag, data, dataFile);
     if (starReader.getByteSwap())
         faintmag = bswap_16(faintmag);
-    ret = fread(&htm_level, 1, 1, dataFile);
-    ret = fread(&t_MSpT, 2, 1, dataFile); // Unused
+    BinFileHelper::readRecord(htm_level, data, dataFile);
+    BinFileHelper::readRecord(t_MSpT, data, dataFile); // Unused
     if (starReader.getByteSwap())
         faintmag = bswap_16(faintmag);
 
@@ -126,7 +133,7 @@ bool DeepStarComponent::loadStaticStars()
 
             for (quint64 j = 0; j < records; ++j)
             {
-                bool fread_success = fread(&stardata, sizeof(StarData), 1, dataFile);
+                bool fread_success = BinFileHelper::readRecord(stardata, data, dataFile);
 
                 if (!fread_success)
                 {
@@ -139,19 +146,16 @@ bool DeepStarComponent::loadStaticStars()
                     byteSwap(&stardata);
 
                 /* Initialize star with data just read. */
-                StarObject *star;
 #ifdef KSTARS_LITE
-                star = &(SB->addStar(stardata)->star);
+                const bool added = SB->addStar(stardata) != nullptr;
 #else
-                star = SB->addStar(stardata);
+                const bool added = SB->addStar(stardata) >= 0;
 #endif
-                if (star)
+                if (added)
                 {
-                    //KStarsData* data = KStarsData::Instance();
-                    //star->EquatorialToHorizontal( data->lst(), data->geo()->lat() );
-                    //if( star->getHDIndex() != 0 )
+                    // Only the location is kept, the StarObject is made by findByHDIndex()
                     if (stardata.HD)
-                        m_CatalogNumber.insert(stardata.HD, star);
+                        m_CatalogNumber.insert(stardata.HD, qMakePair(SB.get(), SB->getStarCount() - 1));
                 }
                 else
                 {
@@ -177,8 +181,7 @@ bool DeepStarComponent::loadStaticStars()
 
             for (quint64 j = 0; j < records; ++j)
             {
-                bool fread_success = false;
-                fread_success      = fread(&deepstardata, sizeof(DeepStarData), 1, dataFile);
+                bool fread_success = BinFileHelper::readRecord(deepstardata, data, dataFile);
 
                 if (!fread_success)
                 {
@@ -191,19 +194,16 @@ bool DeepStarComponent::loadStaticStars()
                     byteSwap(&deepstardata);
 
                 /* Initialize star with data just read. */
-                StarObject *star;
 #ifdef KSTARS_LITE
-                star = &(SB->addStar(stardata)->star);
+                const bool added = SB->addStar(deepstardata) != nullptr;
 #else
-                star = SB->addStar(deepstardata);
+                const bool added = SB->addStar(deepstardata) >= 0;
 #endif
-                if (star)
+                if (added)
                 {
-                    //KStarsData* data = KStarsData::Instance();
-                    //star->EquatorialToHorizontal( data->lst(), data->geo()->lat() );
-                    //if( star->getHDIndex() != 0 )
+                    // Only the location is kept, the StarObject is made by findByHDIndex()
                     if (stardata.HD)
-                        m_CatalogNumber.insert(stardata.HD, star);
+                        m_CatalogNumber.insert(stardata.HD, qMakePair(SB.get(), SB->getStarCount() - 1));
                 }
                 else
                 {
@@ -258,7 +258,6 @@ void DeepStarComponent::draw(SkyPainter *skyp)
 #endif
     SkyMap *map       = SkyMap::Instance();
     KStarsData *data  = KStarsData::Instance();
-    UpdateID updateID = data->updateID();
 
     //FIXME_FOV -- maybe not clamp like that...
     float radius = map->projector()->fov();
@@ -299,6 +298,9 @@ void DeepStarComponent::draw(SkyPainter *skyp)
     if (hideFaintStars && maglim > hideStarsMag)
         maglim = hideStarsMag;
 
+    // Precession, nutation, aberration and the horizon are the same for all the stars of the frame
+    const EpochTransform transform(data->updateNum(), data->lst(), data->geo()->lat());
+
     StarBlockFactory *m_StarBlockFactory = StarBlockFactory::Instance();
     //    m_StarBlockFactory->drawID = m_skyMesh->drawID();
     //    qDebug() << "Mesh size = " << m_skyMesh->size() << "; drawID = " << m_skyMesh->drawID();
@@ -319,6 +321,10 @@ void DeepStarComponent::draw(SkyPainter *skyp)
         while (region.hasNext())
         {
             Trixel currentRegion = region.next();
+
+            // Let the records about to be loaded page in while the other trixels are being drawn
+            m_starBlockList.at(currentRegion)->prefetchToMag(maglim);
+
             for (int i = 0; i < m_starBlockList.at(currentRegion)->getBlockCount(); ++i)
             {
                 std::shared_ptr<StarBlock> prevBlock = ((i >= 1) ? m_starBlockList.at(currentRegion)->block(
@@ -368,40 +374,21 @@ void DeepStarComponent::draw(SkyPainter *skyp)
         //        qDebug() << "Drawing SBL for trixel " << currentRegion << ", SBL has "
         //                 <<  m_starBlockList[ currentRegion ]->getBlockCount() << " blocks";
 
-        // REMARK: The following should never carry state, except for const parameters like updateID and maglim
-        std::function<void(std::shared_ptr<StarBlock>)> mapFunction = [&updateID, &maglim](std::shared_ptr<StarBlock> myBlock)
+        // REMARK: The following should never carry state, except for const parameters like maglim
+        std::function<void(std::shared_ptr<StarBlock>)> mapFunction = [&maglim, &transform](std::shared_ptr<StarBlock> myBlock)
         {
-            for (StarObject &star : myBlock->contents())
-            {
-                if (star.updateID != updateID)
-                    star.JITupdate();
-                if (star.mag() > maglim)
-                    break;
-            }
+            myBlock->JITupdate(maglim, transform);
         };
 
         QtConcurrent::blockingMap(m_starBlockList.at(currentRegion)->contents(), mapFunction);
 
+        // The stars are drawn straight from the packed arrays of the blocks, projected together
         for (int i = 0; i < m_starBlockList.at(currentRegion)->getBlockCount(); ++i)
         {
             std::shared_ptr<StarBlock> block = m_starBlockList.at(currentRegion)->block(i);
             //            qDebug() << "---> Drawing stars from block " << i << " of trixel " <<
             //                currentRegion << ". SB has " << block->getStarCount() << " stars";
-            for (int j = 0; j < block->getStarCount(); j++)
-            {
-                StarObject *curStar = block->star(j);
-
-                //                qDebug() << "We claim that he's from trixel " << currentRegion
-                //<< ", and indexStar says he's from " << m_skyMesh->indexStar( curStar );
-
-                float mag = curStar->mag();
-
-                if (mag > maglim)
-                    break;
-
-                if (skyp->drawPointSource(curStar, mag, curStar->spchar()))
-                    visibleStarCount++;
-            }
+            visibleStarCount += block->draw(skyp, maglim);
         }
 
         // DEBUG: Uncomment to identify problems with Star Block Factory / preservation of Magnitude Order in the LRU Cache
@@ -472,6 +459,8 @@ bool DeepStarComponent::openDataFile()
         ret = fread(&MSpT, 2, 1, starReader.getFileHandle());
         if (starReader.getByteSwap())
             MSpT = bswap_16(MSpT);
+        if (!starReader.mapFile())
+            qCDebug(KSTARS) << "Could not map" << dataFileName << "into memory, reading it through the file instead";
         fileOpened = true;
         qCInfo(KSTARS) << "  Sky Mesh Size: " << m_skyMesh->size();
         for (long int i = 0; i < m_skyMesh->size(); i++)
@@ -493,7 +482,15 @@ bool DeepStarComponent::openDataFile()
 StarObject *DeepStarComponent::findByHDIndex(int HDnum)
 {
     // Currently, we only handle HD catalog indexes
-    return m_CatalogNumber.value(HDnum, nullptr); // TODO: Maybe, make this more general.
+    // TODO: Maybe, make this more general.
+    const QPair<StarBlock *, int> location = m_CatalogNumber.value(HDnum, qMakePair<StarBlock *, int>(nullptr, 0));
+    if (!location.first)
+        return nullptr;
+#ifdef KSTARS_LITE
+    return &(location.first->star(location.second)->star);
+#else
+    return location.first->star(location.second);
+#endif
 }
 
 // This uses the main star index for looking up nearby stars but then
@@ -508,6 +505,10 @@ SkyObject *DeepStarComponent::objectNearest(SkyPoint *p, double &maxrad)
 
 #ifdef KSTARS_LITE
     m_zoomMagLimit = StarComponent::zoomMagnitudeLimit();
+#else
+    SkyPoint point;
+    StarBlock *bestBlock = nullptr;
+    int bestIndex        = 0;
 #endif
     if (!fileOpened)
         return nullptr;
@@ -531,9 +532,6 @@ SkyObject *DeepStarComponent::objectNearest(SkyPoint *p, double &maxrad)
             {
 #ifdef KSTARS_LITE
                 StarObject *star = &(block->star(j)->star);
-#else
-                StarObject *star = block->star(j);
-#endif
                 if (!star)
                     continue;
                 if (star->mag() > m_zoomMagLimit)
@@ -545,10 +543,29 @@ SkyObject *DeepStarComponent::objectNearest(SkyPoint *p, double &maxrad)
                     oBest  = star;
                     maxrad = r;
                 }
+#else
+                if (block->mag(j) > m_zoomMagLimit)
+                    continue;
+
+                block->position(j, point);
+                double r = point.angularDistanceTo(p).Degrees();
+                if (r < maxrad)
+                {
+                    bestBlock = block.get();
+                    bestIndex = j;
+                    maxrad    = r;
+                }
+#endif
             }
         }
     }
 
+#ifndef KSTARS_LITE
+    // Only the nearest star is made into a StarObject
+    if (bestBlock)
+        oBest = bestBlock->star(bestIndex);
+#endif
+
     // TODO: What if we are looking around a point that's not on
     // screen? objectNearest() will need to keep on filling up all
     // trixels around the SkyPoint to find the best match in case it
@@ -581,6 +598,12 @@ bool DeepStarComponent::starsInAperture(QList<StarObject *> &list, const SkyPoin
     if (maglim < -28)
         maglim = m_FaintMagnitude;
 
+#ifndef KSTARS_LITE
+    SkyPoint point;
+    KStarsData *data = KStarsData::Instance();
+    const EpochTransform transform(data->updateNum(), data->lst(), data->geo()->lat());
+#endif
+
     while (region.hasNext())
     {
         Trixel currentRegion = region.next();
@@ -591,17 +614,24 @@ bool DeepStarComponent::starsInAperture(QList<StarObject *> &list, const SkyPoin
         for (int i = 0; i < sbl->getBlockCount(); ++i)
         {
             std::shared_ptr<StarBlock> block = sbl->block(i);
+#ifndef KSTARS_LITE
+            block->JITupdate(maglim, transform);
+#endif
             for (int j = 0; j < block->getStarCount(); ++j)
             {
 #ifdef KSTARS_LITE
                 StarObject *star = &(block->star(j)->star);
-#else
-                StarObject *star = block->star(j);
-#endif
                 if (star->mag() > maglim)
                     break; // Stars are organized by magnitude, so this should work
                 if (star->angularDistanceTo(&center).Degrees() <= radius)
                     list.append(star);
+#else
+                if (block->mag(j) > maglim)
+                    break; // Stars are organized by magnitude, so this should work
+                block->position(j, point);
+                if (point.angularDistanceTo(&center).Degrees() <= radius)
+                    list.append(block->star(j));
+#endif
             }
         }
     }
@@ -35,6 +35,7 @@
 
 class SkyLabeler;
 class SkyMesh;
+class StarBlock;
 class StarBlockFactory;
 class StarBlockList;
 class StarObject;
@@ -133,7 +134,8 @@ class DeepStarComponent : public ListComponent
     long unsigned t_updateCache { 0 };
 
     QVector<std::shared_ptr<StarBlockList>> m_starBlockList;
-    QHash<int, StarObject *> m_CatalogNumber;
+    /// Block and index within it of the static stars, by HD catalog number
+    QHash<int, QPair<StarBlock *, int>> m_CatalogNumber;
 
     bool staticStars { false };
 
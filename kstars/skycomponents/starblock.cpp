@@ -22,6 +22,15 @@
 #include "starcomponent.h"
 #include "skyobjects/stardata.h"
 #include "skyobjects/deepstardata.h"
+#ifndef KSTARS_LITE
+#include "kstarsdata.h"
+#include "Options.h"
+#include "skyobjects/epochtransform.h"
+#include "skypainter.h"
+
+#include <algorithm>
+#include <cmath>
+#endif
 
 #ifdef KSTARS_LITE
 #include "skymaplite.h"
@@ -46,20 +55,33 @@ StarBlock::StarBlock(int nstars)
 #ifdef KSTARS_LITE
       stars(nstars, StarNode())
 #else
-      stars(nstars, StarObject())
+      m_RA0(nstars), m_Dec0(nstars), m_PMRA(nstars), m_PMDec(nstars), m_Mag(nstars), m_SpType(nstars),
+      m_RA(nstars), m_Dec(nstars), m_Alt(nstars), m_Az(nstars)
 #endif
 {
 }
 
+StarBlock::~StarBlock() = default;
+
 void StarBlock::reset()
 {
     if (parent)
         parent->releaseBlock(this);
 
-    parent    = nullptr;
-    faintMag  = -5.0;
-    brightMag = 35.0;
-    nStars    = 0;
+    parent      = nullptr;
+    faintMag    = -5.0;
+    brightMag   = 35.0;
+    nStars      = 0;
+    firstRecord = 0;
+
+#ifndef KSTARS_LITE
+    nPrecessed = nUpdated = 0;
+
+    // Keep the objects handed out, so that pointers to them stay valid
+    for (auto &object : m_Objects)
+        m_SpareObjects.push_back(std::move(object.second));
+    m_Objects.clear();
+#endif
 }
 
 #ifdef KSTARS_LITE
@@ -93,31 +115,161 @@ StarNode *StarBlock::addStar(const DeepStarData &data)
     return &node;
 }
 #else
-StarObject *StarBlock::addStar(const StarData &data)
+int StarBlock::addStar(const StarData &data)
 {
-    if (isFull())
-        return nullptr;
-    StarObject &star = stars[nStars++];
+    // Same scales as StarObject::init(const StarData *)
+    return addStar(data.RA / 1000000.0, data.Dec / 100000.0, data.mag / 100.0, data.spec_type[0], data.dRA / 10.0,
+                   data.dDec / 10.0);
+}
 
-    star.init(&data);
-    if (star.mag() > faintMag)
-        faintMag = star.mag();
-    if (star.mag() < brightMag)
-        brightMag = star.mag();
-    return &star;
+int StarBlock::addStar(const DeepStarData &data)
+{
+    // Same magnitude and spectral class as StarObject::init(const DeepStarData *)
+    float mag;
+    if (data.V == 30000 && data.B != 30000)
+        mag = (data.B - 1600) / 1000.0;
+    else
+        mag = data.V / 1000.0;
+
+    char sp = 'B';
+    if (data.B == 30000 || data.V == 30000)
+        sp = '?';
+    else
+    {
+        const double BV_Index = (data.B - data.V) / 1000.0;
+        if (BV_Index > 0.0) sp = 'A';
+        if (BV_Index > 0.325) sp = 'F';
+        if (BV_Index > 0.575) sp = 'G';
+        if (BV_Index > 0.975) sp = 'K';
+        if (BV_Index > 1.6) sp = 'M';
+    }
+
+    return addStar(data.RA / 1000000.0, data.Dec / 100000.0, mag, sp, data.dRA / 100.0, data.dDec / 100.0);
 }
 
-StarObject *StarBlock::addStar(const DeepStarData &data)
+int StarBlock::addStar(double ra, double dec, float mag, char sp, double pmRA, double pmDec)
 {
     if (isFull())
-        return nullptr;
-    StarObject &star = stars[nStars++];
+        return -1;
 
-    star.init(&data);
-    if (star.mag() > faintMag)
-        faintMag = star.mag();
-    if (star.mag() < brightMag)
-        brightMag = star.mag();
-    return &star;
+    const int i = nStars++;
+    m_RA0[i]    = ra;
+    m_Dec0[i]   = dec;
+    m_PMRA[i]   = pmRA;
+    m_PMDec[i]  = pmDec;
+    m_Mag[i]    = mag;
+    m_SpType[i] = sp;
+    m_RA[i]     = ra;
+    m_Dec[i]    = dec;
+
+    if (mag > faintMag)
+        faintMag = mag;
+    if (mag < brightMag)
+        brightMag = mag;
+    return i;
+}
+
+void StarBlock::JITupdate(float maglim, const EpochTransform &transform)
+{
+    static KStarsData *data = KStarsData::Instance();
+
+    if (updateNumID != data->updateNumID())
+    {
+        // Same short circuit as StarObject::JITupdate(), precessing again once per solar minute
+        if (Options::alwaysRecomputeCoordinates() || Options::useRelativistic() ||
+                std::abs(precessJD - data->updateNum()->getJD()) >= 0.00069444)
+        {
+            precessJD  = data->updateNum()->getJD();
+            nPrecessed = 0;
+            nUpdated   = 0;
+        }
+        updateNumID = data->updateNumID();
+    }
+
+    if (updateID != data->updateID())
+    {
+        updateID = data->updateID();
+        nUpdated = 0;
+    }
+
+    // Up to date down to the magnitude limit already
+    if (nUpdated >= nStars || (nUpdated > 0 && m_Mag[nUpdated - 1] > maglim))
+        return;
+
+    // Stars are sorted by magnitude, so update up to and including the first one fainter than maglim
+    const int end = std::min<int>(nStars, std::upper_bound(m_Mag.constBegin() + nUpdated, m_Mag.constBegin() + nStars,
+                                  maglim) - m_Mag.constBegin() + 1);
+
+    if (nPrecessed < end)
+    {
+        if (Options::useRelativistic())
+        {
+            // The bending of light near the Sun is only done by StarObject
+            StarObject scratch;
+            for (int i = nPrecessed; i < end; ++i)
+            {
+                scratch.set(dms(m_RA0[i] * 15.0), dms(m_Dec0[i]));
+                scratch.setProperMotion(m_PMRA[i], m_PMDec[i]);
+                scratch.updateCoords(data->updateNum());
+                m_RA[i]  = scratch.ra().Hours();
+                m_Dec[i] = scratch.dec().Degrees();
+            }
+        }
+        else
+        {
+            transform.apparent(end - nPrecessed, &m_RA0[nPrecessed], &m_Dec0[nPrecessed], &m_PMRA[nPrecessed],
+                               &m_PMDec[nPrecessed], &m_RA[nPrecessed], &m_Dec[nPrecessed]);
+        }
+        nPrecessed = end;
+    }
+
+    transform.horizontal(end - nUpdated, &m_RA[nUpdated], &m_Dec[nUpdated], &m_Alt[nUpdated], &m_Az[nUpdated]);
+    nUpdated = end;
+}
+
+void StarBlock::position(int i, SkyPoint &point) const
+{
+    point.setRA(m_RA[i]);
+    point.setDec(m_Dec[i]);
+    point.setAlt(m_Alt[i]);
+    point.setAz(m_Az[i]);
+}
+
+int StarBlock::draw(SkyPainter *skyp, float maglim) const
+{
+    const int count = std::upper_bound(m_Mag.constBegin(), m_Mag.constBegin() + nStars, maglim) - m_Mag.constBegin();
+
+    return skyp->drawPointSources(count, m_RA.constData(), m_Dec.constData(), m_Alt.constData(), m_Az.constData(),
+                                  m_Mag.constData(), m_SpType.constData());
+}
+
+StarObject *StarBlock::star(int i)
+{
+    Q_ASSERT(i >= 0 && i < nStars);
+
+    std::unique_ptr<StarObject> &star = m_Objects[i];
+    if (!star)
+    {
+        if (!m_SpareObjects.empty())
+        {
+            star = std::move(m_SpareObjects.back());
+            m_SpareObjects.pop_back();
+        }
+        else
+            star.reset(new StarObject);
+
+        // Fall back on the packed values if the record cannot be read again
+        if (!parent || !parent->readStar(firstRecord + i, *star))
+        {
+            *star = StarObject(double(m_RA0[i]), double(m_Dec0[i]), m_Mag[i], QString(), QString(),
+                               QString(QChar(m_SpType[i])), m_PMRA[i], m_PMDec[i]);
+        }
+        star->updateID = star->updateNumID = 0;
+    }
+
+    if (star->updateID != KStarsData::Instance()->updateID())
+        star->JITupdate();
+
+    return star.get();
 }
 #endif
@@ -22,8 +22,17 @@
 
 #include <QVector>
 
+#include <memory>
+#ifndef KSTARS_LITE
+#include <unordered_map>
+#include <vector>
+#endif
+
+class SkyPoint;
 class StarObject;
 class StarBlockList;
+class EpochTransform;
+class SkyPainter;
 class PointSourceNode;
 struct StarData;
 struct DeepStarData;
@@ -46,6 +55,11 @@ struct StarNode
  *
  * Holds a block of stars and various peripheral variables to mark its place in data structures
  *
+ * In KStars Lite every star is a full StarObject, paired with its scene graph node. Otherwise the
+ * stars, which are all unnamed, are kept in packed arrays of the few values needed to update and
+ * draw them: catalog and current positions, proper motion, magnitude and spectral class. A
+ * StarObject is only made by star() for the code that needs one, like popups and searches.
+ *
  * @author  Akarsh Simha
  * @version 1.0
  */
@@ -53,11 +67,9 @@ struct StarNode
 class StarBlock
 {
   public:
-// StarBlockEntry is the data type held by the StarBlock's QVector
 #ifdef KSTARS_LITE
+    // StarBlockEntry is the data type held by the StarBlock's QVector
     typedef StarNode StarBlockEntry;
-#else
-    typedef StarObject StarBlockEntry;
 #endif
 
     /**
@@ -69,8 +81,9 @@ class StarBlock
      */
     explicit StarBlock(int nstars = 100);
 
-    ~StarBlock() = default;
+    ~StarBlock();
 
+#ifdef KSTARS_LITE
     /**
      * @short Initialize another star with data.
      *
@@ -83,6 +96,16 @@ class StarBlock
      */
     StarBlockEntry *addStar(const StarData &data);
     StarBlockEntry *addStar(const DeepStarData &data);
+#else
+    /**
+     * @short Add another star, decoded the same way as StarObject::init() does.
+     *
+     * @param  data    data to initialize star with.
+     * @return index of the star in this block, -1 if block is full.
+     */
+    int addStar(const StarData &data);
+    int addStar(const DeepStarData &data);
+#endif
 
     /**
      * @short Returns true if the StarBlock is full
@@ -100,8 +123,13 @@ class StarBlock
      *
      * @return The number of stars that this StarBlock can hold
      */
+#ifdef KSTARS_LITE
     inline int size() const { return stars.size(); }
+#else
+    inline int size() const { return m_Mag.size(); }
+#endif
 
+#ifdef KSTARS_LITE
     /**
      * @short  Return the i-th star in this StarBlock
      *
@@ -117,6 +145,48 @@ class StarBlock
      */
 
     inline QVector<StarBlockEntry> &contents() { return stars; }
+#else
+    /**
+     * @short  Return the i-th star in this StarBlock as a StarObject, made on first use.
+     *
+     * The star is read again from the catalog file, so it carries all the catalog data, and its
+     * coordinates are updated. The pointer remains valid as long as the block, but the StarObject
+     * is reused for another star once the block is recycled.
+     *
+     * @param  i Index of the star
+     * @return A pointer to the i-th star
+     */
+    StarObject *star(int i);
+
+    /**
+     * @short  Update the current coordinates of the stars, from the brightest up to the first one
+     *         fainter than maglim, as StarObject::JITupdate() does for a single star.
+     *
+     * Stars already up to date are skipped, so this is cheap to call on every draw. The stars
+     * left are converted together by transform, which must be set up for the current epoch,
+     * sidereal time and location.
+     */
+    void JITupdate(float maglim, const EpochTransform &transform);
+
+    /** @return the magnitude of the i-th star */
+    inline float mag(int i) const { return m_Mag[i]; }
+
+    /** @return the first character of the spectral type of the i-th star */
+    inline char spchar(int i) const { return m_SpType[i]; }
+
+    /**
+     * @short  Set the current equatorial and horizontal coordinates of point to those of the
+     *         i-th star, as last computed by JITupdate()
+     */
+    void position(int i, SkyPoint &point) const;
+
+    /**
+     * @short  Draw the stars brighter than maglim, at the coordinates last computed by JITupdate()
+     *
+     * @return The number of stars drawn
+     */
+    int draw(SkyPainter *skyp, float maglim) const;
+#endif
 
     // These methods are there because we might want to make faintMag and brightMag private at some point
     /**
@@ -149,6 +219,8 @@ class StarBlock
     std::shared_ptr<StarBlock> prev;
     std::shared_ptr<StarBlock> next;
     quint32 drawID { 0 };
+    /** Index within its trixel in the catalog file of the first star of this block */
+    quint32 firstRecord { 0 };
 
   private:
     // Disallow copying and assignment. Just in case.
@@ -157,6 +229,36 @@ class StarBlock
 
     /** Number of initialized stars in StarBlock. */
     int nStars { 0 };
+#ifdef KSTARS_LITE
     /** Array of stars. */
     QVector<StarBlockEntry> stars;
+#else
+    /** @short Append a star, updating the magnitude range of the block */
+    int addStar(double ra, double dec, float mag, char sp, double pmRA, double pmDec);
+
+    /** Catalog coordinates, RA in hours and Dec in degrees */
+    QVector<float> m_RA0;
+    QVector<float> m_Dec0;
+    /** Proper motion in mas/yr, RA multiplied by cos(dec) */
+    QVector<float> m_PMRA;
+    QVector<float> m_PMDec;
+    QVector<float> m_Mag;
+    QVector<char> m_SpType;
+    /** Current coordinates, RA in hours and the others in degrees */
+    QVector<float> m_RA;
+    QVector<float> m_Dec;
+    QVector<float> m_Alt;
+    QVector<float> m_Az;
+
+    /** Stars whose current RA and Dec, and their horizontal coordinates, are up to date */
+    int nPrecessed { 0 };
+    int nUpdated { 0 };
+    quint64 updateID { 0 };
+    quint64 updateNumID { 0 };
+    long double precessJD { 0 };
+
+    /** Stars made by star(), and those kept from before the block was last reset */
+    std::unordered_map<int, std::unique_ptr<StarObject>> m_Objects;
+    std::vector<std::unique_ptr<StarObject>> m_SpareObjects;
+#endif
 };
@@ -21,6 +21,7 @@
 #include "deepstarcomponent.h"
 #include "starblock.h"
 #include "starcomponent.h"
+#include "skyobjects/starobject.h"
 
 #ifdef KSTARS_LITE
 #include "skymaplite.h"
@@ -70,6 +71,21 @@ int StarBlockList::releaseBlock(StarBlock *block)
     return 0;
 }
 
+void StarBlockList::prefetchToMag(float maglim)
+{
+    BinFileHelper *dSReader = parent->getStarReader();
+
+    if (staticStars || faintMag >= maglim || !dSReader->isMapped())
+        return;
+
+    const unsigned long records = dSReader->getRecordCount(trixel);
+    if (nStars >= records)
+        return;
+
+    const long offset = (readOffset <= 0) ? dSReader->getOffset(trixel) : readOffset;
+    dSReader->adviseWillNeed(offset, (records - nStars) * dSReader->guessRecordSize());
+}
+
 bool StarBlockList::fillToMag(float maglim)
 {
     // TODO: Remove staticity of BinFileHelper
@@ -103,7 +119,13 @@ bool StarBlockList::fillToMag(float maglim)
 
     Q_ASSERT(nBlocks == (unsigned int)blocks.size());
 
-    BinFileHelper::unsigned_KDE_fseek(dataFile, readOffset, SEEK_SET);
+    const int recordSize        = dSReader->guessRecordSize();
+    const unsigned long records = dSReader->getRecordCount(trixelId);
+
+    // Decode the records straight from the mapping if the file is mapped, else seek and read them one by one
+    const uchar *data = (nStars < records) ? dSReader->mappedData(readOffset, (records - nStars) * recordSize) : nullptr;
+    if (!data)
+        BinFileHelper::unsigned_KDE_fseek(dataFile, readOffset, SEEK_SET);
 
     /*
     qDebug() << "Reading trixel" << trixel << ", id on disk =" << trixelId << ", currently nStars =" << nStars
@@ -111,10 +133,8 @@ bool StarBlockList::fillToMag(float maglim)
              << "to maglim =" << maglim << "with current faintMag =" << faintMag;
     */
 
-    while (maglim >= faintMag && nStars < dSReader->getRecordCount(trixelId))
+    while (maglim >= faintMag && nStars < records)
     {
-        int ret = 0;
-
         if (nBlocks == 0 || blocks[nBlocks - 1]->isFull())
         {
             std::shared_ptr<StarBlock> newBlock = SBFactory->getBlock();
@@ -126,7 +146,8 @@ bool StarBlockList::fillToMag(float maglim)
                 return false;
             }
             blocks.append(newBlock);
-            blocks[nBlocks]->parent = this;
+            blocks[nBlocks]->parent      = this;
+            blocks[nBlocks]->firstRecord = nStars;
             if (nBlocks == 0)
                 SBFactory->markFirst(blocks[0]);
             else if (!SBFactory->markNext(blocks[nBlocks - 1], blocks[nBlocks]))
@@ -135,9 +156,13 @@ bool StarBlockList::fillToMag(float maglim)
             ++nBlocks;
         }
         // TODO: Make this more general
-        if (dSReader->guessRecordSize() == 32)
+        if (recordSize == 32)
         {
-            ret = fread(&stardata, sizeof(StarData), 1, dataFile);
+            if (!BinFileHelper::readRecord(stardata, data, dataFile))
+            {
+                qWarning() << "ERROR: Could not read StarData structure for star #" << nStars << "in trixel" << trixel;
+                return false;
+            }
             if (dSReader->getByteSwap())
                 DeepStarComponent::byteSwap(&stardata);
             readOffset += sizeof(StarData);
@@ -145,7 +170,11 @@ bool StarBlockList::fillToMag(float maglim)
         }
         else
         {
-            ret = fread(&deepstardata, sizeof(DeepStarData), 1, dataFile);
+            if (!BinFileHelper::readRecord(deepstardata, data, dataFile))
+            {
+                qWarning() << "ERROR: Could not read DeepStarData structure for star #" << nStars << "in trixel" << trixel;
+                return false;
+            }
             if (dSReader->getByteSwap())
                 DeepStarComponent::byteSwap(&deepstardata);
             readOffset += sizeof(DeepStarData);
@@ -165,6 +194,44 @@ bool StarBlockList::fillToMag(float maglim)
     return ((maglim < faintMag) ? true : false);
 }
 
+bool StarBlockList::readStar(quint32 index, StarObject &star) const
+{
+    BinFileHelper *dSReader = parent->getStarReader();
+    FILE *dataFile          = dSReader->getFileHandle();
+
+    if (!dataFile || index >= dSReader->getRecordCount(trixel))
+        return false;
+
+    const int recordSize = dSReader->guessRecordSize();
+    const quint64 offset = quint64(dSReader->getOffset(trixel)) + quint64(index) * recordSize;
+
+    // fillToMag() seeks before reading, so moving the file position here is harmless
+    const uchar *data = dSReader->mappedData(offset, recordSize);
+    if (!data && BinFileHelper::unsigned_KDE_fseek(dataFile, offset, SEEK_SET) != 0)
+        return false;
+
+    if (recordSize == 32)
+    {
+        StarData stardata;
+        if (!BinFileHelper::readRecord(stardata, data, dataFile))
+            return false;
+        if (dSReader->getByteSwap())
+            DeepStarComponent::byteSwap(&stardata);
+        star.init(&stardata);
+    }
+    else
+    {
+        DeepStarData deepstardata;
+        if (!BinFileHelper::readRecord(deepstardata, data, dataFile))
+            return false;
+        if (dSReader->getByteSwap())
+            DeepStarComponent::byteSwap(&deepstardata);
+        star.init(&deepstardata);
+    }
+
+    return true;
+}
+
 void StarBlockList::setStaticBlock(std::shared_ptr<StarBlock> &block)
 {
     if (!block)
@@ -21,6 +21,7 @@
 
 class DeepStarComponent;
 class StarBlock;
+class StarObject;
 
 /**
  * @class StarBlockList
@@ -48,6 +49,25 @@ class StarBlockList
      */
     bool fillToMag(float maglim);
 
+    /**
+     * @short Hints that fillToMag() is about to be called, so that the records it
+     * will read are paged in meanwhile
+     *
+     * Does nothing unless the catalog file is memory-mapped.
+     *
+     * @param maglim Magnitude limit fillToMag() will be called with
+     */
+    void prefetchToMag(float maglim);
+
+    /**
+     * @short Reads the given star of this trixel again from the catalog file
+     *
+     * @param index Index of the star within the trixel
+     * @param star StarObject to initialize with the record
+     * @return true on success, false if the record could not be read
+     */
+    bool readStar(quint32 index, StarObject &star) const;
+
     /**
      * @short Sets the first StarBlock in the list to point to the given StarBlock
      *
@@ -442,33 +442,38 @@ bool StarComponent::loadStaticData()
                           << nameReader.getError();
         return false;
     }
-    //KDE_fseek(nameFile, nameReader.getDataOffset(), SEEK_SET);
-    QT_FSEEK(nameFile, nameReader.getDataOffset(), SEEK_SET);
+    // Decode the records straight from memory when the files can be mapped, else read them one by one
+    const uchar *names = nullptr;
+    if (nameReader.mapFile())
+        names = nameReader.mappedData(nameReader.getDataOffset(),
+                                      quint64(nameReader.getRecordCount()) * sizeof(starName));
+    if (!names)
+        QT_FSEEK(nameFile, nameReader.getDataOffset(), SEEK_SET);
     swapBytes = dataReader.getByteSwap();
 
     long int nstars = 0;
 
-    //KDE_fseek(dataFile, dataReader.getDataOffset(), SEEK_SET);
-    QT_FSEEK(dataFile, dataReader.getDataOffset(), SEEK_SET);
+    const uchar *data = nullptr;
+    if (dataReader.mapFile())
+        data = dataReader.mappedData(dataReader.getDataOffset(),
+                                     5 + quint64(dataReader.getRecordCount()) * sizeof(StarData));
+    if (!data)
+        QT_FSEEK(dataFile, dataReader.getDataOffset(), SEEK_SET);
 
     qint16 faintmag;
     quint8 htm_level;
     quint16 t_MSpT;
-    int ret = 0;
 
     // Faint Magnitude
-    ret = fread(&faintmag, 2, 1, dataFile);
+    BinFileHelper::readRecord(faintmag, data, dataFile);
     if (swapBytes)
         faintmag = bswap_16(faintmag);
 
     // HTM Level
-    ret = fread(&htm_level, 1, 1, dataFile);
+    BinFileHelper::readRecord(htm_level, data, dataFile);
 
     // Unused
-    {
-        int rc = fread(&t_MSpT, 2, 1, dataFile);
-        Q_UNUSED(rc)
-    }
+    BinFileHelper::readRecord(t_MSpT, data, dataFile);
 
     if (faintmag / 100.0 > m_FaintMagnitude)
         m_FaintMagnitude = faintmag / 100.0;
@@ -482,7 +487,7 @@ bool StarComponent::loadStaticData()
         Trixel trixel = i; // = ( ( i >= 256 ) ? ( i - 256 ) : ( i + 256 ) );
         for (unsigned long j = 0; j < static_cast<unsigned long>(dataReader.getRecordCount(i)); ++j)
         {
-            if (1 != fread(&stardata, sizeof(StarData), 1, dataFile))
+            if (!BinFileHelper::readRecord(stardata, data, dataFile))
             {
                 qCCritical(KSTARS) << "FILE FORMAT ERROR: Could not read StarData structure for star #" << j << " under trixel #"
                                    << trixel;
@@ -500,7 +505,7 @@ bool StarComponent::loadStaticData()
             if (stardata.flags & 0x01)
             {
                 visibleName = "";
-                if (1 != fread(&starname, sizeof(starName), 1, nameFile))
+                if (!BinFileHelper::readRecord(starname, names, nameFile))
                     qCCritical(KSTARS) << "ERROR: fread() call on nameFile failed in trixel " << trixel << " star " << j;
 
                 name  = QByteArray(starname.longName, 32);
@@ -631,27 +636,26 @@ StarObject *StarComponent::findByHDIndex(int HDnum)
     if (m_DeepStarComponents.size() >= 2)
     {
         qint32 offset = 0;
-        int ret = 0;
         FILE *hdidxFile = hdidxReader.openFile("Henry-Draper.idx");
         FILE *dataFile = nullptr;
 
-        if (!hdidxFile)
+        if (!hdidxFile || HDnum <= 0)
             return nullptr;
         //KDE_fseek( hdidxFile, (HDnum - 1) * 4, SEEK_SET );
         QT_FSEEK(hdidxFile, (HDnum - 1) * 4, SEEK_SET);
         // TODO: Offsets need to be byteswapped if this is a big endian machine.
         // This means that the Henry Draper Index needs a endianness indicator.
-        ret = fread(&offset, 4, 1, hdidxFile);
-        if (offset <= 0)
+        if (1 != fread(&offset, 4, 1, hdidxFile) || offset <= 0)
             return nullptr;
-        dataFile = m_DeepStarComponents.at(1)->getStarReader()->getFileHandle();
-        //KDE_fseek( dataFile, offset, SEEK_SET );
-        QT_FSEEK(dataFile, offset, SEEK_SET);
-        {
-            int rc = fread(&stardata, sizeof(StarData), 1, dataFile);
-            Q_UNUSED(rc)
-        }
-        if (m_DeepStarComponents.at(1)->getStarReader()->getByteSwap())
+        // The deep star catalog is mapped when it is opened, so the record is copied without a seek
+        BinFileHelper *dataReader = m_DeepStarComponents.at(1)->getStarReader();
+        dataFile = dataReader->getFileHandle();
+        const uchar *data = dataReader->mappedData(offset, sizeof(StarData));
+        if (!data)
+            QT_FSEEK(dataFile, offset, SEEK_SET);
+        if (!BinFileHelper::readRecord(stardata, data, dataFile))
+            return nullptr;
+        if (dataReader->getByteSwap())
         {
             byteSwap(&stardata);
         }
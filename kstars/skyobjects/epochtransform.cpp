@@ -0,0 +1,161 @@
+/*  Epoch Transform
+    Batched conversion of catalog star positions to apparent and horizontal coordinates.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#include "epochtransform.h"
+
+#include "ksnumbers.h"
+#include "dms.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Stars are processed in chunks kept on the stack, so that the arrays below are not allocated
+constexpr int ChunkSize = 256;
+typedef Eigen::Array<float, Eigen::Dynamic, 1, 0, ChunkSize, 1> Chunk;
+typedef Eigen::Array<bool, Eigen::Dynamic, 1, 0, ChunkSize, 1> Mask;
+typedef Eigen::Map<const Eigen::ArrayXf> ConstArray;
+
+// Rotation about the X axis, from equatorial to ecliptic coordinates for the obliquity epsilon
+Eigen::Matrix3d toEcliptic(double epsilon)
+{
+    const double c = std::cos(epsilon), s = std::sin(epsilon);
+    Eigen::Matrix3d m;
+    m << 1, 0, 0,
+    0, c, s,
+    0, -s, c;
+    return m;
+}
+
+// Write the right ascensions in hours and declinations in degrees of the vectors (x, y, z)
+void toEquatorial(int count, const Chunk &x, const Chunk &y, const Chunk &z, float *ra, float *dec)
+{
+    // No vectorized atan2 in Eigen, but this is the only scalar part
+    for (int i = 0; i < count; ++i)
+    {
+        float alpha = std::atan2(y[i], x[i]) * float(12.0 / M_PI);
+        if (alpha < 0)
+            alpha += 24.0f;
+        ra[i]  = alpha;
+        dec[i] = std::atan2(z[i], std::sqrt(x[i] * x[i] + y[i] * y[i])) * float(180.0 / M_PI);
+    }
+}
+}
+
+EpochTransform::EpochTransform(const KSNumbers *num, const dms *LST, const dms *lat)
+{
+    // Precession, as in SkyPoint::precess()
+    const Eigen::Matrix3d &precession = num->p2();
+
+    // Nutation as a rotation: to ecliptic coordinates of the mean equator, by the nutation in
+    // longitude, and back with the true obliquity. See SkyPoint::nutate() near the poles.
+    const double trueObliquity = num->obliquity()->radians();
+    const double meanObliquity = trueObliquity - num->dObliq() * dms::DegToRad;
+    const double dPsi          = num->dEcLong() * dms::DegToRad;
+    Eigen::Matrix3d longitude;
+    longitude << std::cos(dPsi), -std::sin(dPsi), 0,
+              std::sin(dPsi), std::cos(dPsi), 0,
+              0, 0, 1;
+    m_Rotation  = toEcliptic(trueObliquity).transpose() * longitude * toEcliptic(meanObliquity) * precession;
+    m_RotationF = m_Rotation.cast<float>();
+
+    // Aberration, the vector form of Meeus equation (23.3) used by SkyPoint::aberrate()
+    double sinOb, cosOb, sinL, cosL, sinP, cosP;
+    num->obliquity()->SinCos(sinOb, cosOb);
+    num->sunTrueLongitude().SinCos(sinL, cosL);
+    num->earthPerihelionLongitude().SinCos(sinP, cosP);
+    const double K = num->constAberr().radians();
+    const double e = num->earthEccentricity();
+    m_Aberration   = Eigen::Vector3d(K * (sinL - e * sinP), K * cosOb * (e * cosP - cosL), K * sinOb * (e * cosP - cosL))
+                     .cast<float>();
+
+    // Proper motion, as in StarObject::getIndexCoords()
+    m_PMScale     = num->julianMillenia() * (M_PI / (180.0 * 3600.0));
+    m_PMThreshold = .01 / (num->julianMillenia() * num->julianMillenia());
+
+    // Horizontal coordinates, as in SkyPoint::EquatorialToHorizontal()
+    double sinLST, cosLST, sinLat, cosLat;
+    LST->SinCos(sinLST, cosLST);
+    lat->SinCos(sinLat, cosLat);
+    Eigen::Matrix3d horizon;
+    horizon << -sinLat * cosLST, -sinLat * sinLST, cosLat,
+            -sinLST, cosLST, 0,
+            cosLat * cosLST, cosLat * sinLST, sinLat;
+    m_Horizon = horizon.cast<float>();
+}
+
+void EpochTransform::apparent(int count, const float *ra0, const float *dec0, const float *pmRA, const float *pmDec,
+                              float *ra, float *dec) const
+{
+    const Eigen::Matrix3f &R = m_RotationF;
+    const Eigen::Vector3f &b = m_Aberration;
+
+    for (int first = 0; first < count; first += ChunkSize)
+    {
+        const int n = std::min(ChunkSize, count - first);
+
+        const Chunk alpha = ConstArray(ra0 + first, n) * float(M_PI / 12.0);
+        const Chunk delta = ConstArray(dec0 + first, n) * float(M_PI / 180.0);
+        const Chunk sinRA = alpha.sin(), cosRA = alpha.cos();
+        const Chunk sinDec = delta.sin(), cosDec = delta.cos();
+
+        // Proper motion, neglected below a tenth of an arcsecond like StarObject does
+        Chunk muRA  = ConstArray(pmRA + first, n);
+        Chunk muDec = ConstArray(pmDec + first, n);
+        const Mask neglected = (muRA.square() + muDec.square()) < m_PMThreshold;
+        muRA  = neglected.select(0.0f, muRA * m_PMScale);
+        muDec = neglected.select(0.0f, muDec * m_PMScale);
+
+        const Chunk x0 = cosDec * cosRA - muRA * sinRA - muDec * sinDec * cosRA;
+        const Chunk y0 = cosDec * sinRA + muRA * cosRA - muDec * sinDec * sinRA;
+        const Chunk z0 = sinDec + muDec * cosDec;
+
+        // Precession and nutation
+        Chunk x = R(0, 0) * x0 + R(0, 1) * y0 + R(0, 2) * z0;
+        Chunk y = R(1, 0) * x0 + R(1, 1) * y0 + R(1, 2) * z0;
+        Chunk z = R(2, 0) * x0 + R(2, 1) * y0 + R(2, 2) * z0;
+
+        // Aberration, keeping the component of the velocity across the line of sight
+        const Chunk along = b[0] * x + b[1] * y + b[2] * z;
+        x += b[0] - along * x;
+        y += b[1] - along * y;
+        z += b[2] - along * z;
+
+        toEquatorial(n, x, y, z, ra + first, dec + first);
+    }
+}
+
+void EpochTransform::horizontal(int count, const float *ra, const float *dec, float *alt, float *az) const
+{
+    const Eigen::Matrix3f &H = m_Horizon;
+
+    for (int first = 0; first < count; first += ChunkSize)
+    {
+        const int n = std::min(ChunkSize, count - first);
+
+        const Chunk alpha = ConstArray(ra + first, n) * float(M_PI / 12.0);
+        const Chunk delta = ConstArray(dec + first, n) * float(M_PI / 180.0);
+        const Chunk cosDec = delta.cos();
+        const Chunk x = cosDec * alpha.cos(), y = cosDec * alpha.sin(), z = delta.sin();
+
+        const Chunk north  = H(0, 0) * x + H(0, 1) * y + H(0, 2) * z;
+        const Chunk east   = H(1, 0) * x + H(1, 1) * y;
+        const Chunk zenith = H(2, 0) * x + H(2, 1) * y + H(2, 2) * z;
+
+        for (int i = 0; i < n; ++i)
+        {
+            float A = std::atan2(east[i], north[i]) * float(180.0 / M_PI);
+            if (A < 0)
+                A += 360.0f;
+            az[first + i]  = A;
+            alt[first + i] = std::atan2(zenith[i], std::sqrt(north[i] * north[i] + east[i] * east[i])) * float(180.0 / M_PI);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/*  Epoch Transform
+    Batched conversion of catalog star positions to apparent and horizontal coordinates.
+
+    This application is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#if __GNUC__ > 5
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#endif
+#if __GNUC__ > 6
+#pragma GCC diagnostic ignored "-Wint-in-bool-context"
+#endif
+#include <Eigen/Core>
+#if __GNUC__ > 5
+#pragma GCC diagnostic pop
+#endif
+
+class dms;
+class KSNumbers;
+
+/**
+ * @class EpochTransform
+ *
+ * Converts the catalog positions of many stars at once, as StarObject::updateCoords() followed by
+ * SkyPoint::EquatorialToHorizontal() would do for each of them.
+ *
+ * For stars, which are far enough to neglect parallax, precession and nutation at a given epoch
+ * are one rotation, and aberration one small shift along the velocity of the Earth. Both are set
+ * up once from KSNumbers, then applied to the unit vectors of the stars with Eigen, so that the
+ * arithmetic runs on SIMD registers. Proper motion is applied first, as in
+ * StarObject::getIndexCoords().
+ *
+ * The nutation rotation is exact where SkyPoint::nutate() uses the approximation of Meeus away from
+ * the poles, and aberration is applied in vector form. Both agree to a few milliarcseconds.
+ * The bending of light by the Sun is not applied.
+ */
+class EpochTransform
+{
+    public:
+        /**
+         * @short Prepare the transform from J2000 to the apparent place
+         * @param num Numbers of the epoch
+         * @param LST Local sidereal time, for horizontal coordinates
+         * @param lat Geographic latitude, for horizontal coordinates
+         */
+        EpochTransform(const KSNumbers *num, const dms *LST, const dms *lat);
+
+        /**
+         * @short Compute the apparent place of stars
+         * @param count Number of stars
+         * @param ra0 Catalog right ascensions, in hours
+         * @param dec0 Catalog declinations, in degrees
+         * @param pmRA Proper motions in right ascension multiplied by cos(dec), in mas/yr
+         * @param pmDec Proper motions in declination, in mas/yr
+         * @param ra Apparent right ascensions in hours, in [0, 24)
+         * @param dec Apparent declinations in degrees
+         */
+        void apparent(int count, const float *ra0, const float *dec0, const float *pmRA, const float *pmDec, float *ra,
+                      float *dec) const;
+
+        /**
+         * @short Compute the horizontal coordinates of stars
+         * @param count Number of stars
+         * @param ra Apparent right ascensions, in hours
+         * @param dec Apparent declinations, in degrees
+         * @param alt Altitudes in degrees, without refraction
+         * @param az Azimuths in degrees, from the North through the East, in [0, 360)
+         */
+        void horizontal(int count, const float *ra, const float *dec, float *alt, float *az) const;
+
+        /** @return the rotation applying precession then nutation */
+        inline const Eigen::Matrix3d &rotation() const { return m_Rotation; }
+
+    private:
+        /** Precession then nutation */
+        Eigen::Matrix3d m_Rotation;
+        Eigen::Matrix3f m_RotationF;
+        /** Velocity of the Earth in units of the speed of light, as the constant of aberration in radians */
+        Eigen::Vector3f m_Aberration;
+        /** Proper motion from mas/yr to radians at the epoch */
+        float m_PMScale { 0 };
+        /** Proper motion below this squared displacement in arcsec is neglected, as StarObject does */
+        float m_PMThreshold { 0 };
+        /** Equatorial to horizontal, rows pointing North, East and to the zenith */
+        Eigen::Matrix3f m_Horizon;
+};
@@ -30,6 +30,7 @@
 #include "skyobjects/ksplanetbase.h"
 #include "skyobjects/trailobject.h"
 #include "skyobjects/constellationsart.h"
+#include "skyobjects/skypoint.h"
 
 SkyPainter::SkyPainter()
 {
@@ -60,3 +61,44 @@ float SkyPainter::starWidth(float mag) const
 
     return size;
 }
+
+int SkyPainter::drawPointSources(int count, const float *ra, const float *dec, const float *alt, const float *az,
+                                 const float *mag, const char *sp, bool *drawn)
+{
+    int nDrawn = 0;
+    SkyPoint point;
+    for (int i = 0; i < count; ++i)
+    {
+        point.setRA(ra[i]);
+        point.setDec(dec[i]);
+        point.setAlt(alt[i]);
+        point.setAz(az[i]);
+
+        const bool isDrawn = drawPointSource(&point, mag[i], sp ? sp[i] : 'A');
+        if (drawn)
+            drawn[i] = isDrawn;
+        if (isDrawn)
+            nDrawn++;
+    }
+    return nDrawn;
+}
+
+int SkyPainter::drawPointSources(int count, const SkyPoint *const *points, const float *mag, bool *drawn)
+{
+    int nDrawn = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const bool isDrawn = drawPointSource(points[i], mag[i]);
+        if (drawn)
+            drawn[i] = isDrawn;
+        if (isDrawn)
+            nDrawn++;
+    }
+    return nDrawn;
+}
+
+bool SkyPainter::drawCatalogObject(const CatalogObject &obj, const QPointF &pos)
+{
+    Q_UNUSED(pos)
+    return drawCatalogObject(obj);
+}
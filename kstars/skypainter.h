@@ -130,6 +130,33 @@ class SkyPainter
          */
     virtual bool drawPointSource(const SkyPoint *loc, float mag, char sp = 'A') = 0;
 
+        /**
+         * @short Draw many point sources at once, e.g. the stars of a StarBlock.
+         * The default implementation calls drawPointSource() for each of them.
+         * @param count the number of sources
+         * @param ra the current right ascensions of the sources, in hours
+         * @param dec the current declinations of the sources, in degrees
+         * @param alt the current altitudes of the sources, in degrees
+         * @param az the current azimuths of the sources, in degrees
+         * @param mag the magnitudes of the sources
+         * @param sp the spectral classes of the sources, or nullptr for class A
+         * @param drawn if not null, set to whether each source was drawn
+         * @return the number of sources drawn
+         * @see Projector::toScreenBatch()
+         */
+        virtual int drawPointSources(int count, const float *ra, const float *dec, const float *alt, const float *az,
+                                     const float *mag, const char *sp = nullptr, bool *drawn = nullptr);
+
+        /**
+         * @short Draw many point sources of class A at once.
+         * @param count the number of sources
+         * @param points the locations of the sources
+         * @param mag the magnitudes of the sources
+         * @param drawn if not null, set to whether each source was drawn
+         * @return the number of sources drawn
+         */
+        virtual int drawPointSources(int count, const SkyPoint *const *points, const float *mag, bool *drawn = nullptr);
+
         /**
      * @short Draw a deep sky object (loaded from the new implementation)
      * @param obj the object to draw
@@ -138,6 +165,15 @@ class SkyPainter
      */
     virtual bool drawCatalogObject(const CatalogObject &obj) = 0;
 
+    /**
+     * @short Draw a deep sky object already projected, e.g. by Projector::toScreenBatch()
+     * The default implementation projects it again with drawCatalogObject().
+     * @param obj the object to draw
+     * @param pos the position of the object on screen
+     * @return true if a valid object was drawn, as drawCatalogObject(const CatalogObject &)
+     */
+    virtual bool drawCatalogObject(const CatalogObject &obj, const QPointF &pos);
+
     /**
          * @short Draw a planet
          * @param planet the planet to draw
@@ -21,6 +21,8 @@
 
 #include <QPointer>
 
+#include <algorithm>
+
 #include "kstarsdata.h"
 #include "Options.h"
 #include "skymap.h"
@@ -598,6 +600,61 @@ bool SkyQPainter::drawPointSource(const SkyPoint *loc, float mag, char sp)
     }
 }
 
+int SkyQPainter::drawPointSources(int count, const float *ra, const float *dec,
+                                  const float *alt, const float *az, const float *mag,
+                                  const char *sp, bool *drawn)
+{
+    float x[Projector::BatchSize], y[Projector::BatchSize];
+    bool visible[Projector::BatchSize];
+
+    int nDrawn = 0;
+    for (int first = 0; first < count; first += Projector::BatchSize)
+    {
+        const int n = std::min(Projector::BatchSize, count - first);
+        m_proj->toScreenBatch(n, ra + first, dec + first, alt + first, az + first, x, y,
+                              visible);
+        nDrawn += drawProjectedPointSources(n, x, y, visible, mag + first,
+                                            sp ? sp + first : nullptr,
+                                            drawn ? drawn + first : nullptr);
+    }
+    return nDrawn;
+}
+
+int SkyQPainter::drawPointSources(int count, const SkyPoint *const *points,
+                                  const float *mag, bool *drawn)
+{
+    float x[Projector::BatchSize], y[Projector::BatchSize];
+    bool visible[Projector::BatchSize];
+
+    int nDrawn = 0;
+    for (int first = 0; first < count; first += Projector::BatchSize)
+    {
+        const int n = std::min(Projector::BatchSize, count - first);
+        m_proj->toScreenBatch(n, points + first, x, y, visible);
+        nDrawn += drawProjectedPointSources(n, x, y, visible, mag + first, nullptr,
+                                            drawn ? drawn + first : nullptr);
+    }
+    return nDrawn;
+}
+
+int SkyQPainter::drawProjectedPointSources(int count, const float *x, const float *y,
+                                           const bool *visible, const float *mag,
+                                           const char *sp, bool *drawn)
+{
+    int nDrawn = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (visible[i])
+        {
+            drawPointSource(QPointF(x[i], y[i]), starWidth(mag[i]), sp ? sp[i] : 'A');
+            nDrawn++;
+        }
+        if (drawn)
+            drawn[i] = visible[i];
+    }
+    return nDrawn;
+}
+
 void SkyQPainter::drawPointSource(const QPointF &pos, float size, char sp)
 {
     int isize = qMin(static_cast<int>(size), 14);
@@ -725,6 +782,11 @@ bool SkyQPainter::drawCatalogObject(const CatalogObject &obj)
     if (!visible || !m_proj->onScreen(pos))
         return false;
 
+    return drawCatalogObject(obj, pos);
+}
+
+bool SkyQPainter::drawCatalogObject(const CatalogObject &obj, const QPointF &pos)
+{
     // if size is 0.0 set it to 1.0, this are normally stars (type 0 and 1)
     // if we use size 0.0 the star wouldn't be drawn
     float majorAxis = obj.a();
@@ -88,7 +88,12 @@ class SkyQPainter : public SkyPainter, public QPainter
                          LineListLabel *label = nullptr) override;
     void drawSkyPolygon(LineList *list, bool forceClip = true) override;
     bool drawPointSource(const SkyPoint *loc, float mag, char sp = 'A') override;
+    int drawPointSources(int count, const float *ra, const float *dec, const float *alt, const float *az,
+                         const float *mag, const char *sp = nullptr, bool *drawn = nullptr) override;
+    int drawPointSources(int count, const SkyPoint *const *points, const float *mag,
+                         bool *drawn = nullptr) override;
     bool drawCatalogObject(const CatalogObject &obj) override;
+    bool drawCatalogObject(const CatalogObject &obj, const QPointF &pos) override;
     void drawCatalogObjectImage(const QPointF &pos, const CatalogObject &obj,
                                 float positionAngle);
     bool drawPlanet(KSPlanetBase *planet) override;
@@ -109,6 +114,10 @@ class SkyQPainter : public SkyPainter, public QPainter
     bool drawTerrain() override;
 
   private:
+    /** Draw the visible point sources of a batch projected by Projector::toScreenBatch() */
+    int drawProjectedPointSources(int count, const float *x, const float *y, const bool *visible,
+                                  const float *mag, const char *sp, bool *drawn);
+
     QPaintDevice *m_pd{ nullptr };
     const Projector *m_proj{ nullptr };
     bool m_vectorStars{ false };